@@ -9,3 +9,36 @@ void Add_Force(const T_DATA (&x_Blocked)[4][3],
                const T_DATA &strainMin,
                const T_DATA &strainMax,
                T_DATA (&f_Blocked)[4][3]);
+
+// Add_Force over a whole block of BlockWidth elements, Tarch::Width elements at a time
+template<class Tarch, class T, int BlockWidth>
+void Add_Force_Block(const T (&x_Blocked)[4][3][BlockWidth],
+                     const T (&DmInverse_Blocked)[9][BlockWidth],
+                     const T (&restVolume)[BlockWidth],
+                     const T (&muLow)[BlockWidth],
+                     const T (&muHigh)[BlockWidth],
+                     const T (&strainMin)[BlockWidth],
+                     const T (&strainMax)[BlockWidth],
+                     T (&f_Blocked)[4][3][BlockWidth]);
+
+template<class T, int BlockWidth>
+using Add_Force_Block_Function = void (*)(const T (&)[4][3][BlockWidth],
+                                          const T (&)[9][BlockWidth],
+                                          const T (&)[BlockWidth],
+                                          const T (&)[BlockWidth],
+                                          const T (&)[BlockWidth],
+                                          const T (&)[BlockWidth],
+                                          const T (&)[BlockWidth],
+                                          T (&)[4][3][BlockWidth]);
+
+// Instruction sets the Add_Force kernel is built for. The AVX2 instance lives in Add_Force.cpp,
+// the scalar one in Add_Force_Scalar.cpp (built without AVX code generation) and the AVX-512 one
+// in Add_Force_AVX512.cpp (built with AVX-512 code generation, only when ENABLE_AVX512_KERNELS is defined).
+enum class SIMDArchitectureType { Scalar = 0, AVX2 = 1, AVX512 = 2 };
+
+// widest instruction set supported by both the cpu (CPUID) and the build
+SIMDArchitectureType Detect_SIMD_Architecture();
+
+// throws std::logic_error when the requested instruction set is not part of the build
+template<class T, int BlockWidth>
+Add_Force_Block_Function<T, BlockWidth> Select_Add_Force_Block(const SIMDArchitectureType architecture);
@@ -0,0 +1,12 @@
+//#####################################################################
+// Copyright (c) 2019, Eftychios Sifakis, Yutian Tao, Qisi Wang
+// Distributed under the FreeBSD license (see license.txt)
+//#####################################################################
+
+#pragma once
+
+#include <tbb/task_arena.h>
+
+// OpenMP and MKL know nothing of TBB arenas, so their parallel regions would otherwise each take every core.
+// Sizing them to the arena the calling task runs in keeps a scene inside the share of cores its scheduler was given.
+inline int arenaThreads() { return tbb::this_task_arena::max_concurrency(); }
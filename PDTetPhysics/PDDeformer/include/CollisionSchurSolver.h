@@ -0,0 +1,193 @@
+//#####################################################################
+// Copyright (c) 2019, Eftychios Sifakis, Yutian Tao, Qisi Wang
+// Distributed under the FreeBSD license (see license.txt)
+//#####################################################################
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "SchurSolver.h"
+
+namespace PhysBAM {
+
+// CPU counterpart of CudaSolver for the inner collision iterations of PDTetSolver::solve(). The collision
+// nodes are numbered last and left uneliminated by the sparse factor of SchurSolver, so forward and backward
+// substitution only touch the interior, while the dense Schur complement S of the collision block plus the
+// collision constraint and suture tensors is factored here by a blocked Cholesky parallelized with TBB.
+// Each inner iteration re-evaluates the collision element and collision forces at the current positions and
+// solves the dense block only; the coupling of the other elements is carried by m_f2 -= (S - A22) * x2.
+// S couples two collision nodes only if they are connected in the system matrix, so it is kept as one dense
+// block per connected component, storing the upper triangle only. A block is reset from its S and refactored
+// only when the collision terms on it changed since the last frame, and the full schurSize x schurSize array
+// the sparse solver returns S in is only allocated while factoring.
+template <class Discretization, class IntType> struct CollisionSchurSolver {
+
+    using AssemblyType = SchurSolver<Discretization, IntType>;
+    using DiscretizationType = Discretization;
+    using StateVariableType = typename AssemblyType::StateVariableType;
+    using IteratorType = typename AssemblyType::IteratorType;
+    using IndexType = typename AssemblyType::IndexType;
+    using VectorType = typename AssemblyType::VectorType;
+    using T = typename AssemblyType::T;
+    static constexpr int d = AssemblyType::d;
+    static constexpr int elementNodes = AssemblyType::elementNodes;
+
+    using GradientMatrixType = typename AssemblyType::GradientMatrixType;
+    using ElementType = typename AssemblyType::ElementType;
+    using NodeArrayType = typename AssemblyType::NodeArrayType;
+    using Constraint = typename AssemblyType::Constraint;
+    using Suture = typename AssemblyType::Suture;
+    using CollisionSuture = typename AssemblyType::CollisionSuture;
+    using InternodeConstraint = typename AssemblyType::InternodeConstraint;
+
+    static constexpr int blockSize = 64; // of the blocked dense Cholesky
+
+    AssemblyType m_assembly; // numbering, tensor assembly and sparse factor with the collision nodes as its schur block
+    IntType schurSize = IntType(0);
+    IntType matrixSize = IntType(0);
+
+    // collision element part of the collision block, full symmetric CSR in local schur numbering, positive
+    std::vector<IntType> m_A22RowIndex;
+    std::vector<IntType> m_A22Column;
+    std::vector<T> m_A22Value;
+    std::vector<T> m_f2; // reduced right hand side of the collision block, d columns of schurSize entries
+
+    // Dense diagonal block of S. Packed matrices store row i from its diagonal entry on, see row().
+    struct DenseBlock {
+        std::vector<IntType> nodes; // local schur numbers
+        std::vector<T> S; // packed upper triangle of the Schur complement
+        std::vector<T> factor; // packed upper Cholesky factor U of S plus the collision terms, U^T * U
+        // collision stiffnesses, weights and nodes of the terms in the last factorization
+        std::vector<T> state;
+        std::vector<IndexType> stateNodes;
+        bool factored = false;
+        // collision constraints and sutures on the block in the current frame
+        std::vector<int> constraints;
+        std::vector<int> sutures;
+        std::vector<T> work; // 2 * d columns of nodes.size() entries, a right hand side and S times it
+    };
+    std::vector<DenseBlock> m_blocks;
+    std::vector<IntType> m_block; // block of each local schur number
+    std::vector<IntType> m_position; // and its position in the block
+
+    std::vector<T> m_rhs; // d columns of matrixSize entries
+    std::vector<T> m_x;
+
+    // Rank one changes c * u * u^T from hooks and sutures added or deleted since the last factorization, as in
+    // SchurSolver. Eliminating the interior against its unchanged factor, with Z = A11^-1 * U1 and V = U2 - A21 * Z,
+    // turns S into S + V * G^-1 * V^T with G = C^-1 + U1^T * Z. The inner iterations use it in place of S, diagSolve()
+    // by the Sherman-Morrison-Woodbury formula with W the dense block solve of V, and backwardSubstitution() subtracts
+    // Z * G^-1 * (V^T * x2 + U1^T * A11^-1 * f1) from the interior. Term i has the numbered rows and weights of u in
+    // [m_lowRankStart[i], m_lowRankStart[i+1]) and stiffness c in m_lowRankStiffness[i].
+    std::vector<IntType> m_lowRankRows;
+    std::vector<T> m_lowRankWeights;
+    std::vector<int> m_lowRankStart{ 0 };
+    std::vector<T> m_lowRankStiffness;
+    std::vector<T> m_lowRankZ; // matrixSize - schurSize interior entries per term
+    std::vector<T> m_lowRankV; // schurSize entries per term, and the same for W
+    std::vector<T> m_lowRankW;
+    std::vector<T> m_lowRankG; // k x k row major, and LU factors with partial pivoting of it and of G + V^T * W
+    std::vector<T> m_lowRankGLU;
+    std::vector<int> m_lowRankGPivot;
+    std::vector<T> m_lowRankKLU;
+    std::vector<int> m_lowRankKPivot;
+    std::vector<T> m_lowRankH; // U1^T * A11^-1 * f1 of the last forwardSubstitution(), d columns of k entries
+    bool m_lowRankWCurrent = false; // W and G + V^T * W are stale after a dense block is refactored
+
+    void initialize(const NodeArrayType& nodeType);
+
+    void setSparseSolverType(const SparseSolverType type) { m_assembly.setSparseSolverType(type); }
+
+    template <class... Args>
+    void computeTensor(const Args&... args) { m_assembly.computeTensor(args...); }
+
+    // the tensors of the elements flagged CollisionEl, with the same stiffness as computeTensor()
+    void computeE2Tensor(const std::vector<ElementType>& elements, const std::vector<ElementFlag>& flags,
+        const std::vector<GradientMatrixType>& gradients, const std::vector<T>& restVol, const std::vector<T>& muLow, const std::vector<T>& muHigh);
+    void computeE2Tensor(const std::vector<ElementType>& elements, const std::vector<ElementFlag>& flags, const std::vector<uint8_t>& elementShape,
+        const std::vector<GradientMatrixType>& shapeGradients, const std::vector<T>& shapeRestVol, const std::vector<T>& muLow, const std::vector<T>& muHigh);
+
+    // factors the interior and copies the Schur complement of the collision block to the dense blocks
+    void initializePardiso(const std::vector<Constraint>& constraints, const std::vector<Suture>& sutures, const std::vector<Constraint>& fakeSutures, const std::vector<InternodeConstraint>& microNodes);
+    void reInitializePardiso(const std::vector<Constraint>& constraints, const std::vector<Suture>& sutures, const std::vector<Constraint>& fakeSutures, const std::vector<InternodeConstraint>& microNodes);
+
+    // factors every dense block for the current collision constraints and sutures
+    void initializeCollision(const std::vector<Constraint>& collisionConstraints, const std::vector<CollisionSuture>& collisionSutures);
+    // resets and refactors the dense blocks whose collision stiffnesses, weights or suture nodes changed since the last factorization
+    void updateCollision(const std::vector<Constraint>& collisionConstraints, const std::vector<CollisionSuture>& collisionSutures);
+
+    inline int lowRankTerms() const { return (int)m_lowRankStiffness.size(); }
+    void clearLowRank();
+
+    // adds stiffness * u * u^T with u = weights on the nodes of elementIndex, takes effect at factorLowRank()
+    template <int elementNodesN>
+    void addLowRankTerm(const std::array<IndexType, elementNodesN>& elementIndex, const std::array<T, elementNodesN>& weights, const T stiffness);
+
+    // substitutes every term through the interior factor and factors G, W follows at the next diagSolve()
+    void factorLowRank();
+
+    void copyIn(const StateVariableType& f) {
+        const IntType n = matrixSize;
+        for (IteratorType iterator(f); !iterator.isEnd(); iterator.next()) {
+            const int number = iterator.value(m_assembly.m_numbering);
+            if (number >= 0) {
+                const VectorType& value = iterator.value(f);
+                for (int v = 0; v < d; v++)
+                    m_rhs[v * n + number] = value(v + 1);
+            }
+        }
+    }
+
+    void copyOut(StateVariableType& f) const {
+        const IntType n = matrixSize;
+        for (IteratorType iterator(f); !iterator.isEnd(); iterator.next()) {
+            const int number = iterator.value(m_assembly.m_numbering);
+            if (number >= 0) {
+                VectorType& value = iterator.value(f);
+                for (int v = 0; v < d; v++)
+                    value(v + 1) = m_x[v * n + number];
+            }
+        }
+    }
+
+    void forwardSubstitution();
+    void backwardSubstitution();
+
+    // m_f2 = collision block of m_x after forwardSubstitution()
+    void setTemp();
+    // m_x = m_rhs with m_f2 added on the collision block
+    void updateForce();
+    // solves the collision block of m_x in place with the dense factor, the interior keeps the forwarded right hand side
+    void diagSolve();
+    // m_f2 -= (S - A22) * x2
+    void updateTemp();
+
+    void releasePardiso() { m_assembly.releasePardiso(); }
+    void deallocatePardiso() { m_assembly.deallocatePardiso(); }
+    void deallocate();
+
+private:
+    template <class ElementTensor>
+    void assembleE2Tensor(const std::vector<ElementType>& elements, const std::vector<ElementFlag>& flags, const ElementTensor& elementTensor);
+
+    // row i of a packed upper triangular matrix of size n, valid from column i on
+    static T* row(std::vector<T>& packed, const IntType n, const IntType i) { return packed.data() + (size_t)i * n - (size_t)i * (i + 1) / 2; }
+    static const T* row(const std::vector<T>& packed, const IntType n, const IntType i) { return packed.data() + (size_t)i * n - (size_t)i * (i + 1) / 2; }
+
+    void initializeBlocks(); // groups the collision nodes by connected component of the system matrix
+    void mergeBlocks(IntType a, IntType b); // for a collision suture across two blocks
+    void copySchur(); // from the array the sparse solver returns S in to the blocks
+    IntType localNumber(const IndexType node) const; // -1 unless a collision node
+    template <int elementNodesN>
+    void scatterTerm(DenseBlock& block, const std::array<IndexType, elementNodesN>& elementIndex, const MATRIX<T, elementNodesN>& stiffnessMatrix) const;
+    static void factorDense(std::vector<T>& packed, const IntType n); // blocked U^T * U in place
+    static void solveDense(const std::vector<T>& packed, const IntType n, T* const b); // d columns of n entries
+    void factorCapacitance(); // W and the LU factors of G + V^T * W
+    // s = V^T * x2 for d columns of x2 with stride n, k entries per column
+    void projectLowRank(const T* const x2, const IntType n, std::vector<T>& s) const;
+    static void factorSmall(std::vector<T>& LU, std::vector<int>& pivot, const int k); // in place, partial pivoting
+    static void solveSmall(const std::vector<T>& LU, const std::vector<int>& pivot, const int k, T* const s);
+};
+
+} // namespace PhysBAM
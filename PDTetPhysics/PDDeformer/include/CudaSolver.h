@@ -6,6 +6,7 @@
 
 #include <mkl.h>
 #include <array>
+#include <cstdint>
 
 #include "MKLWrapper.h"
 #include "PardisoWrapper.h"
@@ -74,12 +75,12 @@ namespace PhysBAM {
             void initialize(const NodeArrayType &nodeType);
 
             template <int elementNodesN>
-            void accumToTensor(const PhysBAM::MATRIX_MXN<T>& stiffnessMatrix,
+            void accumToTensor(const PhysBAM::MATRIX<T, elementNodesN>& stiffnessMatrix,
                                const std::array<IndexType, elementNodesN> &elementIndex);
 
             template <int elementNodesN>
             void updateTensor(T* const result,
-                              const PhysBAM::MATRIX_MXN<T>& stiffnessMatrix,
+                              const PhysBAM::MATRIX<T, elementNodesN>& stiffnessMatrix,
                               const std::array<IndexType, elementNodesN> &elementIndex);
 
             // void updatePardiso(const std::vector<Constraint> &collisionConstraints);
@@ -92,6 +93,19 @@ namespace PhysBAM {
                                   const std::vector<GradientMatrixType> &gradients,
                                   const std::vector<T> &restVol, const T mu);
 
+            // same from one unit stiffness template per element shape (see GridDeformerTet::m_elementShape)
+            void computeE2Tensor (const std::vector<ElementType> &elements,
+                                  const std::vector<ElementFlag> &flags,
+                                  const std::vector<uint8_t> &elementShape,
+                                  const std::vector<GradientMatrixType> &shapeGradients,
+                                  const std::vector<T> &shapeRestVol, const T mu);
+
+            void computeShapeTensors(std::vector<typename DiscretizationType::ElementTensorType> &shapeTensor,
+                                     const std::vector<ElementType> &elements,
+                                     const std::vector<uint8_t> &elementShape,
+                                     const std::vector<GradientMatrixType> &shapeGradients,
+                                     const std::vector<T> &shapeRestVol) const;
+
             inline void setTemp(int v) {
                 for (int i=0; i<schurSize; i++) {
                     m_f2[i+v*schurSize] = x[i+matrixSize-schurSize];
@@ -123,6 +137,14 @@ namespace PhysBAM {
                 const std::vector<Suture>& sutures
             );
 
+            // element tensors scaled from one template per element shape, scattered into m_tensor in parallel
+            void computeTensor(const std::vector<ElementType>& elements,
+                const std::vector<uint8_t>& elementShape,
+                const std::vector<GradientMatrixType>& shapeGradients,
+                const std::vector<T>& shapeRestVol, const std::vector<T>& muLow, const std::vector<T>& muHigh,
+                const std::vector<Suture>& sutures
+            );
+
 
 
 			inline void reInitializePardiso(const std::vector<Constraint> &constraints, const std::vector<Suture> &sutures, const std::vector<Constraint> &fakeSutures) { factPardiso(constraints, sutures, fakeSutures); }
@@ -131,7 +153,7 @@ namespace PhysBAM {
                                   const std::vector<CollisionSuture> &collisionSutures);
 
             template <int elementNodesN>
-            void accumToPardiso(const PhysBAM::MATRIX_MXN<T>& stiffnessMatrix,
+            void accumToPardiso(const PhysBAM::MATRIX<T, elementNodesN>& stiffnessMatrix,
                                 const std::array<IndexType, elementNodesN> &elementIndex);
 
 
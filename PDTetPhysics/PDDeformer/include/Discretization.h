@@ -7,6 +7,8 @@
 
 #include <PhysBAM_Tools/Matrices/MATRIX_2X2.h>
 #include <PhysBAM_Tools/Matrices/MATRIX_3X3.h>
+#include <PhysBAM_Tools/Matrices/MATRIX_4X4.h>
+#include <PhysBAM_Tools/Matrices/MATRIX.h>
 #include <PhysBAM_Tools/Matrices/MATRIX_MXN.h>
 
 #include <PhysBAM_Tools/Math_Tools/FACTORIAL.h>
@@ -39,6 +41,9 @@ template <class StateVariable> struct TetrahedralDiscretization {
     using ShapeMatrixType = MATRIX<T, d>;
     using GradientMatrixType = MATRIX<T, d>;
     using MatrixType = MATRIX<T, d>;
+    // fixed size tensors of an element, constraint or microNode and of a suture
+    using ElementTensorType = MATRIX<T, elementNodes>;
+    using SutureTensorType = MATRIX<T, 2 * elementNodes>;
 
     static inline ElementIndexType &getElementIndex(ElementType &element) { return element; }
 
@@ -245,6 +250,7 @@ template <class StateVariable> struct TetrahedralDiscretization {
             elementIndex[i] = suture.m_elementIndex1[i];
             elementIndex[i + elementNodes] = suture.m_elementIndex2[i];
         }
+
         MATRIX_MXN<T> weightMatrix(1, elementNodes * 2);
         for (int i = 0; i < elementNodes; i++) {
             weightMatrix(1, i + 1) = suture.m_weights1[i];
@@ -252,6 +258,66 @@ template <class StateVariable> struct TetrahedralDiscretization {
         }
         stiffnessMatrix = weightMatrix.Transpose_Times(weightMatrix) * -suture.m_stiffness;
     }
+
+    // Fixed size overloads of the tensors above. They live on the stack, so the assembly loops allocate nothing.
+    template <int nNodes>
+    static inline void computeWeightTensor(MATRIX<T, nNodes>& stiffnessMatrix, const std::array<T, nNodes>& weights, const T constant) {
+        for (int i = 0; i < nNodes; i++)
+            for (int j = 0; j < nNodes; j++)
+                stiffnessMatrix(i + 1, j + 1) = weights[i] * weights[j] * constant;
+    }
+
+    static void computeElementTensor(ElementTensorType& stiffnessMatrix, const GradientMatrixType& gradientMatrix, const T constant) {
+        // S * Dm^-1 * Dm^-T * S^T, S maps node values to the d edges from node 0
+        const MatrixType M = gradientMatrix.Times_Transpose(gradientMatrix) * constant;
+        T sum = 0;
+        for (int i = 1; i <= d; i++) {
+            T rowSum = 0;
+            for (int j = 1; j <= d; j++) {
+                stiffnessMatrix(i + 1, j + 1) = M(i, j);
+                rowSum += M(i, j);
+            }
+            stiffnessMatrix(i + 1, 1) = stiffnessMatrix(1, i + 1) = -rowSum;
+            sum += rowSum;
+        }
+        stiffnessMatrix(1, 1) = sum;
+    }
+
+    static void computeMicroNodeTensor(ElementTensorType& stiffnessMatrix, std::array<IndexType, d + 1>& elementIndex, const InternodeConstraint& microNode) {
+        std::array<T, d + 1> weights;
+        for (int i = 0; i < d; i++) {
+            elementIndex[i] = microNode.m_macroNodes[i];
+            weights[i] = microNode.m_macroWeights[i];
+        }
+        elementIndex[d] = microNode.m_microNodeNumber;
+        weights[d] = -1;
+        computeWeightTensor<d + 1>(stiffnessMatrix, weights, -microNode.m_stiffness);
+    }
+
+    static void computeConstraintTensor(ElementTensorType& stiffnessMatrix, const ConstraintType& constraint) {
+        computeWeightTensor<elementNodes>(stiffnessMatrix, constraint.m_weights, -constraint.m_stiffness);
+    }
+
+    // sutures and collision sutures both tie two barycentric points together
+    template <class PairConstraintType>
+    static void computePairTensor(SutureTensorType& stiffnessMatrix, std::array<IndexType, elementNodes * 2>& elementIndex, const PairConstraintType& pair) {
+        std::array<T, elementNodes * 2> weights;
+        for (int i = 0; i < elementNodes; i++) {
+            elementIndex[i] = pair.m_elementIndex1[i];
+            elementIndex[i + elementNodes] = pair.m_elementIndex2[i];
+            weights[i] = pair.m_weights1[i];
+            weights[i + elementNodes] = -pair.m_weights2[i];
+        }
+        computeWeightTensor<elementNodes * 2>(stiffnessMatrix, weights, -pair.m_stiffness);
+    }
+
+    static void computeSutureTensor(SutureTensorType& stiffnessMatrix, std::array<IndexType, elementNodes * 2>& elementIndex, const SutureType& suture) {
+        computePairTensor(stiffnessMatrix, elementIndex, suture);
+    }
+
+    static void computeCollisionSutureTensor(SutureTensorType& stiffnessMatrix, std::array<IndexType, elementNodes * 2>& elementIndex, const CollisionSutureType& suture) {
+        computePairTensor(stiffnessMatrix, elementIndex, suture);
+    }
 };
 
 } // namespace PhysBAM
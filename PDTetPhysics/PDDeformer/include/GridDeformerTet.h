@@ -16,6 +16,7 @@
 
 #include <Common/KernelCommon.h>
 #include "ReshapeDataStructure.h"
+#include "Add_Force.h"
 
 #include <PhysBAM_Tools/Math_Tools/FACTORIAL.h>
 
@@ -59,16 +60,21 @@ namespace PhysBAM {
         using DiagonalMatrixType = DIAGONAL_MATRIX<T, d>;
         using NodeArrayType = typename IteratorType::template ContainerType<NodeType>;
 
-        using Tarch = typename SIMD_Numeric_Kernel::template SIMDArchitectureAVX2<T>;
+        // BlockWidth is the AVX-512 float width; the AVX2 and scalar kernels cover a block in several steps
         static constexpr int BlockWidth = 16;
         static constexpr int Alignment = 64;
         using BlockedShapeMatrixType = T (*) [d+1][d][BlockWidth];
         using BlockedMatrixType = T (*) [d*d][BlockWidth];
         using BlockedScalarType = T (*) [BlockWidth];
         using BlockedElementType = int (*) [d+1][BlockWidth];
+        using BlockedShapeType = uint8_t (*) [BlockWidth];
 
         // T m_uniformMu;
 
+        // Add_Force kernel for the widest instruction set of the cpu, chosen at construction
+        SIMDArchitectureType m_simdArchitecture;
+        Add_Force_Block_Function<T, BlockWidth> m_addForceBlock;
+
         StateVariableType m_X;
         NodeArrayType m_nodeType;
 
@@ -90,6 +96,20 @@ namespace PhysBAM {
 
         std::vector<GradientMatrixType> m_gradientMatrix;
 
+        // Compact element encoding for meshes made of a few distinct element shapes, e.g. the BCC lattice
+        // where every tet is the same shape at one of a few size levels. When m_elementShape is not empty
+        // element e has the gradient matrix m_shapeGradientMatrix[m_elementShape[e]] and rest volume
+        // m_shapeRestVolume[m_elementShape[e]], and addElasticForce() streams one byte per element
+        // instead of the reshaped gradient matrix and rest volume.
+        std::vector<uint8_t> m_elementShape;
+        std::vector<GradientMatrixType> m_shapeGradientMatrix;
+        std::vector<T> m_shapeRestVolume;
+
+        // When set, initializeAuxiliaryStructures() packs the elements into blocks along a Morton curve of their
+        // centroids, so a block holds neighboring tets and blockX()/unblockAddForce() touch few cache lines per node.
+        // Only the block packing is permuted, element and node numbering are unchanged.
+        bool m_spatialElementOrder = false;
+
         // reshaped data
         int m_nUncollisionBlocks = 0;
         int m_nCollisionBlocks = 0;
@@ -110,6 +130,10 @@ namespace PhysBAM {
         BlockedScalarType m_reshapeUncollisionRangeMin = nullptr;
         BlockedScalarType m_reshapeUncollisionRangeMax = nullptr;
 
+        // force scratch of addElasticForce(), sized in initializeAuxiliaryStructures() and reused across frames
+        BlockedShapeMatrixType m_reshapeUncollisionf = nullptr;
+        BlockedShapeMatrixType m_reshapeCollisionf = nullptr;
+
         // auxilary structure
         std::vector<int> m_reshapeUncollisionIndicesOffsets;
         std::vector<int> m_reshapeCollisionIndicesOffsets;
@@ -118,6 +142,32 @@ namespace PhysBAM {
         BlockedElementType m_reshapeUncollisionElement;
         BlockedElementType m_reshapeCollisionElement;
 
+        // compact encoding, replaces m_reshape*GradientMatrix and m_reshape*ElementRestVolume when m_elementShape is used
+        BlockedShapeType m_reshapeUncollisionShape = nullptr;
+        BlockedShapeType m_reshapeCollisionShape = nullptr;
+        std::vector<std::array<T, d * d>> m_reshapeShapeGradientMatrix; // same i + 3 * j layout as the reshaped blocks
+
+        // Structure of arrays store of the interpolation points of the constraints. Every point is
+        // a weighted sum of d+1 nodes; a soft constraint has one point, a suture or collision suture two,
+        // a fake suture half constraint one and an internode constraint one (its micro node enters with weight -1).
+        // Points are stored in blocks of BlockWidth, laid out like the reshaped element data, so the per node
+        // forces can be accumulated with the same CSR offsets used by unblockAddForce.
+        struct ConstraintPointBlocks {
+            int m_nPoints = 0;
+            int m_nBlocks = 0;
+            std::vector<int> m_node; // [block][d+1][BlockWidth]
+            std::vector<T> m_weight; // [block][d+1][BlockWidth]
+            std::vector<T> m_x; // interpolated positions, [block][d][BlockWidth]
+            std::vector<T> m_force; // force applied at each point, [block][d][BlockWidth]
+            std::vector<T> m_nodeForce; // weighted force per point node, [block][d+1][d][BlockWidth]
+            std::vector<int> m_nodes; // nodes touched by any point
+            std::vector<int> m_indicesOffsets; // offsets into m_nodeForce of each touched node, CSR over m_nodes
+            std::vector<int> m_indicesValues;
+        };
+        // rebuilt on the fly by addConstraintForce() and addCollisionForce(), the CSR part only when the point nodes change
+        mutable ConstraintPointBlocks m_constraintPoints;
+        mutable ConstraintPointBlocks m_collisionPoints;
+
         // std::function<void(const GeometryType &, const NodeArrayType &, StateVariableType &)> m_clearDirichlet;
 
 		GridDeformerTet() /*:m_uniformMu(muIn)*/ {
@@ -135,6 +185,13 @@ namespace PhysBAM {
 			m_reshapeCollisionElement = nullptr;
 
 			static_assert((BlockWidth * sizeof(T)) % Alignment == 0, "Blocks don't have requisite alignment");
+
+			setSIMDArchitecture(Detect_SIMD_Architecture());
+		}
+
+		void setSIMDArchitecture(const SIMDArchitectureType architecture) {
+			m_addForceBlock = Select_Add_Force_Block<T, BlockWidth>(architecture);
+			m_simdArchitecture = architecture;
 		}
 
         void initializeDeformer();
@@ -161,6 +218,14 @@ namespace PhysBAM {
 
         void deallocateAuxiliaryStructures();
         void initializeElementFlags();
+
+    private:
+        template <class PointFunction>
+        void packConstraintPoints(ConstraintPointBlocks &points, const int nPoints, PointFunction pointNodes) const;
+        void interpolateConstraintPoints(ConstraintPointBlocks &points) const;
+        void addElasticForceBlocks(const int nBlocks, BlockedShapeMatrixType x, BlockedMatrixType gradientMatrix, BlockedScalarType restVolume, BlockedShapeType shape,
+            BlockedScalarType muLow, BlockedScalarType muHigh, BlockedScalarType rangeMin, BlockedScalarType rangeMax, BlockedShapeMatrixType f) const;
+        void distributeConstraintPoints(ConstraintPointBlocks &points, StateVariableType &f) const;
     };
 
 } // namespace PhysBAM
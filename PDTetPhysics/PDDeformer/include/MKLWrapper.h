@@ -1,13 +1,16 @@
 #pragma once
 
 #include "mkl_types.h"
+#include "ArenaThreads.h"
 
 template<class T, class IntType> struct PardisoPolicy;
     template<class T> struct PardisoPolicy<T, int> {
         using IntType = int;
         static inline IntType exec(void** pt, const IntType maxfct, const IntType mnum, const IntType mtype, const IntType phase, const IntType n, T* a, IntType* ia, IntType* ja, IntType* perm, const IntType nrhs, IntType* iparm, const IntType msglvl, T* b, T* x) {
             IntType error;
+            const int previousThreads = mkl_set_num_threads_local(arenaThreads());
             pardiso(pt, &maxfct, &mnum, &mtype, &phase, &n, a, ia, ja, perm, &nrhs, iparm, &msglvl, b, x, &error);
+            mkl_set_num_threads_local(previousThreads);
             return error;
         }
     };
@@ -16,7 +19,9 @@ template<class T, class IntType> struct PardisoPolicy;
         using IntType = long long int;
         static inline IntType exec(void** pt, const IntType maxfct, const IntType mnum, const IntType mtype, const IntType phase, const IntType n, T* a, IntType* ia, IntType* ja, IntType* perm, const IntType nrhs, IntType* iparm, const IntType msglvl, T* b, T* x) {
             IntType error;
+            const int previousThreads = mkl_set_num_threads_local(arenaThreads());
             pardiso_64(pt, &maxfct, &mnum, &mtype, &phase, &n, a, ia, ja, perm, &nrhs, iparm, &msglvl, b, x, &error);
+            mkl_set_num_threads_local(previousThreads);
             return error;
         }
     };
@@ -0,0 +1,155 @@
+//#####################################################################
+// Copyright (c) 2019, Eftychios Sifakis, Yutian Tao, Qisi Wang
+// Distributed under the FreeBSD license (see license.txt)
+//#####################################################################
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "SchurSolver.h"
+
+enum class GlobalSolverType { Direct = 0, Multigrid = 1 };
+
+namespace PhysBAM {
+
+// Iterative alternative to SchurSolver for the PD global step, for models too large to factor.
+// The system matrix (elastic tensor plus the rank one terms of constraints, sutures, microNodes and
+// collisions) is solved by conjugate gradients, warm started from the previous solution and
+// preconditioned by one V-cycle of a smoothed aggregation hierarchy. The aggregates of level l + 1 are
+// the nodes of level l that lie in one cube of a grid twice as coarse and are connected inside that cube,
+// so the hierarchy follows the power of two BCC levels and never couples the two sides of an incision.
+// initializeHierarchy() builds the aggregates, prolongations and coarse operators with the constraints present then
+// and factors the small dense coarsest matrix, the fine matrix is never factored. Later constraint changes are exact
+// on the finest level, reach the coarse levels only as rank one terms restricted through the fixed prolongations,
+// and enter the coarsest factor as a low rank update, so hooks and sutures never rebuild the hierarchy.
+template <class Discretization, class IntType> struct MultigridSolver {
+
+    using AssemblyType = SchurSolver<Discretization, IntType>;
+    using DiscretizationType = Discretization;
+    using StateVariableType = typename AssemblyType::StateVariableType;
+    using IteratorType = typename AssemblyType::IteratorType;
+    using IndexType = typename AssemblyType::IndexType;
+    using VectorType = typename AssemblyType::VectorType;
+    using T = typename AssemblyType::T;
+    static constexpr int d = AssemblyType::d;
+    static constexpr int elementNodes = AssemblyType::elementNodes;
+
+    using GradientMatrixType = typename AssemblyType::GradientMatrixType;
+    using ElementType = typename AssemblyType::ElementType;
+    using NodeArrayType = typename AssemblyType::NodeArrayType;
+    using Constraint = typename AssemblyType::Constraint;
+    using Suture = typename AssemblyType::Suture;
+    using CollisionSuture = typename AssemblyType::CollisionSuture;
+    using InternodeConstraint = typename AssemblyType::InternodeConstraint;
+
+    // Rank one terms c * u * u^T, term i has the rows and weights of u in [start[i], start[i+1])
+    // and stiffness c in stiffness[i], as SchurSolver's low rank terms.
+    struct RankOneTerms {
+        std::vector<IntType> rows;
+        std::vector<T> weights;
+        std::vector<int> start{ 0 };
+        std::vector<T> stiffness;
+
+        void clear() {
+            rows.clear();
+            weights.clear();
+            start.assign(1, 0);
+            stiffness.clear();
+        }
+    };
+
+    struct Level {
+        IntType n = 0;
+        // full symmetric CSR of the elastic part
+        std::vector<IntType> rowIndex;
+        std::vector<IntType> column;
+        std::vector<T> value;
+        RankOneTerms terms;
+        std::vector<T> elasticDiagonal;
+        // elastic diagonal plus each term's l1 row sums, which bound the terms' part of the spectral radius of D^-1 * A by one
+        std::vector<T> diagonal;
+        T jacobiWeight = T(0); // 4 / 3 over the larger of one and the estimated spectral radius of the elastic part
+        std::vector<IntType> aggregate; // node of the next level, empty on the coarsest level
+        // prolongation from the next level (n rows) and its transpose, the restriction, empty on the coarsest level
+        std::vector<IntType> pRowIndex, pColumn, rRowIndex, rColumn;
+        std::vector<T> pValue, rValue;
+        // d columns of n entries each
+        std::vector<T> b, x, r;
+    };
+
+    AssemblyType m_assembly; // numbering and parallel assembly of the elastic tensor, never factored
+    std::vector<Level> m_levels;
+    RankOneTerms m_collisionTerms; // finest level only, they change at every solve
+    std::vector<T> m_fineDiagonal; // finest level diagonal without the collision terms
+    std::vector<double> m_coarseFactor; // dense lower Cholesky factor of the coarsest level, row major, empty if it is smoothed instead
+    RankOneTerms m_factoredTerms; // finest level terms the coarsest level was factored with
+    // Woodbury update of the coarsest factor, A = M + U * C * U^T with M the factored matrix. U and C are the coarsest
+    // level terms added (c > 0) or removed (c < 0) since factoring, the capacitance C^-1 + U^T * M^-1 * U is LU factored.
+    RankOneTerms m_coarseChange;
+    std::vector<double> m_changeSolved; // M^-1 * U, one column of the coarsest level size per term
+    std::vector<double> m_capacitance; // row major, LU factors in place
+    std::vector<int> m_capacitancePivot;
+
+    std::vector<T> m_rhs; // d columns of m_levels[0].n entries
+    std::vector<T> m_x; // last solution, warm starts the next solve
+    std::vector<T> m_r, m_p, m_q; // conjugate gradient work vectors
+
+    T m_tolerance = T(1e-4); // relative residual of each column
+    int m_maxIterations = 100;
+    int m_smoothingIterations = 2;
+    IntType m_maxCoarsestSize = 1024;
+    int m_lastIterations = 0;
+
+    // numbers the active and collision nodes alike, there is no schur block
+    void initialize(const NodeArrayType& nodeType);
+
+    void deallocate();
+
+    template <class... Args>
+    void computeTensor(const Args&... args) { m_assembly.computeTensor(args...); }
+
+    // builds the aggregates of every level from the node positions X, then the operators with these constraints
+    void initializeHierarchy(const StateVariableType& X, const std::vector<Constraint>& constraints, const std::vector<Suture>& sutures, const std::vector<Constraint>& fakeSutures, const std::vector<InternodeConstraint>& microNodes);
+
+    // replaces the rank one terms of every level and updates the coarsest factor by the terms changed since it was
+    // factored. The prolongations and elastic operators are kept.
+    void setConstraints(const std::vector<Constraint>& constraints, const std::vector<Suture>& sutures, const std::vector<Constraint>& fakeSutures, const std::vector<InternodeConstraint>& microNodes);
+
+    // collision terms only enter the finest level, the preconditioner stays valid without them
+    void updateCollision(const std::vector<Constraint>& collisionConstraints, const std::vector<CollisionSuture>& collisionSutures);
+
+    void copyIn(const StateVariableType& f);
+    void copyOut(StateVariableType& f) const;
+    void solve();
+
+private:
+    // appends c * u * u^T with u = weights on the numbered nodes, merging repeated nodes
+    template <int nNodes>
+    void addTerm(RankOneTerms& terms, const std::array<IndexType, nNodes>& nodes, const std::array<T, nNodes>& weights, const T c) const;
+    static void appendTerm(RankOneTerms& terms, const IntType* const rows, const T* const weights, const int count, const T c);
+    // C = A * B for CSR matrices, B has nColumns columns
+    static void multiplySparse(const std::vector<IntType>& aRowIndex, const std::vector<IntType>& aColumn, const std::vector<T>& aValue,
+        const std::vector<IntType>& bRowIndex, const std::vector<IntType>& bColumn, const std::vector<T>& bValue, const IntType nColumns,
+        std::vector<IntType>& cRowIndex, std::vector<IntType>& cColumn, std::vector<T>& cValue);
+    void buildTerms(RankOneTerms& terms, const std::vector<Constraint>& constraints, const std::vector<Suture>& sutures, const std::vector<Constraint>& fakeSutures, const std::vector<InternodeConstraint>& microNodes) const;
+    void restrictTerms(const int l, const RankOneTerms& fineTerms, RankOneTerms& coarseTerms) const; // R * u of each term of level l
+    static void addDiagonal(const RankOneTerms& terms, std::vector<T>& diagonal); // l1 row sums of the terms
+    static void applyTerms(const RankOneTerms& terms, const IntType n, const T* const x, T* const y); // y += terms * x
+
+    // smoothed prolongation of level l from its aggregates and whole operator, then the elastic operator of level l + 1
+    void initializeProlongation(const int l);
+    void setTerms(); // restricts the finest level terms to every level and sets the diagonals
+    T estimateSpectralRadius(const int l); // of D^-1 * K for the elastic part K and its diagonal D, by power iteration
+
+    void multiply(const int l, const T* const x, T* const y) const; // y = A_l * x for all d columns
+    void multiplyElastic(const int l, const T* const x, T* const y) const; // without the rank one terms
+    void smooth(const int l, const T* const b, T* const x);
+    void vCycle(const int l);
+    void factorCoarsest();
+    void updateCoarsestFactor(); // from the difference between the finest level terms and m_factoredTerms
+    void solveFactored(double* const y) const; // y = M^-1 * y with the coarsest factor
+    void solveCoarsest(const T* const b, T* const x);
+};
+
+} // namespace PhysBAM
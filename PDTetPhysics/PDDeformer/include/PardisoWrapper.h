@@ -4,22 +4,23 @@
 //#####################################################################
 #pragma once
 #include <iostream>
+#include "SparseSolver.h"
 
 
-template <class T, class IntType_> struct PardisoWrapper {
+template <class T, class IntType_> struct PardisoWrapper : public SparseSolver<T, IntType_> {
+    using Base = SparseSolver<T, IntType_>;
     using IntType = IntType_;
+    using Base::n;
+    using Base::m;
+    using Base::rowIndex;
+    using Base::column;
+    using Base::value;
+    using Base::schur;
+    using Base::nrhs;
 
-    IntType  n = 0; // dimension of the matrix
-    int      m = 0;// number of nodes in the schur complement part
     IntType *schurNodes = nullptr;
 
-    IntType *rowIndex = nullptr;
-    IntType *column = nullptr;
-    T       *value = nullptr;
-    T       *schur = nullptr;
-
     IntType mtype = 0;
-    int     nrhs = 0;
     void   *pt[64] = {
         nullptr, nullptr, nullptr, nullptr,
         nullptr, nullptr, nullptr, nullptr,
@@ -41,24 +42,20 @@ template <class T, class IntType_> struct PardisoWrapper {
     IntType iparm[64]{}; // Pardiso control parameters.
     IntType maxfct=0, mnum=0, msglvl=0;
 
-    void initialize(const IntType _n, const IntType _nnz, const IntType _m = 0);
-
-    void  factSchur();
+    void initialize(const IntType _n, const IntType _nnz, const IntType _m = 0, const int _nrhs = 1) override;
 
-    void factorize() {
-        symbolicFact(); // symFact
-        numericFact(); // numFact
-    }
+    void  factSchur() override;
 
-    void symbolicFact();
-    void numericFact();
+    void symbolicFact() override;
+    void numericFact() override;
 
     void releasePardisoInternal();
-    void deallocate();
+    void releaseInternal() override { releasePardisoInternal(); }
+    void deallocate() override;
 
-    void forwardSubstitution(T* const _rhs, T* const _x);
-    void diagSolve(T* const _rhs, T* const _x);
-    void backwardSubstitution(T* const _rhs, T* const _x);
+    void forwardSubstitution(T* const _rhs, T* const _x) override;
+    void diagSolve(T* const _rhs, T* const _x) override;
+    void backwardSubstitution(T* const _rhs, T* const _x) override;
 
     void printSchur () {
         std::cout<<std::endl;
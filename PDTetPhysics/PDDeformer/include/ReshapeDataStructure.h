@@ -5,5 +5,9 @@
 template<class T, int CoordinateStride>
 void unblockAddForce(const T* fReshapedBasePtr, const int* reshapeIndicesOffsets, const int* reshapeIndicesValues, const int nParticles, T* f);
 
+// same as unblockAddForce, restricted to the particles listed in particles; the CSR rows follow that list
+template<class T, int CoordinateStride>
+void unblockAddForce(const T* fReshapedBasePtr, const int* reshapeIndicesOffsets, const int* reshapeIndicesValues, const int* particles, const int nParticles, T* f);
+
 template<class T, int CoordinateStride>
 void blockX(const T* X, const int* elementsPtr, const int nBlocks, T* XBasePtr);
@@ -4,11 +4,17 @@
 //#####################################################################
 #pragma once
 
-#include <mkl.h>
+#include <algorithm>
 #include <array>
+#include <memory>
+#include <cstdint>
 
+#ifndef NO_MKL
+#include <mkl.h>
 #include "MKLWrapper.h"
 #include "PardisoWrapper.h"
+#endif
+#include "SupernodalCholesky.h"
 #include "SimulationFlags.h"
 #include "PDConstraints.h"
 // #include "CudaWrapper.h"
@@ -33,6 +39,8 @@ template <class Discretization, class IntType> struct SchurSolver {
     static constexpr int d = VectorType::dimension;
 
     using GradientMatrixType = MATRIX<T, d>;
+    using ElementTensorType = typename DiscretizationType::ElementTensorType;
+    using SutureTensorType = typename DiscretizationType::SutureTensorType;
 
     static constexpr int elementNodes = d + 1;
     using ElementType = std::array<IndexType, elementNodes>;
@@ -48,30 +56,122 @@ template <class Discretization, class IntType> struct SchurSolver {
 
     IntType schurSize = IntType(0);
     NumberingArrayType m_numbering; // only number the active nodes, collisionNodes at the bottom
-    std::vector<std::map<int, T>> m_tensor;
+
+    // CSR pattern of the upper triangle and its elastic part, built by computeTensor() in two passes
+    std::vector<IntType> m_tensorRowIndex;
+    std::vector<IntType> m_tensorColumn;
+    std::vector<T> m_tensorValue;
+    // Each entry (i, j) of an element, suture or microNode tensor is a source, numbered element by element, then
+    // suture by suture from m_sutureSourceStart and microNode by microNode from m_microNodeSourceStart.
+    // m_sourceSlot is its position in the CSR value array, -1 if not stored. CSR entry k gathers the sources
+    // m_slotSource[m_slotSourceStart[k] ... m_slotSourceStart[k+1]).
+    std::vector<IntType> m_sourceSlot;
+    std::vector<IntType> m_slotSourceStart;
+    std::vector<IntType> m_slotSource;
+    size_t m_sutureSourceStart = 0;
+    size_t m_microNodeSourceStart = 0;
+    std::vector<T> m_elementTensor; // elementNodes x elementNodes row major per element, or per shape when assembled from shape templates
+    // slots of constraints and fake sutures, found as they are appended
+    std::vector<std::array<IntType, elementNodes * elementNodes>> m_constraintSlots;
+    std::vector<std::array<IntType, elementNodes * elementNodes>> m_fakeSutureSlots;
     T *m_originalValue = nullptr;
+    // false leaves the schur block unfactored for an owner that keeps it itself (CollisionSchurSolver),
+    // m_originalValue is then not allocated and m_schur is only needed while factoring
+    bool m_factSchur = true;
     T *m_schur = nullptr;
     T *m_x = nullptr;
     T *m_rhs = nullptr;
-    mutable PardisoWrapper<T, IntType> m_pardiso;
+
+    // Rank one changes c * u * u^T of the factored matrix from hooks and sutures added or deleted since the last
+    // factorization, applied at solve time by the Sherman-Morrison-Woodbury formula. Term i has the numbered rows
+    // and weights of u in [m_lowRankStart[i], m_lowRankStart[i+1]) and stiffness c in m_lowRankStiffness[i].
+    std::vector<IntType> m_lowRankRows;
+    std::vector<T> m_lowRankWeights;
+    std::vector<int> m_lowRankStart{ 0 };
+    std::vector<T> m_lowRankStiffness;
+    std::vector<T> m_lowRankZ; // factored matrix inverse times u, n entries per term
+    std::vector<T> m_lowRankLU; // LU factors of I + C * U^T * Z, row major
+    std::vector<int> m_lowRankPivot;
+    std::unique_ptr<SparseSolver<T, IntType>> m_sparseSolver;
+#ifndef NO_MKL
+    SparseSolverType m_sparseSolverType = SparseSolverType::Pardiso;
+#else
+    SparseSolverType m_sparseSolverType = SparseSolverType::Supernodal;
+#endif
+
+    SchurSolver() { setSparseSolverType(m_sparseSolverType); }
+
+    // selects the sparse direct solver, takes effect at the next initializePardiso()
+    void setSparseSolverType(const SparseSolverType type) {
+        if (m_sparseSolver)
+            releasePardiso();
+        m_sparseSolverType = type;
+#ifndef NO_MKL
+        if (type == SparseSolverType::Pardiso)
+            m_sparseSolver.reset(new PardisoWrapper<T, IntType>);
+        else
+#endif
+            m_sparseSolver.reset(new SupernodalCholesky<T, IntType>);
+        m_sparseSolver->schur = m_schur;
+    }
 
     void initialize(const NodeArrayType& nodeType);
 
+    // the dense schurSize x schurSize block the sparse solver returns the Schur complement in
+    void allocateSchur() {
+        if (!m_schur && schurSize)
+            m_schur = new T[(size_t)schurSize * schurSize];
+        m_sparseSolver->schur = m_schur;
+    }
+
+    void releaseSchur() {
+        delete[] m_schur;
+        m_schur = nullptr;
+        m_sparseSolver->schur = nullptr;
+    }
+
+    // slots of the entries (i, j) of a tensor on elementIndex in the CSR value array, -1 where not stored
     template <int elementNodesN>
-    void accumToTensor(const PhysBAM::MATRIX_MXN<T>& stiffnessMatrix,
-        const std::array<IndexType, elementNodesN>& elementIndex);
+    void findSlots(IntType* const slots, const std::array<IndexType, elementNodesN>& elementIndex) const;
 
+    // same in the dense row major schur block, all numbered nodes must be collision nodes
     template <int elementNodesN>
-    void accumToTensor_debug(const PhysBAM::MATRIX_MXN<T>& stiffnessMatrix, const std::array<IndexType, elementNodesN>& elementIndex);  // COURT added to separate out microNode crash in Release
+    void findSchurSlots(IntType* const slots, const std::array<IndexType, elementNodesN>& elementIndex) const;
+
+    template <class ConstraintType>
+    void extendSlots(std::vector<std::array<IntType, elementNodes * elementNodes>>& slots, const std::vector<ConstraintType>& constraints, const bool schurBlock) const;
+
+    // stiffnessMatrix is negative definite
+    template <int elementNodesN>
+    static void scatterTensor(T* const values, const IntType* const slots, const PhysBAM::MATRIX<T, elementNodesN>& stiffnessMatrix) {
+        for (int i = 0; i < elementNodesN; i++)
+            for (int j = 0; j < elementNodesN; j++)
+                if (slots[i * elementNodesN + j] >= 0)
+                    values[slots[i * elementNodesN + j]] -= stiffnessMatrix(i + 1, j + 1);
+    }
+
+    void buildTensorPattern(const std::vector<ElementType>& elements, const std::vector<Suture>& sutures, const std::vector<InternodeConstraint>& microNodes);
+
+    // builds the pattern and sets each CSR value to minus the sum of elementTensorEntry(source) over its element sources
+    template <class ElementTensorEntry>
+    void gatherTensor(const std::vector<ElementType>& elements, const ElementTensorEntry& elementTensorEntry,
+        const std::vector<Suture>& sutures, const std::vector<InternodeConstraint>& microNodes);
+
+    template <class Coefficient>
+    void assembleTensor(const std::vector<ElementType>& elements, const std::vector<GradientMatrixType>& gradients, const Coefficient& coefficient,
+        const std::vector<Suture>& sutures, const std::vector<InternodeConstraint>& microNodes);
+
+    // element e has the tensor of shape elementShape[e] at unit stiffness, scaled by coefficient(e)
+    template <class Coefficient>
+    void assembleShapeTensor(const std::vector<ElementType>& elements, const std::vector<uint8_t>& elementShape,
+        const std::vector<GradientMatrixType>& shapeGradients, const std::vector<T>& shapeRestVol, const Coefficient& coefficient,
+        const std::vector<Suture>& sutures, const std::vector<InternodeConstraint>& microNodes);
 
     template <int elementNodesN>
-    void updateTensor(const PhysBAM::MATRIX_MXN<T>& stiffnessMatrix,
+    void updateTensor(const PhysBAM::MATRIX<T, elementNodesN>& stiffnessMatrix,
         const std::array<IndexType, elementNodesN>& elementIndex);
 
-    void updatePardiso(
-        const std::vector<Constraint> &collisionConstraints,
-        const std::vector<CollisionSuture>& collisionSutures
-    );
+
 #if 0
     void computeTensor(const std::vector<ElementType> &elements,
                        const std::vector<GradientMatrixType> &gradients,
@@ -82,6 +182,12 @@ template <class Discretization, class IntType> struct SchurSolver {
 
     void computeTensor(const std::vector<ElementType>& elements, const std::vector<GradientMatrixType>& gradients, const std::vector<T>& restVol, const std::vector<T>& muLow, const std::vector<T>& muHigh, const std::vector<Suture>& sutures, const std::vector<InternodeConstraint>& microNodes);
 
+    // same for meshes with few distinct element shapes (see GridDeformerTet::m_elementShape), the element
+    // tensors are scaled from one template per shape instead of being computed element by element
+    void computeTensor(const std::vector<ElementType>& elements, const std::vector<uint8_t>& elementShape, const std::vector<GradientMatrixType>& shapeGradients, const std::vector<T>& shapeRestVol, const T mu, const std::vector<Suture>& sutures, const std::vector<InternodeConstraint>& microNodes);
+
+    void computeTensor(const std::vector<ElementType>& elements, const std::vector<uint8_t>& elementShape, const std::vector<GradientMatrixType>& shapeGradients, const std::vector<T>& shapeRestVol, const std::vector<T>& muLow, const std::vector<T>& muHigh, const std::vector<Suture>& sutures, const std::vector<InternodeConstraint>& microNodes);
+
 
 #if 0 // add back when converting adaptive constraints to hard constraints
     void computeTensor(const std::vector<ElementType>& elements,
@@ -92,37 +198,60 @@ template <class Discretization, class IntType> struct SchurSolver {
 #endif
 
     inline void reInitializePardiso(const std::vector<Constraint>& constraints, const std::vector<Suture>& sutures, const std::vector<Constraint>& fakeSutures, const std::vector<InternodeConstraint>& microNodes) {
+        clearLowRank();
         factPardiso(constraints, sutures, fakeSutures, microNodes);  
-        if (schurSize) {
-            for (IntType i = 0; i < schurSize * schurSize; i++)
-                m_originalValue[i] = m_pardiso.schur[i];
-            m_pardiso.factSchur();
+        if (schurSize && m_factSchur) {
+            std::copy(m_sparseSolver->schur, m_sparseSolver->schur + (size_t)schurSize * schurSize, m_originalValue);
+            m_sparseSolver->factSchur();
         }
     }
 
+    inline int lowRankTerms() const { return (int)m_lowRankStiffness.size(); }
+
+    inline void clearLowRank() {
+        m_lowRankRows.clear();
+        m_lowRankWeights.clear();
+        m_lowRankStart.assign(1, 0);
+        m_lowRankStiffness.clear();
+        m_lowRankZ.clear();
+    }
+
+    // adds stiffness * u * u^T with u = weights on the nodes of elementIndex, takes effect at factorLowRank()
     template <int elementNodesN>
-    void accumToPardiso(const PhysBAM::MATRIX_MXN<T>& stiffnessMatrix,
-        const std::array<IndexType, elementNodesN>& elementIndex);
+    void addLowRankTerm(const std::array<IndexType, elementNodesN>& elementIndex, const std::array<T, elementNodesN>& weights, const T stiffness);
+
+    // solves the factored matrix for every term and factors the small capacitance matrix
+    void factorLowRank();
 
 #if 0
     void initializePardiso(const std::vector<Constraint>& constraints, const std::vector<Suture>& sutures, const std::vector<Constraint>& fakeSutures);
 #endif
 
-    void copyIn(const StateVariableType &f, const int v) const {
+    // m_rhs and m_x hold all d coordinates as d contiguous columns of m_sparseSolver->n entries,
+    // so one substitution pass over the factor solves every axis
+    void copyIn(const StateVariableType &f) const {
         // copy in x
+        const IntType n = m_sparseSolver->n;
         for (Iterator<StateVariableType> iterator(f); !iterator.isEnd(); iterator.next()) {
             const int number = iterator.value(m_numbering);
-            if (number >= 0)
-                m_rhs[number] = iterator.value(f)(v + 1);
+            if (number >= 0) {
+                const VectorType &value = iterator.value(f);
+                for (int v = 0; v < d; v++)
+                    m_rhs[v * n + number] = value(v + 1);
+            }
         }
     }
 
-    void copyOut(StateVariableType &f, const int v) const {
+    void copyOut(StateVariableType &f) const {
         // copy out x
+        const IntType n = m_sparseSolver->n;
         for (Iterator<StateVariableType> iterator(f); !iterator.isEnd(); iterator.next()) {
             const int number = iterator.value(m_numbering);
-            if (number >= 0)
-                iterator.value(f)(v + 1) = m_x[number];
+            if (number >= 0) {
+                VectorType &value = iterator.value(f);
+                for (int v = 0; v < d; v++)
+                    value(v + 1) = m_x[v * n + number];
+            }
         }
     }
 
@@ -130,19 +259,21 @@ template <class Discretization, class IntType> struct SchurSolver {
 #if TIMING
         auto start1 = std::chrono::steady_clock::now();
 #endif
-        m_pardiso.forwardSubstitution(m_rhs, m_x);
+        m_sparseSolver->forwardSubstitution(m_rhs, m_x);
 #if TIMING
          auto end1 = std::chrono::steady_clock::now();
          std::chrono::duration<double> elapsed_seconds1 = end1 - start1;
          std::cout<<"Forward Substitution Time: "<<elapsed_seconds1.count()<<" s"<<std::endl;
 #endif
 
-        m_pardiso.diagSolve(m_x, m_rhs);
+        m_sparseSolver->diagSolve(m_x, m_rhs);
 
 #if TIMING
         auto start2 = std::chrono::steady_clock::now();
 #endif
-        m_pardiso.backwardSubstitution(m_rhs, m_x);
+        m_sparseSolver->backwardSubstitution(m_rhs, m_x);
+        if (!m_lowRankStiffness.empty())
+            correctLowRank();
 
 #if TIMING
          auto end2 = std::chrono::steady_clock::now();
@@ -151,9 +282,18 @@ template <class Discretization, class IntType> struct SchurSolver {
 #endif
     }
 
+    // x -= Z * (I + C * U^T * Z)^-1 * C * U^T * x for each column of m_x
+    void correctLowRank() const;
+
     void inline releasePardiso() {
-        m_pardiso.releasePardisoInternal();
-        m_pardiso.deallocate();
+        m_sparseSolver->releaseInternal();
+        m_sparseSolver->deallocate();
+    }
+
+    // frees the CSR arrays but keeps the ordering and symbolic factor, which the next
+    // initializePardiso() reuses if the sparsity pattern has not changed
+    void inline deallocatePardiso() {
+        m_sparseSolver->deallocate();
     }
 
 
@@ -162,11 +302,7 @@ template <class Discretization, class IntType> struct SchurSolver {
             delete[] m_originalValue;
             m_originalValue = NULL;
         }
-        if (m_schur) {
-            delete m_schur;
-            m_schur = NULL;
-            m_pardiso.schur = NULL;
-        }
+        releaseSchur();
         if (m_x) {
             delete[] m_x;
             m_x = NULL;
@@ -180,6 +316,13 @@ template <class Discretization, class IntType> struct SchurSolver {
     void initializePardiso(const std::vector<Constraint>& constraints, const std::vector<Suture>& sutures, const std::vector<Constraint>& fakeSutures, const std::vector<InternodeConstraint>& microNodes);
 
     void factPardiso(const std::vector<Constraint>& constraints, const std::vector<Suture>& sutures, const std::vector<Constraint>& fakeSutures, const std::vector<InternodeConstraint>& microNodes);
+
+#if defined(SPARSE_SOLVER_BENCHMARK) && !defined(NO_MKL)
+    void benchmarkSparseSolvers() const;
+#endif
+#ifdef TENSOR_ASSEMBLY_BENCHMARK
+    void benchmarkTensorAssembly(const std::vector<ElementType>& elements, const std::vector<GradientMatrixType>& gradients) const;
+#endif
 #if 0
     void factPardiso(
         const std::vector<Constraint>& constraints,
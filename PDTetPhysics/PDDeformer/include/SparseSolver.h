@@ -0,0 +1,84 @@
+//#####################################################################
+// Copyright (c) 2019, Eftychios Sifakis, Yutian Tao, Qisi Wang
+// Distributed under the FreeBSD license (see license.txt)
+//#####################################################################
+#pragma once
+#include <cstring>
+#include <vector>
+
+enum class SparseSolverType { Pardiso = 0, Supernodal = 1 };
+
+// Interface of the symmetric positive definite sparse solvers used by SchurSolver.
+// The matrix is passed as the upper triangle of a 0-based CSR matrix (rowIndex, column, value).
+// When m > 0 the last m rows are not eliminated; numericFact() returns their Schur complement
+// in schur as a dense row major m x m matrix, of which factSchur() and diagSolve() only use the upper triangle.
+// Right hand sides and solutions are stored column by column, n entries per column.
+template <class T, class IntType_> struct SparseSolver {
+    using IntType = IntType_;
+
+    IntType  n = 0; // dimension of the matrix
+    int      m = 0; // number of nodes in the schur complement part
+
+    IntType *rowIndex = nullptr;
+    IntType *column = nullptr;
+    T       *value = nullptr;
+    T       *schur = nullptr;
+
+    int     nrhs = 0;
+
+    // true while a symbolic factor from the last symbolicFact() is held
+    bool patternAnalyzed = false;
+
+    virtual ~SparseSolver() {}
+
+    // True when the current pattern is the one the held symbolic factor was computed for, so symbolicFact() can keep it.
+    // Changed dimensions or nonzero counts reject in O(1), anything else is compared against the copy of the analyzed pattern.
+    bool patternUnchanged() const {
+        if (!patternAnalyzed || n != analyzedN || m != analyzedM || nrhs != analyzedNrhs)
+            return false;
+        const size_t nnz = (size_t)rowIndex[n];
+        return nnz == analyzedColumn.size() &&
+            !std::memcmp(rowIndex, analyzedRowIndex.data(), sizeof(IntType) * ((size_t)n + 1)) &&
+            (!nnz || !std::memcmp(column, analyzedColumn.data(), sizeof(IntType) * nnz));
+    }
+
+    void recordAnalyzedPattern() {
+        analyzedN = n;
+        analyzedM = m;
+        analyzedNrhs = nrhs;
+        analyzedRowIndex.assign(rowIndex, rowIndex + n + 1);
+        analyzedColumn.assign(column, column + rowIndex[n]);
+        patternAnalyzed = true;
+    }
+
+    void clearAnalyzedPattern() {
+        patternAnalyzed = false;
+        std::vector<IntType>().swap(analyzedRowIndex);
+        std::vector<IntType>().swap(analyzedColumn);
+    }
+
+    virtual void initialize(const IntType _n, const IntType _nnz, const IntType _m = 0, const int _nrhs = 1) = 0;
+
+    virtual void factSchur() = 0;
+
+    void factorize() {
+        symbolicFact(); // symFact, skipped when the pattern is unchanged
+        numericFact(); // numFact
+    }
+
+    virtual void symbolicFact() = 0;
+    virtual void numericFact() = 0;
+
+    virtual void releaseInternal() = 0; // frees the symbolic and numeric factors
+    virtual void deallocate() = 0; // frees the CSR arrays only
+
+    virtual void forwardSubstitution(T* const _rhs, T* const _x) = 0;
+    virtual void diagSolve(T* const _rhs, T* const _x) = 0;
+    virtual void backwardSubstitution(T* const _rhs, T* const _x) = 0;
+
+private:
+    // pattern the held symbolic factor was computed for
+    IntType analyzedN = 0;
+    int analyzedM = 0, analyzedNrhs = 0;
+    std::vector<IntType> analyzedRowIndex, analyzedColumn;
+};
@@ -0,0 +1,71 @@
+//#####################################################################
+// Copyright (c) 2019, Eftychios Sifakis, Yutian Tao, Qisi Wang
+// Distributed under the FreeBSD license (see license.txt)
+//#####################################################################
+#pragma once
+#include <vector>
+#include <cstddef>
+#include "SparseSolver.h"
+
+// Native multifrontal supernodal Cholesky factorization L*L^T, used in place of MKL Pardiso.
+// symbolicFact() computes a nested dissection ordering of the non-Schur nodes, the elimination tree
+// and the fundamental supernodes. numericFact() and the substitutions traverse the supernodal
+// elimination tree in parallel with TBB. Schur nodes are ordered last and never eliminated.
+template <class T, class IntType_> struct SupernodalCholesky : public SparseSolver<T, IntType_> {
+    using Base = SparseSolver<T, IntType_>;
+    using IntType = IntType_;
+    using Base::n;
+    using Base::m;
+    using Base::rowIndex;
+    using Base::column;
+    using Base::value;
+    using Base::schur;
+    using Base::nrhs;
+
+    void initialize(const IntType _n, const IntType _nnz, const IntType _m = 0, const int _nrhs = 1) override;
+
+    void factSchur() override;
+
+    void symbolicFact() override;
+    void numericFact() override;
+
+    void releaseInternal() override;
+    void deallocate() override;
+
+    void forwardSubstitution(T* const _rhs, T* const _x) override;
+    void diagSolve(T* const _rhs, T* const _x) override;
+    void backwardSubstitution(T* const _rhs, T* const _x) override;
+
+    ~SupernodalCholesky() {
+        releaseInternal();
+        deallocate();
+    }
+
+private:
+    void nestedDissection(const std::vector<IntType>& adjStart, const std::vector<IntType>& adj);
+    void eliminationTree(const std::vector<IntType>& adjStart, const std::vector<IntType>& adj, std::vector<IntType>& parent) const;
+    void factorSubtree(const IntType s, std::vector<std::vector<T> >& updates);
+    void forwardSubtree(const IntType s, T* const w, T* const u);
+    void backwardSubtree(const IntType s, T* const w);
+
+    IntType m_eliminated = 0; // n - m, number of nodes eliminated by the sparse factor
+    std::vector<IntType> m_perm; // new index -> original index
+    std::vector<IntType> m_iperm; // original index -> new index
+
+    // supernode s owns columns [m_snFirst[s], m_snFirst[s+1]) and the rows below them listed in
+    // m_snRows[m_snRowStart[s] ... m_snRowStart[s+1]). Its factor is a dense column major block of
+    // (columns + rows) x columns entries starting at m_factor[m_snValueStart[s]].
+    std::vector<IntType> m_snFirst;
+    std::vector<IntType> m_snRowStart;
+    std::vector<IntType> m_snRows;
+    std::vector<IntType> m_snRelative; // position of each row of m_snRows in the front of the parent supernode, or in the schur complement for roots
+    std::vector<size_t> m_snValueStart;
+    std::vector<IntType> m_snChildStart;
+    std::vector<IntType> m_snChildren;
+    std::vector<IntType> m_roots;
+
+    std::vector<size_t> m_valueMap; // location of each CSR entry in m_factor, or in schur when it couples two Schur nodes
+    std::vector<T> m_factor;
+    std::vector<T> m_work;
+    std::vector<T> m_update;
+};
@@ -1,5 +1,10 @@
 // #pragma once
+#include <stdexcept>
 #include <Common/KernelCommon.h>
+#include "Add_Force.h"
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
 
 #ifdef FORCE_INLINE
 #include <Kernels/Matrix_Times_Matrix/Matrix_Times_Matrix.h>
@@ -169,6 +174,28 @@ void Add_Force(const T_DATA (&x_Blocked)[4][3],
     v3.Store(f_Blocked[3]);
 }
 
+template<class Tarch, class T, int BlockWidth>
+void Add_Force_Block(const T (&x_Blocked)[4][3][BlockWidth],
+                     const T (&DmInverse_Blocked)[9][BlockWidth],
+                     const T (&restVolume)[BlockWidth],
+                     const T (&muLow)[BlockWidth],
+                     const T (&muHigh)[BlockWidth],
+                     const T (&strainMin)[BlockWidth],
+                     const T (&strainMax)[BlockWidth],
+                     T (&f_Blocked)[4][3][BlockWidth])
+{
+    static_assert(BlockWidth % Tarch::Width == 0, "block width must be a multiple of the SIMD width");
+    for (int ee = 0; ee < BlockWidth; ee += Tarch::Width)
+        Add_Force<Tarch, T[BlockWidth]>(reinterpret_cast<const T(&)[4][3][BlockWidth]>(x_Blocked[0][0][ee]),
+            reinterpret_cast<const T(&)[9][BlockWidth]>(DmInverse_Blocked[0][ee]),
+            reinterpret_cast<const T(&)[BlockWidth]>(restVolume[ee]),
+            reinterpret_cast<const T(&)[BlockWidth]>(muLow[ee]),
+            reinterpret_cast<const T(&)[BlockWidth]>(muHigh[ee]),
+            reinterpret_cast<const T(&)[BlockWidth]>(strainMin[ee]),
+            reinterpret_cast<const T(&)[BlockWidth]>(strainMax[ee]),
+            reinterpret_cast<T(&)[4][3][BlockWidth]>(f_Blocked[0][0][ee]));
+}
+
 #define INSTANCE_KERNEL_Add_Force(WIDTH,TYPE)               \
     const WIDETYPE(TYPE,WIDTH) (&x_Blocked)[4][3],          \
         const WIDETYPE(TYPE,WIDTH) (&DmInverse_Blocked)[9], \
@@ -179,6 +206,84 @@ void Add_Force(const T_DATA (&x_Blocked)[4][3],
         const WIDETYPE(TYPE,WIDTH) &strainMax,              \
         WIDETYPE(TYPE,WIDTH) (&f_Blocked)[4][3]
 
-INSTANCE_KERNEL_SIMD_AVX_FLOAT( Add_Force, 16)
+#define INSTANCE_KERNEL_Add_Force_Block(ARCH,TYPE,WIDTH)                                                   \
+    template void Add_Force_Block<ARCH<TYPE>, TYPE, WIDTH>(const TYPE (&x_Blocked)[4][3][WIDTH],         \
+        const TYPE (&DmInverse_Blocked)[9][WIDTH], const TYPE (&restVolume)[WIDTH],                      \
+        const TYPE (&muLow)[WIDTH], const TYPE (&muHigh)[WIDTH], const TYPE (&strainMin)[WIDTH],         \
+        const TYPE (&strainMax)[WIDTH], TYPE (&f_Blocked)[4][3][WIDTH]);
+
+#if defined(ADD_FORCE_SCALAR)
+INSTANCE_KERNEL_SCALAR_FLOAT( Add_Force, 16)
+INSTANCE_KERNEL_Add_Force_Block(SIMD_Numeric_Kernel::SIMDArchitectureScalar, float, 16)
+#elif defined(ADD_FORCE_AVX512)
 INSTANCE_KERNEL_SIMD_MIC_FLOAT( Add_Force, 16)
+INSTANCE_KERNEL_Add_Force_Block(SIMD_Numeric_Kernel::SIMDArchitectureAVX512, float, 16)
+#else
+INSTANCE_KERNEL_SIMD_AVX_FLOAT( Add_Force, 16)
+#ifdef ENABLE_AVX_INSTRUCTION_SET
+INSTANCE_KERNEL_Add_Force_Block(SIMD_Numeric_Kernel::SIMDArchitectureAVX2, float, 16)
+#endif
+
+// declarations of the instances compiled in Add_Force_Scalar.cpp and Add_Force_AVX512.cpp
+namespace SIMD_Numeric_Kernel {
+    template<class T> struct SIMDArchitectureAVX512;
+}
+extern INSTANCE_KERNEL_Add_Force_Block(SIMD_Numeric_Kernel::SIMDArchitectureScalar, float, 16)
+#ifdef ENABLE_AVX512_KERNELS
+extern INSTANCE_KERNEL_Add_Force_Block(SIMD_Numeric_Kernel::SIMDArchitectureAVX512, float, 16)
+#endif
+
+SIMDArchitectureType Detect_SIMD_Architecture()
+{
+    bool avx2 = false, avx512 = false;
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] >= 7) {
+        __cpuid(info, 1);
+        const bool osxsave = (info[2] & (1 << 27)) != 0;
+        const bool fma = (info[2] & (1 << 12)) != 0;
+        const unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+        __cpuidex(info, 7, 0);
+        avx2 = fma && (info[1] & (1 << 5)) && (xcr0 & 0x6) == 0x6; // ymm state saved by the OS
+        avx512 = avx2 && (info[1] & (1 << 16)) && (xcr0 & 0xe6) == 0xe6; // zmm and opmask state saved by the OS
+    }
+#elif defined(__GNUC__)
+    __builtin_cpu_init();
+    avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    avx512 = avx2 && __builtin_cpu_supports("avx512f");
+#endif
+#ifdef ENABLE_AVX512_KERNELS
+    if (avx512) return SIMDArchitectureType::AVX512;
+#endif
+#ifdef ENABLE_AVX_INSTRUCTION_SET
+    if (avx2) return SIMDArchitectureType::AVX2;
+#endif
+    return SIMDArchitectureType::Scalar;
+}
+
+template<class T, int BlockWidth>
+Add_Force_Block_Function<T, BlockWidth> Select_Add_Force_Block(const SIMDArchitectureType architecture)
+{
+    using namespace SIMD_Numeric_Kernel;
+    switch (architecture) {
+    case SIMDArchitectureType::Scalar:
+        return &Add_Force_Block<SIMDArchitectureScalar<T>, T, BlockWidth>;
+#ifdef ENABLE_AVX_INSTRUCTION_SET
+    case SIMDArchitectureType::AVX2:
+        return &Add_Force_Block<SIMDArchitectureAVX2<T>, T, BlockWidth>;
+#endif
+#ifdef ENABLE_AVX512_KERNELS
+    case SIMDArchitectureType::AVX512:
+        return &Add_Force_Block<SIMDArchitectureAVX512<T>, T, BlockWidth>;
+#endif
+    default:
+        throw std::logic_error("Add_Force is not built for the requested instruction set");
+    }
+}
+
+template Add_Force_Block_Function<float, 16> Select_Add_Force_Block<float, 16>(const SIMDArchitectureType architecture);
+#endif
+
+#undef INSTANCE_KERNEL_Add_Force_Block
 #undef INSTANCE_KERNEL_Add_Force
@@ -0,0 +1,8 @@
+// AVX-512 instance of the Add_Force kernel, selected at run time by Detect_SIMD_Architecture().
+// Build this file with AVX-512 code generation (/arch:AVX512, -mavx512f) and define
+// ENABLE_AVX512_KERNELS for the whole target when it is part of the build.
+#ifndef ENABLE_MIC_INSTRUCTION_SET
+#define ENABLE_MIC_INSTRUCTION_SET
+#endif
+#define ADD_FORCE_AVX512
+#include "Add_Force.cpp"
@@ -0,0 +1,4 @@
+// Scalar instance of the Add_Force kernel, the fallback of Detect_SIMD_Architecture().
+// Build this file without AVX code generation flags so it runs on any x86-64 cpu.
+#define ADD_FORCE_SCALAR
+#include "Add_Force.cpp"
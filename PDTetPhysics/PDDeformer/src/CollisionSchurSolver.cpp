@@ -0,0 +1,854 @@
+#include "CollisionSchurSolver.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <tbb/parallel_for.h>
+#include <tbb/blocked_range.h>
+
+namespace PhysBAM {
+    template<class Discretization, class IntType>
+    void CollisionSchurSolver<Discretization, IntType>::initialize(const NodeArrayType& nodeType)
+    {
+#ifndef _WIN32
+        LOG::SCOPE scope("CollisionSchurSolver::initialize()");
+#endif
+        m_assembly.m_factSchur = false;
+        m_assembly.deallocate();
+        m_assembly.initialize(nodeType);
+        schurSize = m_assembly.schurSize;
+        matrixSize = (IntType)m_assembly.m_tensorRowIndex.size() - 1;
+        m_A22RowIndex.assign(schurSize + 1, 0);
+        m_A22Column.clear();
+        m_A22Value.clear();
+        m_rhs.assign((size_t)matrixSize * d, T(0));
+        m_x.assign((size_t)matrixSize * d, T(0));
+        m_f2.assign((size_t)schurSize * d, T(0));
+        m_blocks.clear();
+        m_block.clear();
+        m_position.clear();
+        clearLowRank();
+    }
+
+    template<class Discretization, class IntType>
+    void CollisionSchurSolver<Discretization, IntType>::deallocate()
+    {
+        m_assembly.deallocate();
+        std::vector<IntType>().swap(m_A22RowIndex);
+        std::vector<IntType>().swap(m_A22Column);
+        std::vector<T>().swap(m_A22Value);
+        std::vector<T>().swap(m_f2);
+        std::vector<T>().swap(m_rhs);
+        std::vector<T>().swap(m_x);
+        std::vector<DenseBlock>().swap(m_blocks);
+        std::vector<IntType>().swap(m_block);
+        std::vector<IntType>().swap(m_position);
+        clearLowRank();
+        std::vector<T>().swap(m_lowRankZ);
+        std::vector<T>().swap(m_lowRankV);
+        std::vector<T>().swap(m_lowRankW);
+    }
+
+    template<class Discretization, class IntType>
+    template<class ElementTensor>
+    void CollisionSchurSolver<Discretization, IntType>::assembleE2Tensor(const std::vector<ElementType>& elements, const std::vector<ElementFlag>& flags, const ElementTensor& elementTensor)
+    {
+        using NodeIteratorType = Iterator<NodeArrayType>;
+        const IntType offset = matrixSize - schurSize;
+        std::vector<std::tuple<IntType, IntType, T>> entries;
+        for (size_t e = 0; e < elements.size(); e++)
+            if (flags[e] == ElementFlag::CollisionEl) {
+                typename DiscretizationType::ElementTensorType stiffnessMatrix;
+                elementTensor(e, stiffnessMatrix);
+                const auto& elementIndex = DiscretizationType::getElementIndex(elements[e]);
+                std::array<IntType, elementNodes> local;
+                for (int i = 0; i < elementNodes; i++) {
+                    local[i] = NodeIteratorType::at(m_assembly.m_numbering, elementIndex[i]) - offset;
+                    if (local[i] < 0)
+                        throw std::logic_error("collision element " + std::to_string(e) + " has a node outside the collision block");
+                }
+                // the element tensor is negative definite, A22 is positive as the system matrix
+                for (int i = 0; i < elementNodes; i++)
+                    for (int j = 0; j < elementNodes; j++)
+                        entries.emplace_back(local[i], local[j], -stiffnessMatrix(i + 1, j + 1));
+            }
+        std::sort(entries.begin(), entries.end(), [](const std::tuple<IntType, IntType, T>& a, const std::tuple<IntType, IntType, T>& b) {
+            return std::get<0>(a) < std::get<0>(b) || (std::get<0>(a) == std::get<0>(b) && std::get<1>(a) < std::get<1>(b));
+        });
+
+        m_A22RowIndex.assign(schurSize + 1, 0);
+        m_A22Column.clear();
+        m_A22Value.clear();
+        for (size_t k = 0; k < entries.size(); k++) {
+            const IntType row = std::get<0>(entries[k]), col = std::get<1>(entries[k]);
+            if (k && std::get<0>(entries[k - 1]) == row && std::get<1>(entries[k - 1]) == col)
+                m_A22Value.back() += std::get<2>(entries[k]);
+            else {
+                m_A22Column.push_back(col);
+                m_A22Value.push_back(std::get<2>(entries[k]));
+                m_A22RowIndex[row + 1]++;
+            }
+        }
+        for (IntType i = 0; i < schurSize; i++)
+            m_A22RowIndex[i + 1] += m_A22RowIndex[i];
+    }
+
+    template<class Discretization, class IntType>
+    void CollisionSchurSolver<Discretization, IntType>::computeE2Tensor(const std::vector<ElementType>& elements, const std::vector<ElementFlag>& flags,
+        const std::vector<GradientMatrixType>& gradients, const std::vector<T>& restVol, const std::vector<T>& muLow, const std::vector<T>& muHigh)
+    {
+#ifndef _WIN32
+        LOG::SCOPE scope("CollisionSchurSolver::computeE2Tensor()");
+#endif
+        assembleE2Tensor(elements, flags, [&](const size_t e, typename DiscretizationType::ElementTensorType& stiffnessMatrix) {
+            DiscretizationType::computeElementTensor(stiffnessMatrix, gradients[e], -2 * (muLow[e] + muHigh[e]) * restVol[e]);
+        });
+    }
+
+    template<class Discretization, class IntType>
+    void CollisionSchurSolver<Discretization, IntType>::computeE2Tensor(const std::vector<ElementType>& elements, const std::vector<ElementFlag>& flags, const std::vector<uint8_t>& elementShape,
+        const std::vector<GradientMatrixType>& shapeGradients, const std::vector<T>& shapeRestVol, const std::vector<T>& muLow, const std::vector<T>& muHigh)
+    {
+#ifndef _WIN32
+        LOG::SCOPE scope("CollisionSchurSolver::computeE2Tensor()");
+#endif
+        if (elementShape.size() != elements.size() || shapeGradients.size() != shapeRestVol.size())
+            throw std::logic_error("element shape table does not match the elements");
+        std::vector<typename DiscretizationType::ElementTensorType> shapeTensor(shapeGradients.size());
+        for (size_t s = 0; s < shapeGradients.size(); s++)
+            DiscretizationType::computeElementTensor(shapeTensor[s], shapeGradients[s], shapeRestVol[s]);
+        assembleE2Tensor(elements, flags, [&](const size_t e, typename DiscretizationType::ElementTensorType& stiffnessMatrix) {
+            if (elementShape[e] >= shapeTensor.size())
+                throw std::logic_error("element shape out of range");
+            stiffnessMatrix = shapeTensor[elementShape[e]] * (-2 * (muLow[e] + muHigh[e]));
+        });
+    }
+
+    template<class Discretization, class IntType>
+    void CollisionSchurSolver<Discretization, IntType>::initializeBlocks()
+    {
+        // connected components of the system matrix by union find over its upper triangle
+        const IntType n = matrixSize, m = schurSize;
+        const auto& rowIndex = m_assembly.m_tensorRowIndex;
+        const auto& column = m_assembly.m_tensorColumn;
+        std::vector<IntType> parent(n);
+        for (IntType i = 0; i < n; i++)
+            parent[i] = i;
+        auto find = [&](IntType i) {
+            while (parent[i] != i)
+                i = parent[i] = parent[parent[i]];
+            return i;
+        };
+        for (IntType i = 0; i < n; i++)
+            for (IntType k = rowIndex[i]; k < rowIndex[i + 1]; k++) {
+                const IntType a = find(i), b = find(column[k]);
+                if (a != b)
+                    parent[std::max(a, b)] = std::min(a, b);
+            }
+
+        std::vector<IntType> blockOfRoot(n, -1);
+        m_blocks.clear();
+        m_block.resize(m);
+        m_position.resize(m);
+        for (IntType i = 0; i < m; i++) {
+            IntType& b = blockOfRoot[find(n - m + i)];
+            if (b < 0) {
+                b = (IntType)m_blocks.size();
+                m_blocks.emplace_back();
+            }
+            m_block[i] = b;
+            m_position[i] = (IntType)m_blocks[b].nodes.size();
+            m_blocks[b].nodes.push_back(i);
+        }
+        for (auto& block : m_blocks) {
+            const size_t nb = block.nodes.size();
+            block.S.resize(nb * (nb + 1) / 2);
+            block.work.resize(2 * d * nb);
+        }
+        LOG::cout << "    collision blocks = " << m_blocks.size() << std::endl;
+    }
+
+    template<class Discretization, class IntType>
+    void CollisionSchurSolver<Discretization, IntType>::mergeBlocks(IntType a, IntType b)
+    {
+        // b joins a, the last block takes the place of b
+        if (a > b)
+            std::swap(a, b);
+        DenseBlock& first = m_blocks[a];
+        const DenseBlock& second = m_blocks[b];
+        const IntType n1 = (IntType)first.nodes.size(), n2 = (IntType)second.nodes.size(), nb = n1 + n2;
+        std::vector<T> S((size_t)nb * (nb + 1) / 2, T(0));
+        for (IntType p = 0; p < n1; p++)
+            std::copy(row(first.S, n1, p) + p, row(first.S, n1, p) + n1, row(S, nb, p) + p);
+        for (IntType p = 0; p < n2; p++)
+            std::copy(row(second.S, n2, p) + p, row(second.S, n2, p) + n2, row(S, nb, n1 + p) + n1 + p);
+        for (IntType p = 0; p < n2; p++) {
+            m_block[second.nodes[p]] = a;
+            m_position[second.nodes[p]] = n1 + p;
+        }
+        first.nodes.insert(first.nodes.end(), second.nodes.begin(), second.nodes.end());
+        first.S.swap(S);
+        first.work.resize(2 * d * (size_t)nb);
+        first.factored = false;
+
+        if (b + 1 != (IntType)m_blocks.size()) {
+            m_blocks[b] = std::move(m_blocks.back());
+            for (const IntType i : m_blocks[b].nodes)
+                m_block[i] = b;
+        }
+        m_blocks.pop_back();
+    }
+
+    template<class Discretization, class IntType>
+    void CollisionSchurSolver<Discretization, IntType>::copySchur()
+    {
+        const IntType m = schurSize;
+        const T* const schur = m_assembly.m_sparseSolver->schur;
+        for (auto& block : m_blocks) {
+            const IntType nb = (IntType)block.nodes.size();
+            tbb::parallel_for(tbb::blocked_range<IntType>(0, nb, 16), [&](const tbb::blocked_range<IntType>& r) {
+                for (IntType p = r.begin(); p < r.end(); p++) {
+                    T* const Sp = row(block.S, nb, p);
+                    for (IntType q = p; q < nb; q++) {
+                        const IntType i = std::min(block.nodes[p], block.nodes[q]), j = std::max(block.nodes[p], block.nodes[q]);
+                        Sp[q] = schur[(size_t)i * m + j];
+                    }
+                }
+            });
+            block.factored = false;
+        }
+    }
+
+    template<class Discretization, class IntType>
+    void CollisionSchurSolver<Discretization, IntType>::initializePardiso(const std::vector<Constraint>& constraints, const std::vector<Suture>& sutures, const std::vector<Constraint>& fakeSutures, const std::vector<InternodeConstraint>& microNodes)
+    {
+        clearLowRank();
+        initializeBlocks();
+        m_assembly.allocateSchur();
+        m_assembly.initializePardiso(constraints, sutures, fakeSutures, microNodes);
+        copySchur();
+        m_assembly.releaseSchur();
+    }
+
+    template<class Discretization, class IntType>
+    void CollisionSchurSolver<Discretization, IntType>::reInitializePardiso(const std::vector<Constraint>& constraints, const std::vector<Suture>& sutures, const std::vector<Constraint>& fakeSutures, const std::vector<InternodeConstraint>& microNodes)
+    {
+        clearLowRank();
+        m_assembly.allocateSchur();
+        m_assembly.reInitializePardiso(constraints, sutures, fakeSutures, microNodes);
+        copySchur();
+        m_assembly.releaseSchur();
+    }
+
+    template<class Discretization, class IntType>
+    void CollisionSchurSolver<Discretization, IntType>::initializeCollision(const std::vector<Constraint>& collisionConstraints, const std::vector<CollisionSuture>& collisionSutures)
+    {
+        for (auto& block : m_blocks)
+            block.factored = false;
+        updateCollision(collisionConstraints, collisionSutures);
+    }
+
+    template<class Discretization, class IntType>
+    IntType CollisionSchurSolver<Discretization, IntType>::localNumber(const IndexType node) const
+    {
+        const IntType number = Iterator<NodeArrayType>::at(m_assembly.m_numbering, node) - (matrixSize - schurSize);
+        return number >= 0 ? number : IntType(-1);
+    }
+
+    template<class Discretization, class IntType>
+    template<int elementNodesN>
+    void CollisionSchurSolver<Discretization, IntType>::scatterTerm(DenseBlock& block, const std::array<IndexType, elementNodesN>& elementIndex, const MATRIX<T, elementNodesN>& stiffnessMatrix) const
+    {
+        // stiffnessMatrix is negative definite, as in SchurSolver::scatterTensor()
+        const IntType nb = (IntType)block.nodes.size();
+        std::array<IntType, elementNodesN> position;
+        for (int i = 0; i < elementNodesN; i++) {
+            const IntType local = localNumber(elementIndex[i]);
+            position[i] = local >= 0 ? m_position[local] : IntType(-1);
+        }
+        for (int i = 0; i < elementNodesN; i++)
+            if (position[i] >= 0) {
+                T* const Ui = row(block.factor, nb, position[i]);
+                for (int j = 0; j < elementNodesN; j++)
+                    if (position[j] >= position[i])
+                        Ui[position[j]] -= stiffnessMatrix(i + 1, j + 1);
+            }
+    }
+
+    template<class Discretization, class IntType>
+    void CollisionSchurSolver<Discretization, IntType>::updateCollision(const std::vector<Constraint>& collisionConstraints, const std::vector<CollisionSuture>& collisionSutures)
+    {
+        // the block of a term is the block of its first collision node, a suture across two blocks merges them
+        auto blockOf = [&](const IndexType* const nodes, const int count, const bool merge) {
+            IntType b = -1;
+            for (int i = 0; i < count; i++) {
+                const IntType local = localNumber(nodes[i]);
+                if (local < 0)
+                    continue;
+                if (b < 0)
+                    b = m_block[local];
+                else if (merge && m_block[local] != b) {
+                    const IntType other = m_block[local];
+                    mergeBlocks(b, other);
+                    b = std::min(b, other);
+                }
+            }
+            return b;
+        };
+        for (const auto& suture : collisionSutures)
+            if (suture.m_stiffness) {
+                std::array<IndexType, elementNodes * 2> nodes;
+                std::copy(suture.m_elementIndex1.begin(), suture.m_elementIndex1.end(), nodes.begin());
+                std::copy(suture.m_elementIndex2.begin(), suture.m_elementIndex2.end(), nodes.begin() + elementNodes);
+                blockOf(nodes.data(), elementNodes * 2, true);
+            }
+
+        for (auto& block : m_blocks) {
+            block.constraints.clear();
+            block.sutures.clear();
+        }
+        for (int c = 0; c < (int)collisionConstraints.size(); c++)
+            if (collisionConstraints[c].m_stiffness != 0) {
+                const IntType b = blockOf(collisionConstraints[c].m_elementIndex.data(), elementNodes, false);
+                if (b >= 0)
+                    m_blocks[b].constraints.push_back(c);
+            }
+        for (int c = 0; c < (int)collisionSutures.size(); c++)
+            if (collisionSutures[c].m_stiffness) {
+                IntType b = blockOf(collisionSutures[c].m_elementIndex1.data(), elementNodes, false);
+                if (b < 0)
+                    b = blockOf(collisionSutures[c].m_elementIndex2.data(), elementNodes, false);
+                if (b >= 0)
+                    m_blocks[b].sutures.push_back(c);
+            }
+
+#if TIMING
+        auto start = std::chrono::steady_clock::now();
+#endif
+        std::atomic<bool> refactored(false);
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, m_blocks.size(), 1), [&](const tbb::blocked_range<size_t>& r) {
+            for (size_t b = r.begin(); b < r.end(); b++) {
+                DenseBlock& block = m_blocks[b];
+                std::vector<T> state;
+                std::vector<IndexType> stateNodes;
+                for (const int c : block.constraints) {
+                    const Constraint& constraint = collisionConstraints[c];
+                    state.push_back(constraint.m_stiffness);
+                    state.insert(state.end(), constraint.m_weights.begin(), constraint.m_weights.end());
+                    stateNodes.insert(stateNodes.end(), constraint.m_elementIndex.begin(), constraint.m_elementIndex.end());
+                }
+                for (const int c : block.sutures) {
+                    const CollisionSuture& suture = collisionSutures[c];
+                    state.push_back(suture.m_stiffness);
+                    state.insert(state.end(), suture.m_weights1.begin(), suture.m_weights1.end());
+                    state.insert(state.end(), suture.m_weights2.begin(), suture.m_weights2.end());
+                    stateNodes.insert(stateNodes.end(), suture.m_elementIndex1.begin(), suture.m_elementIndex1.end());
+                    stateNodes.insert(stateNodes.end(), suture.m_elementIndex2.begin(), suture.m_elementIndex2.end());
+                }
+                if (block.factored && state == block.state && stateNodes == block.stateNodes)
+                    continue;
+                block.state.swap(state);
+                block.stateNodes.swap(stateNodes);
+
+                // reset from S, so the terms of the previous frame are gone
+                block.factor = block.S;
+                for (const int c : block.constraints) {
+                    typename DiscretizationType::ElementTensorType stiffnessMatrix;
+                    DiscretizationType::computeConstraintTensor(stiffnessMatrix, collisionConstraints[c]);
+                    scatterTerm<elementNodes>(block, collisionConstraints[c].m_elementIndex, stiffnessMatrix);
+                }
+                for (const int c : block.sutures) {
+                    typename DiscretizationType::SutureTensorType stiffnessMatrix;
+                    std::array<IndexType, elementNodes * 2> elementIndex;
+                    DiscretizationType::computeCollisionSutureTensor(stiffnessMatrix, elementIndex, collisionSutures[c]);
+                    scatterTerm<elementNodes * 2>(block, elementIndex, stiffnessMatrix);
+                }
+                factorDense(block.factor, (IntType)block.nodes.size());
+                block.factored = true;
+                refactored = true;
+            }
+        });
+        if (refactored)
+            m_lowRankWCurrent = false;
+#if TIMING
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << "Collision Block Factorization Time: " << elapsed.count() << " s" << std::endl;
+#endif
+    }
+
+    template<class Discretization, class IntType>
+    void CollisionSchurSolver<Discretization, IntType>::factorDense(std::vector<T>& packed, const IntType n)
+    {
+        // right looking blocked U^T * U: each diagonal block is factored serially, then the panel to its
+        // right and the trailing upper triangle are updated in parallel
+        for (IntType k0 = 0; k0 < n; k0 += blockSize) {
+            const IntType k1 = std::min<IntType>(k0 + blockSize, n);
+            for (IntType k = k0; k < k1; k++) {
+                T* const Uk = row(packed, n, k);
+                if (!(Uk[k] > T(0)))
+                    throw std::logic_error("non positive pivot in collision block factorization at row " + std::to_string(k));
+                const T pivot = std::sqrt(Uk[k]);
+                Uk[k] = pivot;
+                for (IntType j = k + 1; j < k1; j++)
+                    Uk[j] /= pivot;
+                for (IntType i = k + 1; i < k1; i++) {
+                    T* const Ui = row(packed, n, i);
+                    const T f = Uk[i];
+                    for (IntType j = i; j < k1; j++)
+                        Ui[j] -= f * Uk[j];
+                }
+            }
+
+            tbb::parallel_for(tbb::blocked_range<IntType>(k1, n, 256), [&](const tbb::blocked_range<IntType>& r) {
+                for (IntType k = k0; k < k1; k++) {
+                    T* const Uk = row(packed, n, k);
+                    const T pivot = Uk[k];
+                    for (IntType j = r.begin(); j < r.end(); j++)
+                        Uk[j] /= pivot;
+                    for (IntType i = k + 1; i < k1; i++) {
+                        T* const Ui = row(packed, n, i);
+                        const T f = Uk[i];
+                        for (IntType j = r.begin(); j < r.end(); j++)
+                            Ui[j] -= f * Uk[j];
+                    }
+                }
+            });
+
+            tbb::parallel_for(tbb::blocked_range<IntType>(k1, n, 8), [&](const tbb::blocked_range<IntType>& r) {
+                for (IntType i = r.begin(); i < r.end(); i++) {
+                    T* const Ui = row(packed, n, i);
+                    // a tile of row i stays in cache while the panel rows are applied to it
+                    for (IntType j0 = i; j0 < n; j0 += 256) {
+                        const IntType j1 = std::min<IntType>(j0 + 256, n);
+                        for (IntType p = k0; p < k1; p++) {
+                            const T* const Up = row(packed, n, p);
+                            const T f = Up[i];
+                            for (IntType j = j0; j < j1; j++)
+                                Ui[j] -= f * Up[j];
+                        }
+                    }
+                }
+            });
+        }
+    }
+
+    template<class Discretization, class IntType>
+    void CollisionSchurSolver<Discretization, IntType>::solveDense(const std::vector<T>& packed, const IntType n, T* const x)
+    {
+        // U^T * U * x = b for all d columns at once, blocked so that the off diagonal part of each block row
+        // is applied in parallel and U is streamed once per substitution
+        std::array<T*, d> b;
+        for (int v = 0; v < d; v++)
+            b[v] = x + (size_t)v * n;
+
+        for (IntType k0 = 0; k0 < n; k0 += blockSize) {
+            const IntType k1 = std::min<IntType>(k0 + blockSize, n);
+            for (IntType k = k0; k < k1; k++) {
+                const T* const Uk = row(packed, n, k);
+                for (int v = 0; v < d; v++) {
+                    b[v][k] /= Uk[k];
+                    for (IntType j = k + 1; j < k1; j++)
+                        b[v][j] -= Uk[j] * b[v][k];
+                }
+            }
+            tbb::parallel_for(tbb::blocked_range<IntType>(k1, n, 256), [&](const tbb::blocked_range<IntType>& r) {
+                for (IntType k = k0; k < k1; k++) {
+                    const T* const Uk = row(packed, n, k);
+                    for (int v = 0; v < d; v++) {
+                        const T f = b[v][k];
+                        for (IntType j = r.begin(); j < r.end(); j++)
+                            b[v][j] -= Uk[j] * f;
+                    }
+                }
+            });
+        }
+
+        for (IntType k1 = n; k1 > 0; k1 -= std::min<IntType>(k1, blockSize)) {
+            const IntType k0 = k1 - std::min<IntType>(k1, blockSize);
+            tbb::parallel_for(tbb::blocked_range<IntType>(k0, k1, 4), [&](const tbb::blocked_range<IntType>& r) {
+                for (IntType i = r.begin(); i < r.end(); i++) {
+                    const T* const Ui = row(packed, n, i);
+                    for (int v = 0; v < d; v++) {
+                        T sum = T(0);
+                        for (IntType j = k1; j < n; j++)
+                            sum += Ui[j] * b[v][j];
+                        b[v][i] -= sum;
+                    }
+                }
+            });
+            for (IntType i = k1 - 1; i >= k0; i--) {
+                const T* const Ui = row(packed, n, i);
+                for (int v = 0; v < d; v++) {
+                    T sum = b[v][i];
+                    for (IntType j = i + 1; j < k1; j++)
+                        sum -= Ui[j] * b[v][j];
+                    b[v][i] = sum / Ui[i];
+                }
+            }
+        }
+    }
+
+    template<class Discretization, class IntType>
+    void CollisionSchurSolver<Discretization, IntType>::setTemp()
+    {
+        const IntType n = matrixSize, m = schurSize;
+        for (int v = 0; v < d; v++)
+            std::copy(m_x.begin() + (size_t)v * n + n - m, m_x.begin() + (size_t)(v + 1) * n, m_f2.begin() + (size_t)v * m);
+        // the interior load the low rank terms carry to the collision block, m_f2 -= V * G^-1 * h
+        const int k = lowRankTerms();
+        if (!k)
+            return;
+        std::vector<T> s(m_lowRankH);
+        for (int v = 0; v < d; v++) {
+            solveSmall(m_lowRankGLU, m_lowRankGPivot, k, s.data() + (size_t)v * k);
+            for (int j = 0; j < k; j++) {
+                const T* const Vj = m_lowRankV.data() + (size_t)j * m;
+                T* const f2 = m_f2.data() + (size_t)v * m;
+                for (IntType i = 0; i < m; i++)
+                    f2[i] -= s[(size_t)v * k + j] * Vj[i];
+            }
+        }
+    }
+
+    template<class Discretization, class IntType>
+    void CollisionSchurSolver<Discretization, IntType>::updateForce()
+    {
+        const IntType n = matrixSize, m = schurSize;
+        std::copy(m_rhs.begin(), m_rhs.end(), m_x.begin());
+        for (int v = 0; v < d; v++)
+            for (IntType i = 0; i < m; i++)
+                m_x[(size_t)v * n + n - m + i] += m_f2[(size_t)v * m + i];
+    }
+
+    template<class Discretization, class IntType>
+    void CollisionSchurSolver<Discretization, IntType>::diagSolve()
+    {
+        const IntType n = matrixSize, m = schurSize;
+        T* const x2 = m_x.data() + n - m;
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, m_blocks.size(), 1), [&](const tbb::blocked_range<size_t>& r) {
+            for (size_t b = r.begin(); b < r.end(); b++) {
+                DenseBlock& block = m_blocks[b];
+                const IntType nb = (IntType)block.nodes.size();
+                for (int v = 0; v < d; v++)
+                    for (IntType p = 0; p < nb; p++)
+                        block.work[(size_t)v * nb + p] = x2[(size_t)v * n + block.nodes[p]];
+                solveDense(block.factor, nb, block.work.data());
+                for (int v = 0; v < d; v++)
+                    for (IntType p = 0; p < nb; p++)
+                        x2[(size_t)v * n + block.nodes[p]] = block.work[(size_t)v * nb + p];
+            }
+        });
+
+        // x2 -= W * (G + V^T * W)^-1 * V^T * x2
+        const int k = lowRankTerms();
+        if (!k)
+            return;
+        if (!m_lowRankWCurrent)
+            factorCapacitance();
+        std::vector<T> s;
+        projectLowRank(x2, n, s);
+        for (int v = 0; v < d; v++) {
+            solveSmall(m_lowRankKLU, m_lowRankKPivot, k, s.data() + (size_t)v * k);
+            for (int j = 0; j < k; j++) {
+                const T* const Wj = m_lowRankW.data() + (size_t)j * m;
+                T* const x = x2 + (size_t)v * n;
+                for (IntType i = 0; i < m; i++)
+                    x[i] -= s[(size_t)v * k + j] * Wj[i];
+            }
+        }
+    }
+
+    template<class Discretization, class IntType>
+    void CollisionSchurSolver<Discretization, IntType>::updateTemp()
+    {
+        const IntType n = matrixSize, m = schurSize;
+        const T* const x2 = m_x.data() + n - m;
+        for (auto& block : m_blocks) {
+            const IntType nb = (IntType)block.nodes.size();
+            T* const x = block.work.data();
+            T* const y = x + (size_t)d * nb;
+            for (int v = 0; v < d; v++)
+                for (IntType p = 0; p < nb; p++)
+                    x[(size_t)v * nb + p] = x2[(size_t)v * n + block.nodes[p]];
+            // y = S * x from the upper triangle, by rows and then by columns for the transposed part
+            tbb::parallel_for(tbb::blocked_range<IntType>(0, nb, 16), [&](const tbb::blocked_range<IntType>& r) {
+                for (IntType p = r.begin(); p < r.end(); p++) {
+                    const T* const Sp = row(block.S, nb, p);
+                    for (int v = 0; v < d; v++) {
+                        const T* const xv = x + (size_t)v * nb;
+                        T sum = T(0);
+                        for (IntType q = p; q < nb; q++)
+                            sum += Sp[q] * xv[q];
+                        y[(size_t)v * nb + p] = sum;
+                    }
+                }
+            });
+            tbb::parallel_for(tbb::blocked_range<IntType>(0, nb, 256), [&](const tbb::blocked_range<IntType>& r) {
+                for (IntType p = 0; p + 1 < r.end(); p++) {
+                    const T* const Sp = row(block.S, nb, p);
+                    for (int v = 0; v < d; v++) {
+                        const T xp = x[(size_t)v * nb + p];
+                        T* const yv = y + (size_t)v * nb;
+                        for (IntType q = std::max<IntType>(r.begin(), p + 1); q < r.end(); q++)
+                            yv[q] += Sp[q] * xp;
+                    }
+                }
+            });
+            for (int v = 0; v < d; v++)
+                for (IntType p = 0; p < nb; p++)
+                    m_f2[(size_t)v * m + block.nodes[p]] -= y[(size_t)v * nb + p];
+        }
+
+        tbb::parallel_for(tbb::blocked_range<IntType>(0, m, 64), [&](const tbb::blocked_range<IntType>& r) {
+            for (IntType i = r.begin(); i < r.end(); i++)
+                for (int v = 0; v < d; v++) {
+                    T sum = T(0);
+                    for (IntType k = m_A22RowIndex[i]; k < m_A22RowIndex[i + 1]; k++)
+                        sum += m_A22Value[k] * x2[(size_t)v * n + m_A22Column[k]];
+                    m_f2[(size_t)v * m + i] += sum;
+                }
+        });
+
+        // and the low rank part of the Schur complement, m_f2 -= V * G^-1 * V^T * x2
+        const int k = lowRankTerms();
+        if (!k)
+            return;
+        std::vector<T> s;
+        projectLowRank(x2, n, s);
+        for (int v = 0; v < d; v++) {
+            solveSmall(m_lowRankGLU, m_lowRankGPivot, k, s.data() + (size_t)v * k);
+            for (int j = 0; j < k; j++) {
+                const T* const Vj = m_lowRankV.data() + (size_t)j * m;
+                T* const f2 = m_f2.data() + (size_t)v * m;
+                for (IntType i = 0; i < m; i++)
+                    f2[i] -= s[(size_t)v * k + j] * Vj[i];
+            }
+        }
+    }
+
+    template<class Discretization, class IntType>
+    void CollisionSchurSolver<Discretization, IntType>::forwardSubstitution()
+    {
+        // h = Z^T * f1 = U1^T * A11^-1 * f1, needed by setTemp() and backwardSubstitution()
+        const int k = lowRankTerms();
+        if (k) {
+            const IntType n = matrixSize, interior = matrixSize - schurSize;
+            m_lowRankH.assign((size_t)d * k, T(0));
+            for (int v = 0; v < d; v++)
+                for (int j = 0; j < k; j++) {
+                    const T* const Zj = m_lowRankZ.data() + (size_t)j * interior;
+                    const T* const f1 = m_rhs.data() + (size_t)v * n;
+                    T dot = T(0);
+                    for (IntType r = 0; r < interior; r++)
+                        dot += Zj[r] * f1[r];
+                    m_lowRankH[(size_t)v * k + j] = dot;
+                }
+        }
+        m_assembly.m_sparseSolver->forwardSubstitution(m_rhs.data(), m_x.data());
+    }
+
+    template<class Discretization, class IntType>
+    void CollisionSchurSolver<Discretization, IntType>::backwardSubstitution()
+    {
+        const IntType n = matrixSize, m = schurSize, interior = n - m;
+        const int k = lowRankTerms();
+        std::vector<T> y;
+        if (k) {
+            // y = G^-1 * (V^T * x2 + h), the extra unknowns C * U^T * x of the low rank terms
+            projectLowRank(m_rhs.data() + interior, n, y);
+            for (int v = 0; v < d; v++) {
+                for (int j = 0; j < k; j++)
+                    y[(size_t)v * k + j] += m_lowRankH[(size_t)v * k + j];
+                solveSmall(m_lowRankGLU, m_lowRankGPivot, k, y.data() + (size_t)v * k);
+            }
+        }
+        m_assembly.m_sparseSolver->backwardSubstitution(m_rhs.data(), m_x.data());
+        for (int v = 0; v < d; v++)
+            for (int j = 0; j < k; j++) {
+                const T* const Zj = m_lowRankZ.data() + (size_t)j * interior;
+                T* const x1 = m_x.data() + (size_t)v * n;
+                const T yj = y[(size_t)v * k + j];
+                for (IntType r = 0; r < interior; r++)
+                    x1[r] -= yj * Zj[r];
+            }
+    }
+
+    template<class Discretization, class IntType>
+    void CollisionSchurSolver<Discretization, IntType>::clearLowRank()
+    {
+        m_lowRankRows.clear();
+        m_lowRankWeights.clear();
+        m_lowRankStart.assign(1, 0);
+        m_lowRankStiffness.clear();
+        m_lowRankH.clear();
+        m_lowRankWCurrent = false;
+    }
+
+    template<class Discretization, class IntType>
+    template<int elementNodesN>
+    void CollisionSchurSolver<Discretization, IntType>::addLowRankTerm(const std::array<IndexType, elementNodesN>& elementIndex, const std::array<T, elementNodesN>& weights, const T stiffness)
+    {
+        for (int i = 0; i < elementNodesN; i++) {
+            const IntType row = Iterator<NodeArrayType>::at(m_assembly.m_numbering, elementIndex[i]);
+            if (row >= 0 && weights[i] != 0) {
+                m_lowRankRows.push_back(row);
+                m_lowRankWeights.push_back(weights[i]);
+            }
+        }
+        if ((int)m_lowRankRows.size() == m_lowRankStart.back())
+            return;
+        m_lowRankStart.push_back((int)m_lowRankRows.size());
+        m_lowRankStiffness.push_back(stiffness);
+    }
+
+    template<class Discretization, class IntType>
+    void CollisionSchurSolver<Discretization, IntType>::factorLowRank()
+    {
+        const IntType n = matrixSize, m = schurSize, interior = n - m;
+        const int k = lowRankTerms();
+        m_lowRankZ.assign((size_t)interior * k, T(0));
+        m_lowRankV.assign((size_t)m * k, T(0));
+
+        // Forward substitution of u leaves V on the collision block. Backward substitution with the collision block
+        // zeroed then gives Z on the interior. The solver takes d right hand sides at a time.
+        for (int first = 0; first < k; first += d) {
+            std::fill(m_rhs.begin(), m_rhs.end(), T(0));
+            const int last = std::min(k, first + d);
+            for (int j = first; j < last; j++)
+                for (int e = m_lowRankStart[j]; e < m_lowRankStart[j + 1]; e++)
+                    m_rhs[(size_t)(j - first) * n + m_lowRankRows[e]] += m_lowRankWeights[e];
+            m_assembly.m_sparseSolver->forwardSubstitution(m_rhs.data(), m_x.data());
+            for (int j = first; j < last; j++) {
+                T* const x = m_x.data() + (size_t)(j - first) * n;
+                std::copy(x + interior, x + n, m_lowRankV.begin() + (size_t)j * m);
+                std::fill(x + interior, x + n, T(0));
+            }
+            m_assembly.m_sparseSolver->backwardSubstitution(m_x.data(), m_rhs.data());
+            for (int j = first; j < last; j++) {
+                const T* const z = m_rhs.data() + (size_t)(j - first) * n;
+                std::copy(z, z + interior, m_lowRankZ.begin() + (size_t)j * interior);
+            }
+        }
+
+        // G = C^-1 + U1^T * Z
+        m_lowRankG.assign((size_t)k * k, T(0));
+        for (int i = 0; i < k; i++) {
+            for (int j = 0; j < k; j++) {
+                const T* const Zj = m_lowRankZ.data() + (size_t)j * interior;
+                T dot = T(0);
+                for (int e = m_lowRankStart[i]; e < m_lowRankStart[i + 1]; e++)
+                    if (m_lowRankRows[e] < interior)
+                        dot += m_lowRankWeights[e] * Zj[m_lowRankRows[e]];
+                m_lowRankG[(size_t)i * k + j] = dot;
+            }
+            m_lowRankG[(size_t)i * k + i] += T(1) / m_lowRankStiffness[i];
+        }
+        m_lowRankGLU = m_lowRankG;
+        factorSmall(m_lowRankGLU, m_lowRankGPivot, k);
+        m_lowRankWCurrent = false;
+    }
+
+    template<class Discretization, class IntType>
+    void CollisionSchurSolver<Discretization, IntType>::factorCapacitance()
+    {
+        const IntType m = schurSize;
+        const int k = lowRankTerms();
+        m_lowRankW.assign((size_t)m * k, T(0));
+        // W = (S + collision terms)^-1 * V block by block, d terms at a time
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, m_blocks.size(), 1), [&](const tbb::blocked_range<size_t>& r) {
+            for (size_t b = r.begin(); b < r.end(); b++) {
+                DenseBlock& block = m_blocks[b];
+                const IntType nb = (IntType)block.nodes.size();
+                for (int first = 0; first < k; first += d) {
+                    const int last = std::min(k, first + d);
+                    std::fill(block.work.begin(), block.work.begin() + (size_t)d * nb, T(0));
+                    for (int j = first; j < last; j++)
+                        for (IntType p = 0; p < nb; p++)
+                            block.work[(size_t)(j - first) * nb + p] = m_lowRankV[(size_t)j * m + block.nodes[p]];
+                    solveDense(block.factor, nb, block.work.data());
+                    for (int j = first; j < last; j++)
+                        for (IntType p = 0; p < nb; p++)
+                            m_lowRankW[(size_t)j * m + block.nodes[p]] = block.work[(size_t)(j - first) * nb + p];
+                }
+            }
+        });
+
+        m_lowRankKLU = m_lowRankG;
+        for (int i = 0; i < k; i++)
+            for (int j = 0; j < k; j++) {
+                const T* const Vi = m_lowRankV.data() + (size_t)i * m;
+                const T* const Wj = m_lowRankW.data() + (size_t)j * m;
+                T dot = T(0);
+                for (IntType r = 0; r < m; r++)
+                    dot += Vi[r] * Wj[r];
+                m_lowRankKLU[(size_t)i * k + j] += dot;
+            }
+        factorSmall(m_lowRankKLU, m_lowRankKPivot, k);
+        m_lowRankWCurrent = true;
+    }
+
+    template<class Discretization, class IntType>
+    void CollisionSchurSolver<Discretization, IntType>::projectLowRank(const T* const x2, const IntType n, std::vector<T>& s) const
+    {
+        const IntType m = schurSize;
+        const int k = lowRankTerms();
+        s.assign((size_t)d * k, T(0));
+        for (int v = 0; v < d; v++)
+            for (int j = 0; j < k; j++) {
+                const T* const Vj = m_lowRankV.data() + (size_t)j * m;
+                const T* const x = x2 + (size_t)v * n;
+                T dot = T(0);
+                for (IntType i = 0; i < m; i++)
+                    dot += Vj[i] * x[i];
+                s[(size_t)v * k + j] = dot;
+            }
+    }
+
+    template<class Discretization, class IntType>
+    void CollisionSchurSolver<Discretization, IntType>::factorSmall(std::vector<T>& LU, std::vector<int>& pivot, const int k)
+    {
+        // neither G nor G + V^T * W is definite, deleted terms have negative stiffness
+        pivot.resize(k);
+        for (int c = 0; c < k; c++) {
+            int p = c;
+            for (int r = c + 1; r < k; r++)
+                if (std::abs(LU[(size_t)r * k + c]) > std::abs(LU[(size_t)p * k + c]))
+                    p = r;
+            pivot[c] = p;
+            if (p != c)
+                for (int j = 0; j < k; j++)
+                    std::swap(LU[(size_t)c * k + j], LU[(size_t)p * k + j]);
+            if (LU[(size_t)c * k + c] == 0)
+                throw std::logic_error("singular low rank update");
+            for (int r = c + 1; r < k; r++) {
+                const T l = LU[(size_t)r * k + c] /= LU[(size_t)c * k + c];
+                for (int j = c + 1; j < k; j++)
+                    LU[(size_t)r * k + j] -= l * LU[(size_t)c * k + j];
+            }
+        }
+    }
+
+    template<class Discretization, class IntType>
+    void CollisionSchurSolver<Discretization, IntType>::solveSmall(const std::vector<T>& LU, const std::vector<int>& pivot, const int k, T* const s)
+    {
+        for (int i = 0; i < k; i++) {
+            std::swap(s[i], s[pivot[i]]);
+            for (int j = 0; j < i; j++)
+                s[i] -= LU[(size_t)i * k + j] * s[j];
+        }
+        for (int i = k - 1; i >= 0; i--) {
+            for (int j = i + 1; j < k; j++)
+                s[i] -= LU[(size_t)i * k + j] * s[j];
+            s[i] /= LU[(size_t)i * k + i];
+        }
+    }
+}
+
+namespace PhysBAM {
+    template struct CollisionSchurSolver<TetrahedralDiscretization<std::vector<VECTOR<float, 3>>>, int>;
+    template void CollisionSchurSolver<TetrahedralDiscretization<std::vector<VECTOR<float, 3>>>, int>::addLowRankTerm<4>(const std::array<int, 4>&, const std::array<float, 4>&, const float);
+    template void CollisionSchurSolver<TetrahedralDiscretization<std::vector<VECTOR<float, 3>>>, int>::addLowRankTerm<8>(const std::array<int, 8>&, const std::array<float, 8>&, const float);
+}
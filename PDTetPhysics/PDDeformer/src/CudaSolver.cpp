@@ -1,4 +1,11 @@
 #include "CudaSolver.h"
+#include "ArenaThreads.h"
+
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+#include <tbb/parallel_for.h>
+#include <tbb/blocked_range.h>
 
 #if TIMING
 #include <chrono>
@@ -57,7 +64,7 @@ namespace PhysBAM {
     template <class Discretization, class IntType>
     template<int elementNodesN>
     void CudaSolver<Discretization, IntType>::
-        accumToTensor(const PhysBAM::MATRIX_MXN<T>& stiffnessMatrix,
+        accumToTensor(const PhysBAM::MATRIX<T, elementNodesN>& stiffnessMatrix,
             const std::array<IndexType, elementNodesN>& elementIndex) {
         using IteratorType = Iterator<NodeArrayType>;
         for (int i = 0; i < elementNodesN; i++) {
@@ -80,7 +87,7 @@ namespace PhysBAM {
     template <class Discretization, class IntType>
     template <int elementNodesN>
     void CudaSolver<Discretization, IntType>::
-        accumToPardiso(const PhysBAM::MATRIX_MXN<T>& stiffnessMatrix,
+        accumToPardiso(const PhysBAM::MATRIX<T, elementNodesN>& stiffnessMatrix,
             const std::array<IndexType, elementNodesN>& elementIndex) {
         // need to check if repeated entry matters or not
         using IteratorType = Iterator<NodeArrayType>;
@@ -122,7 +129,7 @@ namespace PhysBAM {
     template <int elementNodesN>
     void CudaSolver<Discretization, IntType>::
         updateTensor(T* const result,
-            const PhysBAM::MATRIX_MXN<T>& stiffnessMatrix,
+            const PhysBAM::MATRIX<T, elementNodesN>& stiffnessMatrix,
             const std::array<IndexType, elementNodesN>& elementIndex) {
         // only cared about upper triangular in row major
         //LOG::SCOPE scope("CudaSolver::updateTensor");
@@ -156,7 +163,7 @@ namespace PhysBAM {
         for (int c = 0; c < collisionConstraints.size(); c++) {
             auto &constraint = collisionConstraints[c];
             if (constraint.m_stiffness != 0) {
-                MATRIX_MXN<T> stiffnessMatrix;
+                typename DiscretizationType::ElementTensorType stiffnessMatrix;
                 computeConstraintTensor(stiffnessMatrix, constraint);
                 updateTensor<elementNodes>(m_schur, stiffnessMatrix, constraint.m_elementIndex);
             }
@@ -195,7 +202,7 @@ namespace PhysBAM {
             auto stamp1 = std::chrono::steady_clock::now();
 #endif
 
-#pragma omp parallel for
+#pragma omp parallel for num_threads(arenaThreads())
             for (int i = 0; i < ps; i++) {
                 const auto& suture = collisionSutures[i];
                 std::pair<int, T> indexWeightPair[(d + 1) * 2];
@@ -259,7 +266,7 @@ namespace PhysBAM {
         for (int e = 0; e < elements.size(); e++)
             if (flags[e] == ElementFlag::CollisionEl)
             {
-                MATRIX_MXN<T> stiffnessMatrix;
+                typename DiscretizationType::ElementTensorType stiffnessMatrix;
                 DiscretizationType::computeElementTensor(stiffnessMatrix, gradients[e], -2 * mu * restVol[e]);
                 updateTensor<elementNodes>(m_A22, stiffnessMatrix, DiscretizationType::getElementIndex(elements[e]));
             }
@@ -285,7 +292,7 @@ namespace PhysBAM {
 #endif
 
         for (int e = 0; e < elements.size(); e++) {
-            MATRIX_MXN<T> stiffnessMatrix;
+            typename DiscretizationType::ElementTensorType stiffnessMatrix;
 
 #if TIMING
             startStamp = std::chrono::steady_clock::now();
@@ -313,7 +320,7 @@ namespace PhysBAM {
 #endif
         /*
          for (int c = 0; c < constraints.size(); c++) {
-             MATRIX_MXN<T> stiffnessMatrix;
+             typename DiscretizationType::ElementTensorType stiffnessMatrix;
              computeConstraintTensor(stiffnessMatrix, constraints[c]);
 
             accumToTensor<elementNodes>(stiffnessMatrix,
@@ -321,7 +328,7 @@ namespace PhysBAM {
          }
          */
         for (int c = 0; c < sutures.size(); c++) {
-            MATRIX_MXN<T> stiffnessMatrix;
+            typename DiscretizationType::SutureTensorType stiffnessMatrix;
             std::array<IndexType, elementNodes * 2> elementIndex;
             Suture tmp = sutures[c];
             tmp.m_stiffness = 0;
@@ -352,7 +359,7 @@ namespace PhysBAM {
 #endif
 
         for (int e = 0; e < elements.size(); e++) {
-            MATRIX_MXN<T> stiffnessMatrix;
+            typename DiscretizationType::ElementTensorType stiffnessMatrix;
 
 #if TIMING
             startStamp = std::chrono::steady_clock::now();
@@ -380,7 +387,7 @@ namespace PhysBAM {
 #endif
         /*
          for (int c = 0; c < constraints.size(); c++) {
-             MATRIX_MXN<T> stiffnessMatrix;
+             typename DiscretizationType::ElementTensorType stiffnessMatrix;
              computeConstraintTensor(stiffnessMatrix, constraints[c]);
 
             accumToTensor<elementNodes>(stiffnessMatrix,
@@ -388,7 +395,7 @@ namespace PhysBAM {
          }
          */
         for (int c = 0; c < sutures.size(); c++) {
-            MATRIX_MXN<T> stiffnessMatrix;
+            typename DiscretizationType::SutureTensorType stiffnessMatrix;
             std::array<IndexType, elementNodes * 2> elementIndex;
             Suture tmp = sutures[c];
             tmp.m_stiffness = 0;
@@ -399,6 +406,127 @@ namespace PhysBAM {
 
     }
 
+    template <class Discretization, class IntType>
+    void CudaSolver<Discretization, IntType>::
+        computeE2Tensor(const std::vector<ElementType>& elements,
+            const std::vector<ElementFlag>& flags,
+            const std::vector<uint8_t>& elementShape,
+            const std::vector<GradientMatrixType>& shapeGradients,
+            const std::vector<T>& shapeRestVol, const T mu
+        )
+    {
+#ifndef _WIN32
+        LOG::SCOPE scope("CudaSolver::computeE2Tensor()");
+#endif
+        std::vector<typename DiscretizationType::ElementTensorType> shapeTensor;
+        computeShapeTensors(shapeTensor, elements, elementShape, shapeGradients, shapeRestVol);
+        for (int e = 0; e < elements.size(); e++)
+            if (flags[e] == ElementFlag::CollisionEl)
+            {
+                typename DiscretizationType::ElementTensorType stiffnessMatrix = shapeTensor[elementShape[e]] * (-2 * mu);
+                updateTensor<elementNodes>(m_A22, stiffnessMatrix, DiscretizationType::getElementIndex(elements[e]));
+            }
+    }
+
+    template <class Discretization, class IntType>
+    void CudaSolver<Discretization, IntType>::
+        computeShapeTensors(std::vector<typename DiscretizationType::ElementTensorType>& shapeTensor,
+            const std::vector<ElementType>& elements,
+            const std::vector<uint8_t>& elementShape,
+            const std::vector<GradientMatrixType>& shapeGradients,
+            const std::vector<T>& shapeRestVol
+        ) const
+    {
+        if (elementShape.size() != elements.size() || shapeGradients.size() != shapeRestVol.size())
+            throw std::logic_error("element shape table does not match the elements");
+        for (const auto shape : elementShape)
+            if (shape >= shapeGradients.size())
+                throw std::logic_error("element shape out of range");
+        // the element tensor is linear in its coefficient, so one template at unit stiffness per shape
+        shapeTensor.resize(shapeGradients.size());
+        for (size_t s = 0; s < shapeGradients.size(); s++)
+            DiscretizationType::computeElementTensor(shapeTensor[s], shapeGradients[s], shapeRestVol[s]);
+    }
+
+    template <class Discretization, class IntType>
+    void CudaSolver<Discretization, IntType>::
+        computeTensor(
+            const std::vector<ElementType>& elements,
+            const std::vector<uint8_t>& elementShape,
+            const std::vector<GradientMatrixType>& shapeGradients,
+            const std::vector<T>& shapeRestVol, const std::vector<T>& muLow, const std::vector<T>& muHigh,
+            const std::vector<Suture>& sutures
+        ) {
+        using IteratorType = Iterator<NodeArrayType>;
+        constexpr int elementEntries = elementNodes * elementNodes;
+#if TIMING
+        auto startStamp = std::chrono::steady_clock::now();
+#endif
+        std::vector<typename DiscretizationType::ElementTensorType> shapeTensor;
+        computeShapeTensors(shapeTensor, elements, elementShape, shapeGradients, shapeRestVol);
+
+        // numbered row and column of entry s of the element tensors, row is -1 when the entry is not stored
+        auto entry = [&](const size_t s, int& row, int& col) {
+            const auto elementIndex = DiscretizationType::getElementIndex(elements[s / elementEntries]);
+            row = IteratorType::at(m_numbering, elementIndex[s % elementEntries / elementNodes]);
+            col = IteratorType::at(m_numbering, elementIndex[s % elementNodes]);
+            if (col < row)
+                row = -1;
+        };
+
+        // parallel scatter, the entries are bucketed by row so that every row of m_tensor is accumulated by one thread
+        const size_t sources = elements.size() * elementEntries;
+        std::vector<std::atomic<size_t>> fill(m_tensor.size());
+        for (auto& f : fill)
+            f.store(0, std::memory_order_relaxed);
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, sources), [&](const tbb::blocked_range<size_t>& r) {
+            for (size_t s = r.begin(); s < r.end(); s++) {
+                int row, col;
+                entry(s, row, col);
+                if (row >= 0)
+                    fill[row].fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+        std::vector<size_t> bucketStart(m_tensor.size() + 1, 0);
+        for (size_t i = 0; i < m_tensor.size(); i++) {
+            bucketStart[i + 1] = bucketStart[i] + fill[i].load(std::memory_order_relaxed);
+            fill[i].store(bucketStart[i], std::memory_order_relaxed);
+        }
+        std::vector<std::pair<int, size_t>> bucket(bucketStart.back()); // (column, source)
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, sources), [&](const tbb::blocked_range<size_t>& r) {
+            for (size_t s = r.begin(); s < r.end(); s++) {
+                int row, col;
+                entry(s, row, col);
+                if (row >= 0)
+                    bucket[fill[row].fetch_add(1, std::memory_order_relaxed)] = std::make_pair(col, s);
+            }
+        });
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, m_tensor.size()), [&](const tbb::blocked_range<size_t>& r) {
+            for (size_t i = r.begin(); i < r.end(); i++) {
+                // sorted, so the sums do not depend on the thread schedule
+                std::sort(bucket.begin() + bucketStart[i], bucket.begin() + bucketStart[i + 1]);
+                for (size_t k = bucketStart[i]; k < bucketStart[i + 1]; k++) {
+                    const size_t e = bucket[k].second / elementEntries, ij = bucket[k].second % elementEntries;
+                    m_tensor[i][bucket[k].first] += -2 * (muLow[e] + muHigh[e]) * shapeTensor[elementShape[e]](ij / elementNodes + 1, ij % elementNodes + 1);
+                }
+            }
+        });
+#if TIMING
+        std::chrono::duration<double> elapsed_second = std::chrono::steady_clock::now() - startStamp;
+        LOG::cout << "        accumElTensor       Time : " << elapsed_second.count() << std::endl;
+#endif
+
+        for (int c = 0; c < sutures.size(); c++) {
+            typename DiscretizationType::SutureTensorType stiffnessMatrix;
+            std::array<IndexType, elementNodes * 2> elementIndex;
+            Suture tmp = sutures[c];
+            tmp.m_stiffness = 0;
+            DiscretizationType::computeSutureTensor(stiffnessMatrix, elementIndex, tmp);
+            accumToTensor<elementNodes * 2>(stiffnessMatrix,
+                elementIndex);
+        }
+    }
+
     template <class Discretization, class IntType>
     void CudaSolver<Discretization, IntType>::
         initializePardiso(
@@ -436,7 +564,7 @@ namespace PhysBAM {
         /*
         for (int c = 0; c < constraints.size(); c++)
             if (constraints[c].m_stiffness != 0) {
-                MATRIX_MXN<T> stiffnessMatrix;
+                typename DiscretizationType::ElementTensorType stiffnessMatrix;
                 DiscretizationType::computeConstraintTensor(stiffnessMatrix, constraints[c]);
                 accumToPardiso<elementNodes>(stiffnessMatrix,
                     constraints[c].m_elementIndex);
@@ -444,7 +572,7 @@ namespace PhysBAM {
 
         for (int c = 0; c < sutures.size(); c++)
             if (sutures[c].m_stiffness != 0) {
-                MATRIX_MXN<T> stiffnessMatrix;
+                typename DiscretizationType::SutureTensorType stiffnessMatrix;
                 std::array<IndexType, elementNodes * 2> elementIndex;
                 DiscretizationType::computeSutureTensor(stiffnessMatrix, elementIndex, sutures[c]);
                 accumToPardiso<elementNodes * 2>(stiffnessMatrix,
@@ -637,7 +765,7 @@ namespace PhysBAM {
 
         for (int c = 0; c < constraints.size(); c++)
             if (constraints[c].m_stiffness != 0) {
-                MATRIX_MXN<T> stiffnessMatrix;
+                typename DiscretizationType::ElementTensorType stiffnessMatrix;
                 DiscretizationType::computeConstraintTensor(stiffnessMatrix, constraints[c]);
                 accumToPardiso<elementNodes>(stiffnessMatrix,
                     constraints[c].m_elementIndex);
@@ -645,7 +773,7 @@ namespace PhysBAM {
 
         for (int c = 0; c < fakeSutures.size(); c++)
             if (fakeSutures[c].m_stiffness != 0) {
-                MATRIX_MXN<T> stiffnessMatrix;
+                typename DiscretizationType::ElementTensorType stiffnessMatrix;
                 DiscretizationType::computeConstraintTensor(stiffnessMatrix, fakeSutures[c]);
                 accumToPardiso<elementNodes>(stiffnessMatrix,
                     fakeSutures[c].m_elementIndex);
@@ -653,7 +781,7 @@ namespace PhysBAM {
 
         for (int c = 0; c < sutures.size(); c++)
             if (sutures[c].m_stiffness != 0) {
-                MATRIX_MXN<T> stiffnessMatrix;
+                typename DiscretizationType::SutureTensorType stiffnessMatrix;
                 std::array<IndexType, elementNodes * 2> elementIndex;
                 DiscretizationType::computeSutureTensor(stiffnessMatrix, elementIndex, sutures[c]);
                 accumToPardiso<elementNodes * 2>(stiffnessMatrix,
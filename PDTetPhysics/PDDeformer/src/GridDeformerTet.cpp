@@ -1,14 +1,76 @@
 #include "GridDeformerTet.h"
 #include "Add_Force.h"
+#include "ArenaThreads.h"
 
 
 #include <omp.h>
+#include <algorithm>
+#include <utility>
 
 #include "dumper.h"
 
 
 namespace {
+    // access to the point p of a [block][d][BlockWidth] structure of arrays
+    template <class VectorType, int BlockWidth>
+    VectorType loadPoint(const std::vector<typename VectorType::ELEMENT> &x, const int p) {
+        constexpr int d = VectorType::dimension;
+        VectorType result;
+        for (int i = 0; i < d; i++)
+            result(i + 1) = x[((p / BlockWidth) * d + i) * BlockWidth + p % BlockWidth];
+        return result;
+    }
+
+    template <class VectorType, int BlockWidth>
+    void storePoint(std::vector<typename VectorType::ELEMENT> &x, const int p, const VectorType &value) {
+        constexpr int d = VectorType::dimension;
+        for (int i = 0; i < d; i++)
+            x[((p / BlockWidth) * d + i) * BlockWidth + p % BlockWidth] = value(i + 1);
+    }
 
+    // spreads the low 10 bits of v to every third bit
+    inline uint32_t spreadBits(uint32_t v) {
+        v &= 0x3ff;
+        v = (v | (v << 16)) & 0x030000ff;
+        v = (v | (v << 8)) & 0x0300f00f;
+        v = (v | (v << 4)) & 0x030c30c3;
+        v = (v | (v << 2)) & 0x09249249;
+        return v;
+    }
+
+    // sorts elements along the Morton curve of their centroids, quantized to 1024 cells per axis of the bounding box of X
+    template <class VectorType, class ElementType>
+    void sortElementsSpatially(std::vector<int> &order, const std::vector<ElementType> &elements, const std::vector<VectorType> &X) {
+        using T = typename VectorType::ELEMENT;
+        constexpr int d = VectorType::dimension;
+        if (order.size() < 2)
+            return;
+        VectorType lower = X[elements[order[0]][0]], upper = lower;
+        for (const int e : order)
+            for (const int v : elements[e])
+                for (int i = 1; i <= d; i++) {
+                    lower(i) = std::min(lower(i), X[v](i));
+                    upper(i) = std::max(upper(i), X[v](i));
+                }
+        std::vector<std::pair<uint32_t, int>> keys(order.size());
+#pragma omp parallel for num_threads(arenaThreads())
+        for (int k = 0; k < (int)order.size(); k++) {
+            VectorType centroid;
+            for (const int v : elements[order[k]])
+                centroid += X[v];
+            centroid /= T(elements[order[k]].size());
+            uint32_t code = 0;
+            for (int i = 1; i <= d; i++) {
+                const T extent = upper(i) - lower(i);
+                const uint32_t cell = extent > 0 ? (uint32_t)std::min(T(1023), (centroid(i) - lower(i)) / extent * T(1024)) : 0;
+                code |= spreadBits(cell) << (i - 1);
+            }
+            keys[k] = std::make_pair(code, order[k]);
+        }
+        std::sort(keys.begin(), keys.end());
+        for (size_t k = 0; k < keys.size(); k++)
+            order[k] = keys[k].second;
+    }
 }
 
 namespace PhysBAM {
@@ -26,6 +88,9 @@ namespace PhysBAM {
         // LOG::SCOPE scope("GridDeformerTet::initializeUndeformedState()");
 		m_gradientMatrix.clear();
 		m_elementRestVolume.clear();
+		m_elementShape.clear();
+		m_shapeGradientMatrix.clear();
+		m_shapeRestVolume.clear();
         for (int e = 0; e < m_elements.size(); e++) {
             const auto &element = m_elements[e];
             GradientMatrixType gradientMatrix;
@@ -55,20 +120,51 @@ namespace PhysBAM {
 		m_nUncollisionBlocks = (uncollisionSize + (BlockWidth - 1)) / BlockWidth;
 		m_nCollisionBlocks = (collisionSize + (BlockWidth - 1)) / BlockWidth;
 
+		// elements in the order they are packed into blocks, numOfUncollision / numOfCollision below index these
+		std::vector<int> uncollisionOrder, collisionOrder;
+		uncollisionOrder.reserve(uncollisionSize);
+		collisionOrder.reserve(collisionSize);
+		for (int e = 0; e < m_elements.size(); e++)
+			if (m_elementFlags[e] == ElementFlag::unCollisionEl) uncollisionOrder.push_back(e);
+			else if (m_elementFlags[e] == ElementFlag::CollisionEl) collisionOrder.push_back(e);
+			else if (m_elementFlags[e] != ElementFlag::inActive) throw std::logic_error("elements must be inActive, unCollisionEl or CollisionEl");
+		if (m_spatialElementOrder) {
+			sortElementsSpatially(uncollisionOrder, m_elements, m_X);
+			sortElementsSpatially(collisionOrder, m_elements, m_X);
+		}
+
+		const bool compactShapes = !m_elementShape.empty();
+		if (compactShapes) {
+			if (m_elementShape.size() != m_elements.size() || m_shapeGradientMatrix.size() != m_shapeRestVolume.size())
+				throw std::logic_error("element shape table does not match the elements");
+			for (const auto shape : m_elementShape)
+				if (shape >= m_shapeGradientMatrix.size())
+					throw std::logic_error("element shape out of range");
+			m_reshapeShapeGradientMatrix.resize(m_shapeGradientMatrix.size());
+			for (size_t s = 0; s < m_shapeGradientMatrix.size(); s++)
+				for (int i = 0; i < d; i++)
+					for (int j = 0; j < d; j++)
+						m_reshapeShapeGradientMatrix[s][i + 3 * j] = m_shapeGradientMatrix[s](i + 1, j + 1);
+		}
+		else
+			m_reshapeShapeGradientMatrix.clear();
+		// blocks of whichever encoding is not used stay unallocated
+		const int nUncollisionFullBlocks = compactShapes ? 0 : m_nUncollisionBlocks;
+		const int nCollisionFullBlocks = compactShapes ? 0 : m_nCollisionBlocks;
+		const int nUncollisionShapeBlocks = compactShapes ? m_nUncollisionBlocks : 0;
+		const int nCollisionShapeBlocks = compactShapes ? m_nCollisionBlocks : 0;
+
 
 #ifdef _WIN32
 		m_reshapeUncollisionX = reinterpret_cast<BlockedShapeMatrixType>(_aligned_malloc(m_nUncollisionBlocks*BlockWidth*(d + 1)*d * sizeof(T), Alignment));
 		m_reshapeCollisionX = reinterpret_cast<BlockedShapeMatrixType>(_aligned_malloc(m_nCollisionBlocks*BlockWidth*(d + 1)*d * sizeof(T), Alignment));
 
-		m_reshapeUncollisionGradientMatrix = reinterpret_cast<BlockedMatrixType>(_aligned_malloc(m_nUncollisionBlocks*BlockWidth*d*d * sizeof(T), Alignment));
-		m_reshapeCollisionGradientMatrix = reinterpret_cast<BlockedMatrixType>(_aligned_malloc(m_nCollisionBlocks*BlockWidth*d*d * sizeof(T), Alignment));
-
-		m_reshapeUncollisionElementRestVolume = reinterpret_cast<BlockedScalarType>(_aligned_malloc(m_nUncollisionBlocks*BlockWidth * sizeof(T), Alignment));
-		m_reshapeCollisionElementRestVolume = reinterpret_cast<BlockedScalarType>(_aligned_malloc(m_nCollisionBlocks*BlockWidth * sizeof(T), Alignment));
+		m_reshapeUncollisionGradientMatrix = reinterpret_cast<BlockedMatrixType>(_aligned_malloc(nUncollisionFullBlocks*BlockWidth*d*d * sizeof(T), Alignment));
+		m_reshapeCollisionGradientMatrix = reinterpret_cast<BlockedMatrixType>(_aligned_malloc(nCollisionFullBlocks*BlockWidth*d*d * sizeof(T), Alignment));
 
+		m_reshapeUncollisionElementRestVolume = reinterpret_cast<BlockedScalarType>(_aligned_malloc(nUncollisionFullBlocks*BlockWidth * sizeof(T), Alignment));
+		m_reshapeCollisionElementRestVolume = reinterpret_cast<BlockedScalarType>(_aligned_malloc(nCollisionFullBlocks*BlockWidth * sizeof(T), Alignment));
 
-		m_reshapeUncollisionElementRestVolume = reinterpret_cast<BlockedScalarType>(_aligned_malloc(m_nUncollisionBlocks * BlockWidth * sizeof(T), Alignment));
-		m_reshapeCollisionElementRestVolume = reinterpret_cast<BlockedScalarType>(_aligned_malloc(m_nCollisionBlocks * BlockWidth * sizeof(T), Alignment));
 
 		m_reshapeUncollisionMuLow = reinterpret_cast<BlockedScalarType>(_aligned_malloc(m_nUncollisionBlocks * BlockWidth * sizeof(T), Alignment));
 		m_reshapeCollisionMuLow = reinterpret_cast<BlockedScalarType>(_aligned_malloc(m_nCollisionBlocks * BlockWidth * sizeof(T), Alignment));
@@ -82,16 +178,22 @@ namespace PhysBAM {
 		m_reshapeUncollisionRangeMax = reinterpret_cast<BlockedScalarType>(_aligned_malloc(m_nUncollisionBlocks * BlockWidth * sizeof(T), Alignment));
 		m_reshapeCollisionRangeMax = reinterpret_cast<BlockedScalarType>(_aligned_malloc(m_nCollisionBlocks * BlockWidth * sizeof(T), Alignment));
 
+		m_reshapeUncollisionf = reinterpret_cast<BlockedShapeMatrixType>(_aligned_malloc(m_nUncollisionBlocks*BlockWidth*(d + 1)*d * sizeof(T), Alignment));
+		m_reshapeCollisionf = reinterpret_cast<BlockedShapeMatrixType>(_aligned_malloc(m_nCollisionBlocks*BlockWidth*(d + 1)*d * sizeof(T), Alignment));
+
+		m_reshapeUncollisionShape = reinterpret_cast<BlockedShapeType>(_aligned_malloc(nUncollisionShapeBlocks*BlockWidth * sizeof(uint8_t), Alignment));
+		m_reshapeCollisionShape = reinterpret_cast<BlockedShapeType>(_aligned_malloc(nCollisionShapeBlocks*BlockWidth * sizeof(uint8_t), Alignment));
+
 #else
 
 		m_reshapeUncollisionX = reinterpret_cast<BlockedShapeMatrixType>(aligned_alloc(Alignment, m_nUncollisionBlocks*BlockWidth*(d + 1)*d * sizeof(T)));
 		m_reshapeCollisionX = reinterpret_cast<BlockedShapeMatrixType>(aligned_alloc(Alignment, m_nCollisionBlocks*BlockWidth*(d + 1)*d * sizeof(T)));
 
-		m_reshapeUncollisionGradientMatrix = reinterpret_cast<BlockedMatrixType>(aligned_alloc(Alignment, m_nUncollisionBlocks*BlockWidth*d*d * sizeof(T)));
-		m_reshapeCollisionGradientMatrix = reinterpret_cast<BlockedMatrixType>(aligned_alloc(Alignment, m_nCollisionBlocks*BlockWidth*d*d * sizeof(T)));
+		m_reshapeUncollisionGradientMatrix = reinterpret_cast<BlockedMatrixType>(aligned_alloc(Alignment, nUncollisionFullBlocks*BlockWidth*d*d * sizeof(T)));
+		m_reshapeCollisionGradientMatrix = reinterpret_cast<BlockedMatrixType>(aligned_alloc(Alignment, nCollisionFullBlocks*BlockWidth*d*d * sizeof(T)));
 
-		m_reshapeUncollisionElementRestVolume = reinterpret_cast<BlockedScalarType>(aligned_alloc(Alignment, m_nUncollisionBlocks*BlockWidth * sizeof(T)));
-		m_reshapeCollisionElementRestVolume = reinterpret_cast<BlockedScalarType>(aligned_alloc(Alignment, m_nCollisionBlocks*BlockWidth * sizeof(T)));
+		m_reshapeUncollisionElementRestVolume = reinterpret_cast<BlockedScalarType>(aligned_alloc(Alignment, nUncollisionFullBlocks*BlockWidth * sizeof(T)));
+		m_reshapeCollisionElementRestVolume = reinterpret_cast<BlockedScalarType>(aligned_alloc(Alignment, nCollisionFullBlocks*BlockWidth * sizeof(T)));
 
 		m_reshapeUncollisionMuLow = reinterpret_cast<BlockedScalarType>(aligned_alloc(Alignment, m_nUncollisionBlocks * BlockWidth * sizeof(T)));
 		m_reshapeCollisionMuLow = reinterpret_cast<BlockedScalarType>(aligned_alloc(Alignment, m_nCollisionBlocks * BlockWidth * sizeof(T)));
@@ -104,75 +206,96 @@ namespace PhysBAM {
 
 		m_reshapeUncollisionRangeMax = reinterpret_cast<BlockedScalarType>(aligned_alloc(Alignment, m_nUncollisionBlocks * BlockWidth * sizeof(T)));
 		m_reshapeCollisionRangeMax = reinterpret_cast<BlockedScalarType>(aligned_alloc(Alignment, m_nCollisionBlocks * BlockWidth * sizeof(T)));
+
+		m_reshapeUncollisionf = reinterpret_cast<BlockedShapeMatrixType>(aligned_alloc(Alignment, m_nUncollisionBlocks*BlockWidth*(d + 1)*d * sizeof(T)));
+		m_reshapeCollisionf = reinterpret_cast<BlockedShapeMatrixType>(aligned_alloc(Alignment, m_nCollisionBlocks*BlockWidth*(d + 1)*d * sizeof(T)));
+
+		m_reshapeUncollisionShape = reinterpret_cast<BlockedShapeType>(aligned_alloc(Alignment, nUncollisionShapeBlocks*BlockWidth * sizeof(uint8_t)));
+		m_reshapeCollisionShape = reinterpret_cast<BlockedShapeType>(aligned_alloc(Alignment, nCollisionShapeBlocks*BlockWidth * sizeof(uint8_t)));
 #endif
-		if (m_reshapeUncollisionX == nullptr || m_reshapeCollisionX == nullptr ||
-			m_reshapeUncollisionGradientMatrix == nullptr || m_reshapeCollisionGradientMatrix == nullptr ||
+		if (compactShapes) {
+			if ((nUncollisionShapeBlocks && m_reshapeUncollisionShape == nullptr) || (nCollisionShapeBlocks && m_reshapeCollisionShape == nullptr))
+				throw std::logic_error("fail to allocate memory for the reshaped element shapes");
+			// padding lanes use shape 0
+			for (int b = 0; b < nUncollisionShapeBlocks; b++)
+				for (int e = 0; e < BlockWidth; e++)
+					m_reshapeUncollisionShape[b][e] = 0;
+			for (int b = 0; b < nCollisionShapeBlocks; b++)
+				for (int e = 0; e < BlockWidth; e++)
+					m_reshapeCollisionShape[b][e] = 0;
+		}
+		else if (m_reshapeUncollisionGradientMatrix == nullptr || m_reshapeCollisionGradientMatrix == nullptr ||
 			m_reshapeUncollisionElementRestVolume == nullptr || m_reshapeCollisionElementRestVolume == nullptr)
 			throw std::logic_error("fail to allocate memory for m_reshapeX");
+		if (m_reshapeUncollisionX == nullptr || m_reshapeCollisionX == nullptr)
+			throw std::logic_error("fail to allocate memory for m_reshapeX");
+		if ((m_nUncollisionBlocks && m_reshapeUncollisionf == nullptr) || (m_nCollisionBlocks && m_reshapeCollisionf == nullptr))
+			throw std::logic_error("fail to allocate memory for the reshaped force");
 
 		// initialize reshaped data
-		for (int e = 0, numOfUncollision = 0, numOfCollision = 0; e < m_elements.size(); e++) {
-			if (m_elementFlags[e] == ElementFlag::unCollisionEl) {
-				for (int i = 0; i < d + 1; i++)
-					for (int j = 0; j < d; j++)
-						m_reshapeUncollisionX[numOfUncollision / BlockWidth][i][j][numOfUncollision%BlockWidth] = m_X[m_elements[e][i]](j + 1);
-
+		for (int numOfUncollision = 0; numOfUncollision < uncollisionSize; numOfUncollision++) {
+			const int e = uncollisionOrder[numOfUncollision];
+			for (int i = 0; i < d + 1; i++)
+				for (int j = 0; j < d; j++)
+					m_reshapeUncollisionX[numOfUncollision / BlockWidth][i][j][numOfUncollision%BlockWidth] = m_X[m_elements[e][i]](j + 1);
+
+			if (compactShapes)
+				m_reshapeUncollisionShape[numOfUncollision / BlockWidth][numOfUncollision % BlockWidth] = m_elementShape[e];
+			else {
 				for (int i = 0; i < d; i++)
 					for (int j = 0; j < d; j++)
 						m_reshapeUncollisionGradientMatrix[numOfUncollision / BlockWidth][i + 3 * j][numOfUncollision%BlockWidth] = m_gradientMatrix[e](i + 1, j + 1);
 
 				m_reshapeUncollisionElementRestVolume[numOfUncollision / BlockWidth][numOfUncollision%BlockWidth] = m_elementRestVolume[e];
-				m_reshapeUncollisionMuLow[numOfUncollision / BlockWidth][numOfUncollision % BlockWidth] = m_muLow[e];
-				m_reshapeUncollisionMuHigh[numOfUncollision / BlockWidth][numOfUncollision % BlockWidth] = m_muHigh[e];
-				m_reshapeUncollisionRangeMin[numOfUncollision / BlockWidth][numOfUncollision % BlockWidth] = m_rangeMin[e];
-				m_reshapeUncollisionRangeMax[numOfUncollision / BlockWidth][numOfUncollision % BlockWidth] = m_rangeMax[e];
-
-				numOfUncollision++;
 			}
-			else if (m_elementFlags[e] == ElementFlag::CollisionEl) {
-				for (int i = 0; i < d + 1; i++)
-					for (int j = 0; j < d; j++)
-						m_reshapeCollisionX[numOfCollision / BlockWidth][i][j][numOfCollision%BlockWidth] = m_X[m_elements[e][i]](j + 1);
-
+			m_reshapeUncollisionMuLow[numOfUncollision / BlockWidth][numOfUncollision % BlockWidth] = m_muLow[e];
+			m_reshapeUncollisionMuHigh[numOfUncollision / BlockWidth][numOfUncollision % BlockWidth] = m_muHigh[e];
+			m_reshapeUncollisionRangeMin[numOfUncollision / BlockWidth][numOfUncollision % BlockWidth] = m_rangeMin[e];
+			m_reshapeUncollisionRangeMax[numOfUncollision / BlockWidth][numOfUncollision % BlockWidth] = m_rangeMax[e];
+		}
+		for (int numOfCollision = 0; numOfCollision < collisionSize; numOfCollision++) {
+			const int e = collisionOrder[numOfCollision];
+			for (int i = 0; i < d + 1; i++)
+				for (int j = 0; j < d; j++)
+					m_reshapeCollisionX[numOfCollision / BlockWidth][i][j][numOfCollision%BlockWidth] = m_X[m_elements[e][i]](j + 1);
+
+			if (compactShapes)
+				m_reshapeCollisionShape[numOfCollision / BlockWidth][numOfCollision % BlockWidth] = m_elementShape[e];
+			else {
 				for (int i = 0; i < d; i++)
 					for (int j = 0; j < d; j++)
 						m_reshapeCollisionGradientMatrix[numOfCollision / BlockWidth][i + 3 * j][numOfCollision%BlockWidth] = m_gradientMatrix[e](i + 1, j + 1);
 
 				m_reshapeCollisionElementRestVolume[numOfCollision / BlockWidth][numOfCollision % BlockWidth] = m_elementRestVolume[e];
-				m_reshapeCollisionMuLow[numOfCollision / BlockWidth][numOfCollision % BlockWidth] = m_muLow[e];
-				m_reshapeCollisionMuHigh[numOfCollision / BlockWidth][numOfCollision % BlockWidth] = m_muHigh[e];
-				m_reshapeCollisionRangeMax[numOfCollision / BlockWidth][numOfCollision % BlockWidth] = m_rangeMax[e];
-				m_reshapeCollisionRangeMin[numOfCollision / BlockWidth][numOfCollision % BlockWidth] = m_rangeMin[e];
-				numOfCollision++;
 			}
-			else if(m_elementFlags[e] != ElementFlag::inActive) throw std::logic_error("elements must be inActive, unCollisionEl or CollisionEl");
+			m_reshapeCollisionMuLow[numOfCollision / BlockWidth][numOfCollision % BlockWidth] = m_muLow[e];
+			m_reshapeCollisionMuHigh[numOfCollision / BlockWidth][numOfCollision % BlockWidth] = m_muHigh[e];
+			m_reshapeCollisionRangeMax[numOfCollision / BlockWidth][numOfCollision % BlockWidth] = m_rangeMax[e];
+			m_reshapeCollisionRangeMin[numOfCollision / BlockWidth][numOfCollision % BlockWidth] = m_rangeMin[e];
 		}
 
 		// initialize auxiliary structure
 		std::vector<std::vector<int>> reshapeUncollisionIndices(m_X.size());
 		std::vector<std::vector<int>> reshapeCollisionIndices(m_X.size());
-		for (int e = 0, numOfUncollision = 0, numOfCollision = 0; e < m_elements.size(); e++) {
-			if (m_elementFlags[e] == ElementFlag::unCollisionEl) {
-				int blockIndex = numOfUncollision / BlockWidth;
-				int blockOffset = numOfUncollision % BlockWidth;
-				for (int v = 0; v < d + 1; v++) {
-					int p = m_elements[e][v];
-					int offset = (blockIndex * (d + 1) + v) * d * BlockWidth + blockOffset;
-					reshapeUncollisionIndices[p].push_back(offset);
-				}
-				numOfUncollision++;
+		for (int numOfUncollision = 0; numOfUncollision < uncollisionSize; numOfUncollision++) {
+			const int e = uncollisionOrder[numOfUncollision];
+			int blockIndex = numOfUncollision / BlockWidth;
+			int blockOffset = numOfUncollision % BlockWidth;
+			for (int v = 0; v < d + 1; v++) {
+				int p = m_elements[e][v];
+				int offset = (blockIndex * (d + 1) + v) * d * BlockWidth + blockOffset;
+				reshapeUncollisionIndices[p].push_back(offset);
 			}
-			else if (m_elementFlags[e] == ElementFlag::CollisionEl) {
-				int blockIndex = numOfCollision / BlockWidth;
-				int blockOffset = numOfCollision % BlockWidth;
-				for (int v = 0; v < d + 1; v++) {
-					int p = m_elements[e][v];
-					int offset = (blockIndex * (d + 1) + v) * d * BlockWidth + blockOffset;
-					reshapeCollisionIndices[p].push_back(offset);
-				}
-				numOfCollision++;
+		}
+		for (int numOfCollision = 0; numOfCollision < collisionSize; numOfCollision++) {
+			const int e = collisionOrder[numOfCollision];
+			int blockIndex = numOfCollision / BlockWidth;
+			int blockOffset = numOfCollision % BlockWidth;
+			for (int v = 0; v < d + 1; v++) {
+				int p = m_elements[e][v];
+				int offset = (blockIndex * (d + 1) + v) * d * BlockWidth + blockOffset;
+				reshapeCollisionIndices[p].push_back(offset);
 			}
-			else if (m_elementFlags[e] != ElementFlag::inActive) throw std::logic_error("elements must be inActive, unCollisionEl or CollisionEl");
 		}
 
 		m_reshapeUncollisionIndicesOffsets.resize(m_X.size() + 1);
@@ -209,19 +332,12 @@ namespace PhysBAM {
 				for (int e = 0; e < BlockWidth; e++)
 					m_reshapeCollisionElement[b][v][e] = 0;
 
-		for (int e = 0, numOfUncollision = 0, numOfCollision = 0; e < m_elements.size(); e++) {
-			if (m_elementFlags[e] == ElementFlag::unCollisionEl) {
-				for (int v = 0; v < d + 1; v++)
-					m_reshapeUncollisionElement[numOfUncollision / BlockWidth][v][numOfUncollision%BlockWidth] = m_elements[e][v];
-				numOfUncollision++;
-			}
-			else if (m_elementFlags[e] == ElementFlag::CollisionEl) {
-				for (int v = 0; v < d + 1; v++)
-					m_reshapeCollisionElement[numOfCollision / BlockWidth][v][numOfCollision%BlockWidth] = m_elements[e][v];
-				numOfCollision++;
-			}
-			else if (m_elementFlags[e] != ElementFlag::inActive) throw std::logic_error("elements must be inActive, unCollisionEl or CollisionEl");
-		}
+		for (int numOfUncollision = 0; numOfUncollision < uncollisionSize; numOfUncollision++)
+			for (int v = 0; v < d + 1; v++)
+				m_reshapeUncollisionElement[numOfUncollision / BlockWidth][v][numOfUncollision%BlockWidth] = m_elements[uncollisionOrder[numOfUncollision]][v];
+		for (int numOfCollision = 0; numOfCollision < collisionSize; numOfCollision++)
+			for (int v = 0; v < d + 1; v++)
+				m_reshapeCollisionElement[numOfCollision / BlockWidth][v][numOfCollision%BlockWidth] = m_elements[collisionOrder[numOfCollision]][v];
 	}
 
     template <class dataType, int dim>
@@ -261,99 +377,241 @@ namespace PhysBAM {
     }
 
     template <class dataType, int dim>
-    void GridDeformerTet<std::vector<VECTOR<dataType,dim>>>::addCollisionForce(StateVariableType &f) const
+    template <class PointFunction>
+    void GridDeformerTet<std::vector<VECTOR<dataType,dim>>>::packConstraintPoints(ConstraintPointBlocks &points, const int nPoints, PointFunction pointNodes) const
     {
-        {
-            for (int c = 0; c < m_collisionConstraints.size(); c++) {
-                const auto &constraint = m_collisionConstraints[c];
-                VectorType x;
-                x = DiscretizationType::interpolateX(constraint.m_elementIndex, constraint.m_weights, m_X);
-                x -= constraint.m_xT;
-                x *= -constraint.m_stiffness;
+        int changed = nPoints != points.m_nPoints;
+        if (changed) {
+            points.m_nPoints = nPoints;
+            points.m_nBlocks = (nPoints + (BlockWidth - 1)) / BlockWidth;
+            // padding lanes interpolate node 0 with weight 0 and are never scattered
+            points.m_node.assign(points.m_nBlocks * (d + 1) * BlockWidth, 0);
+            points.m_weight.assign(points.m_nBlocks * (d + 1) * BlockWidth, T(0));
+            points.m_x.assign(points.m_nBlocks * d * BlockWidth, T(0));
+            points.m_force.assign(points.m_nBlocks * d * BlockWidth, T(0));
+            points.m_nodeForce.assign(points.m_nBlocks * (d + 1) * d * BlockWidth, T(0));
+        }
 
-                DiscretizationType::distributeForces(x, constraint.m_elementIndex, constraint.m_weights, f);
+#pragma omp parallel for num_threads(arenaThreads()) reduction(|:changed)
+        for (int p = 0; p < nPoints; p++) {
+            ElementIndexType nodes;
+            WeightType weights;
+            pointNodes(p, nodes, weights);
+            const int base = (p / BlockWidth) * (d + 1) * BlockWidth + p % BlockWidth;
+            for (int v = 0; v < d + 1; v++) {
+                if (points.m_node[base + v * BlockWidth] != nodes[v]) {
+                    points.m_node[base + v * BlockWidth] = nodes[v];
+                    changed = 1;
+                }
+                points.m_weight[base + v * BlockWidth] = weights[v];
+            }
+        }
+        if (!changed)
+            return;
+
+        // rebuild the CSR of m_nodeForce offsets per node, offsets are laid out as in initializeAuxiliaryStructures()
+        std::vector<std::pair<int, int>> nodeOffsets;
+        nodeOffsets.reserve(nPoints * (d + 1));
+        for (int p = 0; p < nPoints; p++)
+            for (int v = 0; v < d + 1; v++) {
+                const int blockIndex = p / BlockWidth;
+                const int blockOffset = p % BlockWidth;
+                const int offset = (blockIndex * (d + 1) + v) * d * BlockWidth + blockOffset;
+                nodeOffsets.emplace_back(points.m_node[(blockIndex * (d + 1) + v) * BlockWidth + blockOffset], offset);
+            }
+        std::sort(nodeOffsets.begin(), nodeOffsets.end());
+
+        points.m_nodes.clear();
+        points.m_indicesOffsets.assign(1, 0);
+        points.m_indicesValues.resize(nodeOffsets.size());
+        for (size_t i = 0; i < nodeOffsets.size(); i++) {
+            if (points.m_nodes.empty() || points.m_nodes.back() != nodeOffsets[i].first) {
+                if (!points.m_nodes.empty())
+                    points.m_indicesOffsets.push_back((int)i);
+                points.m_nodes.push_back(nodeOffsets[i].first);
             }
+            points.m_indicesValues[i] = nodeOffsets[i].second;
         }
+        points.m_indicesOffsets.push_back((int)nodeOffsets.size());
+    }
 
-        {
-            for (int c = 0; c < m_collisionSutures.size(); c++) {
-                const auto &suture = m_collisionSutures[c];
-                VectorType x1;
-                x1 = DiscretizationType::interpolateX(suture.m_elementIndex1, suture.m_weights1, m_X);
-                auto x2 = DiscretizationType::interpolateX(suture.m_elementIndex2, suture.m_weights2, m_X);
-//                x1 = x1 - x2 - (x1 - x2).Normalized()*suture.m_restLength;
-				x1 = (x1 - x2).Projected(suture.m_normal);
-                x1 *= -suture.m_stiffness;
-                DiscretizationType::distributeForces(x1, suture.m_elementIndex1, suture.m_weights1, f);
-                DiscretizationType::distributeForces(-x1, suture.m_elementIndex2, suture.m_weights2, f);
+    template <class dataType, int dim>
+    void GridDeformerTet<std::vector<VECTOR<dataType,dim>>>::interpolateConstraintPoints(ConstraintPointBlocks &points) const
+    {
+        using WideType = T (&)[BlockWidth];
+        using ConstWideType = const T (&)[BlockWidth];
+        using ConstWideIndexType = const int (&)[BlockWidth];
+        const T* X = &m_X[0](1);
+
+#pragma omp parallel for num_threads(arenaThreads())
+        for (int b = 0; b < points.m_nBlocks; b++)
+            for (int i = 0; i < d; i++) {
+                WideType x = reinterpret_cast<WideType>(points.m_x[(b * d + i) * BlockWidth]);
+                for (int e = 0; e < BlockWidth; e++)
+                    x[e] = 0;
+                for (int v = 0; v < d + 1; v++) {
+                    ConstWideIndexType node = reinterpret_cast<ConstWideIndexType>(points.m_node[(b * (d + 1) + v) * BlockWidth]);
+                    ConstWideType weight = reinterpret_cast<ConstWideType>(points.m_weight[(b * (d + 1) + v) * BlockWidth]);
+                    for (int e = 0; e < BlockWidth; e++)
+                        x[e] += weight[e] * X[node[e] * d + i];
+                }
             }
+    }
+
+    template <class dataType, int dim>
+    void GridDeformerTet<std::vector<VECTOR<dataType,dim>>>::distributeConstraintPoints(ConstraintPointBlocks &points, StateVariableType &f) const
+    {
+        using WideType = T (&)[BlockWidth];
+        using ConstWideType = const T (&)[BlockWidth];
+        if (points.m_nPoints == 0)
+            return;
+
+#pragma omp parallel for num_threads(arenaThreads())
+        for (int b = 0; b < points.m_nBlocks; b++)
+            for (int v = 0; v < d + 1; v++) {
+                ConstWideType weight = reinterpret_cast<ConstWideType>(points.m_weight[(b * (d + 1) + v) * BlockWidth]);
+                for (int i = 0; i < d; i++) {
+                    ConstWideType force = reinterpret_cast<ConstWideType>(points.m_force[(b * d + i) * BlockWidth]);
+                    WideType nodeForce = reinterpret_cast<WideType>(points.m_nodeForce[((b * (d + 1) + v) * d + i) * BlockWidth]);
+                    for (int e = 0; e < BlockWidth; e++)
+                        nodeForce[e] = weight[e] * force[e];
+                }
+            }
+
+        unblockAddForce<T, BlockWidth>(&points.m_nodeForce[0], &points.m_indicesOffsets[0], &points.m_indicesValues[0], &points.m_nodes[0], (int)points.m_nodes.size(), &f[0](1));
+    }
+
+    template <class dataType, int dim>
+    void GridDeformerTet<std::vector<VECTOR<dataType,dim>>>::addCollisionForce(StateVariableType &f) const
+    {
+        // points: one per collision constraint, then two per collision suture
+        const int nConstraints = (int)m_collisionConstraints.size();
+        const int nSutures = (int)m_collisionSutures.size();
+        const int sutureStart = nConstraints;
+        auto &points = m_collisionPoints;
+
+        packConstraintPoints(points, sutureStart + 2 * nSutures, [&](const int p, ElementIndexType &nodes, WeightType &weights) {
+            if (p < sutureStart) {
+                nodes = m_collisionConstraints[p].m_elementIndex;
+                weights = m_collisionConstraints[p].m_weights;
+            }
+            else {
+                const auto &suture = m_collisionSutures[(p - sutureStart) / 2];
+                nodes = (p - sutureStart) % 2 ? suture.m_elementIndex2 : suture.m_elementIndex1;
+                weights = (p - sutureStart) % 2 ? suture.m_weights2 : suture.m_weights1;
+            }
+        });
+        interpolateConstraintPoints(points);
+
+#pragma omp parallel for num_threads(arenaThreads())
+        for (int c = 0; c < nConstraints; c++) {
+            const auto &constraint = m_collisionConstraints[c];
+            VectorType x = loadPoint<VectorType, BlockWidth>(points.m_x, c);
+            x -= constraint.m_xT;
+            x *= -constraint.m_stiffness;
+            storePoint<VectorType, BlockWidth>(points.m_force, c, x);
+        }
+
+#pragma omp parallel for num_threads(arenaThreads())
+        for (int c = 0; c < nSutures; c++) {
+            const auto &suture = m_collisionSutures[c];
+            VectorType x1 = loadPoint<VectorType, BlockWidth>(points.m_x, sutureStart + 2 * c);
+            const VectorType x2 = loadPoint<VectorType, BlockWidth>(points.m_x, sutureStart + 2 * c + 1);
+//            x1 = x1 - x2 - (x1 - x2).Normalized()*suture.m_restLength;
+            x1 = (x1 - x2).Projected(suture.m_normal);
+            x1 *= -suture.m_stiffness;
+            storePoint<VectorType, BlockWidth>(points.m_force, sutureStart + 2 * c, x1);
+            storePoint<VectorType, BlockWidth>(points.m_force, sutureStart + 2 * c + 1, -x1);
         }
+
+        distributeConstraintPoints(points, f);
     }
 
     template <class dataType, int dim>
     void GridDeformerTet<std::vector<VECTOR<dataType,dim>>>:: addConstraintForce(StateVariableType &f) const
     {
-        StateVariableType fLocal;
-        {
-            for (int c = 0; c < m_constraints.size(); c++) {
-				const auto &constraint = m_constraints[c];
-				if (constraint.m_stiffness) {
-					VectorType x;
-					x = DiscretizationType::interpolateX(constraint.m_elementIndex, constraint.m_weights, m_X);
-					x -= constraint.m_xT;
-					const T length = x.Lp_Norm(2);
-					if (length > constraint.m_stressLimit)
-						x *= constraint.m_stressLimit / length;
-					x *= -constraint.m_stiffness;
-
-					DiscretizationType::distributeForces(x, constraint.m_elementIndex, constraint.m_weights, f);
-				}
+        // points: one per constraint, two per suture, one per internode constraint and one per fake suture half
+        const int nConstraints = (int)m_constraints.size();
+        const int nSutures = (int)m_sutures.size();
+        const int nInternodes = (int)m_InternodeConstraints.size();
+        const int nFakeSutures = (int)m_fakeSutures.size();
+        const int sutureStart = nConstraints;
+        const int internodeStart = sutureStart + 2 * nSutures;
+        const int fakeSutureStart = internodeStart + nInternodes;
+        auto &points = m_constraintPoints;
+
+        packConstraintPoints(points, fakeSutureStart + nFakeSutures, [&](const int p, ElementIndexType &nodes, WeightType &weights) {
+            if (p < sutureStart) {
+                nodes = m_constraints[p].m_elementIndex;
+                weights = m_constraints[p].m_weights;
+            }
+            else if (p < internodeStart) {
+                const auto &suture = m_sutures[(p - sutureStart) / 2];
+                nodes = (p - sutureStart) % 2 ? suture.m_elementIndex2 : suture.m_elementIndex1;
+                weights = (p - sutureStart) % 2 ? suture.m_weights2 : suture.m_weights1;
             }
+            else if (p < fakeSutureStart) {
+                // x = sum of the weighted macro nodes - micro node
+                const auto &nC = m_InternodeConstraints[p - internodeStart];
+                for (int v = 0; v < d; v++) {
+                    nodes[v] = nC.m_macroNodes[v];
+                    weights[v] = nC.m_macroWeights[v];
+                }
+                nodes[d] = nC.m_microNodeNumber;
+                weights[d] = T(-1);
+            }
+            else {
+                nodes = m_fakeSutures[p - fakeSutureStart].m_elementIndex;
+                weights = m_fakeSutures[p - fakeSutureStart].m_weights;
+            }
+        });
+        interpolateConstraintPoints(points);
+
+#pragma omp parallel for num_threads(arenaThreads())
+        for (int c = 0; c < nConstraints; c++) {
+            const auto &constraint = m_constraints[c];
+            VectorType x;
+            if (constraint.m_stiffness) {
+                x = loadPoint<VectorType, BlockWidth>(points.m_x, c);
+                x -= constraint.m_xT;
+                const T length = x.Lp_Norm(2);
+                if (length > constraint.m_stressLimit)
+                    x *= constraint.m_stressLimit / length;
+                x *= -constraint.m_stiffness;
+            }
+            storePoint<VectorType, BlockWidth>(points.m_force, c, x);
+        }
 
+#pragma omp parallel for num_threads(arenaThreads())
+        for (int c = 0; c < nSutures; c++) {
+            const auto &suture = m_sutures[c];
+            VectorType x1 = loadPoint<VectorType, BlockWidth>(points.m_x, sutureStart + 2 * c);
+            const VectorType x2 = loadPoint<VectorType, BlockWidth>(points.m_x, sutureStart + 2 * c + 1);
+            x1 = x1 - x2 - (x1 - x2).Normalized()*suture.m_restLength;
+            x1 *= -suture.m_stiffness;
+            storePoint<VectorType, BlockWidth>(points.m_force, sutureStart + 2 * c, x1);
+            storePoint<VectorType, BlockWidth>(points.m_force, sutureStart + 2 * c + 1, -x1);
         }
 
-        {
-            for (int c = 0; c < m_sutures.size(); c++) {
-                const auto &suture = m_sutures[c];
-                VectorType x1;
-                x1 = DiscretizationType::interpolateX(suture.m_elementIndex1, suture.m_weights1, m_X);
-                auto x2 = DiscretizationType::interpolateX(suture.m_elementIndex2, suture.m_weights2, m_X);
-                x1 = x1 - x2 - (x1 - x2).Normalized()*suture.m_restLength;
-                x1 *= -suture.m_stiffness;
-                DiscretizationType::distributeForces(x1, suture.m_elementIndex1, suture.m_weights1, f);
-                DiscretizationType::distributeForces(-x1, suture.m_elementIndex2, suture.m_weights2, f);
-            }
+#pragma omp parallel for num_threads(arenaThreads())
+        for (int c = 0; c < nInternodes; c++) {
+            VectorType x = loadPoint<VectorType, BlockWidth>(points.m_x, internodeStart + c);
+            x *= -m_InternodeConstraints[c].m_stiffness;
+            storePoint<VectorType, BlockWidth>(points.m_force, internodeStart + c, x);
         }
-#if 1
-		{
-			for (int c = 0; c < m_InternodeConstraints.size(); c++) {
-				const auto& nC = m_InternodeConstraints[c];
-				VectorType x1;
-				x1 = DiscretizationType::interpolateX(nC.m_macroNodes, nC.m_macroWeights, m_X);
-				auto x2 = m_X[nC.m_microNodeNumber];
-				x1 = x1 - x2;
-				x1 *= -nC.m_stiffness;
-				DiscretizationType::distributeForces(x1, nC.m_macroNodes, nC.m_macroWeights, f);
-				f[nC.m_microNodeNumber] -= x1;
-			}
-		}
-#endif
-		{
-			for (int c = 0; c < m_fakeSutures.size(); c+=2) {
-				VectorType x0, x1, x;
-				const auto &constraint0 = m_fakeSutures[c];
-				const auto &constraint1 = m_fakeSutures[c+1];
-
-				x0 = DiscretizationType::interpolateX(constraint0.m_elementIndex, constraint0.m_weights, m_X);
-				x1 = DiscretizationType::interpolateX(constraint1.m_elementIndex, constraint1.m_weights, m_X);
-				x = (x1 - x0)/2;
-				// x -= constraint.m_xT;
-				x *= constraint0.m_stiffness;
-
-				DiscretizationType::distributeForces(x, constraint0.m_elementIndex, constraint0.m_weights, f);
-				DiscretizationType::distributeForces(-x, constraint1.m_elementIndex, constraint1.m_weights, f);
-			}
-		}
+
+#pragma omp parallel for num_threads(arenaThreads())
+        for (int c = 0; c < nFakeSutures; c += 2) {
+            const VectorType x0 = loadPoint<VectorType, BlockWidth>(points.m_x, fakeSutureStart + c);
+            const VectorType x1 = loadPoint<VectorType, BlockWidth>(points.m_x, fakeSutureStart + c + 1);
+            VectorType x = (x1 - x0) / 2;
+            // x -= constraint.m_xT;
+            x *= m_fakeSutures[c].m_stiffness;
+            storePoint<VectorType, BlockWidth>(points.m_force, fakeSutureStart + c, x);
+            storePoint<VectorType, BlockWidth>(points.m_force, fakeSutureStart + c + 1, -x);
+        }
+
+        distributeConstraintPoints(points, f);
     }
 
 	template<class dataType, int dim>
@@ -395,80 +653,41 @@ namespace PhysBAM {
         //for (int i = 0; i < BlockWidth; i++) strainMax[i] = rangeMax;
 
         if (flag == ElementFlag::unCollisionEl) {
-#ifdef _WIN32
-			BlockedShapeMatrixType reshapeUncollisionf = reinterpret_cast<BlockedShapeMatrixType>(_aligned_malloc(m_nUncollisionBlocks*BlockWidth*(d + 1)*d * sizeof(T), Alignment));
-#else
-			BlockedShapeMatrixType reshapeUncollisionf = reinterpret_cast<BlockedShapeMatrixType>(aligned_alloc(Alignment, m_nUncollisionBlocks*BlockWidth*(d+1)*d*sizeof(T)));
-#endif
-			if (reshapeUncollisionf) {
-				for (int b = 0; b < m_nUncollisionBlocks; b++)
-					for (int v = 0; v < d + 1; v++)
-						for (int i = 0; i < d; i++)
-							for (int e = 0; e < BlockWidth; e++)
-								reshapeUncollisionf[b][v][i][e] = 0;
-
-#pragma omp parallel for
-				for (int be = 0; be < m_nUncollisionBlocks; be++) {
-					for (int ee = 0; ee < BlockWidth; ee += Tarch::Width)
-						Add_Force<Tarch, T[BlockWidth]>(reinterpret_cast<T(&)[d + 1][d][BlockWidth]>(m_reshapeUncollisionX[be][0][0][ee]),
-							reinterpret_cast<T(&)[d * d][BlockWidth]>(m_reshapeUncollisionGradientMatrix[be][0][ee]),
-							reinterpret_cast<T(&)[BlockWidth]>(m_reshapeUncollisionElementRestVolume[be][ee]),
-							reinterpret_cast<T(&)[BlockWidth]>(m_reshapeUncollisionMuLow[be][ee]),
-							reinterpret_cast<T(&)[BlockWidth]>(m_reshapeUncollisionMuHigh[be][ee]),
-							reinterpret_cast<T(&)[BlockWidth]>(m_reshapeUncollisionRangeMin[be][ee]),
-							reinterpret_cast<T(&)[BlockWidth]>(m_reshapeUncollisionRangeMax[be][ee]),
-							reinterpret_cast<T(&)[d + 1][d][BlockWidth]>(reshapeUncollisionf[be][0][0][ee]));
-				}
-
-				unblockAddForce<T, BlockWidth>(&reshapeUncollisionf[0][0][0][0], &m_reshapeUncollisionIndicesOffsets[0], &m_reshapeUncollisionIndicesValues[0], (int)m_X.size(), &SIMDf[0](1));
-#ifdef _WIN32
-				_aligned_free(reshapeUncollisionf);
-#else
-				free(reshapeUncollisionf);
-#endif
-			}
-			else {
-				std::cerr << "Not enough space for reshapeUncollisionf" << std::endl;
-				exit(1);
-			}
+			addElasticForceBlocks(m_nUncollisionBlocks, m_reshapeUncollisionX, m_reshapeUncollisionGradientMatrix, m_reshapeUncollisionElementRestVolume, m_reshapeUncollisionShape,
+				m_reshapeUncollisionMuLow, m_reshapeUncollisionMuHigh, m_reshapeUncollisionRangeMin, m_reshapeUncollisionRangeMax, m_reshapeUncollisionf);
+			unblockAddForce<T, BlockWidth>(&m_reshapeUncollisionf[0][0][0][0], &m_reshapeUncollisionIndicesOffsets[0], &m_reshapeUncollisionIndicesValues[0], (int)m_X.size(), &SIMDf[0](1));
         }
         else if (flag == ElementFlag::CollisionEl) {
-#ifdef _WIN32
-			BlockedShapeMatrixType reshapeCollisionf = reinterpret_cast<BlockedShapeMatrixType>(_aligned_malloc(m_nCollisionBlocks*BlockWidth*(d + 1)*d * sizeof(T), Alignment));
-#else
-			BlockedShapeMatrixType reshapeCollisionf = reinterpret_cast<BlockedShapeMatrixType>(aligned_alloc(Alignment, m_nCollisionBlocks*BlockWidth*(d+1)*d*sizeof(T)));
-#endif
-			if (reshapeCollisionf) {
-				for (int b = 0; b < m_nCollisionBlocks; b++)
-					for (int v = 0; v < d + 1; v++)
-						for (int i = 0; i < d; i++)
-							for (int e = 0; e < BlockWidth; e++)
-								reshapeCollisionf[b][v][i][e] = 0;
-
-#pragma omp parallel for
-				for (int be = 0; be < m_nCollisionBlocks; be++) {
-					for (int ee = 0; ee < BlockWidth; ee += Tarch::Width)
-						Add_Force<Tarch, T[BlockWidth]>(reinterpret_cast<T(&)[d + 1][d][BlockWidth]>(m_reshapeCollisionX[be][0][0][ee]),
-							reinterpret_cast<T(&)[d * d][BlockWidth]>(m_reshapeCollisionGradientMatrix[be][0][ee]),
-							reinterpret_cast<T(&)[BlockWidth]>(m_reshapeCollisionElementRestVolume[be][ee]),
-							reinterpret_cast<T(&)[BlockWidth]>(m_reshapeCollisionMuLow[be][ee]),
-							reinterpret_cast<T(&)[BlockWidth]>(m_reshapeCollisionMuHigh[be][ee]),
-							reinterpret_cast<T(&)[BlockWidth]>(m_reshapeCollisionRangeMin[be][ee]),
-							reinterpret_cast<T(&)[BlockWidth]>(m_reshapeCollisionRangeMax[be][ee]),
-							reinterpret_cast<T(&)[d + 1][d][BlockWidth]>(reshapeCollisionf[be][0][0][ee]));
-				}
+			addElasticForceBlocks(m_nCollisionBlocks, m_reshapeCollisionX, m_reshapeCollisionGradientMatrix, m_reshapeCollisionElementRestVolume, m_reshapeCollisionShape,
+				m_reshapeCollisionMuLow, m_reshapeCollisionMuHigh, m_reshapeCollisionRangeMin, m_reshapeCollisionRangeMax, m_reshapeCollisionf);
+			unblockAddForce<T, BlockWidth>(&m_reshapeCollisionf[0][0][0][0], &m_reshapeCollisionIndicesOffsets[0], &m_reshapeCollisionIndicesValues[0], (int)m_X.size(), &SIMDf[0](1));
+        }
+    }
 
-				unblockAddForce<T, BlockWidth>(&reshapeCollisionf[0][0][0][0], &m_reshapeCollisionIndicesOffsets[0], &m_reshapeCollisionIndicesValues[0], (int)m_X.size(), &SIMDf[0](1));
-#ifdef _WIN32
-				_aligned_free(reshapeCollisionf);
-#else
-				free(reshapeCollisionf);
-#endif
-			}
-			else {
-				std::cerr << "Not enough space for reshapeCollisionf" << std::endl;
-				exit(1);
-			}
+    template <class dataType, int dim>
+    void GridDeformerTet<std::vector<VECTOR<dataType,dim>>>::addElasticForceBlocks(const int nBlocks, BlockedShapeMatrixType x, BlockedMatrixType gradientMatrix, BlockedScalarType restVolume, BlockedShapeType shape,
+        BlockedScalarType muLow, BlockedScalarType muHigh, BlockedScalarType rangeMin, BlockedScalarType rangeMax, BlockedShapeMatrixType f) const
+    {
+#pragma omp parallel for num_threads(arenaThreads())
+        for (int be = 0; be < nBlocks; be++) {
+            for (int v = 0; v < d + 1; v++)
+                for (int i = 0; i < d; i++)
+                    for (int e = 0; e < BlockWidth; e++)
+                        f[be][v][i][e] = 0;
+            if (!m_reshapeShapeGradientMatrix.empty()) {
+                // expand the shape table into a block that stays in L1
+                alignas(Alignment) T blockGradientMatrix[d * d][BlockWidth];
+                alignas(Alignment) T blockRestVolume[BlockWidth];
+                for (int e = 0; e < BlockWidth; e++) {
+                    const int s = shape[be][e];
+                    for (int i = 0; i < d * d; i++)
+                        blockGradientMatrix[i][e] = m_reshapeShapeGradientMatrix[s][i];
+                    blockRestVolume[e] = m_shapeRestVolume[s];
+                }
+                m_addForceBlock(x[be], blockGradientMatrix, blockRestVolume, muLow[be], muHigh[be], rangeMin[be], rangeMax[be], f[be]);
+            }
+            else
+                m_addForceBlock(x[be], gradientMatrix[be], restVolume[be], muLow[be], muHigh[be], rangeMin[be], rangeMax[be], f[be]);
         }
     }
 
@@ -492,6 +711,10 @@ namespace PhysBAM {
 		if (m_reshapeCollisionRangeMin) _aligned_free(m_reshapeCollisionRangeMin);
 		if (m_reshapeUncollisionRangeMax) _aligned_free(m_reshapeUncollisionRangeMax);
 		if (m_reshapeCollisionRangeMax) _aligned_free(m_reshapeCollisionRangeMax);
+		if (m_reshapeUncollisionf) _aligned_free(m_reshapeUncollisionf);
+		if (m_reshapeCollisionf) _aligned_free(m_reshapeCollisionf);
+		if (m_reshapeUncollisionShape) _aligned_free(m_reshapeUncollisionShape);
+		if (m_reshapeCollisionShape) _aligned_free(m_reshapeCollisionShape);
 #else
         free(m_reshapeUncollisionX);
         free(m_reshapeCollisionX);
@@ -510,6 +733,10 @@ namespace PhysBAM {
 		free(m_reshapeCollisionRangeMin);
 		free(m_reshapeUncollisionRangeMax);
 		free(m_reshapeCollisionRangeMax);
+		free(m_reshapeUncollisionf);
+		free(m_reshapeCollisionf);
+		free(m_reshapeUncollisionShape);
+		free(m_reshapeCollisionShape);
 
 #endif
 		m_reshapeUncollisionX = nullptr;
@@ -529,6 +756,11 @@ namespace PhysBAM {
 		m_reshapeCollisionRangeMax = nullptr;
 		m_reshapeUncollisionRangeMin = nullptr;
 		m_reshapeCollisionRangeMin = nullptr;
+		m_reshapeUncollisionf = nullptr;
+		m_reshapeCollisionf = nullptr;
+		m_reshapeUncollisionShape = nullptr;
+		m_reshapeCollisionShape = nullptr;
+		m_reshapeShapeGradientMatrix.clear();
 
 
 		
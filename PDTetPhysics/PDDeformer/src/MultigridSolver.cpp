@@ -0,0 +1,962 @@
+#include "MultigridSolver.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+#include <unordered_map>
+#include <tbb/parallel_for.h>
+#include <tbb/blocked_range.h>
+
+namespace PhysBAM {
+    template<class Discretization, class IntType>
+    void MultigridSolver<Discretization, IntType>::initialize(const NodeArrayType& nodeType)
+    {
+#ifndef _WIN32
+        LOG::SCOPE scope("MultigridSolver::initialize()");
+#endif
+        // collision nodes are solved with the others, their terms only enter the finest level
+        NodeArrayType activeType = nodeType;
+        for (Iterator<NodeArrayType> iterator(activeType); !iterator.isEnd(); iterator.next())
+            if (iterator.value(activeType) == NodeType::Collision)
+                iterator.value(activeType) = NodeType::Active;
+        m_assembly.deallocate();
+        m_assembly.initialize(activeType);
+        m_levels.clear();
+        m_collisionTerms.clear();
+        m_factoredTerms.clear();
+        m_coarseChange.clear();
+        m_x.clear();
+    }
+
+    template<class Discretization, class IntType>
+    void MultigridSolver<Discretization, IntType>::deallocate()
+    {
+        m_assembly.deallocate();
+        m_levels.clear();
+        m_collisionTerms.clear();
+        m_fineDiagonal.clear();
+        m_coarseFactor.clear();
+        m_factoredTerms.clear();
+        m_coarseChange.clear();
+        m_changeSolved.clear();
+        m_capacitance.clear();
+        m_capacitancePivot.clear();
+        m_rhs.clear();
+        m_x.clear();
+        m_r.clear();
+        m_p.clear();
+        m_q.clear();
+    }
+
+    template<class Discretization, class IntType>
+    void MultigridSolver<Discretization, IntType>::initializeHierarchy(const StateVariableType& X, const std::vector<Constraint>& constraints, const std::vector<Suture>& sutures, const std::vector<Constraint>& fakeSutures, const std::vector<InternodeConstraint>& microNodes)
+    {
+#ifndef _WIN32
+        LOG::SCOPE scope("MultigridSolver::initializeHierarchy()");
+#endif
+        const std::vector<IntType>& upperRowIndex = m_assembly.m_tensorRowIndex;
+        const std::vector<IntType>& upperColumn = m_assembly.m_tensorColumn;
+        const std::vector<T>& upperValue = m_assembly.m_tensorValue;
+        if (upperRowIndex.empty() || upperValue.size() != upperColumn.size() || (size_t)upperRowIndex.back() != upperColumn.size())
+            throw std::logic_error("MultigridSolver::initializeHierarchy() called before computeTensor()");
+        const IntType n = IntType(upperRowIndex.size()) - 1;
+
+        // finest level, the full matrix from its upper triangle; rows come out sorted since lower entries precede upper ones
+        m_levels.assign(1, Level());
+        {
+            Level& fine = m_levels[0];
+            fine.n = n;
+            fine.rowIndex.assign(n + 1, 0);
+            for (IntType i = 0; i < n; i++)
+                for (IntType k = upperRowIndex[i]; k < upperRowIndex[i + 1]; k++) {
+                    fine.rowIndex[i + 1]++;
+                    if (upperColumn[k] != i)
+                        fine.rowIndex[upperColumn[k] + 1]++;
+                }
+            std::partial_sum(fine.rowIndex.begin(), fine.rowIndex.end(), fine.rowIndex.begin());
+            fine.column.resize(fine.rowIndex[n]);
+            fine.value.resize(fine.rowIndex[n]);
+            std::vector<IntType> next(fine.rowIndex.begin(), fine.rowIndex.end() - 1);
+            for (IntType i = 0; i < n; i++)
+                for (IntType k = upperRowIndex[i]; k < upperRowIndex[i + 1]; k++) {
+                    const IntType j = upperColumn[k];
+                    fine.column[next[i]] = j;
+                    fine.value[next[i]++] = upperValue[k];
+                    if (j != i) {
+                        fine.column[next[j]] = i;
+                        fine.value[next[j]++] = upperValue[k];
+                    }
+                }
+        }
+
+        std::vector<VectorType> position(n);
+        for (Iterator<StateVariableType> iterator(X); !iterator.isEnd(); iterator.next()) {
+            const IntType number = iterator.value(m_assembly.m_numbering);
+            if (number >= 0)
+                position[number] = iterator.value(X);
+        }
+        VectorType minCorner = n ? position[0] : VectorType();
+        for (IntType i = 1; i < n; i++)
+            for (int v = 1; v <= d; v++)
+                minCorner(v) = std::min(minCorner(v), position[i](v));
+
+        // the finest cells hold about two edges per axis, as the first coarser BCC level
+        double edgeLength = 0.;
+        size_t edges = 0;
+        for (IntType i = 0; i < n; i++)
+            for (IntType k = m_levels[0].rowIndex[i]; k < m_levels[0].rowIndex[i + 1]; k++)
+                if (m_levels[0].column[k] > i) {
+                    edgeLength += (position[m_levels[0].column[k]] - position[i]).Magnitude();
+                    edges++;
+                }
+        T cellSize = edges ? T(2. * edgeLength / edges) : T(0);
+
+        // adjacency of the current level, nonzero couplings of the elastic tensor on the finest one
+        std::vector<IntType> graphRowIndex(n + 1, 0), graphColumn;
+        for (IntType i = 0; i < n; i++) {
+            for (IntType k = m_levels[0].rowIndex[i]; k < m_levels[0].rowIndex[i + 1]; k++)
+                if (m_levels[0].column[k] != i && m_levels[0].value[k] != 0)
+                    graphColumn.push_back(m_levels[0].column[k]);
+            graphRowIndex[i + 1] = (IntType)graphColumn.size();
+        }
+
+        constexpr int maxLevels = 16;
+        while (cellSize > 0 && (int)m_levels.size() < maxLevels && m_levels.back().n > m_maxCoarsestSize) {
+            const IntType nl = m_levels.back().n;
+
+            // nodes of one cell connected through the cell form an aggregate, so separated pieces never merge
+            std::vector<uint64_t> cell(nl);
+            for (IntType i = 0; i < nl; i++) {
+                uint64_t key = 0;
+                for (int v = 0; v < d; v++)
+                    key |= uint64_t(std::max(T(0), std::floor((position[i](v + 1) - minCorner(v + 1)) / cellSize))) << (21 * v);
+                cell[i] = key;
+            }
+            std::vector<IntType> parent(nl);
+            std::iota(parent.begin(), parent.end(), IntType(0));
+            auto find = [&parent](IntType i) {
+                while (parent[i] != i)
+                    i = parent[i] = parent[parent[i]];
+                return i;
+            };
+            for (IntType i = 0; i < nl; i++)
+                for (IntType k = graphRowIndex[i]; k < graphRowIndex[i + 1]; k++) {
+                    const IntType j = graphColumn[k];
+                    if (cell[i] == cell[j]) {
+                        const IntType ri = find(i), rj = find(j);
+                        if (ri != rj)
+                            parent[std::max(ri, rj)] = std::min(ri, rj);
+                    }
+                }
+            std::vector<IntType> aggregate(nl), rootAggregate(nl, -1);
+            IntType nc = 0;
+            for (IntType i = 0; i < nl; i++) {
+                const IntType root = find(i);
+                if (rootAggregate[root] < 0)
+                    rootAggregate[root] = nc++;
+                aggregate[i] = rootAggregate[root];
+            }
+            if (nc > nl - nl / 8) // coarsening stalled
+                break;
+
+            std::vector<VectorType> coarsePosition(nc);
+            std::vector<int> count(nc, 0);
+            for (IntType i = 0; i < nl; i++) {
+                coarsePosition[aggregate[i]] += position[i];
+                count[aggregate[i]]++;
+            }
+            for (IntType I = 0; I < nc; I++)
+                coarsePosition[I] /= T(count[I]);
+
+            std::vector<std::pair<IntType, IntType>> coarseEdges;
+            for (IntType i = 0; i < nl; i++)
+                for (IntType k = graphRowIndex[i]; k < graphRowIndex[i + 1]; k++)
+                    if (aggregate[i] != aggregate[graphColumn[k]])
+                        coarseEdges.emplace_back(aggregate[i], aggregate[graphColumn[k]]);
+            std::sort(coarseEdges.begin(), coarseEdges.end());
+            coarseEdges.erase(std::unique(coarseEdges.begin(), coarseEdges.end()), coarseEdges.end());
+            graphRowIndex.assign(nc + 1, 0);
+            graphColumn.resize(coarseEdges.size());
+            for (size_t e = 0; e < coarseEdges.size(); e++) {
+                graphRowIndex[coarseEdges[e].first + 1]++;
+                graphColumn[e] = coarseEdges[e].second;
+            }
+            std::partial_sum(graphRowIndex.begin(), graphRowIndex.end(), graphRowIndex.begin());
+
+            m_levels.back().aggregate = std::move(aggregate);
+            m_levels.emplace_back();
+            m_levels.back().n = nc;
+            position = std::move(coarsePosition);
+            cellSize *= 2;
+        }
+
+        for (Level& level : m_levels) {
+            level.b.assign((size_t)level.n * d, T(0));
+            level.x.assign((size_t)level.n * d, T(0));
+            level.r.assign((size_t)level.n * d, T(0));
+        }
+        m_rhs.assign((size_t)n * d, T(0));
+        m_x.assign((size_t)n * d, T(0));
+        m_r.assign((size_t)n * d, T(0));
+        m_p.assign((size_t)n * d, T(0));
+        m_q.assign((size_t)n * d, T(0));
+
+        // operators of every level with the terms of the constraints present now, which the coarsest level is factored with
+        buildTerms(m_levels[0].terms, constraints, sutures, fakeSutures, microNodes);
+        for (size_t l = 0; l < m_levels.size(); l++) {
+            Level& level = m_levels[l];
+            level.elasticDiagonal.assign(level.n, T(0));
+            for (IntType i = 0; i < level.n; i++)
+                for (IntType k = level.rowIndex[i]; k < level.rowIndex[i + 1]; k++)
+                    if (level.column[k] == i)
+                        level.elasticDiagonal[i] += level.value[k];
+            const T radius = std::max(estimateSpectralRadius((int)l), T(1));
+            level.jacobiWeight = T(4) / (T(3) * radius);
+            level.diagonal = level.elasticDiagonal;
+            addDiagonal(level.terms, level.diagonal);
+            if (l + 1 < m_levels.size()) {
+                initializeProlongation((int)l);
+                restrictTerms((int)l, level.terms, m_levels[l + 1].terms);
+            }
+        }
+        m_fineDiagonal = m_levels[0].diagonal;
+        addDiagonal(m_collisionTerms, m_levels[0].diagonal);
+        factorCoarsest();
+        m_factoredTerms = m_levels[0].terms;
+        updateCoarsestFactor();
+
+        LOG::cout << "    multigrid levels =";
+        for (const Level& level : m_levels)
+            LOG::cout << " " << level.n;
+        LOG::cout << std::endl;
+    }
+
+    template<class Discretization, class IntType>
+    void MultigridSolver<Discretization, IntType>::multiplySparse(const std::vector<IntType>& aRowIndex, const std::vector<IntType>& aColumn, const std::vector<T>& aValue,
+        const std::vector<IntType>& bRowIndex, const std::vector<IntType>& bColumn, const std::vector<T>& bValue, const IntType nColumns,
+        std::vector<IntType>& cRowIndex, std::vector<IntType>& cColumn, std::vector<T>& cValue)
+    {
+        const IntType nRows = IntType(aRowIndex.size()) - 1;
+        cRowIndex.assign(nRows + 1, 0);
+        cColumn.clear();
+        cValue.clear();
+        std::vector<IntType> marker(nColumns, -1);
+        for (IntType i = 0; i < nRows; i++) {
+            const IntType rowStart = (IntType)cColumn.size();
+            for (IntType k = aRowIndex[i]; k < aRowIndex[i + 1]; k++) {
+                const IntType j = aColumn[k];
+                for (IntType m = bRowIndex[j]; m < bRowIndex[j + 1]; m++) {
+                    const IntType J = bColumn[m];
+                    if (marker[J] < rowStart) {
+                        marker[J] = (IntType)cColumn.size();
+                        cColumn.push_back(J);
+                        cValue.push_back(T(0));
+                    }
+                    cValue[marker[J]] += aValue[k] * bValue[m];
+                }
+            }
+            cRowIndex[i + 1] = (IntType)cColumn.size();
+        }
+    }
+
+    template<class Discretization, class IntType>
+    void MultigridSolver<Discretization, IntType>::appendTerm(RankOneTerms& terms, const IntType* const rows, const T* const weights, const int count, const T c)
+    {
+        const int start = terms.start.back();
+        for (int i = 0; i < count; i++) {
+            if (rows[i] < 0 || weights[i] == 0)
+                continue;
+            int e = start;
+            while (e < (int)terms.rows.size() && terms.rows[e] != rows[i])
+                e++;
+            if (e == (int)terms.rows.size()) {
+                terms.rows.push_back(rows[i]);
+                terms.weights.push_back(weights[i]);
+            }
+            else
+                terms.weights[e] += weights[i];
+        }
+        if ((int)terms.rows.size() == start)
+            return;
+        terms.start.push_back((int)terms.rows.size());
+        terms.stiffness.push_back(c);
+    }
+
+    template<class Discretization, class IntType>
+    template<int nNodes>
+    void MultigridSolver<Discretization, IntType>::addTerm(RankOneTerms& terms, const std::array<IndexType, nNodes>& nodes, const std::array<T, nNodes>& weights, const T c) const
+    {
+        std::array<IntType, nNodes> rows;
+        for (int i = 0; i < nNodes; i++)
+            rows[i] = Iterator<NodeArrayType>::at(m_assembly.m_numbering, nodes[i]);
+        appendTerm(terms, rows.data(), weights.data(), nNodes, c);
+    }
+
+    template<class Discretization, class IntType>
+    void MultigridSolver<Discretization, IntType>::addDiagonal(const RankOneTerms& terms, std::vector<T>& diagonal)
+    {
+        for (size_t t = 0; t < terms.stiffness.size(); t++) {
+            T rowSum = T(0);
+            for (int e = terms.start[t]; e < terms.start[t + 1]; e++)
+                rowSum += std::abs(terms.weights[e]);
+            for (int e = terms.start[t]; e < terms.start[t + 1]; e++)
+                diagonal[terms.rows[e]] += terms.stiffness[t] * std::abs(terms.weights[e]) * rowSum;
+        }
+    }
+
+    template<class Discretization, class IntType>
+    void MultigridSolver<Discretization, IntType>::applyTerms(const RankOneTerms& terms, const IntType n, const T* const x, T* const y)
+    {
+        for (size_t t = 0; t < terms.stiffness.size(); t++)
+            for (int v = 0; v < d; v++) {
+                T dot = T(0);
+                for (int e = terms.start[t]; e < terms.start[t + 1]; e++)
+                    dot += terms.weights[e] * x[(size_t)v * n + terms.rows[e]];
+                dot *= terms.stiffness[t];
+                for (int e = terms.start[t]; e < terms.start[t + 1]; e++)
+                    y[(size_t)v * n + terms.rows[e]] += dot * terms.weights[e];
+            }
+    }
+
+    template<class Discretization, class IntType>
+    void MultigridSolver<Discretization, IntType>::buildTerms(RankOneTerms& terms, const std::vector<Constraint>& constraints, const std::vector<Suture>& sutures, const std::vector<Constraint>& fakeSutures, const std::vector<InternodeConstraint>& microNodes) const
+    {
+        terms.clear();
+        for (const Constraint& constraint : constraints)
+            if (constraint.m_stiffness != 0)
+                addTerm<elementNodes>(terms, constraint.m_elementIndex, constraint.m_weights, constraint.m_stiffness);
+        for (const Constraint& constraint : fakeSutures)
+            if (constraint.m_stiffness != 0)
+                addTerm<elementNodes>(terms, constraint.m_elementIndex, constraint.m_weights, constraint.m_stiffness);
+        for (const Suture& suture : sutures)
+            if (suture.m_stiffness != 0) {
+                std::array<IndexType, elementNodes * 2> elementIndex;
+                std::array<T, elementNodes * 2> weights;
+                for (int v = 0; v < elementNodes; v++) {
+                    elementIndex[v] = suture.m_elementIndex1[v];
+                    elementIndex[v + elementNodes] = suture.m_elementIndex2[v];
+                    weights[v] = suture.m_weights1[v];
+                    weights[v + elementNodes] = -suture.m_weights2[v];
+                }
+                addTerm<elementNodes * 2>(terms, elementIndex, weights, suture.m_stiffness);
+            }
+        for (const InternodeConstraint& microNode : microNodes)
+            if (microNode.m_stiffness != 0) {
+                std::array<IndexType, d + 1> elementIndex;
+                std::array<T, d + 1> weights;
+                for (int v = 0; v < d; v++) {
+                    elementIndex[v] = microNode.m_macroNodes[v];
+                    weights[v] = microNode.m_macroWeights[v];
+                }
+                elementIndex[d] = microNode.m_microNodeNumber;
+                weights[d] = -1;
+                addTerm<d + 1>(terms, elementIndex, weights, microNode.m_stiffness);
+            }
+    }
+
+    template<class Discretization, class IntType>
+    void MultigridSolver<Discretization, IntType>::restrictTerms(const int l, const RankOneTerms& fineTerms, RankOneTerms& coarseTerms) const
+    {
+        const Level& fine = m_levels[l];
+        coarseTerms.clear();
+        std::vector<IntType> rows;
+        std::vector<T> weights;
+        for (size_t t = 0; t < fineTerms.stiffness.size(); t++) {
+            rows.clear();
+            weights.clear();
+            for (int e = fineTerms.start[t]; e < fineTerms.start[t + 1]; e++)
+                for (IntType k = fine.pRowIndex[fineTerms.rows[e]]; k < fine.pRowIndex[fineTerms.rows[e] + 1]; k++) {
+                    rows.push_back(fine.pColumn[k]);
+                    weights.push_back(fineTerms.weights[e] * fine.pValue[k]);
+                }
+            appendTerm(coarseTerms, rows.data(), weights.data(), (int)rows.size(), fineTerms.stiffness[t]);
+        }
+    }
+
+    template<class Discretization, class IntType>
+    void MultigridSolver<Discretization, IntType>::setTerms()
+    {
+        for (size_t l = 0; l < m_levels.size(); l++) {
+            Level& level = m_levels[l];
+            if (l > 0)
+                restrictTerms((int)l - 1, m_levels[l - 1].terms, level.terms);
+            level.diagonal = level.elasticDiagonal;
+            addDiagonal(level.terms, level.diagonal);
+        }
+        m_fineDiagonal = m_levels[0].diagonal;
+        addDiagonal(m_collisionTerms, m_levels[0].diagonal);
+    }
+
+    template<class Discretization, class IntType>
+    void MultigridSolver<Discretization, IntType>::setConstraints(const std::vector<Constraint>& constraints, const std::vector<Suture>& sutures, const std::vector<Constraint>& fakeSutures, const std::vector<InternodeConstraint>& microNodes)
+    {
+        if (m_levels.empty())
+            throw std::logic_error("MultigridSolver::setConstraints() called before initializeHierarchy()");
+        buildTerms(m_levels[0].terms, constraints, sutures, fakeSutures, microNodes);
+        setTerms();
+        updateCoarsestFactor();
+    }
+
+    template<class Discretization, class IntType>
+    void MultigridSolver<Discretization, IntType>::updateCollision(const std::vector<Constraint>& collisionConstraints, const std::vector<CollisionSuture>& collisionSutures)
+    {
+        m_collisionTerms.clear();
+        for (const Constraint& constraint : collisionConstraints)
+            if (constraint.m_stiffness != 0)
+                addTerm<elementNodes>(m_collisionTerms, constraint.m_elementIndex, constraint.m_weights, constraint.m_stiffness);
+        for (const CollisionSuture& suture : collisionSutures)
+            if (suture.m_stiffness != 0) {
+                std::array<IndexType, elementNodes * 2> elementIndex;
+                std::array<T, elementNodes * 2> weights;
+                for (int v = 0; v < elementNodes; v++) {
+                    elementIndex[v] = suture.m_elementIndex1[v];
+                    elementIndex[v + elementNodes] = suture.m_elementIndex2[v];
+                    weights[v] = suture.m_weights1[v];
+                    weights[v + elementNodes] = -suture.m_weights2[v];
+                }
+                addTerm<elementNodes * 2>(m_collisionTerms, elementIndex, weights, suture.m_stiffness);
+            }
+        m_levels[0].diagonal = m_fineDiagonal;
+        addDiagonal(m_collisionTerms, m_levels[0].diagonal);
+    }
+
+    template<class Discretization, class IntType>
+    void MultigridSolver<Discretization, IntType>::initializeProlongation(const int l)
+    {
+        Level& fine = m_levels[l];
+        Level& coarse = m_levels[l + 1];
+        const IntType nl = fine.n, nc = coarse.n;
+        const RankOneTerms& terms = fine.terms;
+
+        // Nodes held mostly by the constraints present now are left out of the tentative piecewise constant prolongation,
+        // so the coarse functions vanish there as the solution does. One damped Jacobi step of the whole operator smooths it.
+        std::vector<IntType> aggregate(nl);
+        for (IntType i = 0; i < nl; i++)
+            aggregate[i] = fine.diagonal[i] > 2 * fine.elasticDiagonal[i] ? IntType(-1) : fine.aggregate[i];
+        // the terms' part of A * P0, c * u * (P0^T * u)^T, collected by row
+        std::vector<std::array<IntType, 2>> termEntry; // row, coarse column
+        std::vector<T> termValue;
+        std::vector<IntType> rows;
+        std::vector<T> weights;
+        for (size_t t = 0; t < terms.stiffness.size(); t++) {
+            const T c = terms.stiffness[t];
+            rows.clear();
+            weights.clear();
+            for (int e = terms.start[t]; e < terms.start[t + 1]; e++)
+                if (aggregate[terms.rows[e]] >= 0) {
+                    rows.push_back(aggregate[terms.rows[e]]);
+                    weights.push_back(terms.weights[e]);
+                }
+            for (int e = terms.start[t]; e < terms.start[t + 1]; e++)
+                for (size_t f = 0; f < rows.size(); f++) {
+                    termEntry.push_back({ terms.rows[e], rows[f] });
+                    termValue.push_back(c * terms.weights[e] * weights[f]);
+                }
+        }
+        std::vector<size_t> termOrder(termEntry.size());
+        std::iota(termOrder.begin(), termOrder.end(), size_t(0));
+        std::sort(termOrder.begin(), termOrder.end(), [&termEntry](const size_t a, const size_t b) { return termEntry[a][0] < termEntry[b][0]; });
+
+        const T omega = fine.jacobiWeight;
+        fine.pRowIndex.assign(nl + 1, 0);
+        fine.pColumn.clear();
+        fine.pValue.clear();
+        std::vector<IntType> marker(nc, -1);
+        size_t nextTerm = 0;
+        for (IntType i = 0; i < nl; i++) {
+            const IntType rowStart = (IntType)fine.pColumn.size();
+            auto add = [&](const IntType J, const T value) {
+                if (marker[J] < rowStart) {
+                    marker[J] = (IntType)fine.pColumn.size();
+                    fine.pColumn.push_back(J);
+                    fine.pValue.push_back(T(0));
+                }
+                fine.pValue[marker[J]] += value;
+            };
+            const T scale = fine.diagonal[i] > 0 ? -omega / fine.diagonal[i] : T(0);
+            if (aggregate[i] >= 0)
+                add(aggregate[i], T(1));
+            for (IntType k = fine.rowIndex[i]; k < fine.rowIndex[i + 1]; k++)
+                if (aggregate[fine.column[k]] >= 0)
+                    add(aggregate[fine.column[k]], scale * fine.value[k]);
+            for (; nextTerm < termOrder.size() && termEntry[termOrder[nextTerm]][0] == i; nextTerm++)
+                add(termEntry[termOrder[nextTerm]][1], scale * termValue[termOrder[nextTerm]]);
+            fine.pRowIndex[i + 1] = (IntType)fine.pColumn.size();
+        }
+
+        fine.rRowIndex.assign(nc + 1, 0);
+        fine.rColumn.resize(fine.pColumn.size());
+        fine.rValue.resize(fine.pValue.size());
+        for (const IntType J : fine.pColumn)
+            fine.rRowIndex[J + 1]++;
+        std::partial_sum(fine.rRowIndex.begin(), fine.rRowIndex.end(), fine.rRowIndex.begin());
+        {
+            std::vector<IntType> next(fine.rRowIndex.begin(), fine.rRowIndex.end() - 1);
+            for (IntType i = 0; i < nl; i++)
+                for (IntType k = fine.pRowIndex[i]; k < fine.pRowIndex[i + 1]; k++) {
+                    fine.rColumn[next[fine.pColumn[k]]] = i;
+                    fine.rValue[next[fine.pColumn[k]]++] = fine.pValue[k];
+                }
+        }
+
+        // Galerkin operator R * K * P of the elastic part, restrictTerms() gives its rank one terms R * u
+        std::vector<IntType> apRowIndex, apColumn;
+        std::vector<T> apValue;
+        multiplySparse(fine.rowIndex, fine.column, fine.value, fine.pRowIndex, fine.pColumn, fine.pValue, nc, apRowIndex, apColumn, apValue);
+        multiplySparse(fine.rRowIndex, fine.rColumn, fine.rValue, apRowIndex, apColumn, apValue, nc, coarse.rowIndex, coarse.column, coarse.value);
+    }
+
+    template<class Discretization, class IntType>
+    typename MultigridSolver<Discretization, IntType>::T MultigridSolver<Discretization, IntType>::estimateSpectralRadius(const int l)
+    {
+        Level& level = m_levels[l];
+        const IntType n = level.n;
+        T* const x = level.x.data();
+        T* const y = level.r.data();
+        for (IntType i = 0; i < n; i++)
+            for (int v = 0; v < d; v++)
+                x[(size_t)v * n + i] = T(1 + (i * 7919 + v * 104729) % 17) / T(17);
+        double radius = 0.;
+        for (int iteration = 0; iteration < 12; iteration++) {
+            multiplyElastic(l, x, y);
+            double norm = 0., yNorm = 0.;
+            for (IntType i = 0; i < n; i++)
+                for (int v = 0; v < d; v++) {
+                    const size_t k = (size_t)v * n + i;
+                    norm += (double)x[k] * x[k];
+                    y[k] = level.elasticDiagonal[i] > 0 ? y[k] / level.elasticDiagonal[i] : T(0);
+                    yNorm += (double)y[k] * y[k];
+                }
+            if (yNorm == 0.)
+                return T(0);
+            radius = std::sqrt(yNorm / norm);
+            const T scale = T(1. / std::sqrt(yNorm));
+            for (size_t k = 0; k < (size_t)n * d; k++)
+                x[k] = y[k] * scale;
+        }
+        return T(1.1 * radius); // the power iteration approaches the radius from below
+    }
+
+    template<class Discretization, class IntType>
+    void MultigridSolver<Discretization, IntType>::multiply(const int l, const T* const x, T* const y) const
+    {
+        multiplyElastic(l, x, y);
+        applyTerms(m_levels[l].terms, m_levels[l].n, x, y);
+        if (l == 0)
+            applyTerms(m_collisionTerms, m_levels[0].n, x, y);
+    }
+
+    template<class Discretization, class IntType>
+    void MultigridSolver<Discretization, IntType>::multiplyElastic(const int l, const T* const x, T* const y) const
+    {
+        const Level& level = m_levels[l];
+        const IntType n = level.n;
+        tbb::parallel_for(tbb::blocked_range<IntType>(0, n, 1024), [&](const tbb::blocked_range<IntType>& range) {
+            for (IntType i = range.begin(); i != range.end(); i++) {
+                T sum[d] = {};
+                for (IntType k = level.rowIndex[i]; k < level.rowIndex[i + 1]; k++) {
+                    const T a = level.value[k];
+                    const T* const xj = x + level.column[k];
+                    for (int v = 0; v < d; v++)
+                        sum[v] += a * xj[(size_t)v * n];
+                }
+                for (int v = 0; v < d; v++)
+                    y[(size_t)v * n + i] = sum[v];
+            }
+        });
+    }
+
+    template<class Discretization, class IntType>
+    void MultigridSolver<Discretization, IntType>::smooth(const int l, const T* const b, T* const x)
+    {
+        Level& level = m_levels[l];
+        const IntType n = level.n;
+        T* const Ax = level.r.data();
+        for (int s = 0; s < m_smoothingIterations; s++) {
+            multiply(l, x, Ax);
+            tbb::parallel_for(tbb::blocked_range<IntType>(0, n, 4096), [&](const tbb::blocked_range<IntType>& range) {
+                for (IntType i = range.begin(); i != range.end(); i++)
+                    if (level.diagonal[i] > 0) {
+                        const T w = level.jacobiWeight / level.diagonal[i];
+                        for (int v = 0; v < d; v++)
+                            x[(size_t)v * n + i] += w * (b[(size_t)v * n + i] - Ax[(size_t)v * n + i]);
+                    }
+            });
+        }
+    }
+
+    template<class Discretization, class IntType>
+    void MultigridSolver<Discretization, IntType>::vCycle(const int l)
+    {
+        Level& level = m_levels[l];
+        if (l + 1 == (int)m_levels.size()) {
+            solveCoarsest(level.b.data(), level.x.data());
+            return;
+        }
+        const IntType n = level.n;
+        std::fill(level.x.begin(), level.x.end(), T(0));
+        smooth(l, level.b.data(), level.x.data());
+
+        multiply(l, level.x.data(), level.r.data());
+        Level& coarse = m_levels[l + 1];
+        const IntType nc = coarse.n;
+        tbb::parallel_for(tbb::blocked_range<IntType>(0, nc, 1024), [&](const tbb::blocked_range<IntType>& range) {
+            for (IntType I = range.begin(); I != range.end(); I++)
+                for (int v = 0; v < d; v++) {
+                    T sum = T(0);
+                    for (IntType k = level.rRowIndex[I]; k < level.rRowIndex[I + 1]; k++)
+                        sum += level.rValue[k] * (level.b[(size_t)v * n + level.rColumn[k]] - level.r[(size_t)v * n + level.rColumn[k]]);
+                    coarse.b[(size_t)v * nc + I] = sum;
+                }
+        });
+
+        vCycle(l + 1);
+
+        tbb::parallel_for(tbb::blocked_range<IntType>(0, n, 4096), [&](const tbb::blocked_range<IntType>& range) {
+            for (IntType i = range.begin(); i != range.end(); i++)
+                for (int v = 0; v < d; v++) {
+                    T sum = T(0);
+                    for (IntType k = level.pRowIndex[i]; k < level.pRowIndex[i + 1]; k++)
+                        sum += level.pValue[k] * coarse.x[(size_t)v * nc + level.pColumn[k]];
+                    level.x[(size_t)v * n + i] += sum;
+                }
+        });
+        smooth(l, level.b.data(), level.x.data());
+    }
+
+    template<class Discretization, class IntType>
+    void MultigridSolver<Discretization, IntType>::factorCoarsest()
+    {
+        const Level& level = m_levels.back();
+        const IntType n = level.n;
+        m_coarseFactor.clear();
+        if (n > 2 * m_maxCoarsestSize) {
+            LOG::cout << "    coarsest multigrid level of " << n << " nodes is smoothed, not factored" << std::endl;
+            return;
+        }
+
+        std::vector<double>& L = m_coarseFactor;
+        L.assign((size_t)n * n, 0.);
+        double maxDiagonal = 0.;
+        for (IntType i = 0; i < n; i++) {
+            for (IntType k = level.rowIndex[i]; k < level.rowIndex[i + 1]; k++)
+                L[(size_t)i * n + level.column[k]] += level.value[k];
+            maxDiagonal = std::max(maxDiagonal, (double)level.diagonal[i]);
+        }
+        const RankOneTerms& terms = level.terms;
+        for (size_t t = 0; t < terms.stiffness.size(); t++)
+            for (int e = terms.start[t]; e < terms.start[t + 1]; e++)
+                for (int f = terms.start[t]; f < terms.start[t + 1]; f++)
+                    L[(size_t)terms.rows[e] * n + terms.rows[f]] += (double)terms.stiffness[t] * terms.weights[e] * terms.weights[f];
+
+        // a model with no constraint has a singular operator, the shift keeps the factor defined
+        const double shift = 1e-8 * maxDiagonal;
+        for (IntType j = 0; j < n; j++) {
+            double* const Lj = L.data() + (size_t)j * n;
+            double pivot = Lj[j] + shift;
+            for (IntType k = 0; k < j; k++)
+                pivot -= Lj[k] * Lj[k];
+            Lj[j] = std::sqrt(std::max(pivot, shift > 0 ? shift : 1.));
+            tbb::parallel_for(tbb::blocked_range<IntType>(j + 1, n, 64), [&](const tbb::blocked_range<IntType>& range) {
+                for (IntType i = range.begin(); i != range.end(); i++) {
+                    double* const Li = L.data() + (size_t)i * n;
+                    double sum = Li[j];
+                    for (IntType k = 0; k < j; k++)
+                        sum -= Li[k] * Lj[k];
+                    Li[j] = sum / Lj[j];
+                }
+            });
+        }
+    }
+
+    template<class Discretization, class IntType>
+    void MultigridSolver<Discretization, IntType>::updateCoarsestFactor()
+    {
+        m_coarseChange.clear();
+        m_changeSolved.clear();
+        m_capacitance.clear();
+        m_capacitancePivot.clear();
+        if (m_coarseFactor.empty())
+            return; // the coarsest level is smoothed with its current terms
+
+        // terms are built in the same way from the same constraints, so an unchanged one is bitwise equal to the factored one
+        auto termHash = [](const RankOneTerms& terms, const size_t t) {
+            uint64_t h = 14695981039346656037ull;
+            auto mix = [&h](const void* data, const size_t size) {
+                const unsigned char* bytes = static_cast<const unsigned char*>(data);
+                for (size_t i = 0; i < size; i++)
+                    h = (h ^ bytes[i]) * 1099511628211ull;
+            };
+            const int count = terms.start[t + 1] - terms.start[t];
+            mix(terms.rows.data() + terms.start[t], sizeof(IntType) * count);
+            mix(terms.weights.data() + terms.start[t], sizeof(T) * count);
+            mix(&terms.stiffness[t], sizeof(T));
+            return h;
+        };
+        auto equal = [](const RankOneTerms& a, const size_t s, const RankOneTerms& b, const size_t t) {
+            const int count = a.start[s + 1] - a.start[s];
+            return a.stiffness[s] == b.stiffness[t] && count == b.start[t + 1] - b.start[t] &&
+                std::equal(a.rows.begin() + a.start[s], a.rows.begin() + a.start[s + 1], b.rows.begin() + b.start[t]) &&
+                std::equal(a.weights.begin() + a.start[s], a.weights.begin() + a.start[s + 1], b.weights.begin() + b.start[t]);
+        };
+        const RankOneTerms& factored = m_factoredTerms;
+        const RankOneTerms& current = m_levels[0].terms;
+        std::unordered_multimap<uint64_t, size_t> unmatched;
+        for (size_t t = 0; t < factored.stiffness.size(); t++)
+            unmatched.emplace(termHash(factored, t), t);
+        RankOneTerms change; // finest level, removed terms with negated stiffness
+        for (size_t t = 0; t < current.stiffness.size(); t++) {
+            auto range = unmatched.equal_range(termHash(current, t));
+            auto match = range.first;
+            while (match != range.second && !equal(factored, match->second, current, t))
+                ++match;
+            if (match != range.second)
+                unmatched.erase(match);
+            else
+                appendTerm(change, current.rows.data() + current.start[t], current.weights.data() + current.start[t], current.start[t + 1] - current.start[t], current.stiffness[t]);
+        }
+        std::vector<size_t> removed;
+        for (const auto& entry : unmatched)
+            removed.push_back(entry.second);
+        std::sort(removed.begin(), removed.end());
+        for (const size_t t : removed)
+            appendTerm(change, factored.rows.data() + factored.start[t], factored.weights.data() + factored.start[t], factored.start[t + 1] - factored.start[t], -factored.stiffness[t]);
+        for (int l = 0; l + 1 < (int)m_levels.size(); l++) {
+            RankOneTerms coarse;
+            restrictTerms(l, change, coarse);
+            change = std::move(coarse);
+        }
+        const int k = (int)change.stiffness.size();
+        if (!k)
+            return;
+        m_coarseChange = std::move(change);
+
+        // Woodbury, A^-1 = M^-1 - M^-1 * U * (C^-1 + U^T * M^-1 * U)^-1 * U^T * M^-1
+        const RankOneTerms& U = m_coarseChange;
+        const IntType n = m_levels.back().n;
+        m_changeSolved.assign((size_t)k * n, 0.);
+        tbb::parallel_for(tbb::blocked_range<int>(0, k), [&](const tbb::blocked_range<int>& range) {
+            for (int t = range.begin(); t != range.end(); t++) {
+                double* const w = m_changeSolved.data() + (size_t)t * n;
+                for (int e = U.start[t]; e < U.start[t + 1]; e++)
+                    w[U.rows[e]] = U.weights[e];
+                solveFactored(w);
+            }
+        });
+        std::vector<double>& S = m_capacitance;
+        S.assign((size_t)k * k, 0.);
+        for (int s = 0; s < k; s++) {
+            for (int t = 0; t < k; t++) {
+                const double* const w = m_changeSolved.data() + (size_t)t * n;
+                double sum = 0.;
+                for (int e = U.start[s]; e < U.start[s + 1]; e++)
+                    sum += U.weights[e] * w[U.rows[e]];
+                S[(size_t)s * k + t] = sum;
+            }
+            S[(size_t)s * k + s] += 1. / U.stiffness[s];
+        }
+        // removed terms make it indefinite, so LU with partial pivoting
+        m_capacitancePivot.resize(k);
+        for (int j = 0; j < k; j++) {
+            int pivot = j;
+            for (int i = j + 1; i < k; i++)
+                if (std::abs(S[(size_t)i * k + j]) > std::abs(S[(size_t)pivot * k + j]))
+                    pivot = i;
+            m_capacitancePivot[j] = pivot;
+            if (pivot != j)
+                std::swap_ranges(S.begin() + (size_t)j * k, S.begin() + (size_t)(j + 1) * k, S.begin() + (size_t)pivot * k);
+            if (S[(size_t)j * k + j] == 0.)
+                throw std::logic_error("MultigridSolver::updateCoarsestFactor() singular capacitance matrix");
+            for (int i = j + 1; i < k; i++) {
+                const double factor = S[(size_t)i * k + j] /= S[(size_t)j * k + j];
+                for (int c = j + 1; c < k; c++)
+                    S[(size_t)i * k + c] -= factor * S[(size_t)j * k + c];
+            }
+        }
+    }
+
+    template<class Discretization, class IntType>
+    void MultigridSolver<Discretization, IntType>::solveFactored(double* const y) const
+    {
+        const std::vector<double>& L = m_coarseFactor;
+        const IntType n = m_levels.back().n;
+        for (IntType i = 0; i < n; i++) {
+            double sum = y[i];
+            for (IntType k = 0; k < i; k++)
+                sum -= L[(size_t)i * n + k] * y[k];
+            y[i] = sum / L[(size_t)i * n + i];
+        }
+        for (IntType i = n - 1; i >= 0; i--) {
+            double sum = y[i];
+            for (IntType k = i + 1; k < n; k++)
+                sum -= L[(size_t)k * n + i] * y[k];
+            y[i] = sum / L[(size_t)i * n + i];
+        }
+    }
+
+    template<class Discretization, class IntType>
+    void MultigridSolver<Discretization, IntType>::solveCoarsest(const T* const b, T* const x)
+    {
+        const int l = (int)m_levels.size() - 1;
+        const IntType n = m_levels[l].n;
+        if (m_coarseFactor.empty()) {
+            std::fill(x, x + (size_t)n * d, T(0));
+            for (int s = 0; s < 4; s++)
+                smooth(l, b, x);
+            return;
+        }
+        const RankOneTerms& U = m_coarseChange;
+        const int k = (int)U.stiffness.size();
+        std::vector<double> y(n), z(k);
+        for (int v = 0; v < d; v++) {
+            for (IntType i = 0; i < n; i++)
+                y[i] = b[(size_t)v * n + i];
+            solveFactored(y.data());
+            if (k) {
+                for (int t = 0; t < k; t++) {
+                    double sum = 0.;
+                    for (int e = U.start[t]; e < U.start[t + 1]; e++)
+                        sum += U.weights[e] * y[U.rows[e]];
+                    z[t] = sum;
+                }
+                const std::vector<double>& S = m_capacitance;
+                for (int j = 0; j < k; j++) {
+                    std::swap(z[j], z[m_capacitancePivot[j]]);
+                    for (int i = j + 1; i < k; i++)
+                        z[i] -= S[(size_t)i * k + j] * z[j];
+                }
+                for (int i = k - 1; i >= 0; i--) {
+                    for (int c = i + 1; c < k; c++)
+                        z[i] -= S[(size_t)i * k + c] * z[c];
+                    z[i] /= S[(size_t)i * k + i];
+                }
+                for (int t = 0; t < k; t++) {
+                    const double* const w = m_changeSolved.data() + (size_t)t * n;
+                    for (IntType i = 0; i < n; i++)
+                        y[i] -= z[t] * w[i];
+                }
+            }
+            for (IntType i = 0; i < n; i++)
+                x[(size_t)v * n + i] = T(y[i]);
+        }
+    }
+
+    template<class Discretization, class IntType>
+    void MultigridSolver<Discretization, IntType>::copyIn(const StateVariableType& f)
+    {
+        const IntType n = m_levels[0].n;
+        for (Iterator<StateVariableType> iterator(f); !iterator.isEnd(); iterator.next()) {
+            const int number = iterator.value(m_assembly.m_numbering);
+            if (number >= 0) {
+                const VectorType& value = iterator.value(f);
+                for (int v = 0; v < d; v++)
+                    m_rhs[(size_t)v * n + number] = value(v + 1);
+            }
+        }
+    }
+
+    template<class Discretization, class IntType>
+    void MultigridSolver<Discretization, IntType>::copyOut(StateVariableType& f) const
+    {
+        const IntType n = m_levels[0].n;
+        for (Iterator<StateVariableType> iterator(f); !iterator.isEnd(); iterator.next()) {
+            const int number = iterator.value(m_assembly.m_numbering);
+            if (number >= 0) {
+                VectorType& value = iterator.value(f);
+                for (int v = 0; v < d; v++)
+                    value(v + 1) = m_x[(size_t)v * n + number];
+            }
+        }
+    }
+
+    template<class Discretization, class IntType>
+    void MultigridSolver<Discretization, IntType>::solve()
+    {
+#if TIMING
+        auto start = std::chrono::steady_clock::now();
+#endif
+        Level& fine = m_levels[0];
+        const IntType n = fine.n;
+        const T* const b = m_rhs.data();
+        T* const x = m_x.data();
+        T* const r = m_r.data();
+        T* const p = m_p.data();
+        T* const q = m_q.data();
+        const T* const z = fine.x.data();
+        auto dot = [n](const T* const u, const T* const w, const int v) {
+            double sum = 0.;
+            for (IntType i = 0; i < n; i++)
+                sum += (double)u[(size_t)v * n + i] * w[(size_t)v * n + i];
+            return sum;
+        };
+
+        // each column starts from the last solution unless that is worse than starting from zero
+        std::array<double, d> bNorm, rNorm, rz;
+        multiply(0, x, q);
+        for (int v = 0; v < d; v++) {
+            for (IntType i = 0; i < n; i++)
+                r[(size_t)v * n + i] = b[(size_t)v * n + i] - q[(size_t)v * n + i];
+            bNorm[v] = std::sqrt(dot(b, b, v));
+            rNorm[v] = std::sqrt(dot(r, r, v));
+            if (rNorm[v] > bNorm[v]) {
+                std::fill(x + (size_t)v * n, x + (size_t)(v + 1) * n, T(0));
+                std::copy(b + (size_t)v * n, b + (size_t)(v + 1) * n, r + (size_t)v * n);
+                rNorm[v] = bNorm[v];
+            }
+        }
+        auto converged = [&]() {
+            for (int v = 0; v < d; v++)
+                if (rNorm[v] > m_tolerance * bNorm[v])
+                    return false;
+            return true;
+        };
+
+        // preconditioned conjugate gradients, the d columns in lockstep
+        int iteration = 0;
+        if (!converged()) {
+            std::copy(r, r + (size_t)n * d, fine.b.begin());
+            vCycle(0);
+            std::copy(z, z + (size_t)n * d, p);
+            for (int v = 0; v < d; v++)
+                rz[v] = dot(r, z, v);
+            while (iteration < m_maxIterations) {
+                iteration++;
+                multiply(0, p, q);
+                for (int v = 0; v < d; v++) {
+                    const double pq = dot(p, q, v);
+                    const T alpha = pq > 0. ? T(rz[v] / pq) : T(0);
+                    for (IntType i = 0; i < n; i++) {
+                        x[(size_t)v * n + i] += alpha * p[(size_t)v * n + i];
+                        r[(size_t)v * n + i] -= alpha * q[(size_t)v * n + i];
+                    }
+                    rNorm[v] = std::sqrt(dot(r, r, v));
+                }
+                if (converged())
+                    break;
+                std::copy(r, r + (size_t)n * d, fine.b.begin());
+                vCycle(0);
+                for (int v = 0; v < d; v++) {
+                    const double rzNew = dot(r, z, v);
+                    const T beta = rz[v] > 0. ? T(rzNew / rz[v]) : T(0);
+                    rz[v] = rzNew;
+                    for (IntType i = 0; i < n; i++)
+                        p[(size_t)v * n + i] = z[(size_t)v * n + i] + beta * p[(size_t)v * n + i];
+                }
+            }
+        }
+        m_lastIterations = iteration;
+#if TIMING
+        auto end = std::chrono::steady_clock::now();
+        std::chrono::duration<double> elapsed_seconds = end - start;
+        double residual = 0.;
+        for (int v = 0; v < d; v++)
+            residual = std::max(residual, bNorm[v] > 0. ? rNorm[v] / bNorm[v] : 0.);
+        std::cout << "Multigrid PCG: " << iteration << " iterations, relative residual " << residual << ", " << elapsed_seconds.count() << " s" << std::endl;
+#endif
+    }
+}
+
+namespace PhysBAM {
+    template struct MultigridSolver<TetrahedralDiscretization<std::vector<VECTOR<float, 3>>>, int>;
+}
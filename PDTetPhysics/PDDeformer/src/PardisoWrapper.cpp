@@ -3,6 +3,7 @@
 // Distributed under the FreeBSD license (see license.txt)
 //#####################################################################
 
+#ifndef NO_MKL
 #include <mkl.h>
 #include "PardisoWrapper.h"
 #include "MKLWrapper.h"
@@ -16,7 +17,7 @@
 
 
 template<class T, class IntType>
-void PardisoWrapper<T, IntType>::initialize(const IntType _n, const IntType _nnz, const IntType _m) {
+void PardisoWrapper<T, IntType>::initialize(const IntType _n, const IntType _nnz, const IntType _m, const int _nrhs) {
     //PhysBAM::LOG::SCOPE scope("PardisoWrapper::initialize()");
 
         n = _n;
@@ -33,7 +34,7 @@ void PardisoWrapper<T, IntType>::initialize(const IntType _n, const IntType _nnz
 
         mtype = 2; /* Real symmetric positive definite matrix */
                    // IntType mtype = -2;       /* Real symmetric (maybe indefinite) matrix */
-        nrhs = 1; /* Number of right hand sides. */
+        nrhs = _nrhs; /* Number of right hand sides. */
 
         //      Auxiliary variables.
 
@@ -74,13 +75,8 @@ iparm[13] = 0; /* Output: Number of perturbed pivots (not important for mtype =
         mnum = 1;   /* Number of matrix */
         msglvl = 0; /* 0:No statistical information print*/
 
-        /* -------------------------------------------------------------------- */
-        /* .. Initialize the internal solver memory pointer. This is only */
-        /* necessary for the FIRST call of the PARDISO solver. */
-        /* -------------------------------------------------------------------- */
-        for (int i = 0; i < 64; i++) {
-            pt[i] = nullptr;
-        }
+        // pt is left alone so an analysis of the same pattern survives deallocate() and initialize().
+        // It is zeroed at construction and by releasePardisoInternal().
     }
 
 template<class T, class IntType>
@@ -104,6 +100,11 @@ void PardisoWrapper<T, IntType>::symbolicFact() {
     startStamp = std::chrono::steady_clock::now();
 #endif
 
+    if (this->patternUnchanged())
+        return; // ordering and symbolic factor held in pt still apply, only phase 22 needs to run
+    if (this->patternAnalyzed)
+        releasePardisoInternal();
+
     IntType error;
     T ddum;       /* Scalar dummy */
     IntType idum; /* Integer dummy. */
@@ -125,6 +126,7 @@ void PardisoWrapper<T, IntType>::symbolicFact() {
     if ( error != 0 ) {
         throw std::logic_error("ERROR during symbolic factorization (phase " + std::to_string(phase) + ") with error " + std::to_string(error));
     }
+    this->recordAnalyzedPattern();
 #if TIMING
     endStamp = std::chrono::steady_clock::now();
     elapsed_second = endStamp - startStamp;
@@ -185,6 +187,13 @@ void PardisoWrapper<T, IntType>::releasePardisoInternal() {
             throw std::logic_error("ERROR during release (phase " + std::to_string(phase) + ") with error " + std::to_string(error));
 
         }
+        /* -------------------------------------------------------------------- */
+        /* .. Reset the internal solver memory pointer for the next analysis. */
+        /* -------------------------------------------------------------------- */
+        for (int i = 0; i < 64; i++) {
+            pt[i] = nullptr;
+        }
+        this->clearAnalyzedPattern();
     }
 
 template<class T, class IntType>
@@ -239,12 +248,15 @@ void PardisoWrapper<T, IntType>::diagSolve(T* const _rhs, T* const _x) {
         const IntType phase = 332;
         if (m) {
 
-            IntType info = LAPACKPolicy<T>::solve(m,nrhs,schur,&_rhs[n-m]);
-            if (info != 0)
-            {
-                throw std::logic_error("info after LAPACKE_dspotrs = " + std::to_string(info));
+            // schur part of each right hand side column is its last m entries
+            for (int k = 0; k < nrhs; k++) {
+                IntType info = LAPACKPolicy<T>::solve(m,1,schur,&_rhs[k*n+n-m]);
+                if (info != 0)
+                {
+                    throw std::logic_error("info after LAPACKE_dspotrs = " + std::to_string(info));
+                }
             }
-            for (IntType i = 0; i < n; i++ ) {
+            for (IntType i = 0; i < n*nrhs; i++ ) {
                 _x[i] = _rhs[i];
             }
 
@@ -293,4 +305,5 @@ void PardisoWrapper<T, IntType>::backwardSubstitution(T* const _rhs, T* const _x
 template struct PardisoWrapper<float, int>;
 
  template struct PardisoWrapper<double, long long int>;
- template struct PardisoWrapper<float, long long int>;
\ No newline at end of file
+ template struct PardisoWrapper<float, long long int>;
+#endif
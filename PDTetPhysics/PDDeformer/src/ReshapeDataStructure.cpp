@@ -1,10 +1,11 @@
 #include <omp.h>
 
+#include "ArenaThreads.h"
 #include "ReshapeDataStructure.h"
 
 template<class T, int CoordinateStride>
 void unblockAddForce(const T* fReshapedBasePtr, const int* reshapeIndicesOffsets, const int* reshapeIndicesValues, const int nParticles, T* f) {
-    #pragma omp parallel for
+    #pragma omp parallel for num_threads(arenaThreads())
     for (int i = 0; i < nParticles; i++) {
         T fX = 0., fY = 0., fZ = 0.;
         const int* offsetPtr = &reshapeIndicesValues[reshapeIndicesOffsets[i]];
@@ -19,6 +20,24 @@ void unblockAddForce(const T* fReshapedBasePtr, const int* reshapeIndicesOffsets
     }
 }
 
+template<class T, int CoordinateStride>
+void unblockAddForce(const T* fReshapedBasePtr, const int* reshapeIndicesOffsets, const int* reshapeIndicesValues, const int* particles, const int nParticles, T* f) {
+    #pragma omp parallel for num_threads(arenaThreads())
+    for (int i = 0; i < nParticles; i++) {
+        T fX = 0., fY = 0., fZ = 0.;
+        const int* offsetPtr = &reshapeIndicesValues[reshapeIndicesOffsets[i]];
+        for (int j = reshapeIndicesOffsets[i]; j < reshapeIndicesOffsets[i+1]; j++, offsetPtr++){
+            fX += fReshapedBasePtr[*offsetPtr];
+            fY += fReshapedBasePtr[*offsetPtr + CoordinateStride];
+            fZ += fReshapedBasePtr[*offsetPtr + 2 * CoordinateStride];
+        }
+        const int p = particles[i];
+        f[3*p] += fX;
+        f[3*p + 1] += fY;
+        f[3*p + 2] += fZ;
+    }
+}
+
 template<class T, int CoordinateStride>
 void blockX(const T* X, const int* elementsPtr, const int nBlocks, T* XBasePtr) {
     // Assume everything in elementsPtr can access valid location in X without seg fault
@@ -27,7 +46,7 @@ void blockX(const T* X, const int* elementsPtr, const int nBlocks, T* XBasePtr)
     auto reshapeElements = reinterpret_cast<const int (*) [d+1][CoordinateStride]>(elementsPtr);
     auto XReshapedBasePtr = reinterpret_cast<T (*) [d+1][d][CoordinateStride]>(XBasePtr);
     
-    #pragma omp parallel for
+    #pragma omp parallel for num_threads(arenaThreads())
     for( int b = 0; b < nBlocks; b++ )
         for ( int v = 0; v < d+1; v++) {
             WideType xBlock = XReshapedBasePtr[b][v][0];
@@ -48,6 +67,12 @@ void unblockAddForce<float, 16>(const float* fReshapedBasePtr, const int* reshap
 template
 void unblockAddForce<double, 16>(const double* fReshapedBasePtr, const int* reshapeIndicesOffsets, const int* reshapeIndicesValues, const int nParticles, double* f);
 
+template
+void unblockAddForce<float, 16>(const float* fReshapedBasePtr, const int* reshapeIndicesOffsets, const int* reshapeIndicesValues, const int* particles, const int nParticles, float* f);
+
+template
+void unblockAddForce<double, 16>(const double* fReshapedBasePtr, const int* reshapeIndicesOffsets, const int* reshapeIndicesValues, const int* particles, const int nParticles, double* f);
+
 template
 void blockX<float, 16>(const float* X, const int* elementsPtr, const int nBlocks, float* XBasePtr);
 
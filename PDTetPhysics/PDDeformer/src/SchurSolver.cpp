@@ -1,5 +1,12 @@
 #include "SchurSolver.h"
 
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <tbb/parallel_for.h>
+#include <tbb/blocked_range.h>
+
 namespace PhysBAM {
     template<class Discretization, class IntType>
     inline void SchurSolver<Discretization, IntType>::initialize(const NodeArrayType& nodeType) {
@@ -33,216 +40,439 @@ namespace PhysBAM {
                 iterator.value(m_numbering) = numOfActiveNodes - schurSize + collisionIdx++;
             else
                 iterator.value(m_numbering) = -1;
-        m_tensor.clear();
-        m_tensor.resize(numOfActiveNodes);
+        m_tensorRowIndex.assign(numOfActiveNodes + 1, 0);
+        m_tensorColumn.clear();
+        m_tensorValue.clear();
+        m_constraintSlots.clear();
+        m_fakeSutureSlots.clear();
 
         if (!schurSize) {
 #if 0
             m_originalValue = new T[nnz];
             for (IntType i = 0; i < nnz; i++)
-                m_originalValue[i] = m_pardiso.value[i];
+                m_originalValue[i] = m_sparseSolver->value[i];
 #endif
         }
         else {
-            m_originalValue = new T[schurSize * schurSize];
-            m_schur = new T[schurSize * schurSize];
-            m_pardiso.schur = m_schur;
+            if (m_factSchur)
+                m_originalValue = new T[(size_t)schurSize * schurSize];
+            allocateSchur();
         }
 
-        m_rhs = new T[numOfActiveNodes];
-        m_x = new T[numOfActiveNodes]();
+        m_rhs = new T[numOfActiveNodes * d];
+        m_x = new T[numOfActiveNodes * d]();
     }
 
+
     template<class Discretization, class IntType>
     template<int elementNodesN>
-    inline void SchurSolver<Discretization, IntType>::
-        accumToTensor(const PhysBAM::MATRIX_MXN<T>& stiffnessMatrix, const std::array<IndexType, elementNodesN>& elementIndex) {
+    void SchurSolver<Discretization, IntType>::findSlots(IntType* const slots, const std::array<IndexType, elementNodesN>& elementIndex) const
+    {
         using IteratorType = Iterator<NodeArrayType>;
         for (int i = 0; i < elementNodesN; i++) {
-            int row = IteratorType::at(m_numbering, elementIndex[i]);
-            if (row >= 0) {
-                for (int j = 0; j < elementNodesN; j++) {
-                    int col = IteratorType::at(m_numbering, elementIndex[j]);
-                    if (col >= row) {
-                        if (m_tensor[row].find(col) == m_tensor[row].end())
-                            m_tensor[row].insert(std::pair<int, T>(col, stiffnessMatrix(i + 1, j + 1)));
-                        else
-                            m_tensor[row][col] += stiffnessMatrix(i + 1, j + 1);
-                    }
-                }
+            const int row = IteratorType::at(m_numbering, elementIndex[i]);
+            for (int j = 0; j < elementNodesN; j++) {
+                const int col = IteratorType::at(m_numbering, elementIndex[j]);
+                slots[i * elementNodesN + j] = -1;
+                if (row < 0 || col < row)
+                    continue;
+                const auto begin = m_tensorColumn.begin() + m_tensorRowIndex[row], end = m_tensorColumn.begin() + m_tensorRowIndex[row + 1];
+                const auto it = std::lower_bound(begin, end, (IntType)col);
+                if (it == end || *it != col)
+                    throw std::logic_error("entry (" + std::to_string(row) + " , " + std::to_string(col) + ") not found");
+                slots[i * elementNodesN + j] = (IntType)(it - m_tensorColumn.begin());
             }
         }
     }
 
-
-    template<class Discretization, class IntType>  // COURT added this debug subroutine to isolate Release only crash of physics thread
+    template<class Discretization, class IntType>
     template<int elementNodesN>
-    inline void SchurSolver<Discretization, IntType>::
-        accumToTensor_debug(const PhysBAM::MATRIX_MXN<T>& stiffnessMatrix, const std::array<IndexType, elementNodesN>& elementIndex) {
+    void SchurSolver<Discretization, IntType>::findSchurSlots(IntType* const slots, const std::array<IndexType, elementNodesN>& elementIndex) const
+    {
+        // only cared about upper triangular in row major
         using IteratorType = Iterator<NodeArrayType>;
+        const IntType offset = (IntType)m_tensorRowIndex.size() - 1 - schurSize;
         for (int i = 0; i < elementNodesN; i++) {
-            int row = IteratorType::at(m_numbering, elementIndex[i]);
-            if (row >= 0) {
-                for (int j = 0; j < elementNodesN; j++) {
-                    int col = IteratorType::at(m_numbering, elementIndex[j]);
-                    if (col >= row) {
-                        if (m_tensor[row].find(col) == m_tensor[row].end())
-//                            ;
-                            m_tensor[row].insert(std::pair<int, T>(col, stiffnessMatrix(i + 1, j + 1)));
-                        else
-                            m_tensor[row][col] += stiffnessMatrix(i + 1, j + 1);
-                    }
-                }
+            const int row = IteratorType::at(m_numbering, elementIndex[i]);
+            for (int j = 0; j < elementNodesN; j++) {
+                const int col = IteratorType::at(m_numbering, elementIndex[j]);
+                slots[i * elementNodesN + j] = -1;
+                if (row < 0 || col < row)
+                    continue;
+                assert(row >= offset);
+                slots[i * elementNodesN + j] = (row - offset) * schurSize + col - offset;
             }
         }
     }
 
+    template<class Discretization, class IntType>
+    template<class ConstraintType>
+    void SchurSolver<Discretization, IntType>::extendSlots(std::vector<std::array<IntType, elementNodes * elementNodes>>& slots, const std::vector<ConstraintType>& constraints, const bool schurBlock) const
+    {
+        // constraints are only appended between initialize() calls, so the slots found earlier stay valid
+        if (constraints.size() < slots.size())
+            slots.clear();
+        for (size_t c = slots.size(); c < constraints.size(); c++) {
+            slots.emplace_back();
+            if (schurBlock)
+                findSchurSlots<elementNodes>(slots.back().data(), constraints[c].m_elementIndex);
+            else
+                findSlots<elementNodes>(slots.back().data(), constraints[c].m_elementIndex);
+        }
+    }
 
-
- template<class Discretization, class IntType>
+    template<class Discretization, class IntType>
     template<int elementNodesN>
     inline void SchurSolver<Discretization, IntType>::
         updateTensor(
-           const PhysBAM::MATRIX_MXN<T>& stiffnessMatrix, 
+           const PhysBAM::MATRIX<T, elementNodesN>& stiffnessMatrix, 
           const std::array<IndexType, elementNodesN>& elementIndex) {
-        // only cared about upper triangular in row major
         //LOG::SCOPE scope("SchurSolver::updateTensor");
-        // TODO: think about sort the Indecies by numbering first; wether this will help with
-        // branch prediction
-        IntType& n = m_pardiso.n;
-        using IteratorType = Iterator<NodeArrayType>;
+        std::array<IntType, elementNodesN * elementNodesN> slots;
         if (schurSize) {
-            for (int i = 0; i < elementNodesN; i++) {
-                int row = IteratorType::at(m_numbering, elementIndex[i]);
-                if (row < 0)
-                    continue;
-
-                for (int j = 0; j < elementNodesN; j++) {
-                    int col = IteratorType::at(m_numbering, elementIndex[j]);
-                    if (col < row)
-                        continue;
-
-                    assert(row >= n - schurSize);
-                    m_pardiso.schur[(row - n + schurSize) * schurSize + col - n + schurSize] -= stiffnessMatrix(i + 1, j + 1);
-                }
-            }
+            findSchurSlots<elementNodesN>(slots.data(), elementIndex);
+            scatterTensor<elementNodesN>(m_sparseSolver->schur, slots.data(), stiffnessMatrix);
         }
         else {
-            for (int i = 0; i < elementNodesN; i++) {
-                int row = IteratorType::at(m_numbering, elementIndex[i]);
-                if (row < 0)
-                    continue;
+            findSlots<elementNodesN>(slots.data(), elementIndex);
+            scatterTensor<elementNodesN>(m_sparseSolver->value, slots.data(), stiffnessMatrix);
+        }
+    }
 
-                for (int j = 0; j < elementNodesN; j++) {
-                    int col = IteratorType::at(m_numbering, elementIndex[j]);
-                    if (col < row)
-                        continue;
-
-                    int index = -1;
-                    for (int k = m_pardiso.rowIndex[row]; k < m_pardiso.rowIndex[row + 1]; k++) {
-                        if (m_pardiso.column[k] == col) {
-                            index = k;
-                            break;
-                        }
+    template<class Discretization, class IntType>
+    void SchurSolver<Discretization, IntType>::buildTensorPattern(const std::vector<ElementType>& elements, const std::vector<Suture>& sutures, const std::vector<InternodeConstraint>& microNodes)
+    {
+        using IteratorType = Iterator<NodeArrayType>;
+        constexpr int elementEntries = elementNodes * elementNodes;
+        constexpr int sutureEntries = 4 * elementNodes * elementNodes;
+        constexpr int microNodeEntries = (d + 1) * (d + 1);
+        const IntType n = (IntType)m_tensorRowIndex.size() - 1;
+        m_sutureSourceStart = elements.size() * elementEntries;
+        m_microNodeSourceStart = m_sutureSourceStart + sutures.size() * sutureEntries;
+        const size_t sources = m_microNodeSourceStart + microNodes.size() * microNodeEntries;
+
+        // numbered row and column of a source, row is -1 when the entry is not stored
+        auto entry = [&](const size_t s, int& row, int& col) {
+            IndexType a, b;
+            if (s < m_sutureSourceStart) {
+                const ElementType& element = elements[s / elementEntries];
+                a = element[s % elementEntries / elementNodes];
+                b = element[s % elementNodes];
+            }
+            else if (s < m_microNodeSourceStart) {
+                const Suture& suture = sutures[(s - m_sutureSourceStart) / sutureEntries];
+                const int i = (s - m_sutureSourceStart) % sutureEntries / (2 * elementNodes), j = (s - m_sutureSourceStart) % (2 * elementNodes);
+                a = i < elementNodes ? suture.m_elementIndex1[i] : suture.m_elementIndex2[i - elementNodes];
+                b = j < elementNodes ? suture.m_elementIndex1[j] : suture.m_elementIndex2[j - elementNodes];
+            }
+            else {
+                const InternodeConstraint& microNode = microNodes[(s - m_microNodeSourceStart) / microNodeEntries];
+                const int i = (s - m_microNodeSourceStart) % microNodeEntries / (d + 1), j = (s - m_microNodeSourceStart) % (d + 1);
+                a = i < d ? microNode.m_macroNodes[i] : microNode.m_microNodeNumber;
+                b = j < d ? microNode.m_macroNodes[j] : microNode.m_microNodeNumber;
+            }
+            row = IteratorType::at(m_numbering, a);
+            col = IteratorType::at(m_numbering, b);
+            if (col < row)
+                row = -1;
+        };
+
+        // first pass counts the sources of each row, second pass buckets them by row
+        std::vector<std::atomic<IntType>> fill(n);
+        for (auto& f : fill)
+            f.store(0, std::memory_order_relaxed);
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, sources), [&](const tbb::blocked_range<size_t>& r) {
+            for (size_t s = r.begin(); s < r.end(); s++) {
+                int row, col;
+                entry(s, row, col);
+                if (row >= 0)
+                    fill[row].fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+        std::vector<IntType> bucketStart(n + 1, 0);
+        for (IntType i = 0; i < n; i++) {
+            bucketStart[i + 1] = bucketStart[i] + fill[i].load(std::memory_order_relaxed);
+            fill[i].store(bucketStart[i], std::memory_order_relaxed);
+        }
+        std::vector<std::pair<IntType, IntType>> bucket(bucketStart[n]); // (column, source)
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, sources), [&](const tbb::blocked_range<size_t>& r) {
+            for (size_t s = r.begin(); s < r.end(); s++) {
+                int row, col;
+                entry(s, row, col);
+                if (row >= 0)
+                    bucket[fill[row].fetch_add(1, std::memory_order_relaxed)] = std::make_pair((IntType)col, (IntType)s);
+            }
+        });
+
+        // sources sharing a column within a row become one CSR entry
+        std::vector<IntType> rowEntries(n, 0);
+        tbb::parallel_for(tbb::blocked_range<IntType>(0, n), [&](const tbb::blocked_range<IntType>& r) {
+            for (IntType i = r.begin(); i < r.end(); i++) {
+                std::sort(bucket.begin() + bucketStart[i], bucket.begin() + bucketStart[i + 1]);
+                for (IntType k = bucketStart[i]; k < bucketStart[i + 1]; k++)
+                    if (k == bucketStart[i] || bucket[k].first != bucket[k - 1].first)
+                        rowEntries[i]++;
+            }
+        });
+        m_tensorRowIndex[0] = 0;
+        for (IntType i = 0; i < n; i++)
+            m_tensorRowIndex[i + 1] = m_tensorRowIndex[i] + rowEntries[i];
+        const IntType nnz = m_tensorRowIndex[n];
+        m_tensorColumn.resize(nnz);
+        m_slotSourceStart.resize(nnz + 1);
+        m_slotSource.resize(bucket.size());
+        m_sourceSlot.assign(sources, -1);
+        tbb::parallel_for(tbb::blocked_range<IntType>(0, n), [&](const tbb::blocked_range<IntType>& r) {
+            for (IntType i = r.begin(); i < r.end(); i++) {
+                IntType slot = m_tensorRowIndex[i] - 1;
+                for (IntType k = bucketStart[i]; k < bucketStart[i + 1]; k++) {
+                    if (k == bucketStart[i] || bucket[k].first != bucket[k - 1].first) {
+                        slot++;
+                        m_tensorColumn[slot] = bucket[k].first;
+                        m_slotSourceStart[slot] = k;
                     }
+                    m_slotSource[k] = bucket[k].second;
+                    m_sourceSlot[bucket[k].second] = slot;
+                }
+            }
+        });
+        m_slotSourceStart[nnz] = (IntType)bucket.size();
+    }
 
-                    if (index == -1) {
-                        std::cerr << "cannot find the entry" << std::endl;
-                        exit(1);
-                    }
-                    else
-                        // stiffnessMatrix is negative definite
-                        m_pardiso.value[index] -= stiffnessMatrix(i + 1, j + 1);
+    template<class Discretization, class IntType>
+    template<class ElementTensorEntry>
+    void SchurSolver<Discretization, IntType>::gatherTensor(const std::vector<ElementType>& elements, const ElementTensorEntry& elementTensorEntry,
+        const std::vector<Suture>& sutures, const std::vector<InternodeConstraint>& microNodes)
+    {
+        // only include things that will change the sparsity of stiffness matrix, sutures and microNodes only add to the pattern here
+#if TIMING
+        auto startStamp = std::chrono::steady_clock::now();
+#endif
+        buildTensorPattern(elements, sutures, microNodes);
+#if TIMING
+        auto patternStamp = std::chrono::steady_clock::now();
+#endif
+
+        // each CSR entry gathers its element sources, so the assembly needs no locking
+        const size_t nnz = m_tensorColumn.size();
+        m_tensorValue.resize(nnz);
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, nnz), [&](const tbb::blocked_range<size_t>& r) {
+            for (size_t k = r.begin(); k < r.end(); k++) {
+                T value = 0;
+                for (IntType s = m_slotSourceStart[k]; s < m_slotSourceStart[k + 1]; s++)
+                    if ((size_t)m_slotSource[s] < m_sutureSourceStart)
+                        value -= elementTensorEntry((size_t)m_slotSource[s]);
+                m_tensorValue[k] = value;
+            }
+        });
+#if TIMING
+        auto endStamp = std::chrono::steady_clock::now();
+        std::chrono::duration<double> patternTime = patternStamp - startStamp, assemblyTime = endStamp - patternStamp;
+        LOG::cout << "        tensorPattern       Time : " << patternTime.count() << std::endl;
+        LOG::cout << "        assembleElTensor    Time : " << assemblyTime.count() << std::endl;
+#endif
+    }
+
+    template<class Discretization, class IntType>
+    template<class Coefficient>
+    void SchurSolver<Discretization, IntType>::assembleTensor(const std::vector<ElementType>& elements, const std::vector<GradientMatrixType>& gradients, const Coefficient& coefficient,
+        const std::vector<Suture>& sutures, const std::vector<InternodeConstraint>& microNodes)
+    {
+        constexpr int elementEntries = elementNodes * elementNodes;
+        m_elementTensor.resize(elements.size() * elementEntries);
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, elements.size()), [&](const tbb::blocked_range<size_t>& r) {
+            for (size_t e = r.begin(); e < r.end(); e++) {
+                ElementTensorType stiffnessMatrix;
+                DiscretizationType::computeElementTensor(stiffnessMatrix, gradients[e], coefficient(e));
+                for (int i = 0; i < elementNodes; i++)
+                    for (int j = 0; j < elementNodes; j++)
+                        m_elementTensor[e * elementEntries + i * elementNodes + j] = stiffnessMatrix(i + 1, j + 1);
+            }
+        });
+        gatherTensor(elements, [&](const size_t source) { return m_elementTensor[source]; }, sutures, microNodes);
+#ifdef TENSOR_ASSEMBLY_BENCHMARK
+        benchmarkTensorAssembly(elements, gradients);
+#endif
+    }
+
+    template<class Discretization, class IntType>
+    template<class Coefficient>
+    void SchurSolver<Discretization, IntType>::assembleShapeTensor(const std::vector<ElementType>& elements, const std::vector<uint8_t>& elementShape,
+        const std::vector<GradientMatrixType>& shapeGradients, const std::vector<T>& shapeRestVol, const Coefficient& coefficient,
+        const std::vector<Suture>& sutures, const std::vector<InternodeConstraint>& microNodes)
+    {
+        if (elementShape.size() != elements.size() || shapeGradients.size() != shapeRestVol.size())
+            throw std::logic_error("element shape table does not match the elements");
+        for (const auto shape : elementShape)
+            if (shape >= shapeGradients.size())
+                throw std::logic_error("element shape out of range");
+
+        // the element tensor is linear in its coefficient, so one template per shape, scaled per element while gathering
+        constexpr int elementEntries = elementNodes * elementNodes;
+        m_elementTensor.resize(shapeGradients.size() * elementEntries);
+        for (size_t s = 0; s < shapeGradients.size(); s++) {
+            ElementTensorType stiffnessMatrix;
+            DiscretizationType::computeElementTensor(stiffnessMatrix, shapeGradients[s], shapeRestVol[s]);
+            for (int i = 0; i < elementNodes; i++)
+                for (int j = 0; j < elementNodes; j++)
+                    m_elementTensor[s * elementEntries + i * elementNodes + j] = stiffnessMatrix(i + 1, j + 1);
+        }
+        gatherTensor(elements, [&](const size_t source) {
+            const size_t e = source / elementEntries;
+            return coefficient(e) * m_elementTensor[elementShape[e] * elementEntries + source % elementEntries];
+        }, sutures, microNodes);
+    }
+
+#ifdef TENSOR_ASSEMBLY_BENCHMARK
+    template<class Discretization, class IntType>
+    void SchurSolver<Discretization, IntType>::benchmarkTensorAssembly(const std::vector<ElementType>& elements, const std::vector<GradientMatrixType>& gradients) const
+    {
+        // computes every element tensor and scatters it into a scratch copy of the CSR values, serially,
+        // once through heap allocated MATRIX_MXN and once through the fixed size stack tensors
+        constexpr int elementEntries = elementNodes * elementNodes;
+        std::vector<T> values(m_tensorColumn.size());
+        auto scatter = [&](const size_t e, const auto& stiffnessMatrix) {
+            for (int i = 0; i < elementNodes; i++)
+                for (int j = 0; j < elementNodes; j++) {
+                    const IntType slot = m_sourceSlot[e * elementEntries + i * elementNodes + j];
+                    if (slot >= 0)
+                        values[slot] -= stiffnessMatrix(i + 1, j + 1);
+                }
+        };
+        double seconds[2];
+        T checksum[2];
+        for (int pass = 0; pass < 2; pass++) {
+            std::fill(values.begin(), values.end(), T(0));
+            auto start = std::chrono::steady_clock::now();
+            for (size_t e = 0; e < elements.size(); e++) {
+                if (pass == 0) {
+                    MATRIX_MXN<T> stiffnessMatrix;
+                    DiscretizationType::computeElementTensor(stiffnessMatrix, gradients[e], T(-1));
+                    scatter(e, stiffnessMatrix);
+                }
+                else {
+                    ElementTensorType stiffnessMatrix;
+                    DiscretizationType::computeElementTensor(stiffnessMatrix, gradients[e], T(-1));
+                    scatter(e, stiffnessMatrix);
                 }
             }
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            seconds[pass] = elapsed.count();
+            checksum[pass] = 0;
+            for (const T v : values)
+                checksum[pass] += std::abs(v);
         }
+        LOG::cout << "    tensor assembly of " << elements.size() << " elements" << std::endl;
+        LOG::cout << "        MATRIX_MXN   " << seconds[0] << " s  " << elements.size() / seconds[0] << " elements/s" << std::endl;
+        LOG::cout << "        fixed size   " << seconds[1] << " s  " << elements.size() / seconds[1] << " elements/s" << std::endl;
+        LOG::cout << "        relative checksum difference = " << std::abs(checksum[0] - checksum[1]) / checksum[0] << std::endl;
     }
+#endif
+
 
     template<class Discretization, class IntType>
     template<int elementNodesN>
-    void SchurSolver<Discretization, IntType>::accumToPardiso(const PhysBAM::MATRIX_MXN<T>& stiffnessMatrix, const std::array<IndexType, elementNodesN>& elementIndex)
+    void SchurSolver<Discretization, IntType>::addLowRankTerm(const std::array<IndexType, elementNodesN>& elementIndex, const std::array<T, elementNodesN>& weights, const T stiffness)
     {
-        // need to check if repeated entry matters or not
         using IteratorType = Iterator<NodeArrayType>;
         for (int i = 0; i < elementNodesN; i++) {
-            int row = IteratorType::at(m_numbering, elementIndex[i]);
-            if (row >= 0) {
-                //IntType idx = m_pardiso.rowIndex[row];
-                for (int j = 0; j < elementNodesN; j++) {
-                    int col = IteratorType::at(m_numbering, elementIndex[j]);
-                    if (col >= row) {
-                        bool found = false; // for debugging purposes
-                        // maybe binary search here?
-                        for (IntType jj = m_pardiso.rowIndex[row]; jj < m_pardiso.rowIndex[row + 1]; jj++)
-                            if (col == m_pardiso.column[jj]) {
-                                found = true;
-                                m_pardiso.value[jj] -= stiffnessMatrix(i + 1, j + 1);
-                            }
-                        if (!found) {
-                            std::cout << stiffnessMatrix << std::endl;
-                            std::cout << "index = [ ";
-                            for (int ii = 0; ii < elementNodesN; ii++)
-                                std::cout << elementIndex[ii] << " ";
-                            std::cout << "]" << std::endl;
-                            std::cout << "row = " << row << " col = " << col << std::endl;
-                            throw std::logic_error("entry (" + std::to_string(row) + " , " + std::to_string(col) + ") not found");
-                        }
-                        // if (m_tensor[row].find(col) == m_tensor[row].end())
-                        //     m_tensor[row].insert(std::pair<int, T>(col, stiffnessMatrix(i + 1, j + 1)));
-                        // else
-                        //     m_tensor[row][col] += stiffnessMatrix(i + 1, j + 1);
-                    }
-                }
+            const int row = IteratorType::at(m_numbering, elementIndex[i]);
+            if (row >= 0 && weights[i] != 0) {
+                m_lowRankRows.push_back(row);
+                m_lowRankWeights.push_back(weights[i]);
             }
         }
-
+        if ((int)m_lowRankRows.size() == m_lowRankStart.back())
+            return;
+        m_lowRankStart.push_back((int)m_lowRankRows.size());
+        m_lowRankStiffness.push_back(stiffness);
     }
 
-#if 1
     template<class Discretization, class IntType>
-    inline void SchurSolver<Discretization, IntType>::
-        updatePardiso(const std::vector<Constraint>& collisionConstraints,
-             const std::vector<CollisionSuture>& collisionSutures) {
-#ifndef _WIN32
-        LOG::SCOPE scope("SchurSolver::updatePardiso");
-#endif
-        const IntType& n = m_pardiso.n;
-        const IntType& nnz = m_pardiso.rowIndex[n];
-        if (schurSize)
-            for (int i = 0; i < schurSize * schurSize; i++)
-                m_pardiso.schur[i] = m_originalValue[i];
-        else
-            for (int i = 0; i < nnz; i++)
-                m_pardiso.value[i] = m_originalValue[i];
-
-        for (int c = 0; c < collisionConstraints.size(); c++) {
-            auto& constraint = collisionConstraints[c];
-            if (constraint.m_stiffness != 0) {
-                MATRIX_MXN<T> stiffnessMatrix;
-                DiscretizationType::computeConstraintTensor(stiffnessMatrix, constraint);
-                updateTensor<elementNodes>(stiffnessMatrix, constraint.m_elementIndex);
-            }
+    void SchurSolver<Discretization, IntType>::factorLowRank()
+    {
+        const IntType n = m_sparseSolver->n;
+        const int k = (int)m_lowRankStiffness.size();
+        m_lowRankZ.assign((size_t)n * k, T(0));
+
+        // the solver takes d right hand sides at a time
+        for (int first = 0; first < k; first += d) {
+            std::fill(m_rhs, m_rhs + n * d, T(0));
+            const int last = std::min(k, first + d);
+            for (int j = first; j < last; j++)
+                for (int e = m_lowRankStart[j]; e < m_lowRankStart[j + 1]; e++)
+                    m_rhs[(j - first) * n + m_lowRankRows[e]] += m_lowRankWeights[e];
+            m_sparseSolver->forwardSubstitution(m_rhs, m_x);
+            m_sparseSolver->diagSolve(m_x, m_rhs);
+            m_sparseSolver->backwardSubstitution(m_rhs, m_x);
+            std::copy(m_x, m_x + (size_t)n * (last - first), m_lowRankZ.begin() + (size_t)n * first);
         }
 
-        for (int c = 0; c < collisionSutures.size(); c++) 
-        if (collisionSutures[c].m_stiffness) {
-            MATRIX_MXN<T> stiffnessMatrix;
-            std::array<IndexType, elementNodes * 2> elementIndex;
-            //CollisionSuture tmp = collisionSutures[c];
-            //tmp.m_stiffness = 0;
-            DiscretizationType::computeCollisionSutureTensor(stiffnessMatrix, elementIndex, collisionSutures[c]);
-            updateTensor<elementNodes * 2>(stiffnessMatrix,
-                elementIndex);
+        m_lowRankLU.assign(k * k, T(0));
+        for (int i = 0; i < k; i++) {
+            for (int j = 0; j < k; j++) {
+                const T* z = m_lowRankZ.data() + (size_t)n * j;
+                T dot = 0;
+                for (int e = m_lowRankStart[i]; e < m_lowRankStart[i + 1]; e++)
+                    dot += m_lowRankWeights[e] * z[m_lowRankRows[e]];
+                m_lowRankLU[i * k + j] = m_lowRankStiffness[i] * dot;
+            }
+            m_lowRankLU[i * k + i] += T(1);
         }
 
-        if (schurSize) {
-            m_pardiso.factSchur();
+        // LU with partial pivoting, the matrix is not symmetric and deleted terms have negative stiffness
+        m_lowRankPivot.resize(k);
+        for (int c = 0; c < k; c++) {
+            int p = c;
+            for (int r = c + 1; r < k; r++)
+                if (std::abs(m_lowRankLU[r * k + c]) > std::abs(m_lowRankLU[p * k + c]))
+                    p = r;
+            m_lowRankPivot[c] = p;
+            if (p != c)
+                for (int j = 0; j < k; j++)
+                    std::swap(m_lowRankLU[c * k + j], m_lowRankLU[p * k + j]);
+            if (m_lowRankLU[c * k + c] == 0)
+                throw std::logic_error("singular low rank update");
+            for (int r = c + 1; r < k; r++) {
+                const T l = m_lowRankLU[r * k + c] /= m_lowRankLU[c * k + c];
+                for (int j = c + 1; j < k; j++)
+                    m_lowRankLU[r * k + j] -= l * m_lowRankLU[c * k + j];
+            }
         }
-        else {
-            m_pardiso.factorize();                      
+    }
+
+    template<class Discretization, class IntType>
+    void SchurSolver<Discretization, IntType>::correctLowRank() const
+    {
+        const IntType n = m_sparseSolver->n;
+        const int k = (int)m_lowRankStiffness.size();
+        std::vector<T> s(k);
+        for (int v = 0; v < d; v++) {
+            T* x = m_x + (size_t)v * n;
+            for (int i = 0; i < k; i++) {
+                T dot = 0;
+                for (int e = m_lowRankStart[i]; e < m_lowRankStart[i + 1]; e++)
+                    dot += m_lowRankWeights[e] * x[m_lowRankRows[e]];
+                s[i] = m_lowRankStiffness[i] * dot;
+            }
+            for (int i = 0; i < k; i++) {
+                std::swap(s[i], s[m_lowRankPivot[i]]);
+                for (int j = 0; j < i; j++)
+                    s[i] -= m_lowRankLU[i * k + j] * s[j];
+            }
+            for (int i = k - 1; i >= 0; i--) {
+                for (int j = i + 1; j < k; j++)
+                    s[i] -= m_lowRankLU[i * k + j] * s[j];
+                s[i] /= m_lowRankLU[i * k + i];
+            }
+            for (int j = 0; j < k; j++) {
+                const T* z = m_lowRankZ.data() + (size_t)n * j;
+                for (IntType r = 0; r < n; r++)
+                    x[r] -= s[j] * z[r];
+            }
         }
     }
-#endif
+
 
     template<class Discretization, class IntType>
     inline void SchurSolver<Discretization, IntType>::
@@ -253,75 +483,10 @@ namespace PhysBAM {
             const std::vector<Suture>& sutures,
             const std::vector<InternodeConstraint>& microNodes
         ) {
-#if TIMING
-        auto startStamp = std::chrono::steady_clock::now();
-        auto endStamp = std::chrono::steady_clock::now();
-        std::chrono::duration<double> elapsed_second;
-        double computeElTensorTime = 0;
-        double accumElTensorTime = 0;
-#endif
-
-        for (int e = 0; e < elements.size(); e++) {
-            MATRIX_MXN<T> stiffnessMatrix;
-#if TIMING
-            startStamp = std::chrono::steady_clock::now();
-#endif
-            DiscretizationType::computeElementTensor(stiffnessMatrix, gradients[e], -2 * mu * restVol[e]);
-#if TIMING
-            endStamp = std::chrono::steady_clock::now();
-            elapsed_second = endStamp - startStamp;
-            computeElTensorTime += elapsed_second.count();
-
-            startStamp = std::chrono::steady_clock::now();
-#endif
-            accumToTensor<elementNodes>(stiffnessMatrix, DiscretizationType::getElementIndex(elements[e]));
-#if TIMING
-            endStamp = std::chrono::steady_clock::now();
-            elapsed_second = endStamp - startStamp;
-            accumElTensorTime += elapsed_second.count();
-#endif
-        }
-#if TIMING
-        LOG::cout << "        computeElTensor     Time : " << computeElTensorTime << std::endl;
-        LOG::cout << "        accumElTensor       Time : " << accumElTensorTime << std::endl;
-#endif
-#if 0
-
-        for (int c = 0; c < constraints.size(); c++) {
-            MATRIX_MXN<T> stiffnessMatrix;
-            DiscretizationType::computeConstraintTensor(stiffnessMatrix, constraints[c]);
-
-            accumToTensor<elementNodes>(stiffnessMatrix,
-                constraints[c].m_elementIndex);
-        }
-#endif
-
-        for (int c = 0; c < sutures.size(); c++) {
-            MATRIX_MXN<T> stiffnessMatrix;
-            std::array<IndexType, elementNodes * 2> elementIndex;
-            Suture tmp = sutures[c];
-            tmp.m_stiffness = 0;
-            DiscretizationType::computeSutureTensor(stiffnessMatrix, elementIndex, tmp);
-            accumToTensor<elementNodes * 2>(stiffnessMatrix,
-                elementIndex);
-        }
-
-        std::cout << "About to add microNode constraints in computeTensor()\n";  // COURT debug
-
-        for (const auto& c : microNodes) {
-            MATRIX_MXN<T> stiffnessMatrix;
-            std::array<IndexType, d + 1> elementIndex;
-            auto tmp = c;
-            tmp.m_stiffness = 0;
-            DiscretizationType::computeMicroNodeTensor(stiffnessMatrix, elementIndex, tmp);
-            accumToTensor_debug<d + 1>(stiffnessMatrix,
-                elementIndex);  // COURT created this routine to isolate Release only exception in accumToTensor()
-        }
-
-        std::cout << "Accumulated microNode constraints in computeTensor()\n";  // COURT debug
-
+        assembleTensor(elements, gradients, [&](const size_t e) { return -2 * mu * restVol[e]; }, sutures, microNodes);
     }
 
+
     template<class Discretization, class IntType>
     void SchurSolver<Discretization, IntType>::computeTensor(const std::vector<ElementType>& elements, 
         const std::vector<GradientMatrixType>& gradients, 
@@ -331,65 +496,31 @@ namespace PhysBAM {
         const std::vector<Suture>& sutures,
         const std::vector<InternodeConstraint>& microNodes)
     {
-        // only include things that will change the sparsity of stiffness matrix
-
-#if TIMING
-        auto startStamp = std::chrono::steady_clock::now();
-        auto endStamp = std::chrono::steady_clock::now();
-        std::chrono::duration<double> elapsed_second;
-        double computeElTensorTime = 0;
-        double accumElTensorTime = 0;
-#endif
-
-        for (int e = 0; e < elements.size(); e++) {
-            MATRIX_MXN<T> stiffnessMatrix;
-
-#if TIMING
-            startStamp = std::chrono::steady_clock::now();
-#endif
-            DiscretizationType::computeElementTensor(stiffnessMatrix, gradients[e], -2 * (muLow[e] + muHigh[e]) * restVol[e]); // computeElementTensor
-#if TIMING
-            endStamp = std::chrono::steady_clock::now();
-            elapsed_second = endStamp - startStamp;
-            computeElTensorTime += elapsed_second.count();
-
-            startStamp = std::chrono::steady_clock::now();
-#endif
-            accumToTensor<elementNodes>(stiffnessMatrix, DiscretizationType::getElementIndex(elements[e])); // accumToTensor
-
-#if TIMING
-            endStamp = std::chrono::steady_clock::now();
-            elapsed_second = endStamp - startStamp;
-            accumElTensorTime += elapsed_second.count();
-#endif
-        }
-
-#if TIMING
-        LOG::cout << "        computeElTensor     Time : " << computeElTensorTime << std::endl;
-        LOG::cout << "        accumElTensor       Time : " << accumElTensorTime << std::endl;
-#endif
-
-        // It seems that I don't actually need to compute the matrix here, just need the sparsity
-        for (int c = 0; c < sutures.size(); c++) {
-            MATRIX_MXN<T> stiffnessMatrix;
-            std::array<IndexType, elementNodes * 2> elementIndex;
-            Suture tmp = sutures[c];
-            tmp.m_stiffness = 0;
-            DiscretizationType::computeSutureTensor(stiffnessMatrix, elementIndex, tmp);
-            accumToTensor<elementNodes * 2>(stiffnessMatrix,
-                elementIndex);
-        }
+        assembleTensor(elements, gradients, [&](const size_t e) { return -2 * (muLow[e] + muHigh[e]) * restVol[e]; }, sutures, microNodes); // computeElementTensor
+    }
 
-        for (const auto& c:microNodes) {
-            MATRIX_MXN<T> stiffnessMatrix;
-            std::array<IndexType, d+1> elementIndex;
-            auto tmp = c;
-            tmp.m_stiffness = 0;
-            DiscretizationType::computeMicroNodeTensor(stiffnessMatrix, elementIndex, tmp);
-            accumToTensor_debug<d+1>(stiffnessMatrix,
-                elementIndex);
-        }
+    template<class Discretization, class IntType>
+    void SchurSolver<Discretization, IntType>::computeTensor(const std::vector<ElementType>& elements,
+        const std::vector<uint8_t>& elementShape,
+        const std::vector<GradientMatrixType>& shapeGradients,
+        const std::vector<T>& shapeRestVol, const T mu,
+        const std::vector<Suture>& sutures,
+        const std::vector<InternodeConstraint>& microNodes)
+    {
+        assembleShapeTensor(elements, elementShape, shapeGradients, shapeRestVol, [&](size_t) { return -2 * mu; }, sutures, microNodes);
+    }
 
+    template<class Discretization, class IntType>
+    void SchurSolver<Discretization, IntType>::computeTensor(const std::vector<ElementType>& elements,
+        const std::vector<uint8_t>& elementShape,
+        const std::vector<GradientMatrixType>& shapeGradients,
+        const std::vector<T>& shapeRestVol,
+        const std::vector<T>& muLow,
+        const std::vector<T>& muHigh,
+        const std::vector<Suture>& sutures,
+        const std::vector<InternodeConstraint>& microNodes)
+    {
+        assembleShapeTensor(elements, elementShape, shapeGradients, shapeRestVol, [&](const size_t e) { return -2 * (muLow[e] + muHigh[e]); }, sutures, microNodes);
     }
 
 
@@ -401,94 +532,135 @@ namespace PhysBAM {
         const std::vector<InternodeConstraint>& microNodes
     ) {
 
-        IntType nnz = 0;
-        for (int i = 0; i < m_tensor.size(); i++)
-            nnz += (IntType)m_tensor[i].size();
+        clearLowRank();
+        const IntType n = (IntType)m_tensorRowIndex.size() - 1;
+        const IntType nnz = (IntType)m_tensorColumn.size();
 
         LOG::cout << "nnz = " << nnz << std::endl;
-        m_pardiso.initialize((IntType)m_tensor.size(), nnz, schurSize);
-
-        m_pardiso.rowIndex[0] = 0;
-        for (int i = 0; i < m_pardiso.n; i++)
-            m_pardiso.rowIndex[i + 1] = m_pardiso.rowIndex[i] + (IntType)m_tensor[i].size();
-
-        // const IntType& n = m_pardiso.n;
-
-        size_t idx = 0;
-        for (const auto& r : m_tensor)
-            for (const auto& e : r) {
-                m_pardiso.column[idx] = e.first;
-                //m_pardiso.value[idx] = -e.second;
-                idx++;
-            }
+        m_sparseSolver->initialize(n, nnz, schurSize, d);
+        std::copy(m_tensorRowIndex.begin(), m_tensorRowIndex.end(), m_sparseSolver->rowIndex);
+        std::copy(m_tensorColumn.begin(), m_tensorColumn.end(), m_sparseSolver->column);
 
         if (schurSize)
-            m_pardiso.schur = m_schur;
-        m_pardiso.symbolicFact();
+            m_sparseSolver->schur = m_schur;
+        m_sparseSolver->symbolicFact();
 
         factPardiso(constraints, sutures, fakeSutures, microNodes);
 
-        if (schurSize) {
-            for (IntType i = 0; i < schurSize * schurSize; i++)
-                m_originalValue[i] = m_pardiso.schur[i];
-            m_pardiso.factSchur();
+        if (schurSize && m_factSchur) {
+            std::copy(m_sparseSolver->schur, m_sparseSolver->schur + (size_t)schurSize * schurSize, m_originalValue);
+            m_sparseSolver->factSchur();
+        }
+#if defined(SPARSE_SOLVER_BENCHMARK) && !defined(NO_MKL)
+        benchmarkSparseSolvers();
+#endif
+
+    }
+
+#if defined(SPARSE_SOLVER_BENCHMARK) && !defined(NO_MKL)
+    template<class Discretization, class IntType>
+    void SchurSolver<Discretization, IntType>::benchmarkSparseSolvers() const
+    {
+        // factors the current system matrix with every backend and solves d pseudo random right hand sides
+        const IntType n = m_sparseSolver->n;
+        const IntType nnz = m_sparseSolver->rowIndex[n];
+        std::vector<T> rhs(n * d), solution[2];
+        for (IntType i = 0; i < n * d; i++)
+            rhs[i] = std::sin(T(0.37) * i);
+
+        const char* names[2] = { "Pardiso", "Supernodal" };
+        for (int b = 0; b < 2; b++) {
+            std::unique_ptr<SparseSolver<T, IntType>> solver;
+            if (b == 0)
+                solver.reset(new PardisoWrapper<T, IntType>);
+            else
+                solver.reset(new SupernodalCholesky<T, IntType>);
+            solver->initialize(n, nnz, schurSize, d);
+            std::copy(m_sparseSolver->rowIndex, m_sparseSolver->rowIndex + n + 1, solver->rowIndex);
+            std::copy(m_sparseSolver->column, m_sparseSolver->column + nnz, solver->column);
+            std::copy(m_sparseSolver->value, m_sparseSolver->value + nnz, solver->value);
+            std::vector<T> schur(schurSize * schurSize), b1(rhs), b2(n * d);
+            solver->schur = schurSize ? schur.data() : nullptr;
+            solution[b].resize(n * d);
+
+            auto start = std::chrono::steady_clock::now();
+            solver->symbolicFact();
+            auto symbolic = std::chrono::steady_clock::now();
+            solver->numericFact();
+            solver->factSchur();
+            auto numeric = std::chrono::steady_clock::now();
+            solver->forwardSubstitution(b1.data(), b2.data());
+            solver->diagSolve(b2.data(), b1.data());
+            solver->backwardSubstitution(b1.data(), solution[b].data());
+            auto end = std::chrono::steady_clock::now();
+
+            std::chrono::duration<double> symbolicTime = symbolic - start, numericTime = numeric - symbolic, solveTime = end - numeric;
+            LOG::cout << "    " << names[b] << " n = " << n << " nnz = " << nnz << " schur = " << schurSize
+                << "  symbolic " << symbolicTime.count() << " s  numeric " << numericTime.count() << " s  solve " << solveTime.count() << " s" << std::endl;
+            solver->releaseInternal();
+            solver->deallocate();
         }
 
-        // m_tensor.resize(0);
+        T maxDifference = 0, maxValue = 0;
+        for (IntType i = 0; i < n * d; i++) {
+            maxDifference = std::max(maxDifference, std::abs(solution[0][i] - solution[1][i]));
+            maxValue = std::max(maxValue, std::abs(solution[0][i]));
+        }
+        LOG::cout << "    relative difference of solutions = " << maxDifference / maxValue << std::endl;
     }
+#endif
 
     template<class Discretization, class IntType>
     void SchurSolver<Discretization, IntType>::factPardiso(const std::vector<Constraint>& constraints, const std::vector<Suture>& sutures, const std::vector<Constraint>& fakeSutures, const std::vector<InternodeConstraint>& microNodes)
     {
-        size_t idx = 0;
-        for (const auto& r : m_tensor)
-            for (const auto& e : r) {
-                m_pardiso.value[idx] = -e.second;
-                idx++;
-            }
-        // dumper::writeCSRbyte(m_pardiso.n, m_pardiso.rowIndex, m_pardiso.column, m_pardiso.value, m_pardiso.n, "orig_i.txt", "orig_a.txt");
+        constexpr int sutureEntries = 4 * elementNodes * elementNodes;
+        constexpr int microNodeEntries = (d + 1) * (d + 1);
+        if (m_sutureSourceStart + sutures.size() * sutureEntries != m_microNodeSourceStart || m_microNodeSourceStart + microNodes.size() * microNodeEntries != m_sourceSlot.size())
+            throw std::logic_error("sutures or microNodes changed since computeTensor()");
+
+        T* const value = m_sparseSolver->value;
+        std::copy(m_tensorValue.begin(), m_tensorValue.end(), value);
+        // dumper::writeCSRbyte(m_sparseSolver->n, m_sparseSolver->rowIndex, m_sparseSolver->column, m_sparseSolver->value, m_sparseSolver->n, "orig_i.txt", "orig_a.txt");
 
+        extendSlots(m_constraintSlots, constraints, false);
         for (int c = 0; c < constraints.size(); c++)
             if (constraints[c].m_stiffness != 0) {
-                MATRIX_MXN<T> stiffnessMatrix;
+                ElementTensorType stiffnessMatrix;
                 DiscretizationType::computeConstraintTensor(stiffnessMatrix, constraints[c]);
-                accumToPardiso<elementNodes>(stiffnessMatrix,
-                    constraints[c].m_elementIndex);
+                scatterTensor<elementNodes>(value, m_constraintSlots[c].data(), stiffnessMatrix);
             }
 
+        extendSlots(m_fakeSutureSlots, fakeSutures, false);
         for (int c = 0; c < fakeSutures.size(); c++)
             if (fakeSutures[c].m_stiffness != 0) {
-                MATRIX_MXN<T> stiffnessMatrix;
+                ElementTensorType stiffnessMatrix;
                 DiscretizationType::computeConstraintTensor(stiffnessMatrix, fakeSutures[c]);
-                accumToPardiso<elementNodes>(stiffnessMatrix,
-                    fakeSutures[c].m_elementIndex);
+                scatterTensor<elementNodes>(value, m_fakeSutureSlots[c].data(), stiffnessMatrix);
             }
 
         for (int c = 0; c < sutures.size(); c++)
             if (sutures[c].m_stiffness != 0) {
-                MATRIX_MXN<T> stiffnessMatrix;
+                SutureTensorType stiffnessMatrix;
                 std::array<IndexType, elementNodes * 2> elementIndex;
                 DiscretizationType::computeSutureTensor(stiffnessMatrix, elementIndex, sutures[c]);
-                accumToPardiso<elementNodes * 2>(stiffnessMatrix,
-                    elementIndex);
+                scatterTensor<elementNodes * 2>(value, m_sourceSlot.data() + m_sutureSourceStart + c * sutureEntries, stiffnessMatrix);
             }
 #if 1
-        for (const auto& c:microNodes)
-            if (c.m_stiffness != 0) {
-                MATRIX_MXN<T> stiffnessMatrix;
+        for (int c = 0; c < microNodes.size(); c++)
+            if (microNodes[c].m_stiffness != 0) {
+                ElementTensorType stiffnessMatrix;
                 std::array<IndexType, d+1> elementIndex;
-                DiscretizationType::computeMicroNodeTensor(stiffnessMatrix, elementIndex, c);
-                accumToPardiso<d+1>(stiffnessMatrix,
-                    elementIndex);
+                DiscretizationType::computeMicroNodeTensor(stiffnessMatrix, elementIndex, microNodes[c]);
+                scatterTensor<d+1>(value, m_sourceSlot.data() + m_microNodeSourceStart + c * microNodeEntries, stiffnessMatrix);
             }
 #endif
-        // dumper::writeCSRbyte(m_pardiso.n, m_pardiso.rowIndex, m_pardiso.column, m_pardiso.value, m_pardiso.n, "new_i.txt", "new_a.txt");
+        // dumper::writeCSRbyte(m_sparseSolver->n, m_sparseSolver->rowIndex, m_sparseSolver->column, m_sparseSolver->value, m_sparseSolver->n, "new_i.txt", "new_a.txt");
 
-        m_pardiso.numericFact();
+        m_sparseSolver->numericFact();
         /*
         if (schurSize) {
             for (IntType i = 0; i < schurSize * schurSize; i++)
-                m_Sigma1[i] = m_pardiso.schur[i] - m_A22[i];
+                m_Sigma1[i] = m_sparseSolver->schur[i] - m_A22[i];
         }
         */
     }
@@ -497,4 +669,6 @@ namespace PhysBAM {
 
 namespace PhysBAM {
     template struct SchurSolver<TetrahedralDiscretization<std::vector<VECTOR<float, 3>>>, int>;
+    template void SchurSolver<TetrahedralDiscretization<std::vector<VECTOR<float, 3>>>, int>::addLowRankTerm<4>(const std::array<int, 4>&, const std::array<float, 4>&, const float);
+    template void SchurSolver<TetrahedralDiscretization<std::vector<VECTOR<float, 3>>>, int>::addLowRankTerm<8>(const std::array<int, 8>&, const std::array<float, 8>&, const float);
 }
@@ -0,0 +1,796 @@
+//#####################################################################
+// Copyright (c) 2019, Eftychios Sifakis, Yutian Tao, Qisi Wang
+// Distributed under the FreeBSD license (see license.txt)
+//#####################################################################
+
+#include "SupernodalCholesky.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <stdexcept>
+#include <tbb/parallel_for.h>
+#include <tbb/blocked_range.h>
+
+namespace {
+    // below this many multiply-adds dense supernode kernels run serially
+    constexpr size_t parallelWork = 1 << 16;
+    constexpr int panelWidth = 32;
+
+    template <class IntType, class Func>
+    inline void forColumns(const IntType begin, const IntType end, const size_t work, const Func& func) {
+        if (end <= begin)
+            return;
+        if (work < parallelWork)
+            func(begin, end);
+        else
+            tbb::parallel_for(tbb::blocked_range<IntType>(begin, end), [&](const tbb::blocked_range<IntType>& r) {
+                func(r.begin(), r.end());
+            });
+    }
+
+    template <class IntType, class Func>
+    inline void forChildren(const IntType* children, const IntType nChildren, const Func& func) {
+        if (nChildren == 1)
+            func(children[0]);
+        else if (nChildren > 1)
+            tbb::parallel_for(tbb::blocked_range<IntType>(0, nChildren, 1), [&](const tbb::blocked_range<IntType>& r) {
+                for (IntType c = r.begin(); c < r.end(); c++)
+                    func(children[c]);
+            });
+    }
+}
+
+template<class T, class IntType>
+void SupernodalCholesky<T, IntType>::initialize(const IntType _n, const IntType _nnz, const IntType _m, const int _nrhs) {
+    n = _n;
+    m = (int)_m;
+    nrhs = _nrhs;
+
+    // allocate spaces
+    rowIndex = new IntType[n + 1];
+    column = new IntType[_nnz];
+    value = new T[_nnz];
+}
+
+template<class T, class IntType>
+void SupernodalCholesky<T, IntType>::factSchur() {
+    // in place upper triangular factorization schur = U^T U, row major
+    for (int k = 0; k < m; k++) {
+        T* Uk = schur + (size_t)k * m;
+        if (!(Uk[k] > T(0))) {
+            std::cout << "non positive pivot in Schur complement factorization at row " << std::to_string(k) << std::endl;
+            return;
+        }
+        const T d = std::sqrt(Uk[k]);
+        Uk[k] = d;
+        for (int j = k + 1; j < m; j++)
+            Uk[j] /= d;
+        for (int i = k + 1; i < m; i++) {
+            T* Ui = schur + (size_t)i * m;
+            const T f = Uk[i];
+            for (int j = i; j < m; j++)
+                Ui[j] -= f * Uk[j];
+        }
+    }
+}
+
+template<class T, class IntType>
+void SupernodalCholesky<T, IntType>::nestedDissection(const std::vector<IntType>& adjStart, const std::vector<IntType>& adj) {
+    // Recursive graph bisection with breadth first level structures rooted at a pseudo peripheral node.
+    // The middle level is the vertex separator and is ordered after both halves.
+    const IntType n1 = m_eliminated;
+    constexpr IntType leafSize = 64;
+
+    m_perm.resize(n);
+    for (IntType i = n1; i < n; i++)
+        m_perm[i] = i;
+
+    struct Part {
+        IntType id;
+        IntType lo;
+        std::vector<IntType> nodes;
+    };
+
+    std::vector<IntType> label(n1, 0), level(n1, -1), stamp(n1, -1), queue;
+    queue.reserve(n1);
+    IntType nBfs = 0;
+
+    // breadth first search restricted to nodes labelled id, returns the number of levels
+    auto bfs = [&](const IntType root, const IntType id) -> IntType {
+        queue.clear();
+        queue.push_back(root);
+        stamp[root] = nBfs;
+        level[root] = 0;
+        for (size_t q = 0; q < queue.size(); q++) {
+            const IntType v = queue[q];
+            for (IntType k = adjStart[v]; k < adjStart[v + 1]; k++) {
+                const IntType u = adj[k];
+                if (label[u] == id && stamp[u] != nBfs) {
+                    stamp[u] = nBfs;
+                    level[u] = level[v] + 1;
+                    queue.push_back(u);
+                }
+            }
+        }
+        nBfs++;
+        return level[queue.back()] + 1;
+    };
+
+    std::vector<Part> stack(1);
+    stack[0].id = 0;
+    stack[0].lo = 0;
+    stack[0].nodes.resize(n1);
+    for (IntType i = 0; i < n1; i++)
+        stack[0].nodes[i] = i;
+    IntType nextId = 1;
+
+    while (!stack.empty()) {
+        Part part = std::move(stack.back());
+        stack.pop_back();
+        const IntType size = (IntType)part.nodes.size();
+        if (size <= leafSize) {
+            for (IntType t = 0; t < size; t++)
+                m_perm[part.lo + t] = part.nodes[t];
+            continue;
+        }
+
+        // disconnected parts are split into their components first
+        IntType nLevels = bfs(part.nodes[0], part.id);
+        if ((IntType)queue.size() < size) {
+            IntType lo = part.lo;
+            for (const IntType root : part.nodes) {
+                if (label[root] != part.id)
+                    continue;
+                if (root != part.nodes[0])
+                    bfs(root, part.id);
+                Part component{ nextId++, lo, queue };
+                for (const IntType v : component.nodes)
+                    label[v] = component.id;
+                lo += (IntType)queue.size();
+                stack.push_back(std::move(component));
+            }
+            continue;
+        }
+
+        // pseudo peripheral root, keeps the level structure of the last search
+        for (int iter = 0; iter < 8; iter++) {
+            IntType candidate = queue.back(), minDegree = adjStart[candidate + 1] - adjStart[candidate];
+            for (auto it = queue.rbegin(); it != queue.rend() && level[*it] == nLevels - 1; ++it) {
+                const IntType degree = adjStart[*it + 1] - adjStart[*it];
+                if (degree < minDegree) {
+                    minDegree = degree;
+                    candidate = *it;
+                }
+            }
+            const IntType candidateLevels = bfs(candidate, part.id);
+            if (candidateLevels <= nLevels)
+                break;
+            nLevels = candidateLevels;
+        }
+
+        if (nLevels < 3) {
+            for (IntType t = 0; t < size; t++)
+                m_perm[part.lo + t] = part.nodes[t];
+            continue;
+        }
+
+        std::vector<IntType> levelCount(nLevels, 0);
+        for (const IntType v : queue)
+            levelCount[level[v]]++;
+        // smallest level leaving at least 40% of the part on both sides, otherwise the median level
+        IntType separatorLevel = -1, medianLevel = -1, below = 0;
+        for (IntType l = 1; l < nLevels - 1; l++) {
+            below += levelCount[l - 1];
+            const IntType above = size - below - levelCount[l];
+            if (medianLevel == -1 && below + levelCount[l] > size / 2)
+                medianLevel = l;
+            if (below * 5 >= size * 2 && above * 5 >= size * 2 && (separatorLevel == -1 || levelCount[l] < levelCount[separatorLevel]))
+                separatorLevel = l;
+        }
+        if (separatorLevel == -1)
+            separatorLevel = medianLevel == -1 ? nLevels - 2 : medianLevel;
+
+        Part a{ nextId++, part.lo, {} }, b{ nextId++, 0, {} };
+        std::vector<IntType> separator;
+        for (const IntType v : queue) {
+            const IntType l = level[v];
+            if (l < separatorLevel)
+                a.nodes.push_back(v);
+            else if (l > separatorLevel)
+                b.nodes.push_back(v);
+            else {
+                // separator nodes without a neighbor beyond the separator can join the first half
+                bool touchesB = false;
+                for (IntType k = adjStart[v]; k < adjStart[v + 1] && !touchesB; k++)
+                    touchesB = label[adj[k]] == part.id && level[adj[k]] == separatorLevel + 1;
+                if (touchesB)
+                    separator.push_back(v);
+                else
+                    a.nodes.push_back(v);
+            }
+        }
+        b.lo = part.lo + (IntType)a.nodes.size();
+        const IntType separatorLo = b.lo + (IntType)b.nodes.size();
+        for (size_t t = 0; t < separator.size(); t++)
+            m_perm[separatorLo + t] = separator[t];
+        for (const IntType v : a.nodes)
+            label[v] = a.id;
+        for (const IntType v : b.nodes)
+            label[v] = b.id;
+        stack.push_back(std::move(a));
+        stack.push_back(std::move(b));
+    }
+}
+
+template<class T, class IntType>
+void SupernodalCholesky<T, IntType>::eliminationTree(const std::vector<IntType>& adjStart, const std::vector<IntType>& adj, std::vector<IntType>& parent) const {
+    const IntType n1 = m_eliminated;
+    std::vector<IntType> ancestor(n1, -1);
+    parent.assign(n1, -1);
+    for (IntType k = 0; k < n1; k++)
+        for (IntType kk = adjStart[k]; kk < adjStart[k + 1]; kk++)
+            for (IntType i = adj[kk]; i != -1 && i < k;) {
+                const IntType next = ancestor[i];
+                ancestor[i] = k;
+                if (next == -1)
+                    parent[i] = k;
+                i = next;
+            }
+}
+
+template<class T, class IntType>
+void SupernodalCholesky<T, IntType>::symbolicFact() {
+    if (this->patternUnchanged())
+        return; // ordering, supernodes and value map still apply
+    this->clearAnalyzedPattern();
+
+    const IntType n1 = n - m;
+    m_eliminated = n1;
+
+    // graph of the eliminated block, both triangles, and the coupling of each eliminated node to Schur nodes
+    std::vector<IntType> adjStart(n1 + 1, 0), couplingStart(n1 + 1, 0);
+    for (IntType i = 0; i < n; i++)
+        for (IntType k = rowIndex[i]; k < rowIndex[i + 1]; k++) {
+            const IntType j = column[k];
+            if (j == i)
+                continue;
+            if (j < n1) {
+                adjStart[i + 1]++;
+                adjStart[j + 1]++;
+            }
+            else if (i < n1)
+                couplingStart[i + 1]++;
+        }
+    for (IntType i = 0; i < n1; i++) {
+        adjStart[i + 1] += adjStart[i];
+        couplingStart[i + 1] += couplingStart[i];
+    }
+    std::vector<IntType> adj(adjStart[n1]), coupling(couplingStart[n1]);
+    {
+        std::vector<IntType> adjFill(adjStart.begin(), adjStart.end() - 1), couplingFill(couplingStart.begin(), couplingStart.end() - 1);
+        for (IntType i = 0; i < n; i++)
+            for (IntType k = rowIndex[i]; k < rowIndex[i + 1]; k++) {
+                const IntType j = column[k];
+                if (j == i)
+                    continue;
+                if (j < n1) {
+                    adj[adjFill[i]++] = j;
+                    adj[adjFill[j]++] = i;
+                }
+                else if (i < n1)
+                    coupling[couplingFill[i]++] = j;
+            }
+    }
+
+    nestedDissection(adjStart, adj);
+
+    std::vector<IntType> padjStart(n1 + 1), padj(adj.size());
+    auto permute = [&]() {
+        m_iperm.resize(n);
+        for (IntType i = 0; i < n; i++)
+            m_iperm[m_perm[i]] = i;
+        padjStart[0] = 0;
+        for (IntType i = 0; i < n1; i++) {
+            const IntType old = m_perm[i];
+            IntType fill = padjStart[i];
+            for (IntType k = adjStart[old]; k < adjStart[old + 1]; k++)
+                padj[fill++] = m_iperm[adj[k]];
+            padjStart[i + 1] = fill;
+        }
+    };
+    permute();
+
+    // postorder the elimination tree so that every subtree and supernode has contiguous columns
+    std::vector<IntType> parent;
+    eliminationTree(padjStart, padj, parent);
+    {
+        std::vector<IntType> head(n1, -1), next(n1, -1), post, stack;
+        post.reserve(n1);
+        for (IntType j = n1 - 1; j >= 0; j--)
+            if (parent[j] != -1) {
+                next[j] = head[parent[j]];
+                head[parent[j]] = j;
+            }
+        for (IntType j = 0; j < n1; j++) {
+            if (parent[j] != -1)
+                continue;
+            stack.push_back(j);
+            while (!stack.empty()) {
+                const IntType top = stack.back();
+                const IntType child = head[top];
+                if (child == -1) {
+                    stack.pop_back();
+                    post.push_back(top);
+                }
+                else {
+                    head[top] = next[child];
+                    stack.push_back(child);
+                }
+            }
+        }
+        std::vector<IntType> ndPerm(m_perm.begin(), m_perm.begin() + n1);
+        for (IntType k = 0; k < n1; k++)
+            m_perm[k] = ndPerm[post[k]];
+    }
+    permute();
+    eliminationTree(padjStart, padj, parent);
+
+    // couplings of Schur rows to eliminated columns, in the new numbering
+    std::vector<IntType> schurAdjStart(m + 1, 0), schurAdj(coupling.size());
+    for (IntType k = 0; k < (IntType)coupling.size(); k++)
+        schurAdjStart[coupling[k] - n1 + 1]++;
+    for (int i = 0; i < m; i++)
+        schurAdjStart[i + 1] += schurAdjStart[i];
+    {
+        std::vector<IntType> fill(schurAdjStart.begin(), schurAdjStart.end() - 1);
+        for (IntType old = 0; old < n1; old++)
+            for (IntType k = couplingStart[old]; k < couplingStart[old + 1]; k++)
+                schurAdj[fill[coupling[k] - n1]++] = m_iperm[old];
+    }
+
+    // column counts from row subtrees
+    std::vector<IntType> colCount(n1, 1), mark(n1, -1), childCount(n1, 0);
+    auto rowSubtree = [&](const IntType i, IntType j) {
+        for (; j != -1 && j < i && mark[j] != i; j = parent[j]) {
+            mark[j] = i;
+            colCount[j]++;
+        }
+    };
+    for (IntType i = 0; i < n1; i++)
+        for (IntType k = padjStart[i]; k < padjStart[i + 1]; k++)
+            rowSubtree(i, padj[k]);
+    for (int i = 0; i < m; i++)
+        for (IntType k = schurAdjStart[i]; k < schurAdjStart[i + 1]; k++)
+            rowSubtree(n1 + i, schurAdj[k]);
+    for (IntType j = 0; j < n1; j++)
+        if (parent[j] != -1)
+            childCount[parent[j]]++;
+
+    // fundamental supernodes
+    m_snFirst.clear();
+    for (IntType j = 0; j < n1; j++)
+        if (j == 0 || parent[j - 1] != j || colCount[j - 1] != colCount[j] + 1 || childCount[j] != 1)
+            m_snFirst.push_back(j);
+    m_snFirst.push_back(n1);
+    const IntType nSn = (IntType)m_snFirst.size() - 1;
+
+    std::vector<IntType> colToSn(n1), snParent(nSn);
+    for (IntType s = 0; s < nSn; s++)
+        for (IntType j = m_snFirst[s]; j < m_snFirst[s + 1]; j++)
+            colToSn[j] = s;
+    m_roots.clear();
+    m_snChildStart.assign(nSn + 1, 0);
+    for (IntType s = 0; s < nSn; s++) {
+        const IntType p = parent[m_snFirst[s + 1] - 1];
+        snParent[s] = p == -1 ? -1 : colToSn[p];
+        if (p == -1)
+            m_roots.push_back(s);
+        else
+            m_snChildStart[snParent[s] + 1]++;
+    }
+    for (IntType s = 0; s < nSn; s++)
+        m_snChildStart[s + 1] += m_snChildStart[s];
+    m_snChildren.resize(m_snChildStart[nSn]);
+    {
+        std::vector<IntType> fill(m_snChildStart.begin(), m_snChildStart.end() - 1);
+        for (IntType s = 0; s < nSn; s++)
+            if (snParent[s] != -1)
+                m_snChildren[fill[snParent[s]]++] = s;
+    }
+
+    // row structure of each supernode below its diagonal block, children always precede their parent
+    m_snRowStart.assign(nSn + 1, 0);
+    m_snRows.clear();
+    {
+        std::vector<IntType> rowMark(n, -1), rows;
+        for (IntType s = 0; s < nSn; s++) {
+            const IntType last = m_snFirst[s + 1] - 1;
+            rows.clear();
+            auto addRow = [&](const IntType r) {
+                if (r > last && rowMark[r] != s) {
+                    rowMark[r] = s;
+                    rows.push_back(r);
+                }
+            };
+            for (IntType j = m_snFirst[s]; j <= last; j++) {
+                for (IntType k = padjStart[j]; k < padjStart[j + 1]; k++)
+                    addRow(padj[k]);
+                const IntType old = m_perm[j];
+                for (IntType k = couplingStart[old]; k < couplingStart[old + 1]; k++)
+                    addRow(coupling[k]);
+            }
+            for (IntType c = m_snChildStart[s]; c < m_snChildStart[s + 1]; c++) {
+                const IntType child = m_snChildren[c];
+                for (IntType k = m_snRowStart[child]; k < m_snRowStart[child + 1]; k++)
+                    addRow(m_snRows[k]);
+            }
+            std::sort(rows.begin(), rows.end());
+            m_snRows.insert(m_snRows.end(), rows.begin(), rows.end());
+            m_snRowStart[s + 1] = (IntType)m_snRows.size();
+        }
+    }
+
+    // positions of each supernode's rows in its parent's front, and storage of the factor
+    m_snRelative.resize(m_snRows.size());
+    m_snValueStart.assign(nSn + 1, 0);
+    for (IntType s = 0; s < nSn; s++) {
+        const IntType ns = m_snFirst[s + 1] - m_snFirst[s];
+        const IntType nr = m_snRowStart[s + 1] - m_snRowStart[s];
+        m_snValueStart[s + 1] = m_snValueStart[s] + (size_t)(ns + nr) * ns;
+        const IntType p = snParent[s];
+        for (IntType k = m_snRowStart[s]; k < m_snRowStart[s + 1]; k++) {
+            const IntType r = m_snRows[k];
+            if (p == -1)
+                m_snRelative[k] = r - n1;
+            else if (r < m_snFirst[p + 1])
+                m_snRelative[k] = r - m_snFirst[p];
+            else
+                m_snRelative[k] = m_snFirst[p + 1] - m_snFirst[p] + (IntType)(std::lower_bound(m_snRows.begin() + m_snRowStart[p], m_snRows.begin() + m_snRowStart[p + 1], r) - (m_snRows.begin() + m_snRowStart[p]));
+        }
+    }
+
+    // location of every CSR entry in the factor, or in the dense Schur complement
+    const size_t factorSize = m_snValueStart[nSn];
+    const IntType nnz = rowIndex[n];
+    m_valueMap.resize(nnz);
+    for (IntType i = 0; i < n; i++)
+        for (IntType k = rowIndex[i]; k < rowIndex[i + 1]; k++) {
+            const IntType a = m_iperm[i], b = m_iperm[column[k]];
+            const IntType lo = std::min(a, b), hi = std::max(a, b);
+            if (lo >= n1) {
+                m_valueMap[k] = factorSize + (size_t)(lo - n1) * m + (hi - n1);
+                continue;
+            }
+            const IntType s = colToSn[lo];
+            const IntType ns = m_snFirst[s + 1] - m_snFirst[s];
+            const IntType nr = m_snRowStart[s + 1] - m_snRowStart[s];
+            IntType localRow;
+            if (hi < m_snFirst[s + 1])
+                localRow = hi - m_snFirst[s];
+            else {
+                auto begin = m_snRows.begin() + m_snRowStart[s], end = m_snRows.begin() + m_snRowStart[s + 1];
+                auto it = std::lower_bound(begin, end, hi);
+                if (it == end || *it != hi)
+                    throw std::logic_error("entry (" + std::to_string(i) + " , " + std::to_string(column[k]) + ") not found in the symbolic factor");
+                localRow = ns + (IntType)(it - begin);
+            }
+            m_valueMap[k] = m_snValueStart[s] + (size_t)(lo - m_snFirst[s]) * (ns + nr) + localRow;
+        }
+
+    m_factor.assign(factorSize, T(0));
+    m_work.assign((size_t)n * nrhs, T(0));
+    m_update.assign(m_snRows.size() * nrhs, T(0));
+    this->recordAnalyzedPattern();
+}
+
+template<class T, class IntType>
+void SupernodalCholesky<T, IntType>::factorSubtree(const IntType s, std::vector<std::vector<T> >& updates) {
+    forChildren(m_snChildren.data() + m_snChildStart[s], m_snChildStart[s + 1] - m_snChildStart[s], [&](const IntType c) {
+        factorSubtree(c, updates);
+    });
+
+    const IntType ns = m_snFirst[s + 1] - m_snFirst[s];
+    const IntType nr = m_snRowStart[s + 1] - m_snRowStart[s];
+    const IntType N = ns + nr;
+    T* const L = &m_factor[m_snValueStart[s]];
+    std::vector<T>& U = updates[s];
+    U.assign((size_t)nr * nr, T(0));
+
+    // extend-add the children's update matrices, lower triangle only
+    for (IntType c = m_snChildStart[s]; c < m_snChildStart[s + 1]; c++) {
+        const IntType child = m_snChildren[c];
+        const IntType ncr = m_snRowStart[child + 1] - m_snRowStart[child];
+        const IntType* rel = m_snRelative.data() + m_snRowStart[child];
+        const std::vector<T>& Uc = updates[child];
+        for (IntType jj = 0; jj < ncr; jj++) {
+            const IntType b = rel[jj];
+            for (IntType ii = jj; ii < ncr; ii++) {
+                const IntType a = rel[ii];
+                const T val = Uc[(size_t)jj * ncr + ii];
+                if (b < ns)
+                    L[(size_t)b * N + a] += val;
+                else
+                    U[(size_t)(b - ns) * nr + a - ns] += val;
+            }
+        }
+        std::vector<T>().swap(updates[child]);
+    }
+
+    // blocked right looking factorization of the supernode columns
+    for (IntType k0 = 0; k0 < ns; k0 += panelWidth) {
+        const IntType k1 = std::min(ns, k0 + panelWidth);
+        for (IntType k = k0; k < k1; k++) {
+            T* const Lk = L + (size_t)k * N;
+            if (!(Lk[k] > T(0)))
+                throw std::logic_error("ERROR during numerical factorization: non positive pivot at column " + std::to_string(m_snFirst[s] + k));
+            const T d = std::sqrt(Lk[k]);
+            Lk[k] = d;
+            for (IntType i = k + 1; i < N; i++)
+                Lk[i] /= d;
+            for (IntType j = k + 1; j < k1; j++) {
+                T* const Lj = L + (size_t)j * N;
+                const T f = Lk[j];
+                for (IntType i = j; i < N; i++)
+                    Lj[i] -= f * Lk[i];
+            }
+        }
+        forColumns(k1, ns, (size_t)(ns - k1) * N * (k1 - k0), [&](const IntType jBegin, const IntType jEnd) {
+            for (IntType j = jBegin; j < jEnd; j++) {
+                T* const Lj = L + (size_t)j * N;
+                for (IntType k = k0; k < k1; k++) {
+                    const T* const Lk = L + (size_t)k * N;
+                    const T f = Lk[j];
+                    for (IntType i = j; i < N; i++)
+                        Lj[i] -= f * Lk[i];
+                }
+            }
+        });
+    }
+
+    // update matrix for the parent, U -= L_rs * L_rs^T
+    forColumns(IntType(0), nr, (size_t)nr * nr * ns, [&](const IntType jBegin, const IntType jEnd) {
+        for (IntType jj = jBegin; jj < jEnd; jj++) {
+            T* const Uj = &U[(size_t)jj * nr];
+            for (IntType k = 0; k < ns; k++) {
+                const T* const Lk = L + (size_t)k * N + ns;
+                const T f = Lk[jj];
+                for (IntType ii = jj; ii < nr; ii++)
+                    Uj[ii] -= f * Lk[ii];
+            }
+        }
+    });
+}
+
+template<class T, class IntType>
+void SupernodalCholesky<T, IntType>::numericFact() {
+    const IntType nSn = (IntType)m_snFirst.size() - 1;
+    const size_t factorSize = m_factor.size();
+
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, factorSize), [&](const tbb::blocked_range<size_t>& r) {
+        std::fill(m_factor.begin() + r.begin(), m_factor.begin() + r.end(), T(0));
+    });
+    if (m)
+        std::fill(schur, schur + (size_t)m * m, T(0));
+
+    tbb::parallel_for(tbb::blocked_range<IntType>(0, n), [&](const tbb::blocked_range<IntType>& r) {
+        for (IntType k = rowIndex[r.begin()]; k < rowIndex[r.end()]; k++) {
+            const size_t offset = m_valueMap[k];
+            if (offset < factorSize)
+                m_factor[offset] = value[k];
+            else {
+                const size_t i = (offset - factorSize) / m, j = (offset - factorSize) % m;
+                schur[i * m + j] = value[k];
+                schur[j * m + i] = value[k];
+            }
+        }
+    });
+
+    std::vector<std::vector<T> > updates(nSn);
+    forChildren(m_roots.data(), (IntType)m_roots.size(), [&](const IntType s) {
+        factorSubtree(s, updates);
+    });
+
+    // the roots' update matrices only couple Schur nodes and form the Schur complement
+    for (const IntType s : m_roots) {
+        const IntType nr = m_snRowStart[s + 1] - m_snRowStart[s];
+        const IntType* rel = m_snRelative.data() + m_snRowStart[s];
+        const std::vector<T>& U = updates[s];
+        for (IntType jj = 0; jj < nr; jj++)
+            for (IntType ii = jj; ii < nr; ii++) {
+                const size_t a = rel[ii], b = rel[jj];
+                const T val = U[(size_t)jj * nr + ii];
+                schur[a * m + b] += val;
+                if (a != b)
+                    schur[b * m + a] += val;
+            }
+    }
+}
+
+template<class T, class IntType>
+void SupernodalCholesky<T, IntType>::forwardSubtree(const IntType s, T* const w, T* const u) {
+    forChildren(m_snChildren.data() + m_snChildStart[s], m_snChildStart[s + 1] - m_snChildStart[s], [&](const IntType c) {
+        forwardSubtree(c, w, u);
+    });
+
+    const IntType first = m_snFirst[s];
+    const IntType ns = m_snFirst[s + 1] - first;
+    const IntType nr = m_snRowStart[s + 1] - m_snRowStart[s];
+    const IntType N = ns + nr;
+    const T* const L = &m_factor[m_snValueStart[s]];
+    T* const us = u + (size_t)m_snRowStart[s] * nrhs;
+    std::fill(us, us + (size_t)nr * nrhs, T(0));
+
+    for (IntType c = m_snChildStart[s]; c < m_snChildStart[s + 1]; c++) {
+        const IntType child = m_snChildren[c];
+        const IntType ncr = m_snRowStart[child + 1] - m_snRowStart[child];
+        const IntType* rel = m_snRelative.data() + m_snRowStart[child];
+        const T* const uc = u + (size_t)m_snRowStart[child] * nrhs;
+        for (int v = 0; v < nrhs; v++)
+            for (IntType ii = 0; ii < ncr; ii++) {
+                const IntType a = rel[ii];
+                if (a < ns)
+                    w[(size_t)v * n + first + a] += uc[(size_t)v * ncr + ii];
+                else
+                    us[(size_t)v * nr + a - ns] += uc[(size_t)v * ncr + ii];
+            }
+    }
+
+    for (int v = 0; v < nrhs; v++) {
+        T* const ws = w + (size_t)v * n + first;
+        T* const uv = us + (size_t)v * nr;
+        for (IntType j = 0; j < ns; j++) {
+            const T* const Lj = L + (size_t)j * N;
+            const T y = ws[j] / Lj[j];
+            ws[j] = y;
+            for (IntType i = j + 1; i < ns; i++)
+                ws[i] -= Lj[i] * y;
+            for (IntType ii = 0; ii < nr; ii++)
+                uv[ii] -= Lj[ns + ii] * y;
+        }
+    }
+}
+
+template<class T, class IntType>
+void SupernodalCholesky<T, IntType>::backwardSubtree(const IntType s, T* const w) {
+    const IntType first = m_snFirst[s];
+    const IntType ns = m_snFirst[s + 1] - first;
+    const IntType nr = m_snRowStart[s + 1] - m_snRowStart[s];
+    const IntType N = ns + nr;
+    const T* const L = &m_factor[m_snValueStart[s]];
+    const IntType* rows = m_snRows.data() + m_snRowStart[s];
+
+    for (int v = 0; v < nrhs; v++) {
+        T* const wv = w + (size_t)v * n;
+        T* const ws = wv + first;
+        for (IntType j = ns - 1; j >= 0; j--) {
+            const T* const Lj = L + (size_t)j * N;
+            T sum = ws[j];
+            for (IntType i = j + 1; i < ns; i++)
+                sum -= Lj[i] * ws[i];
+            for (IntType ii = 0; ii < nr; ii++)
+                sum -= Lj[ns + ii] * wv[rows[ii]];
+            ws[j] = sum / Lj[j];
+        }
+    }
+
+    forChildren(m_snChildren.data() + m_snChildStart[s], m_snChildStart[s + 1] - m_snChildStart[s], [&](const IntType c) {
+        backwardSubtree(c, w);
+    });
+}
+
+template<class T, class IntType>
+void SupernodalCholesky<T, IntType>::forwardSubstitution(T* const _rhs, T* const _x) {
+    T* const w = m_work.data();
+    tbb::parallel_for(tbb::blocked_range<IntType>(0, n), [&](const tbb::blocked_range<IntType>& r) {
+        for (int v = 0; v < nrhs; v++)
+            for (IntType i = r.begin(); i < r.end(); i++)
+                w[(size_t)v * n + i] = _rhs[(size_t)v * n + m_perm[i]];
+    });
+
+    T* const u = m_update.data();
+    forChildren(m_roots.data(), (IntType)m_roots.size(), [&](const IntType s) {
+        forwardSubtree(s, w, u);
+    });
+    // the roots' updates reduce the Schur part of the right hand side
+    for (const IntType s : m_roots) {
+        const IntType nr = m_snRowStart[s + 1] - m_snRowStart[s];
+        const IntType* rel = m_snRelative.data() + m_snRowStart[s];
+        const T* const us = u + (size_t)m_snRowStart[s] * nrhs;
+        for (int v = 0; v < nrhs; v++)
+            for (IntType ii = 0; ii < nr; ii++)
+                w[(size_t)v * n + m_eliminated + rel[ii]] += us[(size_t)v * nr + ii];
+    }
+
+    tbb::parallel_for(tbb::blocked_range<IntType>(0, n), [&](const tbb::blocked_range<IntType>& r) {
+        for (int v = 0; v < nrhs; v++)
+            for (IntType i = r.begin(); i < r.end(); i++)
+                _x[(size_t)v * n + m_perm[i]] = w[(size_t)v * n + i];
+    });
+}
+
+template<class T, class IntType>
+void SupernodalCholesky<T, IntType>::diagSolve(T* const _rhs, T* const _x) {
+    if (m) {
+        // solve U^T U x = b on the schur part of each right hand side column
+        for (int v = 0; v < nrhs; v++) {
+            T* const b = _rhs + (size_t)v * n + n - m;
+            for (int k = 0; k < m; k++) {
+                const T* const Uk = schur + (size_t)k * m;
+                b[k] /= Uk[k];
+                for (int j = k + 1; j < m; j++)
+                    b[j] -= Uk[j] * b[k];
+            }
+            for (int i = m - 1; i >= 0; i--) {
+                const T* const Ui = schur + (size_t)i * m;
+                T sum = b[i];
+                for (int j = i + 1; j < m; j++)
+                    sum -= Ui[j] * b[j];
+                b[i] = sum / Ui[i];
+            }
+        }
+    }
+    std::copy(_rhs, _rhs + (size_t)n * nrhs, _x);
+}
+
+template<class T, class IntType>
+void SupernodalCholesky<T, IntType>::backwardSubstitution(T* const _rhs, T* const _x) {
+    T* const w = m_work.data();
+    tbb::parallel_for(tbb::blocked_range<IntType>(0, n), [&](const tbb::blocked_range<IntType>& r) {
+        for (int v = 0; v < nrhs; v++)
+            for (IntType i = r.begin(); i < r.end(); i++)
+                w[(size_t)v * n + i] = _rhs[(size_t)v * n + m_perm[i]];
+    });
+
+    forChildren(m_roots.data(), (IntType)m_roots.size(), [&](const IntType s) {
+        backwardSubtree(s, w);
+    });
+
+    tbb::parallel_for(tbb::blocked_range<IntType>(0, n), [&](const tbb::blocked_range<IntType>& r) {
+        for (int v = 0; v < nrhs; v++)
+            for (IntType i = r.begin(); i < r.end(); i++)
+                _x[(size_t)v * n + m_perm[i]] = w[(size_t)v * n + i];
+    });
+}
+
+template<class T, class IntType>
+void SupernodalCholesky<T, IntType>::releaseInternal() {
+    this->clearAnalyzedPattern();
+    std::vector<IntType>().swap(m_perm);
+    std::vector<IntType>().swap(m_iperm);
+    std::vector<IntType>().swap(m_snFirst);
+    std::vector<IntType>().swap(m_snRowStart);
+    std::vector<IntType>().swap(m_snRows);
+    std::vector<IntType>().swap(m_snRelative);
+    std::vector<size_t>().swap(m_snValueStart);
+    std::vector<IntType>().swap(m_snChildStart);
+    std::vector<IntType>().swap(m_snChildren);
+    std::vector<IntType>().swap(m_roots);
+    std::vector<size_t>().swap(m_valueMap);
+    std::vector<T>().swap(m_factor);
+    std::vector<T>().swap(m_work);
+    std::vector<T>().swap(m_update);
+}
+
+template<class T, class IntType>
+void SupernodalCholesky<T, IntType>::deallocate() {
+    if (value) {
+        delete[] value;
+        value = nullptr;
+    }
+    if (column) {
+        delete[] column;
+        column = nullptr;
+    }
+    if (rowIndex) {
+        delete[] rowIndex;
+        rowIndex = nullptr;
+    }
+}
+
+template struct SupernodalCholesky<double, int>;
+template struct SupernodalCholesky<float, int>;
+
+template struct SupernodalCholesky<double, long long int>;
+template struct SupernodalCholesky<float, long long int>;
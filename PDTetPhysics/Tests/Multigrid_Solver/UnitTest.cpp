@@ -0,0 +1,154 @@
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include "MultigridSolver.h"
+
+using namespace PhysBAM;
+
+using T = float;
+using VectorType = VECTOR<T, 3>;
+using DiscretizationType = TetrahedralDiscretization<std::vector<VectorType>>;
+using DirectSolverType = SchurSolver<DiscretizationType, int>;
+using MultigridSolverType = MultigridSolver<DiscretizationType, int>;
+using Constraint = MultigridSolverType::Constraint;
+using Suture = MultigridSolverType::Suture;
+using InternodeConstraint = MultigridSolverType::InternodeConstraint;
+
+// largest difference from the direct solution over the largest entry of the direct solution
+T relativeError(const std::vector<VectorType>& direct, const std::vector<VectorType>& multigrid)
+{
+    T difference = T(0), size = T(0);
+    for (size_t i = 0; i < direct.size(); i++) {
+        difference = std::max(difference, (direct[i] - multigrid[i]).Max_Abs());
+        size = std::max(size, direct[i].Max_Abs());
+    }
+    return difference / size;
+}
+
+Constraint hook(const int node, const T stiffness)
+{
+    Constraint constraint;
+    constraint.m_elementIndex = { node, node, node, node };
+    constraint.m_weights = { T(1), T(0), T(0), T(0) };
+    constraint.m_stiffness = stiffness;
+    constraint.m_stressLimit = T(0);
+    return constraint;
+}
+
+// A cantilever of Kuhn tetrahedra held at one end by hooks and tied across by a suture is solved by the multigrid
+// preconditioned conjugate gradients and by the direct solver. Hooks are then added and removed, which the
+// multigrid solver applies to its fixed hierarchy as rank one terms and a low rank update of its coarsest factor.
+int main(int argc, char* argv[])
+{
+    const int R = argc > 1 ? atoi(argv[1]) : 16; // cells per side
+    const T threshold = T(1e-3);
+    auto id = [R](const int i, const int j, const int k) { return (i * (R + 1) + j) * (R + 1) + k; };
+    const int nodes = (R + 1) * (R + 1) * (R + 1);
+    LOG::Initialize_Logging(false, true);
+    std::cout << "Running Unit Test for MultigridSolver on " << nodes << " nodes" << std::endl;
+
+    static const int kuhn[6][4][3] = {
+        { {0, 0, 0}, {1, 0, 0}, {1, 1, 0}, {1, 1, 1} }, { {0, 0, 0}, {1, 0, 0}, {1, 0, 1}, {1, 1, 1} },
+        { {0, 0, 0}, {0, 1, 0}, {1, 1, 0}, {1, 1, 1} }, { {0, 0, 0}, {0, 1, 0}, {0, 1, 1}, {1, 1, 1} },
+        { {0, 0, 0}, {0, 0, 1}, {1, 0, 1}, {1, 1, 1} }, { {0, 0, 0}, {0, 0, 1}, {0, 1, 1}, {1, 1, 1} } };
+    std::vector<VectorType> X(nodes);
+    for (int i = 0; i <= R; i++)
+        for (int j = 0; j <= R; j++)
+            for (int k = 0; k <= R; k++)
+                X[id(i, j, k)] = VectorType(T(i), T(j), T(k)) * T(.1);
+    std::vector<std::array<int, 4>> elements;
+    std::vector<MATRIX<T, 3>> gradients;
+    std::vector<T> restVolume;
+    for (int i = 0; i < R; i++)
+        for (int j = 0; j < R; j++)
+            for (int k = 0; k < R; k++)
+                for (int t = 0; t < 6; t++) {
+                    std::array<int, 4> element;
+                    for (int v = 0; v < 4; v++)
+                        element[v] = id(i + kuhn[t][v][0], j + kuhn[t][v][1], k + kuhn[t][v][2]);
+                    MATRIX<T, 3> Dm;
+                    for (int c = 1; c <= 3; c++)
+                        Dm.Set_Column(c, X[element[c]] - X[element[0]]);
+                    elements.push_back(element);
+                    gradients.push_back(Dm.Inverse());
+                    restVolume.push_back(std::abs(Dm.Determinant()) / T(6));
+                }
+
+    std::vector<NodeType> nodeType(nodes, NodeType::Active);
+    std::vector<Constraint> constraints, noFakeSutures;
+    for (int j = 0; j <= R; j++)
+        for (int k = 0; k <= R; k++)
+            constraints.push_back(hook(id(0, j, k), T(50)));
+    std::vector<Suture> sutures(1);
+    sutures[0].m_elementIndex1 = elements[10];
+    sutures[0].m_elementIndex2 = elements[elements.size() - 20];
+    sutures[0].m_weights1 = { T(.25), T(.25), T(.25), T(.25) };
+    sutures[0].m_weights2 = { T(.1), T(.2), T(.3), T(.4) };
+    sutures[0].m_stiffness = T(100);
+    std::vector<InternodeConstraint> microNodes;
+
+    std::mt19937 generator(argc > 2 ? atoi(argv[2]) : 1);
+    std::uniform_real_distribution<T> uniform(T(-1), T(1));
+    std::vector<VectorType> f(nodes), direct(nodes), multigrid(nodes);
+    for (VectorType& force : f)
+        force = VectorType(uniform(generator), uniform(generator), uniform(generator));
+
+    DirectSolverType directSolver;
+    directSolver.initialize(nodeType);
+    directSolver.computeTensor(elements, gradients, restVolume, T(1), sutures, microNodes);
+    directSolver.initializePardiso(constraints, sutures, noFakeSutures, microNodes);
+    MultigridSolverType multigridSolver;
+    multigridSolver.initialize(nodeType);
+    multigridSolver.computeTensor(elements, gradients, restVolume, T(1), sutures, microNodes);
+    multigridSolver.initializeHierarchy(X, constraints, sutures, noFakeSutures, microNodes);
+
+    bool passed = true;
+    auto compare = [&](const char* name) {
+        directSolver.copyIn(f);
+        directSolver.solve();
+        directSolver.copyOut(direct);
+        multigridSolver.copyIn(f);
+        multigridSolver.solve();
+        multigridSolver.copyOut(multigrid);
+        const T error = relativeError(direct, multigrid);
+        std::cout << name << ": " << multigridSolver.m_lastIterations << " iterations, relative error " << error << std::endl;
+        if (!(error < threshold) || multigridSolver.m_lastIterations >= multigridSolver.m_maxIterations) {
+            std::cout << "  FAILED" << std::endl;
+            passed = false;
+        }
+    };
+    compare("initial constraints");
+
+    // Hooks added on the free end, the middle row of the held end released and the suture made stiffer. Released
+    // hooks keep their place with zero stiffness, as PDTetSolver::deleteHook() leaves them.
+    const size_t heldHooks = constraints.size();
+    for (int j = 0; j <= R; j += R / 2)
+        constraints.push_back(hook(id(R, j, R / 2), T(1000)));
+    for (int k = 0; k <= R; k++)
+        constraints[(R / 2) * (R + 1) + k].m_stiffness = T(0);
+    sutures[0].m_stiffness = T(400);
+    directSolver.reInitializePardiso(constraints, sutures, noFakeSutures, microNodes);
+    multigridSolver.setConstraints(constraints, sutures, noFakeSutures, microNodes);
+    std::fill(f.begin(), f.end(), VectorType());
+    f[id(R, R, R)] = VectorType(T(0), T(-1), T(0));
+    compare("changed constraints");
+
+    // back to the constraints the hierarchy was built with, which must leave no low rank update
+    for (size_t c = heldHooks; c < constraints.size(); c++)
+        constraints[c].m_stiffness = T(0);
+    for (int k = 0; k <= R; k++)
+        constraints[(R / 2) * (R + 1) + k].m_stiffness = T(50);
+    sutures[0].m_stiffness = T(100);
+    directSolver.reInitializePardiso(constraints, sutures, noFakeSutures, microNodes);
+    multigridSolver.setConstraints(constraints, sutures, noFakeSutures, microNodes);
+    if (!multigridSolver.m_coarseChange.stiffness.empty()) {
+        std::cout << "restored constraints left a low rank update of " << multigridSolver.m_coarseChange.stiffness.size() << " terms" << std::endl;
+        passed = false;
+    }
+    compare("restored constraints");
+
+    std::cout << (passed ? "PASSED" : "FAILED") << std::endl;
+    LOG::Finish_Logging();
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <array>
+#include <vector>
+
+#include "PhysBAM_Tools/Vectors/VECTOR.h"
+
+namespace PhysBAM {
+	template<class TV>
+		class GRID;
+	template<class T, class ID>
+		class ARRAY;
+
+	// Signed distance grid of a closed triangulated surface built in parallel. The grid is split into bricks that are
+	// processed as independent tbb tasks. Nodes within a narrow band of the surface get exact distances from the
+	// triangles binned to their brick, which also mark the grid edges the surface crosses. The remaining nodes get exact
+	// distances from a per brick culled search of all triangles. Signs come from a flood fill over the unblocked edges
+	// that runs inside each brick and is then joined across brick faces, with one winding number per region deciding
+	// inside or outside, so self intersecting surfaces are signed correctly. Negative inside, as LEVELSET_MAKER_UNIFORM.
+	template<class T>
+	class NarrowBandLevelSetMaker
+	{
+	private:
+		using TV = VECTOR<T, 3>;
+		using TV_INT = VECTOR<int, 3>;
+		static constexpr int brickSize = 8;  // nodes per brick side
+		int m_bandCells;
+
+		struct triangleData {
+			std::array<int, 3> vertices;
+			TV minCorner, maxCorner, center;
+			T radius;  // of a sphere about center enclosing the triangle
+		};
+		std::vector<triangleData> m_triangles;
+		std::vector<TV> m_positions;
+
+		void initializeTriangles(const std::vector<std::array<int, 3>>& triangles, const std::vector<std::array<T, 3>>& positions);
+		T distanceSquared(const TV& x, const triangleData& tri) const;
+		bool inside(const TV& x) const;
+
+	public:
+		// At least two cells, so every grid edge the surface crosses starts at a band node.
+		void setBandWidth(const int cells) { m_bandCells = cells < 2 ? 2 : cells; }
+		// grid must already be initialized. phi is resized to the grid's node domain.
+		void computeLevelSet(const std::vector<std::array<int, 3>>& triangles, const std::vector<std::array<T, 3>>& positions, const GRID<TV>& grid, ARRAY<T, TV_INT>& phi);
+
+		NarrowBandLevelSetMaker() : m_bandCells(3) {}
+	};
+}
@@ -1,11 +1,15 @@
 #pragma once
 
 #include <cstdint>
+#include <limits>
 #include "GridDeformerTet.h"
 #ifdef USE_CUDA
 #include "CudaSolver.h"
+#else
+#include "CollisionSchurSolver.h"
 #endif
 #include "SchurSolver.h"
+#include "MultigridSolver.h"
 #include "MergedLevelSet.h"
 
 namespace PhysBAM {
@@ -36,14 +40,44 @@ private:
 #ifdef USE_CUDA
 	PhysBAM::CudaSolver<DiscretizationType, IntType> m_solver_c; // use this when there are collision nodes
 #else
-	PhysBAM::SchurSolver<DiscretizationType, IntType> m_solver_c;
+	PhysBAM::CollisionSchurSolver<DiscretizationType, IntType> m_solver_c; // same inner iterations on the CPU
 #endif
+	PhysBAM::MultigridSolver<DiscretizationType, IntType> m_solver_mg; // replaces both when m_globalSolverType is Multigrid
+	GlobalSolverType m_globalSolverType = GlobalSolverType::Direct;
 	// PhysBAM::LEVELSET_IMPLICIT_OBJECT<VectorType>* m_softLevelSet;
 	PhysBAM::MergedLevelSet<VectorType>* m_levelSet;
 	std::vector<std::string> m_levelSetPaths;
 
 	bool hasCollision = false;
 
+	// Stiffness of each constraint, suture and fake suture in the last full factorization. Changes against it up to
+	// m_maxLowRankTerms are applied by the solvers as low rank corrections instead of refactoring.
+	std::vector<T> m_factoredConstraintStiffness;
+	std::vector<T> m_factoredSutureStiffness;
+	std::vector<T> m_factoredFakeSutureStiffness;
+	int m_maxLowRankTerms = 12;
+
+	// convergence of the last solve(), largest node motion and largest force on an active node before its last step,
+	// collision response included. m_collisionsChanged is set if a collision constraint or suture became active or
+	// inactive since the previous solve().
+	T m_lastMotion = 0;
+	T m_lastResidual = 0;
+	bool m_collisionsChanged = false;
+	std::vector<bool> m_activeCollisions;
+
+	// solve() repeats local/global steps on the same factorization until the residual drops to m_residualReduction
+	// times that of the first step, a step moves no node more than m_stepTarget, m_timeBudget seconds have passed or
+	// m_maxIterations were done. The defaults do a single step per solve().
+	int m_maxIterations = 1;
+	T m_residualReduction = 0;
+	T m_stepTarget = 0;
+	double m_timeBudget = std::numeric_limits<double>::max();
+	T m_spectralRadius = T(.9); // estimate for the Chebyshev extrapolation, 0 disables it
+	int m_chebyshevDelay = 3;
+	int m_lastIterations = 0;
+	T m_lastStep = 0; // largest node motion of the last step
+	double m_lastSeconds = 0;
+
 	std::vector<int> invalidNodes;
 	std::vector<std::vector<int>> invalidEmbedding;
 	std::vector<std::vector<float>> invalidWeights;
@@ -58,6 +92,8 @@ public:
 		return &m_gridDeformer.m_X[0](1);
 	}
 
+	inline size_t numberOfNodes() const { return m_gridDeformer.m_X.size(); }
+
 	inline void addSubset(const float uniformMu, const float weightProportion, const float strainMin, const float strainMax, const std::vector<int>& tets) {
 		for (const int i : tets) {
 			m_gridDeformer.m_muLow[i] = uniformMu*weightProportion*weightProportion;
@@ -125,9 +161,22 @@ public:
 		}
 	}
 
+	inline void setSparseSolverType(const SparseSolverType type) {  // takes effect at the next initializeSolver()
+		m_solver_d.setSparseSolverType(type);
+#ifndef USE_CUDA
+		m_solver_c.setSparseSolverType(type);
+#endif
+	}
+
+	inline void setGlobalSolverType(const GlobalSolverType type) { m_globalSolverType = type; }  // takes effect at the next initializeSolver()
+
 	void initializeSolver();  // After constraints have changed computes ATA and does its LDLT()
 
-	void reInitializeSolver();  
+	void reInitializeSolver();  // After hooks or sutures changed applies them as a low rank update or refactors
+
+	inline void setMaxLowRankTerms(const int maxTerms) { m_maxLowRankTerms = maxTerms; }  // 0 always refactors
+
+	inline void setSpatialElementOrder(const bool order) { m_gridDeformer.m_spatialElementOrder = order; }  // takes effect at the next initializeSolver()
 
 	void addCollisionProxies(const int *tets, const T (*weights)[d], size_t length);
 	void addSelfCollisionElements(const int* tets, size_t length);
@@ -139,6 +188,17 @@ public:
 
 	void solve();  // do least squares solve and process collisions
 
+	inline T lastMotion() const { return m_lastMotion; }
+	inline T lastResidual() const { return m_lastResidual; }
+	inline bool collisionsChanged() const { return m_collisionsChanged; }
+	inline int lastIterations() const { return m_lastIterations; }
+	inline T lastStep() const { return m_lastStep; }
+	inline double lastSeconds() const { return m_lastSeconds; }
+
+	inline void setIterationBudget(const int maxIterations, const T residualReduction, const T stepTarget, const double seconds) {
+		m_maxIterations = maxIterations; m_residualReduction = residualReduction; m_stepTarget = stepTarget; m_timeBudget = seconds; }
+	inline void setChebyshevAcceleration(const T spectralRadius, const int delay) { m_spectralRadius = spectralRadius; m_chebyshevDelay = delay; }
+
 	PDTetSolver() : m_nInner(1), m_rangeMin(1), m_rangeMax(1), m_weightProportion(0), m_collisionStiffness(0), m_selfCollisionStiffness(0) { m_levelSet = new PhysBAM::MergedLevelSet<VectorType>; }
 	~PDTetSolver();
 
@@ -149,11 +209,19 @@ public:
 
 private:
 	void updateCollisionConstraints();
+	void recordFactoredStiffness();
+	void recordActiveCollisions();
+	void localGlobalStep();
+	void embedInvalidNodes();
+	template<class SolverType>
+	bool lowRankUpdate(SolverType& solver);  // SchurSolver or CollisionSchurSolver
 public:
 	void updateCollisionSutures(const int length, const int* topI, const int* botI, const T* topW, const T* botW, const T* normal); // this should be private and handled by PDSolver it self in future iterations
 
 	inline void releaseSolver() {
-		if (m_gridDeformer.m_collisionConstraints.size()) {
+		if (m_globalSolverType == GlobalSolverType::Multigrid)
+			m_solver_mg.deallocate();
+		else if (m_gridDeformer.m_collisionConstraints.size()) {
 #ifdef USE_CUDA
 			m_solver_c.releaseCuda();
 #endif
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+// Lock free triple buffer handing complete frames from one writer thread to one reader thread. The writer fills back() and
+// publish() swaps it with the middle buffer, acquire() swaps the middle buffer with front() if one was published since the
+// last acquire(). Neither side ever waits and the reader always sees the most recent complete frame.
+template <class T>
+class TripleBuffer {
+public:
+	// writer side
+	inline std::vector<T>& back() { return m_buffers[m_back]; }
+	inline void publish() { m_back = m_middle.exchange(m_back | freshBit, std::memory_order_acq_rel) & indexMask; }
+
+	// reader side, returns true if front() changed
+	inline bool acquire() {
+		if (!(m_middle.load(std::memory_order_acquire) & freshBit))
+			return false;
+		m_front = m_middle.exchange(m_front, std::memory_order_acq_rel) & indexMask;
+		return true;
+	}
+	inline const std::vector<T>& front() const { return m_buffers[m_front]; }
+	inline bool fresh() const { return (m_middle.load(std::memory_order_relaxed) & freshBit) != 0; } // acquire() would change front()
+
+private:
+	static constexpr int indexMask = 3, freshBit = 4;
+	std::vector<T> m_buffers[3];
+	int m_back = 0, m_front = 1;
+	std::atomic<int> m_middle{ 2 };
+};
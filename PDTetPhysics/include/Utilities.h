@@ -8,11 +8,9 @@
 
 namespace pdUtilities {
 	 template<class T, int d>
-	 void readObj(const std::string filename, std::vector<std::array<int, 3>>& triangles, std::vector<std::array<T, d>>& positions)
+	 void readObj(std::istream& myin, std::vector<std::array<int, 3>>& triangles, std::vector<std::array<T, d>>& positions)
 	 {
 		 // To have uniform interface, triangles will have 0-based indices
-		 // read obj file
-		 std::ifstream myin(filename);
 		 std::string line_string;
 		 std::istringstream ss;
 		 std::string type;
@@ -37,6 +35,13 @@ namespace pdUtilities {
 
 			 ss.clear();
 		 }
+	 }
+
+	 template<class T, int d>
+	 void readObj(const std::string filename, std::vector<std::array<int, 3>>& triangles, std::vector<std::array<T, d>>& positions)
+	 {
+		 std::ifstream myin(filename);
+		 readObj<T, d>(myin, triangles, positions);
 		 myin.close();
 	 }
 
@@ -9,6 +9,7 @@
 #include <unordered_map>
 #include "PDTetSolver.h"
 #include "Utilities.h"
+#include "TripleBuffer.h"
 
 
 class pdTetPhysics {
@@ -27,6 +28,8 @@ private:
 
 	std::vector<int> fixedTetConstraints;
 
+	TripleBuffer<std::array<T, d> > m_publishedPositions;
+
 public:
 	/* loaded with model file in history as static variables applied to all tet constraints. Later
 	 * could have different properties for different tissues (e.g. cartilage versus skin
@@ -40,6 +43,7 @@ public:
 
 	void addSoftCollisionTets(const std::vector<int> &tets) {
 		m_solver.addSelfCollisionElements(&tets[0], tets.size());
+		++m_changeCount;
 	}
 
 	void addFixedCollisionSet(const std::string &levelSetFile, const std::vector<int> &tets, const std::vector<std::array<float, 3> > &weights) {
@@ -71,6 +75,7 @@ public:
 
 	inline void tetSubset(const float lowTetWeight, const float highTetWeight, const float strainMin, const float strainMax, const std::vector<int>& tets) {
 		m_solver.addSubset(highTetWeight / 2, lowTetWeight / highTetWeight, strainMin, strainMax, tets);
+		++m_changeCount;
 
 		// QISI - write me.  First 4 arguments are the tet properties of this subset of tets.  Last argument contains the indices of the tets these
 		// properties should be assigned to.  This will be called after every topo change.  Currently there will be only one of these for cartilage.
@@ -85,14 +90,18 @@ public:
 		m_deformerInited = true;
 		m_solverInited = false;
 		fixedTetConstraints.clear();
+		++m_changeCount;
 		return reinterpret_cast<std::array<T, d>(*)>(m_solver.getPositionPtr());
 	}
 
-	inline std::array<float, 3>* createBccTetStructure_multires(const std::vector< std::array<int, 4> >& tetIndices, const std::vector<uint8_t>& tetSizeMultiples, float tetScale) {
+	// spatialOrder packs the tets into the solver's SIMD blocks along a space filling curve. Node and tet numbering seen by the caller are unchanged.
+	inline std::array<float, 3>* createBccTetStructure_multires(const std::vector< std::array<int, 4> >& tetIndices, const std::vector<uint8_t>& tetSizeMultiples, float tetScale, bool spatialOrder = true) {
+		m_solver.setSpatialElementOrder(spatialOrder);
 		m_solver.initializeDeformer_multires(reinterpret_cast<const int(*)[4]>(&tetIndices[0][0]), reinterpret_cast<const uint8_t*>(&tetSizeMultiples[0]), tetIndices.size(), tetScale * 2);
 		m_deformerInited = true;
 		m_solverInited = false;
 		fixedTetConstraints.clear();
+		++m_changeCount;
 		return reinterpret_cast<std::array<T, d>(*)>(m_solver.getPositionPtr());
 	}
 
@@ -113,6 +122,7 @@ public:
 				int handle = m_solver.addInterNodeConstraint(subNodes[i], fN, bC, m_tJunctionWeight);
 			}
 		}
+		++m_changeCount;
 	}
 
 	/* Doesn’t always follow createNewTetTopology() and may happen without changing
@@ -146,6 +156,7 @@ public:
 			int handle = m_solver.addConstraint(reinterpret_cast<const int(&)[4]>(m_solver.getTetIndices(peripheralTets[i])), reinterpret_cast<const T(&)[3]>(peripheralWeights[i]), reinterpret_cast<const T(&)[3]>(peripheralPositions[i]), m_peripheralWeight); // change weight
 			fixedTetConstraints.push_back(handle);
 		}
+		++m_changeCount;
 	}
 
 	/* returns constraint index */
@@ -158,6 +169,7 @@ public:
 		else
 			number = m_solver.addConstraint(tet, reinterpret_cast<const T(&)[d]>(barycentricWeight), reinterpret_cast<const T(&)[d]>(hookPosition), m_hookWeight, m_stressLimit);
 //		initializePhysics();  // don't do this here.  Do in calling routine due to group initilization.
+		++m_changeCount;
 		return number;
 	}
 
@@ -165,6 +177,7 @@ public:
 		if (!m_deformerInited)
 			throw std::logic_error("need to init tet topology before moveHook");
 		m_solver.moveConstraint(hookHandle, reinterpret_cast<const T(&)[d]>(newPosition));
+		++m_changeCount;
 	}
 
 	/* Could also just nullify it. */
@@ -172,6 +185,7 @@ public:
 		if (!m_deformerInited)
 			throw std::logic_error("need to init tet topology before deleteHook");
 		m_solver.deleteConstraint(hookHandle);
+		++m_changeCount;
 	}
 
 	/*Sets static variables for these parameters. */
@@ -188,6 +202,7 @@ public:
 		if (!m_deformerInited)
 			throw std::logic_error("need to init tet topology before addSuture");
 		// m_solverInited = false;
+		++m_changeCount;
 		return m_solver.addSuture(tets, reinterpret_cast<const T(&)[2][d]>(barycentricWeights[0]), sqrt(m_sutureWeight));
 	}
 
@@ -196,10 +211,27 @@ public:
 		if (!m_deformerInited)
 			throw std::logic_error("need to init tet topology before deleteSuture");
 		m_solver.deleteSuture(sutureHandle);
+		++m_changeCount;
+	}
+
+	// Pardiso needs MKL, Supernodal is the built in multithreaded sparse Cholesky. Refactors if the solver is already initialized.
+	inline void setSparseSolverType(const SparseSolverType type) {
+		m_solver.setSparseSolverType(type);
+		if (m_solverInited)
+			m_solver.initializeSolver();
+	}
+
+	// Direct factors the global matrix, Multigrid solves it by multigrid preconditioned conjugate gradients
+	// for models too large to factor. Reinitializes the solver if it is already initialized.
+	inline void setGlobalSolverType(const GlobalSolverType type) {
+		m_solver.setGlobalSolverType(type);
+		if (m_solverInited)
+			m_solver.initializeSolver();
 	}
 
 	// After constraints have changed computes ATA and does its LDLT() if needed
 	inline void initializePhysics() {
+		++m_changeCount;
 		if (m_solverInited) {
 			reInitializePhysics();
 		}
@@ -230,6 +262,7 @@ public:
 		if (!m_deformerInited)
 			throw std::logic_error("need to init tet topology before add proxies");
 		m_solver.addCollisionProxies(&tets[0], reinterpret_cast<const T(*)[d]>(&weights[0]), tets.size());
+		++m_changeCount;
 	}
 
 	// do least squares solve and process collisions
@@ -237,8 +270,42 @@ public:
 		if (!m_solverInited)
 			throw std::logic_error("need to init solver before solve");
 		m_solver.solve();
+		publishPositions();
 	}
 
+	/* The pointer returned by createBccTetStructure*() is written by every solve(). A render thread running alongside
+	 * the solver reads latestPositions() instead, the node positions of the last frame published by solve() or by
+	 * publishPositions(), which must be called after node positions are set outside the solver (e.g. after a topology
+	 * change). Single writer and single reader thread, neither waits for the other. */
+	inline void publishPositions() {
+		const std::array<T, d>* X = reinterpret_cast<const std::array<T, d>*>(m_solver.getPositionPtr());
+		m_publishedPositions.back().assign(X, X + m_solver.numberOfNodes());
+		m_publishedPositions.publish();
+	}
+	inline const std::vector<std::array<float, 3> >& latestPositions() {
+		m_publishedPositions.acquire();
+		return m_publishedPositions.front();
+	}
+	inline bool newPositionsPublished() const { return m_publishedPositions.fresh(); }  // since the last latestPositions()
+
+	/* Convergence of the last solve(). Largest node motion, largest force before the last step including collisions and
+	 * whether any collision came into or out of contact. A caller can stop solving once the motion stays small and
+	 * resume when changeCount() moves, which every hook, suture, collision set and topology change increments. */
+	inline float lastMotion() const { return m_solver.lastMotion(); }
+	inline float lastResidual() const { return m_solver.lastResidual(); }
+	inline bool collisionsChanged() const { return m_solver.collisionsChanged(); }
+	inline unsigned int changeCount() const { return m_changeCount; }
+	inline int lastIterations() const { return m_solver.lastIterations(); }
+	inline double lastSolveSeconds() const { return m_solver.lastSeconds(); }
+
+	/* Each solve() repeats local/global steps reusing the factorization until the residual falls to residualReduction
+	 * times that of its first step, a step moves no node more than stepTarget, seconds have passed or maxIterations
+	 * were done, extrapolating the iterates by Chebyshev's semi-iterative method with the spectral radius estimate
+	 * spectralRadius (0 turns it off) after delay plain steps. Default is one step. */
+	inline void setIterationBudget(const int maxIterations, const float residualReduction, const float stepTarget, const double seconds) {
+		m_solver.setIterationBudget(maxIterations, residualReduction, stepTarget, seconds); }
+	inline void setChebyshevAcceleration(const float spectralRadius, const int delay) { m_solver.setChebyshevAcceleration(spectralRadius, delay); }
+
 	pdTetPhysics() : m_tetPropsSet(false), m_solverInited(false), m_deformerInited(false), m_levelsetInited(false) {}
 
 	~pdTetPhysics() {
@@ -246,7 +313,7 @@ public:
 		m_solver.releaseDeformer();
 	}
 
-	inline void promoteAllSutures() { m_solver.premoteSutures(); m_solverInited = false;}
+	inline void promoteAllSutures() { m_solver.premoteSutures(); m_solverInited = false; ++m_changeCount; }
 
 	inline void initializeCollisionObject(const T levelSetDx) { if (!m_levelsetInited) { m_solver.initializeLevelSet(levelSetDx); m_levelsetInited = true; } }
 
@@ -259,4 +326,6 @@ private:
 
 	bool m_tetPropsSet;
 	bool m_levelsetInited;
+
+	unsigned int m_changeCount = 0;
 };
@@ -1,13 +1,191 @@
 #include "Utilities.h"
 #include "MergedLevelSet.h"
+#include "NarrowBandLevelSetMaker.h"
 
-#include <PhysBAM_Geometry/Topology_Based_Geometry/TRIANGULATED_SURFACE.h>
-#include <PhysBAM_Geometry/Grids_Uniform_Computations/LEVELSET_MAKER_UNIFORM.h>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <iterator>
+#include <stdexcept>
 #include <PhysBAM_Geometry/Grids_Uniform_Level_Sets/LEVELSET_3D.h>
 #include <PhysBAM_Geometry/Implicit_Objects_Uniform/LEVELSET_IMPLICIT_OBJECT.h>
 
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
 using namespace PhysBAM;
 
+namespace {
+	// A computed level set is cached next to its .obj as <name>_<key>.phi, where key hashes the .obj contents, dx and the
+	// scalar size, so an edited collision object or a different dx never reads a stale grid.
+	struct levelSetCacheHeader {
+		char magic[8];
+		uint32_t version;
+		uint32_t scalarBytes;
+		uint64_t key;
+		int32_t counts[3];  // GRID::Initialize() arguments
+		double domainMin[3], domainMax[3];
+		int32_t phiMin[3], phiMax[3];  // phi domain indices
+	};
+	const char levelSetCacheMagic[8] = { 'P', 'D', 'L', 'S', 'P', 'H', 'I', '\0' };
+	const uint32_t levelSetCacheVersion = 2;  // bumped whenever the way phi is computed changes
+
+	uint64_t fnv1a(const void* data, size_t size, uint64_t hash = 14695981039346656037ull)
+	{
+		const unsigned char* c = static_cast<const unsigned char*>(data);
+		for (size_t i = 0; i < size; ++i) {
+			hash ^= c[i];
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	class mappedFile
+	{
+	public:
+		bool open(const std::string& path)
+		{
+#ifdef _WIN32
+			_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+			if (_file == INVALID_HANDLE_VALUE)
+				return false;
+			LARGE_INTEGER size;
+			if (!GetFileSizeEx(_file, &size) || size.QuadPart == 0)
+				return false;
+			_mapping = CreateFileMappingA(_file, NULL, PAGE_READONLY, 0, 0, NULL);
+			if (_mapping == NULL)
+				return false;
+			_data = static_cast<const char*>(MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0));
+			if (_data == NULL)
+				return false;
+			_size = static_cast<size_t>(size.QuadPart);
+#else
+			int fd = ::open(path.c_str(), O_RDONLY);
+			if (fd < 0)
+				return false;
+			struct stat st;
+			if (fstat(fd, &st) != 0 || st.st_size == 0) {
+				::close(fd);
+				return false;
+			}
+			void* data = mmap(NULL, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+			::close(fd);  // the mapping keeps the file open
+			if (data == MAP_FAILED)
+				return false;
+			_data = static_cast<const char*>(data);
+			_size = static_cast<size_t>(st.st_size);
+#endif
+			return true;
+		}
+		const char* data() const { return _data; }
+		size_t size() const { return _size; }
+
+#ifdef _WIN32
+		mappedFile() : _data(nullptr), _size(0), _file(INVALID_HANDLE_VALUE), _mapping(NULL) {}
+		~mappedFile()
+		{
+			if (_data) UnmapViewOfFile(_data);
+			if (_mapping) CloseHandle(_mapping);
+			if (_file != INVALID_HANDLE_VALUE) CloseHandle(_file);
+		}
+#else
+		mappedFile() : _data(nullptr), _size(0) {}
+		~mappedFile() { if (_data) munmap(const_cast<char*>(_data), _size); }
+#endif
+		mappedFile(const mappedFile&) = delete;
+		mappedFile& operator=(const mappedFile&) = delete;
+
+	private:
+		const char* _data;
+		size_t _size;
+#ifdef _WIN32
+		HANDLE _file, _mapping;
+#endif
+	};
+
+	std::string levelSetCachePath(const std::string& objPath, uint64_t key)
+	{
+		std::string path(objPath);
+		size_t pos = path.rfind(".obj");
+		if (pos != std::string::npos && pos + 4 == path.size())
+			path.erase(pos);
+		char hex[24];
+		snprintf(hex, sizeof(hex), "_%016llx.phi", static_cast<unsigned long long>(key));
+		return path + hex;
+	}
+
+	template<class VectorType>
+	bool readLevelSetCache(const std::string& cachePath, uint64_t key, LEVELSET_IMPLICIT_OBJECT<VectorType>& levelSetObject)
+	{
+		using T = typename VectorType::SCALAR;
+		using IndexType = VECTOR<int, 3>;
+		mappedFile mf;
+		if (!mf.open(cachePath) || mf.size() < sizeof(levelSetCacheHeader))
+			return false;
+		levelSetCacheHeader header;
+		memcpy(&header, mf.data(), sizeof(header));
+		if (memcmp(header.magic, levelSetCacheMagic, sizeof(levelSetCacheMagic)) != 0 || header.version != levelSetCacheVersion
+			|| header.scalarBytes != sizeof(T) || header.key != key)
+			return false;
+		IndexType counts(header.counts[0], header.counts[1], header.counts[2]);
+		RANGE<IndexType> phiDomain(IndexType(header.phiMin[0], header.phiMin[1], header.phiMin[2]), IndexType(header.phiMax[0], header.phiMax[1], header.phiMax[2]));
+		IndexType phiCounts = phiDomain.Edge_Lengths() + 1;
+		if (phiCounts.Min() < 1 || mf.size() != sizeof(header) + sizeof(T) * size_t(phiCounts.Product()))
+			return false;
+		GRID<VectorType>& grid = levelSetObject.levelset.grid;
+		grid.Initialize(counts, RANGE<VectorType>(VectorType(T(header.domainMin[0]), T(header.domainMin[1]), T(header.domainMin[2])),
+			VectorType(T(header.domainMax[0]), T(header.domainMax[1]), T(header.domainMax[2]))));
+		levelSetObject.Update_Box();
+		levelSetObject.Update_Minimum_Cell_Size();
+		ARRAY<T, IndexType>& phi = levelSetObject.levelset.phi;
+		phi.Resize(phiDomain, false, false);
+		memcpy(phi.array.Get_Array_Pointer(), mf.data() + sizeof(header), sizeof(T) * phi.array.Size());
+		return true;
+	}
+
+	template<class VectorType>
+	void writeLevelSetCache(const std::string& cachePath, uint64_t key, const LEVELSET_IMPLICIT_OBJECT<VectorType>& levelSetObject)
+	{  // a cache that can't be written only costs the next load a recompute
+		using T = typename VectorType::SCALAR;
+		const GRID<VectorType>& grid = levelSetObject.levelset.grid;
+		const ARRAY<T, VECTOR<int, 3>>& phi = levelSetObject.levelset.phi;
+		levelSetCacheHeader header;
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, levelSetCacheMagic, sizeof(levelSetCacheMagic));
+		header.version = levelSetCacheVersion;
+		header.scalarBytes = sizeof(T);
+		header.key = key;
+		for (int i = 0; i < 3; ++i) {
+			header.counts[i] = grid.counts(i + 1);
+			header.domainMin[i] = grid.domain.min_corner(i + 1);
+			header.domainMax[i] = grid.domain.max_corner(i + 1);
+			header.phiMin[i] = phi.domain.min_corner(i + 1);
+			header.phiMax[i] = phi.domain.max_corner(i + 1);
+		}
+		// written under a temporary name so a concurrent or interrupted load never maps a partial file
+		std::string tmpPath = cachePath + ".tmp";
+		std::ofstream out(tmpPath, std::ios::binary);
+		if (!out.is_open())
+			return;
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		out.write(reinterpret_cast<const char*>(phi.array.Get_Array_Pointer()), sizeof(T) * phi.array.Size());
+		out.close();
+		if (!out || std::rename(tmpPath.c_str(), cachePath.c_str()) != 0)
+			std::remove(tmpPath.c_str());
+	}
+}
+
 
 template<class VectorType>
 typename MergedLevelSet<VectorType>::T MergedLevelSet<VectorType>::Extended_Phi(const VectorType& pos) const
@@ -61,43 +239,42 @@ void MergedLevelSet<VectorType>::addLevelSet(const std::string& collisionObjPath
 {
 	std::cout << collisionObjPath << std::endl;
 	using IndexType = VECTOR<int, d>;
+	auto start = std::chrono::steady_clock::now();
+
+	// The .obj is read once, both to key the cache and, on a miss, to be parsed
+	std::ifstream objFile(collisionObjPath, std::ios::binary);
+	if (!objFile.is_open())
+		throw std::logic_error("Unable to open collision object file " + collisionObjPath);
+	std::string objText((std::istreambuf_iterator<char>(objFile)), std::istreambuf_iterator<char>());
+	objFile.close();
+	uint64_t cacheKey = fnv1a(objText.data(), objText.size());
+	cacheKey = fnv1a(&gridDX, sizeof(T), cacheKey);
+	std::string cachePath = levelSetCachePath(collisionObjPath, cacheKey);
+
+	size_t idx = m_levelSet.size();
+	m_levelSet.push_back(nullptr);
+	m_levelSet[idx] = LEVELSET_IMPLICIT_OBJECT<VectorType>::Create();
+	if (readLevelSetCache(cachePath, cacheKey, *m_levelSet[idx])) {
+		std::cout << "level set mapped from " << cachePath << " in " << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << " seconds" << std::endl;
+		return;
+	}
 
 	std::vector<std::array<int, 3>> triangles;
 	std::vector<std::array<T, d>> particles;
 
-	pdUtilities::readObj<T, d>(collisionObjPath, triangles, particles);
+	std::istringstream objStream(objText);
+	pdUtilities::readObj<T, d>(objStream, triangles, particles);
+	objText.clear();
 	// triangles here need to use 0-based indices
 
-	const size_t nTris = triangles.size();
-	const size_t nVerts = particles.size();
-
-
-	TRIANGULATED_SURFACE<T>* levelset_surface;
-	levelset_surface = TRIANGULATED_SURFACE<T>::Create();
-
-	levelset_surface->particles.array_collection->Add_Elements(static_cast<int>(nVerts));
-	levelset_surface->mesh.elements.Exact_Resize(static_cast<int>(nTris));
-	for (int p = 0; p < nVerts; p++)
-		for (int v = 0; v < d; v++)
-			levelset_surface->particles.X(p + 1)(v + 1) = particles[p][v];
-
-	for (int e = 0; e < nTris; e++) {
-		for (int i = 0; i < d; i++)
-			levelset_surface->mesh.elements(e + 1)(i + 1) = triangles[e][i] + 1;
-	}
-
-	levelset_surface->mesh.number_nodes = static_cast<int>(nVerts);
-	levelset_surface->mesh.Initialize_Neighbor_Nodes();
-
 	VectorType maxCorner = VectorType(-FLT_MAX, -FLT_MAX, -FLT_MAX);
 	VectorType minCorner = VectorType(FLT_MAX, FLT_MAX, FLT_MAX);
-	for (int i = 1; i <= levelset_surface->particles.X.Size(); i++) {
-		const VectorType& X = levelset_surface->particles.X(i);
-		for (int j = 1; j <= d; j++) {
-			if (X(j) > maxCorner(j))
-				maxCorner(j) = X(j);
-			if (X(j) < minCorner(j))
-				minCorner(j) = X(j);
+	for (const auto& X : particles) {
+		for (int j = 0; j < d; j++) {
+			if (X[j] > maxCorner(j + 1))
+				maxCorner(j + 1) = X[j];
+			if (X[j] < minCorner(j + 1))
+				minCorner(j + 1) = X[j];
 		}
 	}
 
@@ -110,21 +287,18 @@ void MergedLevelSet<VectorType>::addLevelSet(const std::string& collisionObjPath
 	LOG::cout << "gridSize: " << gridSize << std::endl;
 	// Compute level set
 
-	size_t idx = m_levelSet.size();
-	m_levelSet.push_back(nullptr);
-	m_levelSet[idx] = LEVELSET_IMPLICIT_OBJECT<VectorType>::Create();
-	
 	m_levelSet[idx]->levelset.grid.Initialize(gridSize, RANGE<VectorType>(minCorner, maxCorner));
 	m_levelSet[idx]->Update_Box();
 	m_levelSet[idx]->Update_Minimum_Cell_Size();
 	//GRID<VectorType>& levelSetGrid = *new GRID<VectorType>(gridSize, RANGE<VectorType>(minCorner, maxCorner));
 	//ARRAY<T, IndexType>& phi = *new ARRAY<T, IndexType>;
-	LEVELSET_MAKER_UNIFORM<T> maker;
+	NarrowBandLevelSetMaker<T> maker;
 	std::cout << "before maker" << std::endl;
-	maker.Compute_Level_Set(*levelset_surface, m_levelSet[idx]->levelset.grid, m_levelSet[idx]->levelset.phi);
+	maker.computeLevelSet(triangles, particles, m_levelSet[idx]->levelset.grid, m_levelSet[idx]->levelset.phi);
 	std::cout << "after maker" << std::endl;
 	
-	delete levelset_surface;
+	writeLevelSetCache(cachePath, cacheKey, *m_levelSet[idx]);
+	std::cout << "level set computed in " << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << " seconds" << std::endl;
 }
 
 template
@@ -0,0 +1,310 @@
+#include "NarrowBandLevelSetMaker.h"
+
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+#include <tbb/parallel_for.h>
+#include <tbb/blocked_range.h>
+#include <PhysBAM_Tools/Grids_Uniform/GRID.h>
+#include <PhysBAM_Tools/Grids_Uniform_Arrays/ARRAYS_ND.h>
+#include <PhysBAM_Geometry/Basic_Geometry/SEGMENT_3D.h>
+#include <PhysBAM_Geometry/Basic_Geometry/TRIANGLE_3D.h>
+#include <PhysBAM_Geometry/Basic_Geometry_Intersections/SEGMENT_3D_TRIANGLE_3D_INTERSECTION.h>
+
+using namespace PhysBAM;
+
+template<class T>
+void NarrowBandLevelSetMaker<T>::initializeTriangles(const std::vector<std::array<int, 3>>& triangles, const std::vector<std::array<T, 3>>& positions)
+{
+	m_positions.clear();
+	m_positions.reserve(positions.size());
+	for (auto& p : positions)
+		m_positions.push_back(TV(p[0], p[1], p[2]));
+	m_triangles.clear();
+	m_triangles.reserve(triangles.size());
+	for (auto& t : triangles) {
+		triangleData td;
+		td.vertices = t;
+		const TV& a = m_positions[t[0]], & b = m_positions[t[1]], & c = m_positions[t[2]];
+		if (TV::Cross_Product(b - a, c - a).Magnitude() < T(2e-15))
+			continue;  // same area threshold LEVELSET_MAKER_UNIFORM removes degenerate triangles with
+		for (int i = 1; i <= 3; ++i) {
+			td.minCorner(i) = std::min(std::min(a(i), b(i)), c(i));
+			td.maxCorner(i) = std::max(std::max(a(i), b(i)), c(i));
+		}
+		td.center = (td.minCorner + td.maxCorner) * T(0.5);
+		td.radius = (td.maxCorner - td.center).Magnitude();
+		m_triangles.push_back(td);
+	}
+}
+
+template<class T>
+T NarrowBandLevelSetMaker<T>::distanceSquared(const TV& x, const triangleData& tri) const
+{  // closest point by region classification, Ericson, Real-Time Collision Detection 5.1.5
+	const TV& a = m_positions[tri.vertices[0]], & b = m_positions[tri.vertices[1]], & c = m_positions[tri.vertices[2]];
+	TV ab = b - a, ac = c - a, ap = x - a;
+	T d1 = TV::Dot_Product(ab, ap), d2 = TV::Dot_Product(ac, ap);
+	if (d1 <= 0 && d2 <= 0)
+		return ap.Magnitude_Squared();
+	TV bp = x - b;
+	T d3 = TV::Dot_Product(ab, bp), d4 = TV::Dot_Product(ac, bp);
+	if (d3 >= 0 && d4 <= d3)
+		return bp.Magnitude_Squared();
+	T vc = d1 * d4 - d3 * d2;
+	if (vc <= 0 && d1 >= 0 && d3 <= 0)
+		return (ap - d1 / (d1 - d3) * ab).Magnitude_Squared();
+	TV cp = x - c;
+	T d5 = TV::Dot_Product(ab, cp), d6 = TV::Dot_Product(ac, cp);
+	if (d6 >= 0 && d5 <= d6)
+		return cp.Magnitude_Squared();
+	T vb = d5 * d2 - d1 * d6;
+	if (vb <= 0 && d2 >= 0 && d6 <= 0)
+		return (ap - d2 / (d2 - d6) * ac).Magnitude_Squared();
+	T va = d3 * d6 - d5 * d4;
+	if (va <= 0 && (d4 - d3) >= 0 && (d5 - d6) >= 0)
+		return (bp - (d4 - d3) / ((d4 - d3) + (d5 - d6)) * (c - b)).Magnitude_Squared();
+	T denom = T(1) / (va + vb + vc);
+	return (ap - (vb * denom) * ab - (vc * denom) * ac).Magnitude_Squared();
+}
+
+template<class T>
+bool NarrowBandLevelSetMaker<T>::inside(const TV& x) const
+{  // winding number from the sum of the triangles' solid angles (Van Oosterom & Strackee), in double
+	double solidAngle = 0.0;
+	for (auto& tri : m_triangles) {
+		double v[3][3], l[3];
+		for (int i = 0; i < 3; ++i) {
+			const TV& p = m_positions[tri.vertices[i]];
+			for (int j = 0; j < 3; ++j)
+				v[i][j] = double(p(j + 1)) - double(x(j + 1));
+			l[i] = std::sqrt(v[i][0] * v[i][0] + v[i][1] * v[i][1] + v[i][2] * v[i][2]);
+		}
+		auto dot = [&](int i, int j) { return v[i][0] * v[j][0] + v[i][1] * v[j][1] + v[i][2] * v[j][2]; };
+		double det = v[0][0] * (v[1][1] * v[2][2] - v[1][2] * v[2][1]) - v[0][1] * (v[1][0] * v[2][2] - v[1][2] * v[2][0]) + v[0][2] * (v[1][0] * v[2][1] - v[1][1] * v[2][0]);
+		solidAngle += 2.0 * std::atan2(det, l[0] * l[1] * l[2] + dot(0, 1) * l[2] + dot(1, 2) * l[0] + dot(2, 0) * l[1]);
+	}
+	return solidAngle > 2.0 * 3.14159265358979;  // winding number above one half
+}
+
+template<class T>
+void NarrowBandLevelSetMaker<T>::computeLevelSet(const std::vector<std::array<int, 3>>& triangles, const std::vector<std::array<T, 3>>& positions, const GRID<TV>& grid, ARRAY<T, TV_INT>& phi)
+{
+	initializeTriangles(triangles, positions);
+	const TV_INT n = grid.counts;
+	phi.Resize(grid.Domain_Indices(), false, false);
+	const TV_INT nBricks((n.x + brickSize - 1) / brickSize, (n.y + brickSize - 1) / brickSize, (n.z + brickSize - 1) / brickSize);
+	const int brickCount = nBricks.x * nBricks.y * nBricks.z;
+	const size_t nodeCount = size_t(n.x) * n.y * n.z;
+	auto nodeIndex = [&](int i, int j, int k) { return (size_t(i - 1) * n.y + (j - 1)) * n.z + (k - 1); };
+	auto indexNode = [&](size_t index) { return TV_INT(int(index / (size_t(n.y) * n.z)) + 1, int(index / n.z % n.y) + 1, int(index % n.z) + 1); };
+	auto brickNodes = [&](int brick, TV_INT& lo, TV_INT& hi) {
+		TV_INT b(brick / (nBricks.y * nBricks.z), (brick / nBricks.z) % nBricks.y, brick % nBricks.z);
+		lo = b * brickSize + 1;
+		hi = TV_INT(std::min(lo.x + brickSize - 1, n.x), std::min(lo.y + brickSize - 1, n.y), std::min(lo.z + brickSize - 1, n.z));
+	};
+	auto clampedNode = [&](const TV& x, const bool roundUp) {
+		TV_INT idx;
+		for (int i = 1; i <= 3; ++i) {
+			T s = (x(i) - grid.domain.min_corner(i)) * grid.one_over_dX(i);
+			idx(i) = std::max(1, std::min(n(i), (roundUp ? int(std::ceil(s)) : int(std::floor(s))) + 1));
+		}
+		return idx;
+	};
+
+	// Bin each triangle to every brick its band could reach. Cheap next to the distance queries, so done serially.
+	const T band = m_bandCells * grid.dX.Max();
+	std::vector<std::vector<int>> brickTriangles(brickCount);
+	for (int t = 0; t < (int)m_triangles.size(); ++t) {
+		const triangleData& tri = m_triangles[t];
+		TV_INT lo = clampedNode(tri.minCorner - band, false), hi = clampedNode(tri.maxCorner + band, true);
+		for (int bi = (lo.x - 1) / brickSize; bi <= (hi.x - 1) / brickSize; ++bi)
+			for (int bj = (lo.y - 1) / brickSize; bj <= (hi.y - 1) / brickSize; ++bj)
+				for (int bk = (lo.z - 1) / brickSize; bk <= (hi.z - 1) / brickSize; ++bk)
+					brickTriangles[(bi * nBricks.y + bj) * nBricks.z + bk].push_back(t);
+	}
+	// Crossed edges are found with the slightly enlarged triangles and thickness of LEVELSET_MAKER_UNIFORM, so the
+	// flood fill can't leak between triangles that share an edge.
+	const T thicknessOverTwo = grid.Minimum_Edge_Length() / 200, padding = grid.Minimum_Edge_Length() / 100;
+	std::vector<TRIANGLE_3D<T>> enlarged;
+	enlarged.reserve(m_triangles.size());
+	for (auto& tri : m_triangles) {
+		enlarged.push_back(TRIANGLE_3D<T>(m_positions[tri.vertices[0]], m_positions[tri.vertices[1]], m_positions[tri.vertices[2]]));
+		enlarged.back().Change_Size(padding);
+	}
+
+	// Narrow band. Exact distance to the binned triangles. A node near enough for the surface to cross one of the three
+	// grid edges leading from it in the positive directions also marks those that are crossed.
+	enum { IN_BAND = 1, BLOCKED_X = 2, BLOCKED_Y = 4, BLOCKED_Z = 8 };
+	std::vector<unsigned char> flags(nodeCount, 0);
+	const T edgeReach = grid.dX.Max() + padding + thicknessOverTwo;
+	tbb::parallel_for(tbb::blocked_range<int>(0, brickCount, 1), [&](const tbb::blocked_range<int>& r) {
+		for (int brick = r.begin(); brick != r.end(); ++brick) {
+			const std::vector<int>& bt = brickTriangles[brick];
+			if (bt.empty())
+				continue;
+			TV_INT lo, hi;
+			brickNodes(brick, lo, hi);
+			for (int i = lo.x; i <= hi.x; ++i) for (int j = lo.y; j <= hi.y; ++j) for (int k = lo.z; k <= hi.z; ++k) {
+				TV_INT node(i, j, k);
+				TV x = grid.X(node);
+				T bestDist2 = band * band;
+				bool found = false;
+				for (int t : bt) {
+					T d2 = distanceSquared(x, m_triangles[t]);
+					if (d2 <= bestDist2) {
+						bestDist2 = d2;
+						found = true;
+					}
+				}
+				if (!found)
+					continue;
+				unsigned char& f = flags[nodeIndex(i, j, k)];
+				f = IN_BAND;
+				phi(node) = std::sqrt(bestDist2);
+				if (phi(node) > edgeReach)
+					continue;
+				for (int axis = 1; axis <= 3; ++axis) {
+					TV_INT next = node;
+					if (++next(axis) > n(axis))
+						continue;
+					SEGMENT_3D<T> edge(x, grid.X(next));
+					for (int t : bt)
+						if (INTERSECTION::Intersects(edge, enlarged[t], thicknessOverTwo)) {
+							f |= BLOCKED_X << (axis - 1);
+							break;
+						}
+				}
+			}
+		}
+	});
+	brickTriangles.clear();
+	brickTriangles.shrink_to_fit();
+	enlarged.clear();
+	enlarged.shrink_to_fit();
+
+	// Outside the band, exact distance from the triangles that could be closest to some node of the brick, searched in
+	// order of their distance from the brick. Each brick then labels its regions with the node index of the region's
+	// first node, keeping the region's node farthest from the surface to decide its sign.
+	std::vector<int> label(nodeCount, -1), parent(nodeCount, -1), farthest(nodeCount, -1);
+	const int triangleCount = (int)m_triangles.size();
+	tbb::parallel_for(tbb::blocked_range<int>(0, brickCount, 1), [&](const tbb::blocked_range<int>& r) {
+		std::vector<std::pair<T, int>> candidates;
+		std::vector<TV_INT> stack;
+		for (int brick = r.begin(); brick != r.end(); ++brick) {
+			TV_INT lo, hi;
+			brickNodes(brick, lo, hi);
+			candidates.clear();
+			TV bMin = grid.X(lo), bMax = grid.X(hi);
+			T upper2 = FLT_MAX;  // no node of the brick is farther than this from its closest triangle
+			for (int t = 0; t < triangleCount; ++t) {
+				const triangleData& tri = m_triangles[t];
+				T lower2 = 0, vertexDist2 = 0;
+				const TV& a = m_positions[tri.vertices[0]];
+				for (int i = 1; i <= 3; ++i) {
+					T gap = std::max(T(0), std::max(tri.minCorner(i) - bMax(i), bMin(i) - tri.maxCorner(i)));
+					lower2 += gap * gap;
+					T extent = std::max(std::abs(a(i) - bMin(i)), std::abs(a(i) - bMax(i)));
+					vertexDist2 += extent * extent;
+				}
+				upper2 = std::min(upper2, vertexDist2);
+				candidates.push_back(std::make_pair(lower2, t));
+			}
+			candidates.erase(std::remove_if(candidates.begin(), candidates.end(), [upper2](const std::pair<T, int>& c) { return c.first > upper2; }), candidates.end());
+			std::sort(candidates.begin(), candidates.end());
+			for (int i = lo.x; i <= hi.x; ++i) for (int j = lo.y; j <= hi.y; ++j) for (int k = lo.z; k <= hi.z; ++k) {
+				if (flags[nodeIndex(i, j, k)] & IN_BAND)
+					continue;
+				TV x = grid.X(TV_INT(i, j, k));
+				T bestDist2 = FLT_MAX, best = FLT_MAX;
+				for (auto& c : candidates) {
+					if (c.first >= bestDist2)
+						break;
+					const triangleData& tri = m_triangles[c.second];
+					if ((x - tri.center).Magnitude_Squared() >= (best + tri.radius) * (best + tri.radius))
+						continue;  // cheaper than the closest point when the triangle's bounding sphere can't be closer
+					T d2 = distanceSquared(x, tri);
+					if (d2 < bestDist2) {
+						bestDist2 = d2;
+						best = std::sqrt(d2);
+					}
+				}
+				phi(i, j, k) = best;
+			}
+			for (int i = lo.x; i <= hi.x; ++i) for (int j = lo.y; j <= hi.y; ++j) for (int k = lo.z; k <= hi.z; ++k) {
+				size_t seed = nodeIndex(i, j, k);
+				if (label[seed] > -1)
+					continue;
+				parent[seed] = label[seed] = farthest[seed] = (int)seed;
+				T farthestDist = phi(i, j, k);
+				stack.push_back(TV_INT(i, j, k));
+				while (!stack.empty()) {
+					TV_INT v = stack.back();
+					stack.pop_back();
+					size_t vi = nodeIndex(v.x, v.y, v.z);
+					if (phi(v) > farthestDist) {
+						farthestDist = phi(v);
+						farthest[seed] = (int)vi;
+					}
+					for (int axis = 1; axis <= 3; ++axis) for (int step = -1; step < 2; step += 2) {
+						TV_INT w = v;
+						w(axis) += step;
+						if (w(axis) < lo(axis) || w(axis) > hi(axis))
+							continue;
+						size_t wi = nodeIndex(w.x, w.y, w.z);
+						if (label[wi] > -1 || (flags[step > 0 ? vi : wi] & (BLOCKED_X << (axis - 1))))
+							continue;
+						label[wi] = (int)seed;
+						stack.push_back(w);
+					}
+				}
+			}
+		}
+	});
+
+	// Join the regions across brick faces. Serial, but only touches the nodes on brick boundaries.
+	auto findRoot = [&](int l) {
+		while (parent[l] != l)
+			l = parent[l];
+		return l;
+	};
+	auto join = [&](size_t a, size_t b, const unsigned char edgeBlocked) {
+		if (flags[a] & edgeBlocked)
+			return;
+		int ra = findRoot(label[a]), rb = findRoot(label[b]);
+		if (ra == rb)
+			return;
+		if (ra > rb)
+			std::swap(ra, rb);
+		parent[rb] = ra;
+		if (phi(indexNode(farthest[rb])) > phi(indexNode(farthest[ra])))
+			farthest[ra] = farthest[rb];
+	};
+	for (int i = brickSize; i < n.x; i += brickSize)
+		for (int j = 1; j <= n.y; ++j) for (int k = 1; k <= n.z; ++k)
+			join(nodeIndex(i, j, k), nodeIndex(i + 1, j, k), BLOCKED_X);
+	for (int j = brickSize; j < n.y; j += brickSize)
+		for (int i = 1; i <= n.x; ++i) for (int k = 1; k <= n.z; ++k)
+			join(nodeIndex(i, j, k), nodeIndex(i, j + 1, k), BLOCKED_Y);
+	for (int k = brickSize; k < n.z; k += brickSize)
+		for (int i = 1; i <= n.x; ++i) for (int j = 1; j <= n.y; ++j)
+			join(nodeIndex(i, j, k), nodeIndex(i, j, k + 1), BLOCKED_Z);
+
+	// One winding number per region, at the node where it is least sensitive to the surface's discretization.
+	std::vector<int> roots;
+	for (size_t i = 0; i < nodeCount; ++i)
+		if (parent[i] == (int)i)
+			roots.push_back((int)i);
+	std::vector<char> rootInside(nodeCount, 0);
+	tbb::parallel_for(tbb::blocked_range<size_t>(0, roots.size(), 1), [&](const tbb::blocked_range<size_t>& r) {
+		for (size_t i = r.begin(); i != r.end(); ++i)
+			rootInside[roots[i]] = inside(grid.X(indexNode(farthest[roots[i]])));
+	});
+	tbb::parallel_for(tbb::blocked_range<int>(1, n.x + 1), [&](const tbb::blocked_range<int>& r) {
+		for (int i = r.begin(); i != r.end(); ++i) for (int j = 1; j <= n.y; ++j) for (int k = 1; k <= n.z; ++k)
+			if (rootInside[findRoot(label[nodeIndex(i, j, k)])])
+				phi(i, j, k) = -phi(i, j, k);
+	});
+}
+
+template
+class NarrowBandLevelSetMaker<float>;
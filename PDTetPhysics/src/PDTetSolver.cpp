@@ -5,6 +5,9 @@
 #include <fstream>
 #include <sstream>
 #include <set>
+#include <array>
+#include <chrono>
+#include <limits>
 
 namespace {
 	// parameter for bcc tet with dual latice of side length 1
@@ -67,51 +70,161 @@ void PDTetSolver<T, d>::initializeSolver()
 	m_gridDeformer.deallocateAuxiliaryStructures();
 	m_gridDeformer.initializeElementFlags();
 	m_gridDeformer.initializeAuxiliaryStructures();
-	if (m_gridDeformer.m_collisionConstraints.size()||m_gridDeformer.m_collisionSutures.size()) {
+	if (m_globalSolverType == GlobalSolverType::Multigrid) {
+		hasCollision = m_gridDeformer.m_collisionConstraints.size() || m_gridDeformer.m_collisionSutures.size();
+		m_solver_mg.initialize(m_gridDeformer.m_nodeType);
+		// same element stiffness as the direct solvers use with and without collisions
+		if (hasCollision && !m_gridDeformer.m_elementShape.empty())
+			m_solver_mg.computeTensor(m_gridDeformer.m_elements, m_gridDeformer.m_elementShape, m_gridDeformer.m_shapeGradientMatrix, m_gridDeformer.m_shapeRestVolume, m_gridDeformer.m_muLow, m_gridDeformer.m_muHigh, m_gridDeformer.m_sutures, m_gridDeformer.m_InternodeConstraints);
+		else if (hasCollision)
+			m_solver_mg.computeTensor(m_gridDeformer.m_elements, m_gridDeformer.m_gradientMatrix, m_gridDeformer.m_elementRestVolume, m_gridDeformer.m_muLow, m_gridDeformer.m_muHigh, m_gridDeformer.m_sutures, m_gridDeformer.m_InternodeConstraints);
+		else if (!m_gridDeformer.m_elementShape.empty())
+			m_solver_mg.computeTensor(m_gridDeformer.m_elements, m_gridDeformer.m_elementShape, m_gridDeformer.m_shapeGradientMatrix, m_gridDeformer.m_shapeRestVolume, m_gridDeformer.m_muHigh[0] * (1 + m_weightProportion * m_weightProportion), m_gridDeformer.m_sutures, m_gridDeformer.m_InternodeConstraints);
+		else
+			m_solver_mg.computeTensor(m_gridDeformer.m_elements, m_gridDeformer.m_gradientMatrix, m_gridDeformer.m_elementRestVolume, m_gridDeformer.m_muHigh[0] * (1 + m_weightProportion * m_weightProportion), m_gridDeformer.m_sutures, m_gridDeformer.m_InternodeConstraints);
+		m_solver_mg.initializeHierarchy(m_gridDeformer.m_X, m_gridDeformer.m_constraints, m_gridDeformer.m_sutures, m_gridDeformer.m_fakeSutures, m_gridDeformer.m_InternodeConstraints);
+		std::cout << "using MultigridSolver" << std::endl;
+	}
+	else if (m_gridDeformer.m_collisionConstraints.size()||m_gridDeformer.m_collisionSutures.size()) {
 		hasCollision = true;
 #ifdef USE_CUDA
 		m_solver_c.releaseCuda();
-#endif
 		m_solver_c.releasePardiso();
+#else
+		m_solver_c.deallocatePardiso();  // symbolic factorization is reused if the pattern is unchanged
+#endif
 		m_solver_c.deallocate();
 
 		m_solver_c.initialize(m_gridDeformer.m_nodeType); // initialzie
-		m_solver_c.computeTensor(m_gridDeformer.m_elements, m_gridDeformer.m_gradientMatrix, m_gridDeformer.m_elementRestVolume, m_gridDeformer.m_muLow, m_gridDeformer.m_muHigh, m_gridDeformer.m_sutures, m_gridDeformer.m_InternodeConstraints); // computeTensor
+		if (!m_gridDeformer.m_elementShape.empty()) // BCC meshes assemble from one stiffness template per element shape
+			m_solver_c.computeTensor(m_gridDeformer.m_elements, m_gridDeformer.m_elementShape, m_gridDeformer.m_shapeGradientMatrix, m_gridDeformer.m_shapeRestVolume, m_gridDeformer.m_muLow, m_gridDeformer.m_muHigh, m_gridDeformer.m_sutures, m_gridDeformer.m_InternodeConstraints);
+		else
+			m_solver_c.computeTensor(m_gridDeformer.m_elements, m_gridDeformer.m_gradientMatrix, m_gridDeformer.m_elementRestVolume, m_gridDeformer.m_muLow, m_gridDeformer.m_muHigh, m_gridDeformer.m_sutures, m_gridDeformer.m_InternodeConstraints); // computeTensor
 #ifdef USE_CUDA
-		m_solver_c.computeE2Tensor(m_gridDeformer.m_elements, m_gridDeformer.m_elementFlags, m_gridDeformer.m_gradientMatrix, m_gridDeformer.m_elementRestVolume, m_gridDeformer.m_muHigh[0] * (1 + m_weightProportion * m_weightProportion)); // computeE2Tensor
+		if (!m_gridDeformer.m_elementShape.empty())
+			m_solver_c.computeE2Tensor(m_gridDeformer.m_elements, m_gridDeformer.m_elementFlags, m_gridDeformer.m_elementShape, m_gridDeformer.m_shapeGradientMatrix, m_gridDeformer.m_shapeRestVolume, m_gridDeformer.m_muHigh[0] * (1 + m_weightProportion * m_weightProportion));
+		else
+			m_solver_c.computeE2Tensor(m_gridDeformer.m_elements, m_gridDeformer.m_elementFlags, m_gridDeformer.m_gradientMatrix, m_gridDeformer.m_elementRestVolume, m_gridDeformer.m_muHigh[0] * (1 + m_weightProportion * m_weightProportion)); // computeE2Tensor
+#else
+		if (!m_gridDeformer.m_elementShape.empty())
+			m_solver_c.computeE2Tensor(m_gridDeformer.m_elements, m_gridDeformer.m_elementFlags, m_gridDeformer.m_elementShape, m_gridDeformer.m_shapeGradientMatrix, m_gridDeformer.m_shapeRestVolume, m_gridDeformer.m_muLow, m_gridDeformer.m_muHigh);
+		else
+			m_solver_c.computeE2Tensor(m_gridDeformer.m_elements, m_gridDeformer.m_elementFlags, m_gridDeformer.m_gradientMatrix, m_gridDeformer.m_elementRestVolume, m_gridDeformer.m_muLow, m_gridDeformer.m_muHigh);
 #endif
 		m_solver_c.initializePardiso(m_gridDeformer.m_constraints, m_gridDeformer.m_sutures, m_gridDeformer.m_fakeSutures, m_gridDeformer.m_InternodeConstraints); // init pardiso
 #ifdef USE_CUDA
 		m_solver_c.initializeCuda(m_gridDeformer.m_collisionConstraints, m_gridDeformer.m_collisionSutures); // init Cuda
 		std::cout << "using CudaSolver with nInner = " << m_nInner << std::endl;
 #else
-		std::cout << "using MKLSolver"<< std::endl;
+		m_solver_c.initializeCollision(m_gridDeformer.m_collisionConstraints, m_gridDeformer.m_collisionSutures);
+		std::cout << "using CollisionSchurSolver with nInner = " << m_nInner << std::endl;
 #endif
 	}
 	else {
 		hasCollision = false;
-		m_solver_d.releasePardiso();
+		m_solver_d.deallocatePardiso();
 		m_solver_d.deallocate();
 
 		m_solver_d.initialize(m_gridDeformer.m_nodeType);
-		m_solver_d.computeTensor(m_gridDeformer.m_elements, m_gridDeformer.m_gradientMatrix, m_gridDeformer.m_elementRestVolume, m_gridDeformer.m_muHigh[0] * (1 + m_weightProportion * m_weightProportion), m_gridDeformer.m_sutures, m_gridDeformer.m_InternodeConstraints);
+		if (!m_gridDeformer.m_elementShape.empty())
+			m_solver_d.computeTensor(m_gridDeformer.m_elements, m_gridDeformer.m_elementShape, m_gridDeformer.m_shapeGradientMatrix, m_gridDeformer.m_shapeRestVolume, m_gridDeformer.m_muHigh[0] * (1 + m_weightProportion * m_weightProportion), m_gridDeformer.m_sutures, m_gridDeformer.m_InternodeConstraints);
+		else
+			m_solver_d.computeTensor(m_gridDeformer.m_elements, m_gridDeformer.m_gradientMatrix, m_gridDeformer.m_elementRestVolume, m_gridDeformer.m_muHigh[0] * (1 + m_weightProportion * m_weightProportion), m_gridDeformer.m_sutures, m_gridDeformer.m_InternodeConstraints);
 		m_solver_d.initializePardiso(m_gridDeformer.m_constraints, m_gridDeformer.m_sutures, m_gridDeformer.m_fakeSutures, m_gridDeformer.m_InternodeConstraints);
 		std::cout << "using DirectSolver" << std::endl;
 	}
+	recordFactoredStiffness();
+}
+
+template<class T, int d>
+void PDTetSolver<T, d>::recordFactoredStiffness()
+{
+	m_factoredConstraintStiffness.resize(m_gridDeformer.m_constraints.size());
+	for (size_t i = 0; i < m_gridDeformer.m_constraints.size(); i++)
+		m_factoredConstraintStiffness[i] = m_gridDeformer.m_constraints[i].m_stiffness;
+	m_factoredSutureStiffness.resize(m_gridDeformer.m_sutures.size());
+	for (size_t i = 0; i < m_gridDeformer.m_sutures.size(); i++)
+		m_factoredSutureStiffness[i] = m_gridDeformer.m_sutures[i].m_stiffness;
+	m_factoredFakeSutureStiffness.resize(m_gridDeformer.m_fakeSutures.size());
+	for (size_t i = 0; i < m_gridDeformer.m_fakeSutures.size(); i++)
+		m_factoredFakeSutureStiffness[i] = m_gridDeformer.m_fakeSutures[i].m_stiffness;
+}
+
+template<class T, int d>
+template<class SolverType>
+bool PDTetSolver<T, d>::lowRankUpdate(SolverType& solver)
+{
+	// Each hook or fake suture half changes the matrix by stiffness * w * w^T, a suture by stiffness * [w1, -w2] * [w1, -w2]^T.
+	// Terms are rebuilt against the last factorization, so a hook added and deleted again cancels out.
+	const auto& constraints = m_gridDeformer.m_constraints;
+	const auto& sutures = m_gridDeformer.m_sutures;
+	const auto& fakeSutures = m_gridDeformer.m_fakeSutures;
+	if (constraints.size() < m_factoredConstraintStiffness.size() || sutures.size() < m_factoredSutureStiffness.size() || fakeSutures.size() < m_factoredFakeSutureStiffness.size())
+		return false;
+	solver.clearLowRank();
+	auto addConstraintTerm = [&](const typename DeformerType::Constraint& c, const T factoredStiffness) {
+		if (c.m_stiffness == factoredStiffness)
+			return true;
+		if (solver.lowRankTerms() >= m_maxLowRankTerms)
+			return false;
+		solver.template addLowRankTerm<d + 1>(c.m_elementIndex, c.m_weights, c.m_stiffness - factoredStiffness);
+		return true;
+	};
+	for (size_t i = 0; i < constraints.size(); i++)
+		if (!addConstraintTerm(constraints[i], i < m_factoredConstraintStiffness.size() ? m_factoredConstraintStiffness[i] : T(0)))
+			return false;
+	for (size_t i = 0; i < fakeSutures.size(); i++)
+		if (!addConstraintTerm(fakeSutures[i], i < m_factoredFakeSutureStiffness.size() ? m_factoredFakeSutureStiffness[i] : T(0)))
+			return false;
+	for (size_t i = 0; i < sutures.size(); i++) {
+		const T factoredStiffness = i < m_factoredSutureStiffness.size() ? m_factoredSutureStiffness[i] : T(0);
+		if (sutures[i].m_stiffness == factoredStiffness)
+			continue;
+		if (solver.lowRankTerms() >= m_maxLowRankTerms)
+			return false;
+		std::array<int, 2 * (d + 1)> elementIndex;
+		std::array<T, 2 * (d + 1)> weights;
+		for (int v = 0; v < d + 1; v++) {
+			elementIndex[v] = sutures[i].m_elementIndex1[v];
+			elementIndex[v + d + 1] = sutures[i].m_elementIndex2[v];
+			weights[v] = sutures[i].m_weights1[v];
+			weights[v + d + 1] = -sutures[i].m_weights2[v];
+		}
+		solver.template addLowRankTerm<2 * (d + 1)>(elementIndex, weights, sutures[i].m_stiffness - factoredStiffness);
+	}
+	solver.factorLowRank();
+	return true;
 }
 
 template<class T, int d>
 void PDTetSolver<T, d>::reInitializeSolver()
 {
+	if (m_globalSolverType == GlobalSolverType::Multigrid) {
+		m_solver_mg.setConstraints(m_gridDeformer.m_constraints, m_gridDeformer.m_sutures, m_gridDeformer.m_fakeSutures, m_gridDeformer.m_InternodeConstraints);
+		recordFactoredStiffness();
+		return;
+	}
+#ifdef USE_CUDA
+	// the CUDA collision solver has no low rank path and always refactors
+	if (!hasCollision && lowRankUpdate(m_solver_d))
+		return;
+#else
+	// the collision solver carries the terms through its inner iterations on the collision block
+	if (hasCollision ? lowRankUpdate(m_solver_c) : lowRankUpdate(m_solver_d))
+		return;
+#endif
 	if (hasCollision) {
 		m_solver_c.reInitializePardiso(m_gridDeformer.m_constraints, m_gridDeformer.m_sutures, m_gridDeformer.m_fakeSutures, m_gridDeformer.m_InternodeConstraints);
 #ifdef USE_CUDA
 		m_solver_c.reInitializeCuda(m_gridDeformer.m_collisionConstraints, m_gridDeformer.m_collisionSutures);
+#else
+		m_solver_c.initializeCollision(m_gridDeformer.m_collisionConstraints, m_gridDeformer.m_collisionSutures);
 #endif
 	}
 	else {
 		m_solver_d.reInitializePardiso(m_gridDeformer.m_constraints, m_gridDeformer.m_sutures, m_gridDeformer.m_fakeSutures, m_gridDeformer.m_InternodeConstraints);
 	}
+	recordFactoredStiffness();
 }
 
 template<class T, int d>
@@ -164,6 +277,60 @@ void PDTetSolver<T, d>::addSelfCollisionElements(const int* tets, size_t length)
 
 template<class T, int d>
 void PDTetSolver<T, d>::solve()
+{
+	using StateVariableType = typename DiscretizationType::StateVariableType;
+	using IteratorType = typename DeformerType::IteratorType;
+
+	const auto start = std::chrono::steady_clock::now();
+	const StateVariableType X0 = m_gridDeformer.m_X;
+	StateVariableType X_previous = X0; // x^(k-1) of the Chebyshev recurrence
+	StateVariableType X_current; // x^k
+	T omega = 1, lastStep = std::numeric_limits<T>::max();
+	int accelerated = -m_chebyshevDelay; // iterations since the acceleration started
+	T firstResidual = 0;
+
+	m_lastIterations = 0;
+	while (true) {
+		X_current = m_gridDeformer.m_X;
+		localGlobalStep();
+		if (++m_lastIterations == 1)
+			firstResidual = m_lastResidual;
+
+		m_lastStep = 0;
+		for (IteratorType i(X_current); !i.isEnd(); i.next())
+			if (i.value(m_gridDeformer.m_nodeType) != NodeType::Inactive)
+				m_lastStep = std::max(m_lastStep, (i.value(m_gridDeformer.m_X) - i.value(X_current)).Magnitude());
+		m_lastSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		// m_lastResidual is that of the iterate this step started from, so a met residual target ends the loop one step late
+		if (m_lastIterations >= m_maxIterations || m_lastResidual <= m_residualReduction * firstResidual || m_lastStep <= m_stepTarget
+			|| m_lastSeconds >= m_timeBudget)
+			break;
+
+		// Chebyshev semi-iterative extrapolation x^(k+1) = omega * (G(x^k) - x^(k-1)) + x^(k-1) after m_chebyshevDelay plain steps,
+		// restarted whenever a step grows as the estimate of the spectral radius was too large for it.
+		if (m_lastStep > lastStep)
+			accelerated = -m_chebyshevDelay;
+		lastStep = m_lastStep;
+		if (m_spectralRadius > 0 && ++accelerated > 0) {
+			const T rho2 = m_spectralRadius * m_spectralRadius;
+			omega = accelerated == 1 ? 2 / (2 - rho2) : 4 / (4 - rho2 * omega);
+			for (IteratorType i(X_previous); !i.isEnd(); i.next())
+				if (i.value(m_gridDeformer.m_nodeType) != NodeType::Inactive)
+					i.value(m_gridDeformer.m_X) = omega * (i.value(m_gridDeformer.m_X) - i.value(X_previous)) + i.value(X_previous);
+			embedInvalidNodes();
+		}
+		std::swap(X_previous, X_current);
+	}
+
+	m_lastMotion = 0;
+	for (IteratorType i(X0); !i.isEnd(); i.next())
+		if (i.value(m_gridDeformer.m_nodeType) != NodeType::Inactive)
+			m_lastMotion = std::max(m_lastMotion, (i.value(m_gridDeformer.m_X) - i.value(X0)).Magnitude());
+	recordActiveCollisions();
+}
+
+template<class T, int d>
+void PDTetSolver<T, d>::localGlobalStep()
 {
 	using StateVariableType = typename DiscretizationType::StateVariableType;
 	using IteratorType = typename DeformerType::IteratorType;
@@ -181,7 +348,39 @@ void PDTetSolver<T, d>::solve()
 	m_gridDeformer.addElasticForce(f, ElementFlag::unCollisionEl /*, m_rangeMin, m_rangeMax, m_weightProportion */); //addR1Force
 	m_gridDeformer.addConstraintForce(f); //addConstraintForec
 
-	if (hasCollision) {
+	// the residual is the largest force on an active node before the step, collision response included
+	const auto largestForce = [&](const StateVariableType& force) {
+		T largest = 0;
+		for (IteratorType i(force); !i.isEnd(); i.next())
+			if (i.value(m_gridDeformer.m_nodeType) != NodeType::Inactive)
+				largest = std::max(largest, i.value(force).Magnitude());
+		return largest;
+	};
+
+	if (m_globalSolverType == GlobalSolverType::Multigrid) {
+		if (hasCollision) {
+			updateCollisionConstraints();
+			m_solver_mg.updateCollision(m_gridDeformer.m_collisionConstraints, m_gridDeformer.m_collisionSutures);
+			m_gridDeformer.updatePositionBasedState(ElementFlag::CollisionEl);
+			m_gridDeformer.addElasticForce(f, ElementFlag::CollisionEl);
+			m_gridDeformer.addCollisionForce(f);
+		}
+		m_lastResidual = largestForce(f);
+		m_solver_mg.copyIn(f);
+		m_solver_mg.solve();
+		m_solver_mg.copyOut(delta_X);
+		AlgebraType::addTo(m_gridDeformer.m_X, delta_X);
+	}
+	else if (hasCollision) {
+		// the inner iterations add the collision terms to the substituted force, so they are evaluated once more here
+		{
+			StateVariableType r = f;
+			updateCollisionConstraints();
+			m_gridDeformer.updatePositionBasedState(ElementFlag::CollisionEl);
+			m_gridDeformer.addElasticForce(r, ElementFlag::CollisionEl);
+			m_gridDeformer.addCollisionForce(r);
+			m_lastResidual = largestForce(r);
+		}
 #ifdef USE_CUDA
 		StateVariableType u{};
 		iterator.resize(u);
@@ -265,41 +464,75 @@ void PDTetSolver<T, d>::solve()
 		StateVariableType u{};
 		iterator.resize(u);
 
-		updateCollisionConstraints();     // updateCollision
-		m_solver_c.updatePardiso(m_gridDeformer.m_collisionConstraints, m_gridDeformer.m_collisionSutures);
-			m_gridDeformer.updatePositionBasedState(ElementFlag::CollisionEl /*, m_rangeMin, m_rangeMax*/); // updateR2
-			m_gridDeformer.addElasticForce(f, ElementFlag::CollisionEl /*, m_rangeMin, m_rangeMax, m_weightProportion */ ); // addR2Force
-			m_gridDeformer.addCollisionForce(f);     // addCollisionForce
+		// same iterations as the CUDA path, with all d columns substituted at once
+		m_solver_c.copyIn(f);
+		m_solver_c.forwardSubstitution();
+		m_solver_c.setTemp();
+		m_solver_c.copyOut(f);
 
-			for (int v = 0; v < d; v++) {
-				m_solver_c.copyIn(f, v); //copyIn
-				m_solver_c.solve(); //diagSolve
-				m_solver_c.copyOut(delta_X, v);//copyOutTime
-			}
+		for (int inner_i = 0; inner_i < m_nInner; inner_i++) {
+			updateCollisionConstraints();
+			m_solver_c.updateCollision(m_gridDeformer.m_collisionConstraints, m_gridDeformer.m_collisionSutures);
+
+			StateVariableType f_temp{};
+			iterator.resize(f_temp);
+			for (IteratorType iterator(f); !iterator.isEnd(); iterator.next())
+				if (iterator.value(m_gridDeformer.m_nodeType) != NodeType::Collision)
+					iterator.value(f_temp) = iterator.value(f);
+
+			m_gridDeformer.updatePositionBasedState(ElementFlag::CollisionEl); // updateR2
+			m_gridDeformer.addElasticForce(f_temp, ElementFlag::CollisionEl); // addR2Force
+			m_gridDeformer.addCollisionForce(f_temp);
+
+			m_solver_c.copyIn(f_temp);
+			m_solver_c.updateForce();
+			m_solver_c.diagSolve();
+			m_solver_c.updateTemp();
+			m_solver_c.copyOut(delta_X);
+
+			// update x2 and accumulate it in u
+			for (IteratorType iterator(delta_X); !iterator.isEnd(); iterator.next())
+				if (iterator.value(m_gridDeformer.m_nodeType) == NodeType::Collision) {
+					iterator.value(m_gridDeformer.m_X) += iterator.value(delta_X);
+					iterator.value(u) += iterator.value(delta_X);
+				}
+				else if (iterator.value(m_gridDeformer.m_nodeType) == NodeType::Inactive)
+					iterator.value(delta_X) = VectorType();
+		}
+		// copy in x1 part
+		for (IteratorType iterator(u); !iterator.isEnd(); iterator.next())
+			if (iterator.value(m_gridDeformer.m_nodeType) != NodeType::Collision)
+				iterator.value(u) = iterator.value(delta_X);
 
-			for (IteratorType i(delta_X); !i.isEnd(); i.next())
-				if (i.value(m_gridDeformer.m_nodeType) == NodeType::Inactive)
-					i.value(delta_X) = VectorType();
+		m_solver_c.copyIn(u);
+		m_solver_c.backwardSubstitution();
+		m_solver_c.copyOut(delta_X);
 
 		// update x1
-		for (IteratorType i(delta_X); !i.isEnd(); i.next())
-				i.value(m_gridDeformer.m_X) += i.value(delta_X);
+		for (IteratorType iterator(delta_X); !iterator.isEnd(); iterator.next())
+			if (iterator.value(m_gridDeformer.m_nodeType) != NodeType::Collision)
+				iterator.value(m_gridDeformer.m_X) += iterator.value(delta_X);
 #endif
 	}
 	else {
 		//m_boxTest.clearDirichlet(m_boxTest.m_geometry, deformer.m_nodeType, f);
 
-		for (int v = 0; v < d; v++) {
-			m_solver_d.copyIn(f, v);
-			m_solver_d.solve();
-			m_solver_d.copyOut(delta_X, v);
-		}
+		m_lastResidual = largestForce(f);
+		m_solver_d.copyIn(f);
+		m_solver_d.solve();
+		m_solver_d.copyOut(delta_X);
 		AlgebraType::addTo(m_gridDeformer.m_X, delta_X);
 	}
 
 	for (IteratorType i(delta_X); !i.isEnd(); i.next())
 	 	if (i.value(m_gridDeformer.m_nodeType) == NodeType::Inactive)
 	 		i.value(delta_X) = VectorType();
+	embedInvalidNodes();
+}
+
+template<class T, int d>
+void PDTetSolver<T, d>::embedInvalidNodes()
+{
 	for (int i = 0; i < invalidNodes.size(); ++i) {
 		m_gridDeformer.m_X[invalidNodes[i]] = VectorType();
 		for (int j = 0; j < invalidEmbedding[i].size(); ++j) {
@@ -308,6 +541,22 @@ void PDTetSolver<T, d>::solve()
 	}
 }
 
+template<class T, int d>
+void PDTetSolver<T, d>::recordActiveCollisions()
+{
+	const auto& constraints = m_gridDeformer.m_collisionConstraints;
+	const auto& sutures = m_gridDeformer.m_collisionSutures;
+	m_collisionsChanged = m_activeCollisions.size() != constraints.size() + sutures.size();
+	m_activeCollisions.resize(constraints.size() + sutures.size());
+	for (size_t i = 0; i < m_activeCollisions.size(); i++) {
+		const bool active = (i < constraints.size() ? constraints[i].m_stiffness : sutures[i - constraints.size()].m_stiffness) != 0;
+		if (m_activeCollisions[i] != active) {
+			m_activeCollisions[i] = active;
+			m_collisionsChanged = true;
+		}
+	}
+}
+
 template<class T, int d>
 PDTetSolver<T, d>::~PDTetSolver()
 {
@@ -538,6 +787,13 @@ void PDTetSolver<T, d>::initializeDeformer(const int(*elements)[d + 1], const si
 					m_gridDeformer.m_gradientMatrix[i](v + 1, w + 1) = ::bccDmInv[(size_t)w * d + v] / T(gridSize);
 			m_gridDeformer.m_elementRestVolume[i] = T(::vol) * gridSize * gridSize * gridSize;
 		}
+		// every BCC tet has the same shape, so the elastic force kernel only needs one table entry
+		m_gridDeformer.m_shapeGradientMatrix.resize(1);
+		for (int v = 0; v < d; v++)
+			for (int w = 0; w < d; w++)
+				m_gridDeformer.m_shapeGradientMatrix[0](v + 1, w + 1) = ::bccDmInv[(size_t)w * d + v] / T(gridSize);
+		m_gridDeformer.m_shapeRestVolume.assign(1, T(::vol) * gridSize * gridSize * gridSize);
+		m_gridDeformer.m_elementShape.assign(nEls, 0);
 	}
 
 }
@@ -592,12 +848,25 @@ void PDTetSolver<T, d>::initializeDeformer_multires(const int(*elements)[d + 1],
 	{
 		m_gridDeformer.m_gradientMatrix.resize(nEls);
 		m_gridDeformer.m_elementRestVolume.resize(nEls);
+		// BCC tets differ only by their size multiplier, one shape table entry per distinct multiplier
+		std::array<int, 256> shapeOfSize;
+		shapeOfSize.fill(-1);
+		m_gridDeformer.m_shapeGradientMatrix.clear();
+		m_gridDeformer.m_shapeRestVolume.clear();
+		m_gridDeformer.m_elementShape.resize(nEls);
 		for (int i = 0; i < nEls; i++) {
 			T sizeMult(tetSizeMultipliers[i]);
 			for (int v = 0; v < d; v++)
 				for (int w = 0; w < d; w++)
 					m_gridDeformer.m_gradientMatrix[i](v + 1, w + 1) = ::bccDmInv[(size_t)w * d + v] / (T(gridSize) * sizeMult);
 			m_gridDeformer.m_elementRestVolume[i] = T(::vol) * gridSize * gridSize * gridSize *sizeMult* sizeMult* sizeMult;
+			int &shape = shapeOfSize[tetSizeMultipliers[i]];
+			if (shape < 0) {
+				shape = (int)m_gridDeformer.m_shapeGradientMatrix.size();
+				m_gridDeformer.m_shapeGradientMatrix.push_back(m_gridDeformer.m_gradientMatrix[i]);
+				m_gridDeformer.m_shapeRestVolume.push_back(m_gridDeformer.m_elementRestVolume[i]);
+			}
+			m_gridDeformer.m_elementShape[i] = (uint8_t)shape;
 		}
 	}
 }
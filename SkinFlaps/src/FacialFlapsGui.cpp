@@ -57,4 +57,5 @@ int FacialFlapsGui::hourglassWidth, FacialFlapsGui::hourglassHeight;
 float FacialFlapsGui::lastSurgX, FacialFlapsGui::lastSurgY;
 surgicalActions FacialFlapsGui::igSurgAct;
 gl3wGraphics FacialFlapsGui::igGl3w;
+gl3wRenderer FacialFlapsGui::igRenderer;
 
@@ -26,6 +26,7 @@
 #include <tbb/task_arena.h>
 #include <gl3wGraphics.h>
 #include "surgicalActions.h"
+#include "gl3wRenderer.h"
 
 static ImGuiKey ImGui_ImplGlfw_KeyToImGuiKey(int key)
 {
@@ -156,6 +157,7 @@ public:
 				buttonsDown |= 4;
 				std::string name; float position[3]; int triangle = 1;
 				igGl3w.pick((unsigned short)xpos, (unsigned short)ypos, name, position, triangle);
+				surfacePick(name, triangle);
 				if (!name.empty()) {
 					if (igSurgAct.rightMouseDown(name, position, triangle)) {
 						lastSurgX = (float)xpos;
@@ -171,6 +173,7 @@ public:
 				if (surgicalDrag) {
 					std::string name; float position[3]; int triangle = 1;
 					igGl3w.pick((unsigned short)xpos, (unsigned short)ypos, name, position, triangle, true);
+					surfacePick(name, triangle);
 					igSurgAct.rightMouseUp(name, position, triangle);  // no longer matters how it returns
 					surgicalDrag = false;
 				}
@@ -246,8 +249,12 @@ public:
 				glfwSetWindowShouldClose(window, 1);
 			else if (mods & (GLFW_MOD_SHIFT | GLFW_MOD_CONTROL))
 				ctrlShiftKeyDown = true;
+			else if (key == GLFW_KEY_DELETE)
+				igSurgAct.onDeleteKey();
+			else if (key == GLFW_KEY_ENTER)
+				igSurgAct.onEnterKey();
 			else
-				igSurgAct.onKeyDown(key);
+				;
 		}
 		else if (action == GLFW_RELEASE && scancode != 0) {
 
@@ -256,7 +263,7 @@ public:
 			else if ((mods & (GLFW_MOD_SHIFT | GLFW_MOD_CONTROL)) == 0)
 				ctrlShiftKeyDown = false;
 			else
-					igSurgAct.onKeyUp(key);
+				;
 		}
 		else  // action == GLFW_REPEAT ignore or forced synthetic GLFW key release
 			;
@@ -293,7 +300,8 @@ public:
 	static bool initCleftSim() {
 		csgToolstate = 0;
 		igGl3w.initializeGraphics();
-		igSurgAct.setGl3wGraphics(&igGl3w);
+		igRenderer.setGl3wGraphics(&igGl3w);
+		igSurgAct.setRenderer(&igRenderer);
 		glfwSetMouseButtonCallback(FFwindow, &mouse_button_callback);
 		glfwSetCursorPosCallback(FFwindow, &cursor_position_callback);
 		glfwSetScrollCallback(FFwindow, mouse_wheel_callback);
@@ -395,6 +403,7 @@ public:
 
 	static inline surgicalActions* getSurgicalActions() { return &igSurgAct; }
 	static inline gl3wGraphics* getgl3wGraphics() { return &igGl3w; }
+	static inline gl3wRenderer* getRenderer() { return &igRenderer; }
 
 	static inline bool CtrlOrShiftKeyIsDown() { return ctrlShiftKeyDown;  }
 
@@ -822,7 +831,6 @@ public:
 	}
 
 	FacialFlapsGui(){
-		igSurgAct.setFacialFlapsGui(this);
 		user_message_flag = false;
 	}
 
@@ -847,6 +855,13 @@ private:
 	static float lastSurgX, lastSurgY;
 	static surgicalActions igSurgAct;
 	static gl3wGraphics igGl3w;
+	static gl3wRenderer igRenderer;
+
+	static void surfacePick(std::string& name, int& triangle)
+	{  // surgicalActions only takes triangles on its dynamic surface
+		if (!name.empty() && igGl3w.getNodePtr(name)->getType() != sceneNode::nodeType::MATERIAL_TRIANGLES)
+			triangle = -1;
+	}
 
 };  // class FacialFlapsGui
 
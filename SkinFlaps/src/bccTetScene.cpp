@@ -16,7 +16,6 @@
 #include <string>
 #include <fstream>
 #include <algorithm>
-#include "gl3wGraphics.h"
 #include "surgicalActions.h"
 #include "boundingBox.h"
 #include "json.h"
@@ -55,7 +54,6 @@ bool bccTetScene::loadScene(const char *dataDirectory, const char *sceneFileName
 	json::Object scnObj = my_data.ToObject();
 	json::Object::ValueMap::iterator oit, suboit, suboit2;
 	// get texture files first
-	std::map<int, GLuint> txMap;
 	std::string nrm, tex;
 	if ((oit = scnObj.find("textureFiles")) == scnObj.end()) {
 		_surgAct->sendUserMessage("No texture files in scene file-", "Error Message");
@@ -65,21 +63,17 @@ bool bccTetScene::loadScene(const char *dataDirectory, const char *sceneFileName
 		json::Object txObj = oit->second.ToObject();
 		for (suboit = txObj.begin(); suboit != txObj.end(); ++suboit) {
 			path = dataDirectory + suboit->first;
-			GLuint txNow = _gl3w->getTextures()->loadTexture(suboit->second.ToInt(), path.c_str());
-			if (txNow > 0xfffffffe) {
+			if (!_renderer->loadTexture(suboit->second.ToInt(), path.c_str())) {
 				path = "Unable to load bitmap .bmp input file: " + path;
 				_surgAct->sendUserMessage(path.c_str(), "Error Message");
 				return false;
 			}
-			int txNum = suboit->second.ToInt();
-			txMap.insert(std::make_pair(txNum, txNow));
 		}
 	}
 	if ((oit = scnObj.find("staticObjects")) != scnObj.end()) {
 		json::Object statObj = oit->second.ToObject();
 		for (suboit = statObj.begin(); suboit != statObj.end(); ++suboit) {
 			path = dataDirectory + suboit->first;
-			std::map<int, GLuint>::iterator tit;
 			std::vector<int> txIds;
 			json::Object tmapObj = suboit->second.ToObject();
 			for (suboit2 = tmapObj.begin(); suboit2 != tmapObj.end(); ++suboit2) {
@@ -92,8 +86,8 @@ bool bccTetScene::loadScene(const char *dataDirectory, const char *sceneFileName
 					return false;
 				}
 			}
-			// this is a staticTriangle, not elastic so put on graphics card and clean up
-			if ( _gl3w->loadStaticObjFile(path.c_str(), txIds, true) == NULL)
+			// scenery only, not elastic
+			if (!_renderer->loadStaticObject(path.c_str(), txIds))
 			{
 				_surgAct->sendUserMessage("Unable to load fixed triangle .obj input file-", "Error Message");
 				return false;
@@ -111,7 +105,6 @@ bool bccTetScene::loadScene(const char *dataDirectory, const char *sceneFileName
 		std::vector<int> txIds;
 		for (suboit = dynObj.begin(); suboit != dynObj.end(); ++suboit) {
 			path = dataDirectory + suboit->first;
-			std::map<int, GLuint>::iterator tit;
 			json::Object tmapObj = suboit->second.ToObject();
 			for (suboit2 = tmapObj.begin(); suboit2 != tmapObj.end(); ++suboit2) {
 				if (suboit2->first == "textureMaps") {
@@ -119,33 +112,29 @@ bool bccTetScene::loadScene(const char *dataDirectory, const char *sceneFileName
 					txArr = suboit2->second.ToArray();
 					for (int i = 0; i < txArr.size(); ++i) {
 						txIds.push_back(txArr[i].ToInt());
-						if (!_gl3w->getTextures()->textureExists(txIds.back())) {
+						if (!_renderer->textureExists(txIds.back())) {
 							_surgAct->sendUserMessage("Missing texture or normal map in dynamic triangle section in .smd input file-", "Error Message");
 							return false;
 						}
 					}
 				}
 			}
-			_mt = _surgAct->getSurgGraphics()->getMaterialTriangles();
+			_mt = _surgAct->getMaterialTriangles();
 			if (_mt->readObjFile(path.c_str())) {
 				_surgAct->sendUserMessage("Unable to load fixed materialTriangle .obj input file-", "Error Message");
 				return false;
 			}
+			_surfaceRadius = _mt->getDiameter() * 0.5f;
 			// same material texture seams processed in graphics,
 			// may want to create hard texture & normal seams between materials here.
-			_surgAct->getSurgGraphics()->setGl3wGraphics(_gl3w);
 			std::string vtxShd(dataDirectory), frgShd(dataDirectory);
 			vtxShd.append("mtVertexShader.txt");
 			frgShd.append("mtFragmentShader.txt");
-			_surgAct->getSurgGraphics()->setTextureFilesCreateProgram(txIds, vtxShd.c_str(), frgShd.c_str());  // openGL buffers ceated here
-			_surgAct->getSurgGraphics()->setNewTopology();
-			_surgAct->getSurgGraphics()->updatePositionsNormalsTangents();
-			_surgAct->getSurgGraphics()->computeLocalBounds();
 			path = suboit->first;
 			size_t pos = path.rfind(".obj");
 			path.erase(pos);
 			_mt->setName(path.c_str());
-			_surgAct->getSurgGraphics()->getSceneNode()->setName(path.c_str());
+			_renderer->createSurface(_mt, path.c_str(), txIds, vtxShd.c_str(), frgShd.c_str());
 			// input new deep bed file here
 			deepBedFilepath.clear();
 			deepBedFilepath.append(dataDirectory);
@@ -206,6 +195,26 @@ bool bccTetScene::loadScene(const char *dataDirectory, const char *sceneFileName
 				maxDimMegatetSubdivs = suboit->second.ToInt();
 			else if (suboit->first == "nTetSizeLevels")
 				nTetSizeLevels = suboit->second.ToInt();
+			else if (suboit->first == "globalSolver") {  // "direct" or "multigrid" for models too large to factor
+				if (suboit->second.ToString() == "multigrid")
+					_ptp.setGlobalSolverType(GlobalSolverType::Multigrid);
+				else if (suboit->second.ToString() == "direct")
+					_ptp.setGlobalSolverType(GlobalSolverType::Direct);
+				else
+					_surgAct->sendUserMessage("Unknown globalSolver in scene file-", "File Error Message");
+			}
+			else if (suboit->first == "sleepMotion")  // in tet unit sizes per solve
+				_sleepMotion = suboit->second.ToFloat();
+			else if (suboit->first == "sleepFrames")
+				_sleepFrames = suboit->second.ToInt();
+			else if (suboit->first == "solveIterations")  // maximum local/global steps per frame
+				_solveIterations = suboit->second.ToInt();
+			else if (suboit->first == "solveSeconds")
+				_solveSeconds = suboit->second.ToFloat();
+			else if (suboit->first == "residualReduction")  // of the residual at the first step of a solve
+				_residualReduction = suboit->second.ToFloat();
+			else if (suboit->first == "stepTarget")  // in tet unit sizes
+				_stepTarget = suboit->second.ToFloat();
 			else
 				_surgAct->sendUserMessage("Unknown tetrahedral property in scene file-", "File Error Message");
 		}
@@ -255,44 +264,49 @@ bool bccTetScene::loadScene(const char *dataDirectory, const char *sceneFileName
 			_tetSubsets.createSubset(&_vnTets, ts.objFile, ts.lowTetWeight, ts.highTetWeight, ts.strainMin, ts.strainMax);
 		_tetSubsets.sendTetSubsets(&_vnTets, _mt, &_ptp);
 	}
-	_gl3w->frameScene(true);  // computes bounding spheres
+	_renderer->frameScene();
 	return true;
 }
 
 void bccTetScene::updateOldPhysicsLattice()
 {
-	_rtp.getOldPhysicsData(&_vnTets);  // must be done before any new incisions.  Worst case example < 0.02 seconds - not worth multithreading.
-	_tc.addNewMultiresIncision();
+	{  // initPdPhysics() times itself
+		phaseTimes::timer recut(_phaseTimes, phaseTimes::TET_RECUT);
+		_rtp.getOldPhysicsData(&_vnTets);  // must be done before any new incisions.  Worst case example < 0.02 seconds - not worth multithreading.
+		_tc.addNewMultiresIncision();
 
-//	std::cout << "Tet number at this time is " << _vnTets.tetNumber() << "\n";
+//		std::cout << "Tet number at this time is " << _vnTets.tetNumber() << "\n";
 
 #ifdef NO_PHYSICS
-	_firstSpatialCoords.assign(_vnTets.nodeNumber(), Vec3f());
-	_vnTets.setNodeSpatialCoordinatePointer(&_firstSpatialCoords[0]);  // for no physics debug
+		_firstSpatialCoords.assign(_vnTets.nodeNumber(), Vec3f());
+		_vnTets.setNodeSpatialCoordinatePointer(&_firstSpatialCoords[0]);  // for no physics debug
 #else
-	std::vector<uint8_t> tetSizeMult;
-	tetSizeMult.reserve(_vnTets.tetNumber());
-	for (int n = _vnTets.tetNumber(), i = 0; i < n; ++i) {
-		uint8_t sizeBit = 1;
-		auto& c = _vnTets.tetCentroid(i);
-		unsigned short ored = c[0] | c[1] | c[2];
-		while (true) {
-			if (ored & sizeBit)
-					break;
-			sizeBit <<= 1;
+		std::vector<uint8_t> tetSizeMult;
+		tetSizeMult.reserve(_vnTets.tetNumber());
+		for (int n = _vnTets.tetNumber(), i = 0; i < n; ++i) {
+			uint8_t sizeBit = 1;
+			auto& c = _vnTets.tetCentroid(i);
+			unsigned short ored = c[0] | c[1] | c[2];
+			while (true) {
+				if (ored & sizeBit)
+						break;
+				sizeBit <<= 1;
+			}
+			tetSizeMult.push_back(sizeBit);
 		}
-		tetSizeMult.push_back(sizeBit);
-	}
-	std::array<float, 3>* nodeSpatialCoords = _ptp.createBccTetStructure_multires(_vnTets.getTetNodeArray(), tetSizeMult, (float)_vnTets.getTetUnitSize());
-	_vnTets.setNodeSpatialCoordinatePointer(nodeSpatialCoords);  // vector created in _ptp
+		std::array<float, 3>* nodeSpatialCoords = _ptp.createBccTetStructure_multires(_vnTets.getTetNodeArray(), tetSizeMult, (float)_vnTets.getTetUnitSize());
+		_vnTets.setNodeSpatialCoordinatePointer(nodeSpatialCoords);  // vector created in _ptp
 #endif
-	_rtp.remapNewPhysicsNodePositions(&_vnTets);  // requires node spatial coordinate array pointer. Worst case example < 0.02 seconds - not worth multithreading.
-	std::vector<int> subNodes;
-	std::vector<std::vector<int> > macroNodes;
-	std::vector<std::vector<float> > macroBarys;
-	_vnTets.getTJunctionConstraints(subNodes, macroNodes, macroBarys);
-	_ptp.addInterNodeConstraints(subNodes, macroNodes, macroBarys);
-
+		_rtp.remapNewPhysicsNodePositions(&_vnTets);  // requires node spatial coordinate array pointer. Worst case example < 0.02 seconds - not worth multithreading.
+#ifndef NO_PHYSICS
+		_ptp.publishPositions();  // the draw reads published positions only
+#endif
+		std::vector<int> subNodes;
+		std::vector<std::vector<int> > macroNodes;
+		std::vector<std::vector<float> > macroBarys;
+		_vnTets.getTJunctionConstraints(subNodes, macroNodes, macroBarys);
+		_ptp.addInterNodeConstraints(subNodes, macroNodes, macroBarys);
+	}
 	if (_forcesApplied) {  // _tetsModified not necessary as implied by calling this routine
 		initPdPhysics();
 		_tetsModified = true;
@@ -303,6 +317,7 @@ void bccTetScene::updateOldPhysicsLattice()
 void bccTetScene::createNewPhysicsLattice(int maxDimMegatetSubdivs, int nTetSizeLevels)
 {
 	try {
+		phaseTimes::timer recut(_phaseTimes, phaseTimes::TET_RECUT);
 		_tetsModified = false;
 
 //		std::chrono::time_point<std::chrono::system_clock> start, end;
@@ -350,8 +365,12 @@ void bccTetScene::createNewPhysicsLattice(int maxDimMegatetSubdivs, int nTetSize
 		}
 		std::array<float, 3>* nodeSpatialCoords = _ptp.createBccTetStructure_multires(_vnTets.getTetNodeArray(), tetSizeMult, (float)_vnTets.getTetUnitSize());
 		_vnTets.setNodeSpatialCoordinatePointer(nodeSpatialCoords);  // vector created in _ptp
+		_ptp.setIterationBudget(_solveIterations, _residualReduction, _stepTarget * (float)_vnTets.getTetUnitSize(), _solveSeconds);
 #endif
 		_vnTets.materialCoordsToNodeSpatialVector();
+#ifndef NO_PHYSICS
+		_ptp.publishPositions();
+#endif
 
 		std::vector<int> subNodes;
 		std::vector<std::vector<int> > macroNodes;
@@ -379,6 +398,7 @@ void bccTetScene::createNewPhysicsLattice(int maxDimMegatetSubdivs, int nTetSize
 
 void bccTetScene::initPdPhysics()
 {  // called after each new tet lattice created
+	phaseTimes::timer reinit(_phaseTimes, phaseTimes::PD_REINIT);
 	fixPeriostealPeriferalVertices();
 	if (!_tetCol.empty()) {
 		_tetCol.updateFixedCollisions(_mt, &_vnTets);
@@ -408,8 +428,23 @@ void bccTetScene::updatePhysics()
 
 #ifndef NO_PHYSICS
 	if (_tetsModified || _forcesApplied) {
-		_tetCol.findSoftCollisionPairs();
-		_ptp.solve();
+		if (_ptp.changeCount() != _solvedChangeCount) {
+			_solvedChangeCount = _ptp.changeCount();
+			_quietFrames = 0;
+		}
+		{
+			phaseTimes::timer collision(_phaseTimes, phaseTimes::COLLISION);
+			_tetCol.findSoftCollisionPairs();
+		}
+		{
+			phaseTimes::timer solve(_phaseTimes, phaseTimes::SOLVE);
+			_ptp.solve();
+		}
+		_phaseTimes.addSolve(_ptp.lastIterations());
+		if (_ptp.lastMotion() < _sleepMotion * (float)_vnTets.getTetUnitSize() && !_ptp.collisionsChanged())
+			++_quietFrames;
+		else
+			_quietFrames = 0;
 	}
 #endif
 
@@ -422,32 +457,47 @@ void bccTetScene::updatePhysics()
 void bccTetScene::setVisability(char surface, char physics)
 {  // 0=off, 1=on, 2=don't change
 	if (surface < 1)
-		_surgAct->getSurgGraphics()->getSceneNode()->visible = false;
+		_renderer->setSurfaceVisible(false);
 	if (surface == 1)
-		_surgAct->getSurgGraphics()->getSceneNode()->visible = true;
+		_renderer->setSurfaceVisible(true);
 	if (physics < 1)
-		_gl3w->getLines()->setLinesVisible(false);
+		_renderer->setTetLinesVisible(false);
 	if (physics == 1) {
-		if (!_gl3w->getLines()->getSceneNode()) {
+		if (!_renderer->tetLinesCreated()) {
 			createTetLatticeDrawing();
 			drawTetLattice();
 		}
 		else
-			_gl3w->getLines()->setLinesVisible(true);
+			_renderer->setTetLinesVisible(true);
 	}
 }
 
+const Vec3f* bccTetScene::publishedNodePositions()
+{  // last frame published by the physics, which may be solving the next one
+#ifdef NO_PHYSICS
+	return _vnTets.getNodeSpatialCoordPointer();
+#else
+	auto& positions = _ptp.latestPositions();
+	if (positions.size() != _vnTets.nodeNumber())
+		return nullptr;  // nothing published yet for this lattice
+	return reinterpret_cast<const Vec3f*>(positions.data());
+#endif
+}
+
 void bccTetScene::updateSurfaceDraw()
 {
+	const Vec3f* nodePositions = publishedNodePositions();
+	if (nodePositions == nullptr)
+		return;
 	int nv;
 	auto pArr = _mt->getPositionArrayPtr();
 	nv = pArr->size();
 	for (int i = 0; i < nv; ++i) {
 		if (_vnTets.getVertexTetrahedron(i) > -1)  // an excision may have occurred leaving an empty vertex
-			_vnTets.getBarycentricTetPosition(_vnTets.getVertexTetrahedron(i), *(_vnTets.getVertexWeight(i)), pArr->at(i));
+			_vnTets.getBarycentricTetPosition(_vnTets.getVertexTetrahedron(i), *(_vnTets.getVertexWeight(i)), pArr->at(i), nodePositions);
 	}
-	_surgAct->getSurgGraphics()->updatePositionsNormalsTangents();
-	if (_gl3w->getLines()->linesVisible())
+	_renderer->surfaceMoved();
+	if (_renderer->tetLinesVisible())
 		drawTetLattice();
 }
 
@@ -513,11 +563,14 @@ void bccTetScene::createTetLatticeDrawing()
 {
 	if (_nodeGraphicsPositions.size() == _vnTets.nodeNumber())
 		return;
+	const Vec3f* nodePositions = publishedNodePositions();
+	if (nodePositions == nullptr)
+		return;
 	_nodeGraphicsPositions.clear();
 	_nodeGraphicsPositions.assign(_vnTets.nodeNumber() << 2, 1.0f);
-	GLfloat *ngp = &_nodeGraphicsPositions[0];
+	float *ngp = &_nodeGraphicsPositions[0];
 	for (int n = _vnTets.nodeNumber(), i = 0; i < n; ++i){
-		const float *fp = _vnTets.nodeSpatialCoordinatePtr(i);
+		const float *fp = nodePositions[i].xyz;
 		*(ngp++) = fp[0];
 		*(ngp++) = fp[1];
 		*(ngp++) = fp[2];
@@ -535,42 +588,40 @@ void bccTetScene::createTetLatticeDrawing()
 			}
 		}
 	}
-	std::vector<GLuint> lines;
+	std::vector<unsigned int> lines;
 	lines.reserve(segs.size() * 3);
 	for (auto &s : segs){
 		lines.push_back(s.first);
 		lines.push_back(s.second);
 		lines.push_back(0xffffffff);
 	}
-	_gl3w->getLines()->setGl3wGraphics(_gl3w);
-	float white2[4] = {1.0f, 1.0f, 1.0f, 1.0f};
-	_gl3w->getLines()->addLines(_nodeGraphicsPositions, lines);
-	_gl3w->getLines()->getSceneNode()->setColor(white2);
+	_renderer->createTetLines(_nodeGraphicsPositions, lines);
 }
 
 void bccTetScene::eraseTetLattice()
 {
 	_nodeGraphicsPositions.clear();
-	_gl3w->getLines()->clear();
-	_gl3w->getLines()->getSceneNode()->visible = false;
+	_renderer->eraseTetLines();
 }
 
 void bccTetScene::drawTetLattice()
 {
-	if (_nodeGraphicsPositions.empty())
+	const Vec3f* nodePositions = publishedNodePositions();
+	if (_nodeGraphicsPositions.empty() || nodePositions == nullptr)
 		return;
-	GLfloat *ngp = &_nodeGraphicsPositions[0];
+	float *ngp = &_nodeGraphicsPositions[0];
 	for (int n = _vnTets.nodeNumber(), i = 0; i < n; ++i){
-		const float *fp = _vnTets.nodeSpatialCoordinatePtr(i);
+		const float *fp = nodePositions[i].xyz;
 		*(ngp++) = fp[0];
 		*(ngp++) = fp[1];
 		*(ngp++) = fp[2];
 		++ngp;
 	}
-	_gl3w->getLines()->updatePoints(_nodeGraphicsPositions);
+	_renderer->updateTetLines(_nodeGraphicsPositions);
 }
 
-bccTetScene::bccTetScene() : _physicsPaused(false), _forcesApplied(false), _tetsModified(false)
+bccTetScene::bccTetScene() : _physicsPaused(false), _forcesApplied(false), _tetsModified(false), _sleepMotion(1e-4f), _sleepFrames(30), _quietFrames(0), _solvedChangeCount(0), _surfaceRadius(1.0f),
+	_residualReduction(1e-3f), _stepTarget(1e-4f), _solveSeconds(0.03f), _solveIterations(20)
 {
 	_tetCol.setPdTetPhysics(&_ptp); // Qisi:set ptp for tetCol so things of ptp are accessible inside of tetCol
 }
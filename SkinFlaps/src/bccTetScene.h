@@ -13,16 +13,17 @@
 #ifndef __BCC_TET_SCENE__
 #define __BCC_TET_SCENE__
 
-#include "surgGraphics.h"
+#include "materialTriangles.h"
 #include "vnBccTetrahedra.h"
 #include "vnBccTetCutter_tbb.h"
 #include "tetCollisions.h"
 #include "tetSubset.h"
 #include "remapTetPhysics.h"
 #include "pdTetPhysics.h"
+#include "phaseTimes.h"
+#include "surgicalRenderer.h"
 
 // forward declarations
-class gl3wGraphics;
 class surgicalActions;
 
 class bccTetScene
@@ -31,16 +32,19 @@ public:
 	bool loadScene(const char *dataDirectory, const char *sceneFileName);
 	void createNewPhysicsLattice(int maxDimMegatetSubdivs, int nTetSizeLevels);
 	void updateOldPhysicsLattice();
-	inline void nonTetPhysicsUpdate() {_ptp.initializePhysics();}
+	inline void nonTetPhysicsUpdate() { phaseTimes::timer t(_phaseTimes, phaseTimes::PD_REINIT); _ptp.initializePhysics(); }
 	void updatePhysics();
 	void fixPeriostealPeriferalVertices();
 	void updateSurfaceDraw();
+	inline bool newPhysicsFrame() { return _ptp.newPositionsPublished(); }  // a solve completed since the last draw
 	pdTetPhysics* getPdTetPhysics_2(){ return &_ptp; }
 	inline void setForcesAppliedFlag(){ _forcesApplied = true; }
-	inline void promoteSutures() { _ptp.promoteAllSutures(); _ptp.initializePhysics(); }
+	inline void promoteSutures() { phaseTimes::timer t(_phaseTimes, phaseTimes::PD_REINIT); _ptp.promoteAllSutures(); _ptp.initializePhysics(); }
+	inline phaseTimes& getPhaseTimes() { return _phaseTimes; }  // seconds spent recutting, reinitializing and solving
 	vnBccTetrahedra* getVirtualNodedBccTetrahedra() { return &_vnTets; }
 	void setVisability(char surface, char physics);	// 0=off, 1=on, 2=don't change
-	void setGl3wGraphics(gl3wGraphics *gl3w) { _gl3w = gl3w; }
+	void setRenderer(surgicalRenderer *renderer) { _renderer = renderer; }
+	inline float getSurfaceRadius() { return _surfaceRadius; }  // of the loaded surface before any deformation, scales tool sizes
 	void createTetLatticeDrawing();
 	void drawTetLattice();
 	void eraseTetLattice();
@@ -48,13 +52,16 @@ public:
 	void setPhysicsPause(bool pause) { _physicsPaused = pause; }
 	inline bool isPhysicsPaused(){ return  _physicsPaused; }
 	inline bool forcesApplied() { return  _forcesApplied; }
+	// true once the solver moved no node more than _sleepMotion tet unit sizes for _sleepFrames solves in a row and no hook, suture,
+	// collision set or topology change was made since. Any of those changes wakes the simulation on the next check.
+	inline bool isPhysicsAsleep() { return _quietFrames >= _sleepFrames && _ptp.changeCount() == _solvedChangeCount; }
 	bccTetScene();
 	~bccTetScene();
 
 private:
-	gl3wGraphics *_gl3w;
+	surgicalRenderer *_renderer;
 	surgicalActions *_surgAct;
-	materialTriangles* _mt;  // pointer from surgGraphics.
+	materialTriangles* _mt;  // pointer from surgicalActions.
 	vnBccTetrahedra _vnTets;
 	remapTetPhysics _rtp;
 	tetCollisions _tetCol;
@@ -62,15 +69,23 @@ private:
 	vnBccTetCutter_tbb _tc;  // multithreaded version using Intel threaded building blocks.  Much faster, but indices of nodes and tets different each run as nondeterministic.
 	pdTetPhysics _ptp;
 	bool _forcesApplied, _tetsModified, _physicsPaused;
+	float _sleepMotion;
+	int _sleepFrames, _quietFrames;
+	float _residualReduction, _stepTarget, _solveSeconds;  // accelerated iterations of each solve, _stepTarget in tet unit sizes
+	int _solveIterations;
+	unsigned int _solvedChangeCount;
+	phaseTimes _phaseTimes;
 	float _lowTetWeight;
+	float _surfaceRadius;
 	struct boundingBox3{
 		float corners[6];
 	};
-	std::vector<GLfloat> _nodeGraphicsPositions;  // homogeneous coords[4]
+	std::vector<float> _nodeGraphicsPositions;  // homogeneous coords[4]
 
 	std::vector<Vec3f> _firstSpatialCoords;
 
 	void initPdPhysics();
+	const Vec3f* publishedNodePositions();
 };
 
 #endif // __BCC_TET_SCENE__
\ No newline at end of file
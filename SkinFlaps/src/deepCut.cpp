@@ -11,7 +11,7 @@
 #include <exception>
 #include "closestPointOnTriangle.h"
 #include "fence.h"
-#include "FacialFlapsGui.h"
+#include "surgicalActions.h"
 #include "clockwise.h"
 #include "deepCut.h"
 
@@ -1150,13 +1150,13 @@ int deepCut::preventPreviousCrossover(const int postNum) {
 	return 0;
 }
 
-bool deepCut::inputCorrectFence(fence* fp, FacialFlapsGui* ffg) {
+bool deepCut::inputCorrectFence(fence* fp, surgicalActions* sa) {
 	// interactive deep cut builder.  On successful exit deep posts have interpost connections set up.
 	_deepPosts.clear();
 	if (fp->numberOfPosts() < 2) {
 		char str[200];
 		sprintf(str, "You need at least 2 posts to create a deep cut.");
-		ffg->sendUserMessage(str, "Invalid deep cut-");
+		sa->sendUserMessage(str, "Invalid deep cut-");
 		return false;
 	}
 	std::vector<Vec3f> positions, normals;
@@ -1173,7 +1173,7 @@ bool deepCut::inputCorrectFence(fence* fp, FacialFlapsGui* ffg) {
 		if (addDeepPost(triangles[i], (const float(&)[2])uv[i * 2], -Vec3d(normals[i]), closedEnd) < 0) {
 			char str[200];
 			sprintf(str, "Post number %d needs direction adjustment.", i + 1);
-			ffg->sendUserMessage(str, "Please correct deep cut-");
+			sa->sendUserMessage(str, "Please correct deep cut-");
 			return false;
 		}
 	}
@@ -1181,7 +1181,7 @@ bool deepCut::inputCorrectFence(fence* fp, FacialFlapsGui* ffg) {
 		if (!topConnectToPreviousPost(i)) {
 			char str[200];
 			sprintf(str, "Post number %d has no top side connection to previous post.\nDelete it and try again", i + 1);
-			ffg->sendUserMessage(str, "Please correct deep cut-");
+			sa->sendUserMessage(str, "Please correct deep cut-");
 			return false;
 		}
 	}
@@ -1189,7 +1189,7 @@ bool deepCut::inputCorrectFence(fence* fp, FacialFlapsGui* ffg) {
 		if (!deepConnectToPreviousPost(i)) {
 			char str[200];
 			sprintf(str, "Post number %d has no bottom connection to previous post.\nAdjust its post direction or previous post direction.", i + 1);
-			ffg->sendUserMessage(str, "Please correct deep cut-");
+			sa->sendUserMessage(str, "Please correct deep cut-");
 			return false;
 		}
 	}
@@ -1198,7 +1198,7 @@ bool deepCut::inputCorrectFence(fence* fp, FacialFlapsGui* ffg) {
 			if (preventPreviousCrossover(i) > 0) {
 				char str[200];
 				sprintf(str, "Solid post line %d intersects a previous cut.\nPlease adjust it's direction.", i + 1);
-				ffg->sendUserMessage(str, "Please correct deep cut-");
+				sa->sendUserMessage(str, "Please correct deep cut-");
 				return false;
 			}
 		}
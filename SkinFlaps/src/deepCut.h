@@ -25,15 +25,13 @@
 // forward declarations
 class vnBccTetrahedra;
 class fence;
-class FacialFlapsGui;
+class surgicalActions;
 struct rayTriangleIntersect;
 
 class deepCut : public skinCutUndermineTets
 {
 public:
-	void setGl3wGraphics(gl3wGraphics *gl3w) { _gl3w = gl3w; }  // for debug - nuke later
-
-	bool inputCorrectFence(fence* fp, FacialFlapsGui* ffg);
+	bool inputCorrectFence(fence* fp, surgicalActions* sa);
 	int addDeepPost(const int triangle, const float(&uv)[2], const Vec3d& rayDirection, bool closedEnd);
 	inline void popLastDeepPost() { if(!_deepPosts.empty()) _deepPosts.pop_back(); }
 	inline int numberOfDeepPosts() { return (int)_deepPosts.size(); }
@@ -4,31 +4,28 @@
 // Purpose: User interface for creating a fence on a glslTriangle object.
 //     This will be used to specify a desired incision line.
 
-#include "shapes.h"
 #include "GLmatrices.h"
 #include "Vec3f.h"
 #include <stdio.h>
 #include <assert.h>
-#include "boundingBox.h"
 #include "materialTriangles.h"
 #include "fence.h"
 
-float fence::_fenceSize=10000.0f;
-GLfloat fence::_selectedColor[]={1.0f,1.0f,0.0f,1.0f};
-GLfloat fence::_unselectedColor[]={0.0f,1.0f,0.0f,1.0f};
+float fence::_selectedColor[]={1.0f,1.0f,0.0f,1.0f};
+float fence::_unselectedColor[]={0.0f,1.0f,0.0f,1.0f};
 
 void fence::clear()	// deletes current fence
 {
 	std::vector<fencePost>::iterator pit;
 	for(pit=_posts.begin(); pit!=_posts.end(); ++pit)	{
-		_gl3w->deleteSceneNode(pit->cylinderShape);
-		_gl3w->deleteSceneNode(pit->sphereShape);
+		_renderer->deleteShape(pit->cylinderShape);
+		if (pit->sphereShape)
+			_renderer->deleteShape(pit->sphereShape);
 	}
 	_posts.clear();
 	_xyz.clear();
 	_norms.clear();
-	if(_wall!= nullptr)
-		_wall->visible = false;  // don't delete if already made.  Will reuse.
+	_renderer->hideFenceWall();
 }
 
 void fence::updatePosts(const std::vector<Vec3f> &positions, const std::vector<Vec3f> &normals)
@@ -40,8 +37,8 @@ void fence::updatePosts(const std::vector<Vec3f> &positions, const std::vector<V
 		_posts[i].xyz = positions[i];
 		_posts[i].nrm = normals[i];
 		_posts[i].nrm.normalize();
-		std::shared_ptr<sceneNode> sh = _posts[i].cylinderShape;
-		GLfloat *mm = sh->getModelViewMatrix();
+		std::shared_ptr<sceneNodeBase> sh = _posts[i].cylinderShape;
+		float *mm = sh->getModelViewMatrix();
 		loadIdentity4x4(mm);
 		scaleMatrix4x4(mm, _fenceSize*0.1f, _fenceSize*0.1f, _fenceSize * 3.0f);
 		Vec3f vz(0.0f, 0.0f, 1.0f), vn;
@@ -68,9 +65,10 @@ void fence::deleteLastPost()
 	if (_posts.empty())
 		return;
 	std::vector<fencePost>::reverse_iterator pit = _posts.rbegin();
-	_gl3w->deleteSceneNode(pit->cylinderShape);
+	_renderer->deleteShape(pit->cylinderShape);
 	pit->cylinderShape.reset();
-	_gl3w->deleteSceneNode(pit->sphereShape);
+	if (pit->sphereShape)
+		_renderer->deleteShape(pit->sphereShape);
 	pit->sphereShape = nullptr;
 	_posts.pop_back();
 	_xyz.pop_back();
@@ -89,8 +87,8 @@ void fence::addPost(materialTriangles *tri, int triangle, float(&xyz)[3], float(
 	_posts.back().openEnd = openEnd;
 	_posts.back().xyz[0]=xyz[0]; _posts.back().xyz[1]=xyz[1]; _posts.back().xyz[2]=xyz[2];
 	_posts.back().nrm[0]=normal[0]; _posts.back().nrm[1]=normal[1]; _posts.back().nrm[2]=normal[2];
-	 std::shared_ptr<sceneNode> sh = _posts.back().cylinderShape = _shapes->addShape(sceneNode::nodeType::CYLINDER,name);
-	GLfloat *mm = sh->getModelViewMatrix();
+	 std::shared_ptr<sceneNodeBase> sh = _posts.back().cylinderShape = _renderer->addShape(sceneNodeBase::nodeType::CYLINDER,name);
+	float *mm = sh->getModelViewMatrix();
 	loadIdentity4x4(mm);
 	sh->setColor(_selectedColor);
 	scaleMatrix4x4(mm,_fenceSize*0.1f,_fenceSize*0.1f,_fenceSize* 2.5f);
@@ -103,7 +101,7 @@ void fence::addPost(materialTriangles *tri, int triangle, float(&xyz)[3], float(
 
 	if (adjustNormal) {
 		sprintf(name, "NP_%d", (int)_posts.size() - 1);
-		sh = _posts.back().sphereShape = _shapes->addShape(sceneNode::nodeType::SPHERE, name);
+		sh = _posts.back().sphereShape = _renderer->addShape(sceneNodeBase::nodeType::SPHERE, name);
 		mm = sh->getModelViewMatrix();
 		loadIdentity4x4(mm);
 		sh->setColor(_selectedColor);
@@ -122,7 +120,7 @@ void fence::addPost(materialTriangles *tri, int triangle, float(&xyz)[3], float(
 
 void fence::setSpherePos(int postNumber, Vec3f& xyz){
 	fencePost* fp = &_posts[postNumber];
-	GLfloat* mm = fp->sphereShape->getModelViewMatrix();
+	float* mm = fp->sphereShape->getModelViewMatrix();
 	loadIdentity4x4(mm);
 	fp->sphereShape->setColor(_selectedColor);
 	scaleMatrix4x4(mm, _fenceSize * 0.5f, _fenceSize * 0.5f, _fenceSize * 0.5f);
@@ -154,37 +152,6 @@ void fence::setSpherePos(int postNumber, Vec3f& xyz){
 
 void fence::displayRemoveWall() {
 	if (_xyz.size() > 3) {  // valid wall to display
-		if (!_wall) {
-			_wall = std::make_shared<sceneNode>();
-			_wall->setType(sceneNode::nodeType::TRISTRIP);
-			GLfloat color[4] = { 1.0f, 0.4f, 0.0f, 1.0f };
-			_wall->setColor(color);
-			GLfloat* mm = _wall->getModelViewMatrix();
-			loadIdentity4x4(mm);
-			GLuint program = _gl3w->getLightsShaders()->getOrCreateColorProgram();
-			_wall->setGlslProgramNumber(program);
-			_wall->setColorLocation(glGetUniformLocation(program, "objectColor"));
-			if (!_wall->vertexArrayBufferObject)
-				glGenVertexArrays(1, &_wall->vertexArrayBufferObject);
-			if (_wall->bufferObjects.size() != 2) {
-				_wall->bufferObjects.assign(2, 0);
-				glGenBuffers(2, &_wall->bufferObjects[0]);
-			}
-			// Create the master vertex array object
-			glBindVertexArray(_wall->vertexArrayBufferObject);
-			// Vertex data
-			glBindBuffer(GL_ARRAY_BUFFER, _wall->bufferObjects[0]);	// VERTEX DATA
-			glEnableVertexAttribArray(0);
-			glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 0, 0);
-			// Normal data
-			glBindBuffer(GL_ARRAY_BUFFER, _wall->bufferObjects[1]);	// NORMAL_DATA
-			glEnableVertexAttribArray(1);
-			glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, 0);
-			// Unbind to anybody
-			glBindVertexArray(0);
-			_gl3w->addSceneNode(_wall);
-		}
-		_wall->visible = true;
 		int n = (int)_xyz.size();
 		_norms.clear();
 		_norms.reserve(n/2);
@@ -211,7 +178,7 @@ void fence::displayRemoveWall() {
 			}
 			lastN = N1;
 		}
-		std::vector<GLfloat> grPos;
+		std::vector<float> grPos;
 		grPos.reserve((n/2-1) * 400 + 16);
 		auto pushBackV = [&](Vec3f &v) {
 			grPos.push_back(v.X);
@@ -219,8 +186,13 @@ void fence::displayRemoveWall() {
 			grPos.push_back(v.Z);
 			grPos.push_back(1.0f);
 		};
-		std::vector<Vec3f> grNorm;
-		grNorm.reserve(grPos.capacity()>>2);
+		std::vector<float> grNorm;
+		grNorm.reserve((grPos.capacity() >> 2) * 3);
+		auto pushBackN = [&](Vec3f &N) {
+			grNorm.push_back(N.X);
+			grNorm.push_back(N.Y);
+			grNorm.push_back(N.Z);
+		};
 		if (_posts.front().openEnd) {
 			v0 = _xyz[0];
 			v1 = _xyz[1];
@@ -231,8 +203,8 @@ void fence::displayRemoveWall() {
 			v1 += v2;
 			pushBackV(v0);
 			pushBackV(v1);
-			grNorm.push_back(_norms[0]);
-			grNorm.push_back(_norms[0]);
+			pushBackN(_norms[0]);
+			pushBackN(_norms[0]);
 		}
 		for (int i = 2; i < n; i+=2) {
 			for (int j = 0; j < 50; ++j) {
@@ -244,8 +216,8 @@ void fence::displayRemoveWall() {
 				pushBackV(v0);
 				N0 = _norms[i/2 - 1] * ((49.0f - j) / 49.0f);
 				N0 += _norms[i/2] * (j / 49.0f);
-				grNorm.push_back(N0);
-				grNorm.push_back(N0);
+				pushBackN(N0);
+				pushBackN(N0);
 			}
 		}
 		if (_posts.back().openEnd) {
@@ -258,39 +230,13 @@ void fence::displayRemoveWall() {
 			v1 += v2;
 			pushBackV(v0);
 			pushBackV(v1);
-			grNorm.push_back(_norms.back());
-			grNorm.push_back(_norms.back());
+			pushBackN(_norms.back());
+			pushBackN(_norms.back());
 		}
-		// Vertex and normal data
-		glBindBuffer(GL_ARRAY_BUFFER, _wall->bufferObjects[0]);	// VERTEX_DATA
-		glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * grPos.size(), &(grPos[0]), GL_STATIC_DRAW);
-		glBindBuffer(GL_ARRAY_BUFFER, _wall->bufferObjects[1]);	// NORMAL_DATA
-		glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * grNorm.size() * 3, &(grNorm[0]), GL_STATIC_DRAW);
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-		_wall->elementArraySize = (GLsizei)(grPos.size() >> 2);
+		_renderer->showFenceWall(grPos, grNorm);
 	}
-	else {
-		if (_wall)
-			_wall->visible = false;
-	}
-}
-
-void fence::computeLocalBounds() {
-	boundingBox<float> bb;
-	bb.Empty_Box();
-	for (int n = (int)_xyz.size(), i = 0; i < n; ++i) 
-		bb.Enlarge_To_Include_Point((const float(&)[3])_xyz[i]);
-	Vec3f vmin, vmax;
-	bb.Minimum_Corner(vmin.xyz);
-	bb.Maximum_Corner(vmax.xyz);
-	vmin += vmax;
-	vmin *= 0.5f;
-	GLfloat lc[3], radius;
-	lc[0] = vmin.X;
-	lc[1] = vmin.Y;
-	lc[2] = vmin.Z;
-	radius = (vmax - vmin).length();
-	_wall->setLocalBounds(lc, radius);
+	else
+		_renderer->hideFenceWall();
 }
 
 void fence::selectPost(int postNumber)
@@ -333,25 +279,13 @@ int fence::getPostData(std::vector<Vec3f> &positions,std::vector<Vec3f> &normals
 	return n;
 }
 
-fence::fence() :_initialized(false)
+fence::fence() :_initialized(false), _fenceSize(10000.0f)
 {
-	_gl3w =NULL;
-	_wall = nullptr;
+	_renderer = NULL;
 	_xyz.clear();
 	_norms.clear();
 }
 
 fence::~fence()
 {
-	if (!_wall)
-		return;
-	if (!_wall->bufferObjects.empty()) {
-		glDeleteBuffers((GLsizei)_wall->bufferObjects.size(), &_wall->bufferObjects[0]);
-		_wall->bufferObjects.clear();
-	}
-	if (_wall->vertexArrayBufferObject > 0) {
-		glDeleteVertexArrays(1, &_wall->vertexArrayBufferObject);
-		_wall->vertexArrayBufferObject = 0;
-	}
 }
-
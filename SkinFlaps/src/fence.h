@@ -11,7 +11,7 @@
 #include <set>
 #include <memory>
 #include "Vec3f.h"
-#include "gl3wGraphics.h"
+#include "surgicalRenderer.h"
 
 // forward declarations
 class materialTriangles;
@@ -30,11 +30,8 @@ public:
 	inline void getPostNormal(int postNumber, Vec3f &nrm) { nrm = _posts[postNumber].nrm; }
 	inline int numberOfPosts() { return (int)_posts.size(); }
 	void setSpherePos(int postNumber, Vec3f& xyz);
-	void setGl3wGraphics(gl3wGraphics *gl3w) {
-		_gl3w = gl3w; _shapes = gl3w->getShapes(); _glm = gl3w->getGLmatrices();
-		if (fence::_fenceSize < 10000.0f) _initialized = true;
-	}
-	void setFenceSize(float size) {fence::_fenceSize=size; if(_gl3w !=NULL) _initialized=true;}
+	void setRenderer(surgicalRenderer *renderer) { _renderer = renderer; }
+	void setFenceSize(float size) {_fenceSize=size; _initialized=true;}
 	void clear();	// deletes this fence COURT - ?nuke as no longer used
 	bool isInitialized()	{return _initialized;}
 	fence();
@@ -48,22 +45,18 @@ private:
 		Vec3f nrm;
 		int triangle;
 		float uv[2];
-		std::shared_ptr<sceneNode>  cylinderShape;
-		std::shared_ptr<sceneNode> sphereShape;
+		std::shared_ptr<sceneNodeBase>  cylinderShape;
+		std::shared_ptr<sceneNodeBase> sphereShape;
 		Vec3f spherePos;
 	};
-	std::shared_ptr<sceneNode> _wall;
 	std::vector<fencePost> _posts;
-	gl3wGraphics *_gl3w;
-	shapes *_shapes;
-	GLmatrices *_glm;
+	surgicalRenderer *_renderer;
 	std::vector<Vec3f> _xyz, _norms;
 	bool _initialized;
-	static float _fenceSize;
-	static GLfloat _selectedColor[4],_unselectedColor[4];
+	float _fenceSize;
+	static float _selectedColor[4],_unselectedColor[4];
 
 	void displayRemoveWall();
-	void computeLocalBounds();
 
 };
 
@@ -0,0 +1,221 @@
+#include <thread>
+#include <chrono>
+#include "FacialFlapsGui.h"
+#include "gl3wRenderer.h"
+
+bool gl3wRenderer::loadTexture(int txId, const char* filePath)
+{
+	GLuint txNow = _gl3w->getTextures()->loadTexture(txId, filePath);
+	return txNow < 0xffffffff;
+}
+
+bool gl3wRenderer::textureExists(int txId)
+{
+	return _gl3w->getTextures()->textureExists(txId);
+}
+
+bool gl3wRenderer::loadStaticObject(const char* filePath, std::vector<int>& textureIds)
+{  // this is a staticTriangle, not elastic so put on graphics card and clean up
+	return _gl3w->loadStaticObjFile(filePath, textureIds, true) != NULL;
+}
+
+void gl3wRenderer::createSurface(materialTriangles* mt, const char* name, std::vector<int>& textureIds, const char* vertexShaderFile, const char* fragmentShaderFile)
+{
+	_sg.setMaterialTriangles(mt);
+	_sg.setGl3wGraphics(_gl3w);
+	_sg.setTextureFilesCreateProgram(textureIds, vertexShaderFile, fragmentShaderFile);  // openGL buffers ceated here
+	_sg.setNewTopology();
+	_sg.updatePositionsNormalsTangents();
+	_sg.computeLocalBounds();
+	_sg.getSceneNode()->setName(name);
+}
+
+void gl3wRenderer::frameScene()
+{
+	_gl3w->frameScene(true);  // computes bounding spheres
+}
+
+void gl3wRenderer::resetView()
+{
+	_gl3w->zeroViewRotations();
+}
+
+void gl3wRenderer::surfaceTopologyChanged()
+{
+	_sg.setNewTopology();
+	_sg.updatePositionsNormalsTangents();
+}
+
+void gl3wRenderer::surfaceMoved()
+{
+	_sg.updatePositionsNormalsTangents();
+}
+
+void gl3wRenderer::setSurfaceVisible(bool visible)
+{
+	_sg.getSceneNode()->visible = visible;
+}
+
+std::shared_ptr<sceneNodeBase> gl3wRenderer::addShape(sceneNodeBase::nodeType type, const char* name)
+{
+	return _gl3w->getShapes()->addShape(type, const_cast<char*>(name));
+}
+
+void gl3wRenderer::deleteShape(std::shared_ptr<sceneNodeBase> shape)
+{  // only ever given shapes made by addShape()
+	_gl3w->getShapes()->deleteShape(std::static_pointer_cast<sceneNode>(shape));
+}
+
+void gl3wRenderer::showFenceWall(const std::vector<float>& points, const std::vector<float>& normals)
+{
+	if (!_wall) {
+		_wall = std::make_shared<sceneNode>();
+		_wall->setType(sceneNode::nodeType::TRISTRIP);
+		GLfloat color[4] = { 1.0f, 0.4f, 0.0f, 1.0f };
+		_wall->setColor(color);
+		GLfloat* mm = _wall->getModelViewMatrix();
+		loadIdentity4x4(mm);
+		GLuint program = _gl3w->getLightsShaders()->getOrCreateColorProgram();
+		_wall->setGlslProgramNumber(program);
+		_wall->setColorLocation(glGetUniformLocation(program, "objectColor"));
+		if (!_wall->vertexArrayBufferObject)
+			glGenVertexArrays(1, &_wall->vertexArrayBufferObject);
+		if (_wall->bufferObjects.size() != 2) {
+			_wall->bufferObjects.assign(2, 0);
+			glGenBuffers(2, &_wall->bufferObjects[0]);
+		}
+		// Create the master vertex array object
+		glBindVertexArray(_wall->vertexArrayBufferObject);
+		// Vertex data
+		glBindBuffer(GL_ARRAY_BUFFER, _wall->bufferObjects[0]);	// VERTEX DATA
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 0, 0);
+		// Normal data
+		glBindBuffer(GL_ARRAY_BUFFER, _wall->bufferObjects[1]);	// NORMAL_DATA
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, 0);
+		// Unbind to anybody
+		glBindVertexArray(0);
+		_gl3w->addSceneNode(_wall);
+	}
+	_wall->visible = true;
+	// Vertex and normal data
+	glBindBuffer(GL_ARRAY_BUFFER, _wall->bufferObjects[0]);	// VERTEX_DATA
+	glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * points.size(), &(points[0]), GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, _wall->bufferObjects[1]);	// NORMAL_DATA
+	glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * normals.size(), &(normals[0]), GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	_wall->elementArraySize = (GLsizei)(points.size() >> 2);
+}
+
+void gl3wRenderer::hideFenceWall()
+{
+	if (_wall)
+		_wall->visible = false;  // don't delete if already made.  Will reuse.
+}
+
+bool gl3wRenderer::tetLinesCreated()
+{
+	return _gl3w->getLines()->getSceneNode() != nullptr;
+}
+
+bool gl3wRenderer::tetLinesVisible()
+{
+	return _gl3w->getLines()->linesVisible();
+}
+
+void gl3wRenderer::setTetLinesVisible(bool visible)
+{
+	_gl3w->getLines()->setLinesVisible(visible);
+}
+
+void gl3wRenderer::createTetLines(const std::vector<float>& points, const std::vector<unsigned int>& lines)
+{
+	_gl3w->getLines()->setGl3wGraphics(_gl3w);
+	float white2[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	_gl3w->getLines()->addLines(points, lines);
+	_gl3w->getLines()->getSceneNode()->setColor(white2);
+}
+
+void gl3wRenderer::updateTetLines(const std::vector<float>& points)
+{
+	_gl3w->getLines()->updatePoints(points);
+}
+
+void gl3wRenderer::eraseTetLines()
+{
+	_gl3w->getLines()->clear();
+	if (_gl3w->getLines()->getSceneNode())
+		_gl3w->getLines()->getSceneNode()->visible = false;
+}
+
+void gl3wRenderer::drawAll()
+{
+	_gl3w->drawAll();
+}
+
+void gl3wRenderer::previewFrame(int milliseconds)
+{
+	_gl3w->drawAll();
+	glfwSwapBuffers(FacialFlapsGui::FFwindow);
+	std::this_thread::sleep_for(std::chrono::milliseconds(milliseconds));
+}
+
+void gl3wRenderer::sendUserMessage(const char* message, const char* title)
+{
+	FacialFlapsGui::sendUserMessage(message, title);
+}
+
+void gl3wRenderer::clearUserMessage()
+{
+	FacialFlapsGui::user_message_flag = false;
+}
+
+void gl3wRenderer::showPhysicsBusy(bool busy)
+{
+	FacialFlapsGui::physicsDrag = busy;
+}
+
+void gl3wRenderer::showToolState(int toolState)
+{
+	FacialFlapsGui::setToolState(toolState);
+}
+
+void gl3wRenderer::showModelFile(const std::string& modelFile)
+{
+	FacialFlapsGui::setModelFile(modelFile);
+}
+
+bool gl3wRenderer::ctrlOrShiftKeyDown()
+{
+	return FacialFlapsGui::CtrlOrShiftKeyIsDown();
+}
+
+void gl3wRenderer::getDragVector(float dScreenX, float dScreenY, float(&position)[3], float(&dragVector)[3])
+{
+	_gl3w->getGLmatrices()->getDragVector(dScreenX, dScreenY, position, dragVector);
+}
+
+const float* gl3wRenderer::getFrameAndRotationMatrix()
+{
+	return _gl3w->getGLmatrices()->getFrameAndRotationMatrix();
+}
+
+void gl3wRenderer::getTrianglePickLine(float(&lineStartPosition)[3], float(&lineDirection)[3])
+{
+	_gl3w->getTrianglePickLine(lineStartPosition, lineDirection);
+}
+
+gl3wRenderer::~gl3wRenderer()
+{
+	if (!_wall)
+		return;
+	if (!_wall->bufferObjects.empty()) {
+		glDeleteBuffers((GLsizei)_wall->bufferObjects.size(), &_wall->bufferObjects[0]);
+		_wall->bufferObjects.clear();
+	}
+	if (_wall->vertexArrayBufferObject > 0) {
+		glDeleteVertexArrays(1, &_wall->vertexArrayBufferObject);
+		_wall->vertexArrayBufferObject = 0;
+	}
+}
@@ -0,0 +1,68 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// File: gl3wRenderer.h
+// Purpose: surgicalRenderer drawing with gl3wGraphics into the FacialFlapsGui window and reporting to its
+// dear imgui interface.
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __GL3W_RENDERER__
+#define __GL3W_RENDERER__
+
+#include "surgicalRenderer.h"
+#include "surgGraphics.h"
+
+// forward declarations
+class gl3wGraphics;
+
+class gl3wRenderer : public surgicalRenderer
+{
+public:
+	void setGl3wGraphics(gl3wGraphics* gl3w) { _gl3w = gl3w; }
+	inline surgGraphics* getSurgGraphics() { return &_sg; }  // draws the simulation's materialTriangles
+
+	bool loadTexture(int txId, const char* filePath) override;
+	bool textureExists(int txId) override;
+	bool loadStaticObject(const char* filePath, std::vector<int>& textureIds) override;
+	void createSurface(materialTriangles* mt, const char* name, std::vector<int>& textureIds, const char* vertexShaderFile, const char* fragmentShaderFile) override;
+	void frameScene() override;
+	void resetView() override;
+
+	void surfaceTopologyChanged() override;
+	void surfaceMoved() override;
+	void setSurfaceVisible(bool visible) override;
+
+	std::shared_ptr<sceneNodeBase> addShape(sceneNodeBase::nodeType type, const char* name) override;
+	void deleteShape(std::shared_ptr<sceneNodeBase> shape) override;
+	void showFenceWall(const std::vector<float>& points, const std::vector<float>& normals) override;
+	void hideFenceWall() override;
+
+	bool tetLinesCreated() override;
+	bool tetLinesVisible() override;
+	void setTetLinesVisible(bool visible) override;
+	void createTetLines(const std::vector<float>& points, const std::vector<unsigned int>& lines) override;
+	void updateTetLines(const std::vector<float>& points) override;
+	void eraseTetLines() override;
+
+	void drawAll() override;
+	void previewFrame(int milliseconds) override;
+
+	void sendUserMessage(const char* message, const char* title) override;
+	void clearUserMessage() override;
+	void showPhysicsBusy(bool busy) override;
+	void showToolState(int toolState) override;
+	void showModelFile(const std::string& modelFile) override;
+	bool ctrlOrShiftKeyDown() override;
+
+	void getDragVector(float dScreenX, float dScreenY, float(&position)[3], float(&dragVector)[3]) override;
+	const float* getFrameAndRotationMatrix() override;
+	void getTrianglePickLine(float(&lineStartPosition)[3], float(&lineDirection)[3]) override;
+
+	gl3wRenderer() : _gl3w(nullptr), _wall(nullptr) {}
+	~gl3wRenderer();
+
+private:
+	gl3wGraphics* _gl3w;
+	surgGraphics _sg;	// dynamic triangulated skin object
+	std::shared_ptr<sceneNode> _wall;  // fence wall, reused once made
+};
+
+#endif  // __GL3W_RENDERER__
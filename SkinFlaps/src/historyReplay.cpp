@@ -0,0 +1,115 @@
+// File: historyReplay.cpp
+// Purpose: Replays a surgical history (.hst) file end to end without the user interface. After each action the physics
+// is stepped a fixed number of solves, then the wall clock seconds the action spent in each phase are written as one
+// CSV line, so the shipped histories can be run as a regression benchmark. surgicalActions keeps its default
+// nullRenderer, so no window or openGL context is created and this runs on headless machines.
+// Usage: historyReplay modelDirectory historyFile [solvesPerAction=10] [timings.csv]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include "surgicalActions.h"
+
+int main(int argc, char** argv)
+{
+	if (argc < 3) {
+		fprintf(stderr, "Usage: historyReplay modelDirectory historyFile [solvesPerAction=10] [timings.csv]\n");
+		return 1;
+	}
+	std::string modelDir(argv[1]), historyPath(argv[2]), historyDir, historyFile;
+	if (modelDir.back() != '/' && modelDir.back() != '\\')
+		modelDir.push_back('/');
+	size_t slash = historyPath.find_last_of("/\\");
+	if (slash == std::string::npos)
+		historyFile = historyPath;
+	else {
+		historyDir = historyPath.substr(0, slash + 1);
+		historyFile = historyPath.substr(slash + 1);
+	}
+	int solvesPerAction = argc > 3 ? atoi(argv[3]) : 10;
+	std::ofstream csvFile;
+	if (argc > 4) {
+		csvFile.open(argv[4]);
+		if (!csvFile.is_open()) {
+			fprintf(stderr, "Can't write timings to %s\n", argv[4]);
+			return 1;
+		}
+	}
+	std::ostream& out = argc > 4 ? csvFile : std::cout;
+
+	int ret = 0;
+	{
+		std::unique_ptr<surgicalActions> sa(new surgicalActions);  // its nullRenderer writes messages to stderr
+		sa->setModelDirectory(modelDir.c_str());
+		bccTetScene* bts = sa->getBccTetScene();
+		phaseTimes& times = bts->getPhaseTimes();
+
+		double totalSeconds = 0.0, totalPhases[phaseTimes::PHASE_COUNT] = {};
+		int totalSolves = 0, totalIterations = 0, actionNumber = 0;
+		out << "action,name,seconds";
+		for (int i = 0; i < phaseTimes::PHASE_COUNT; ++i)
+			out << ',' << phaseTimes::phaseName(i);
+		out << ",solves,solverIterations\n";
+		out << std::fixed << std::setprecision(6);
+		auto writeLine = [&](const std::string& action, const std::string& name, double seconds) {
+			out << action << ',' << name << ',' << seconds;
+			for (int i = 0; i < phaseTimes::PHASE_COUNT; ++i)
+				out << ',' << times.seconds(i);
+			out << ',' << times.solves() << ',' << times.solverIterations() << '\n';
+		};
+		auto completeAction = [&](const std::string& name, std::chrono::steady_clock::time_point start) {
+			sa->physics.wait();
+			sa->updateTopology();
+			// A fixed number of solves whether or not the tissue settles, so every run does the same work.
+			for (int i = 0; i < solvesPerAction && bts->forcesApplied() && !bts->isPhysicsPaused(); ++i) {
+				sa->physics.run([bts]() {
+					bts->updatePhysics();
+					}, true
+				);
+				sa->physics.wait();
+			}
+			if (bts->forcesApplied())
+				bts->updateSurfaceDraw();  // the next action is located on the deformed surface
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			writeLine(std::to_string(actionNumber++), name, seconds);
+			totalSeconds += seconds;
+			for (int i = 0; i < phaseTimes::PHASE_COUNT; ++i)
+				totalPhases[i] += times.seconds(i);
+			totalSolves += times.solves();
+			totalIterations += times.solverIterations();
+		};
+		try {
+			times.clear();
+			auto start = std::chrono::steady_clock::now();
+			// Actions execute in the scene's own arena like its physics, so replays could share a process.
+			if (!sa->physics.execute([&]() { return sa->loadHistory(historyDir.c_str(), historyFile.c_str()); }))  // executes its loadSceneFile action
+				throw(std::runtime_error("Unable to load history file " + historyPath));
+			if (sa->historyEmpty())
+				throw(std::runtime_error("Unable to load the scene of history file " + historyPath));
+			completeAction("loadSceneFile", start);
+			while (!sa->historyComplete()) {
+				std::string name = sa->nextHistoryActionName();
+				times.clear();
+				start = std::chrono::steady_clock::now();
+				sa->physics.execute([&]() { sa->nextHistoryAction(); });
+				completeAction(name, start);
+			}
+			out << "total,," << totalSeconds;
+			for (int i = 0; i < phaseTimes::PHASE_COUNT; ++i)
+				out << ',' << totalPhases[i];
+			out << ',' << totalSolves << ',' << totalIterations << '\n';
+		}
+		catch (const std::exception& e) {
+			sa->physics.wait();
+			fprintf(stderr, "History replay stopped at action %d.\n%s\n", actionNumber, e.what());
+			ret = 1;
+		}
+	}
+	return ret;
+}
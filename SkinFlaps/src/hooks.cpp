@@ -9,16 +9,15 @@
 #include "GLmatrices.h"
 #include "Vec3f.h"
 #include "vnBccTetrahedra.h"
+#include "surgicalRenderer.h"
 #include <assert.h>
 #ifdef linux
 #include <stdio.h>
 #endif
 #include "hooks.h"
 
-float hooks::_hookSize = 2.5f;
-float hooks::_springConstant = 40.0f;
-GLfloat hooks::_selectedColor[] = {1.0f, 1.0f, 0.0f, 1.0f};
-GLfloat hooks::_unselectedColor[] = {0.043f, 0.898f, 0.102f, 1.0f};
+float hooks::_selectedColor[] = {1.0f, 1.0f, 0.0f, 1.0f};
+float hooks::_unselectedColor[] = {0.043f, 0.898f, 0.102f, 1.0f};
 
 void hooks::deleteHook(int hookNumber)
 {
@@ -31,7 +30,7 @@ void hooks::deleteHook(int hookNumber)
 		_ptp->initializePhysics();
 #endif
 	}
-	_shapes->deleteShape(hit->second.getShape());
+	_renderer->deleteShape(hit->second.getShape());
 	_hooks.erase(hit);
 }
 
@@ -54,7 +53,7 @@ bool hooks::getSelectPosition(unsigned int hookNumber, float(&selectPos)[3])
 	HOOKMAP::iterator hit = _hooks.find(hookNumber);
 	if (hit == _hooks.end())
 		return false;
-	GLfloat *mvm = hit->second._shape->getModelViewMatrix();
+	float *mvm = hit->second._shape->getModelViewMatrix();
 	selectPos[0] = hit->second._selectPosition[0];
 	selectPos[1] = hit->second._selectPosition[1];
 	selectPos[2] = hit->second._selectPosition[2];
@@ -66,7 +65,7 @@ bool hooks::getHookPosition(unsigned int hookNumber, float(&hookPos)[3])
 	HOOKMAP::iterator hit = _hooks.find(hookNumber);
 	if(hit==_hooks.end())
 		return false;
-	GLfloat *mvm = hit->second._shape->getModelViewMatrix();
+	float *mvm = hit->second._shape->getModelViewMatrix();
 	hookPos[0] = mvm[12];
 	hookPos[1] = mvm[13];
 	hookPos[2] = mvm[14];
@@ -85,7 +84,7 @@ bool hooks::setHookPosition(unsigned int hookNumber, float(&hookPos)[3])
 	else  // physics not activated yet
 		throw(std::logic_error("Attempting to move a hook without physics activation.\n"));
 #endif
-	GLfloat *mvm = hit->second._shape->getModelViewMatrix();
+	float *mvm = hit->second._shape->getModelViewMatrix();
 	mvm[12] = hookPos[0];
 	mvm[13] = hookPos[1];
 	mvm[14] = hookPos[2];
@@ -98,11 +97,11 @@ int hooks::addHook(materialTriangles *tri, int triangle, float(&uv)[2], bool tin
 	hpr = _hooks.insert(std::make_pair(_hookNow, hookConstraint()));
 	char name[6];
 	sprintf(name,"H_%d",_hookNow);
-	std::shared_ptr<sceneNode> sh;
+	std::shared_ptr<sceneNodeBase> sh;
 	if(tiny)
-		sh = _shapes->addShape(sceneNode::nodeType::SPHERE, name);
+		sh = _renderer->addShape(sceneNodeBase::nodeType::SPHERE, name);
 	else
-		sh = _shapes->addShape(sceneNode::nodeType::CONE, name);
+		sh = _renderer->addShape(sceneNodeBase::nodeType::CONE, name);
 	hpr.first->second.setShape(sh);
 	hpr.first->second._strong = tiny;
 	++_hookNow;
@@ -110,7 +109,7 @@ int hooks::addHook(materialTriangles *tri, int triangle, float(&uv)[2], bool tin
 	hpr.first->second.uv[0] = uv[0];
 	hpr.first->second.uv[1] = uv[1];
 	hpr.first->second._tri = tri;
-	GLfloat *om = sh->getModelViewMatrix();
+	float *om = sh->getModelViewMatrix();
 	loadIdentity4x4(om);
 	if(tiny)
 		scaleMatrix4x4(om,_hookSize*0.1f,_hookSize*0.1f,_hookSize*0.1f);
@@ -180,7 +179,7 @@ bool hooks::updateHookPhysics(){
 	return true;
 }
 
-hooks::hooks() : _groupPhysicsInit(false)
+hooks::hooks() : _springConstant(40.0f), _hookSize(2.5f), _groupPhysicsInit(false)
 {
 	_hookNow=0;
 	_selectedHook=-1;
@@ -8,7 +8,7 @@
 
 #include <map>
 #include <memory>
-#include "shapes.h"
+#include "sceneNodeBase.h"
 #include "Vec3f.h"
 
 #include "skinCutUndermineTets.h"
@@ -16,15 +16,14 @@
 
 // forward declarations
 class materialTriangles;
-class GLmatrices;
-class shapes;
+class surgicalRenderer;
 class vnBccTetrahedra;
 
 class hookConstraint
 {
 public:
-	inline void setShape(std::shared_ptr<sceneNode> &shape) {_shape=shape;}
-	inline std::shared_ptr<sceneNode>  getShape() {return _shape;}
+	inline void setShape(std::shared_ptr<sceneNodeBase> &shape) {_shape=shape;}
+	inline std::shared_ptr<sceneNodeBase>  getShape() {return _shape;}
 	hookConstraint() : _shape(nullptr), _constraintId(-1) {}
 	~hookConstraint() {}
 protected:
@@ -33,7 +32,7 @@ protected:
 	float uv[2];
 	Vec3f xyz, _selectPosition;  // xyz is current hook position
 	bool _selected, _strong;
-	std::shared_ptr<sceneNode> _shape;
+	std::shared_ptr<sceneNodeBase> _shape;
 	int _constraintId;
 	friend class hooks;
 };
@@ -51,10 +50,9 @@ public:
 	void setHookSize(float size) {_hookSize=size;}
 	void selectHook(int hookNumber);
 	void deleteHook(int hookNumber);
-	static inline void setSpringConstant(float k) { _springConstant = k; }
-	static inline float getSpringConstant() { return _springConstant; }
-	void setShapes(shapes *shps) {_shapes=shps;}
-	void setGLmatrices(GLmatrices *GLm) {_glm=GLm;}
+	inline void setSpringConstant(float k) { _springConstant = k; }
+	inline float getSpringConstant() { return _springConstant; }
+	void setRenderer(surgicalRenderer *renderer) { _renderer = renderer; }
 	void setPhysicsLattice(pdTetPhysics *pdtp) { _ptp = pdtp; }
 	void setVnBccTetrahedra(vnBccTetrahedra *vnt) { _vnt = vnt; }
 	inline bool empty() { return _hooks.empty(); }
@@ -64,17 +62,16 @@ public:
 	~hooks();
 
 private:
-	GLmatrices *_glm;
 	pdTetPhysics *_ptp;
 	vnBccTetrahedra *_vnt;
-	shapes *_shapes;
+	surgicalRenderer *_renderer;
 	typedef std::map<unsigned int, hookConstraint> HOOKMAP;
 	HOOKMAP _hooks;
 	unsigned int _hookNow;
 	int _selectedHook;
-	static float _springConstant;
-	static float _hookSize;
-	static GLfloat _selectedColor[4], _unselectedColor[4];  // , _insideSkullColor[4];
+	float _springConstant;
+	float _hookSize;
+	static float _selectedColor[4], _unselectedColor[4];  // , _insideSkullColor[4];
 	bool _groupPhysicsInit;
 };
 
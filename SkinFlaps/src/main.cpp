@@ -4,16 +4,14 @@
 // Read online: https://github.com/ocornut/imgui/tree/master/docs
 
 #include <stdio.h>
-#include <tbb/task_arena.h>
 #include <atomic>
 #include "surgicalActions.h"
 #include <gl3wGraphics.h>
 #include "FacialFlapsGui.h"
 
-FacialFlapsGui ffg;
-
 int main(int, char**)
 {
+	FacialFlapsGui ffg;
 	if (!ffg.initImguiGlfw()) {
 		puts("Failed to open Glfw window.\n");
 		return 1;
@@ -24,7 +22,6 @@ int main(int, char**)
 	}
 	surgicalActions* sa = ffg.getSurgicalActions();
 	bccTetScene* bts = sa->getBccTetScene();
-	sa->physicsDone = true;
 	while (!glfwWindowShouldClose(ffg.FFwindow))
 	{
 		try {
@@ -58,23 +55,21 @@ int main(int, char**)
 			glClearColor(clear_color.x, clear_color.y, clear_color.z, clear_color.w);
 			glClear(GL_COLOR_BUFFER_BIT);
 
-			if (sa->physicsDone) {
-				// draw last physics result before starting a new solve
-				// Unfortunately all graphics calls must be executed fom the master thread.
-				if (sa->newTopology) {
-					sa->getSurgGraphics()->setNewTopology();
-					sa->getSurgGraphics()->updatePositionsNormalsTangents();
-					sa->newTopology = false;
-				}
-				if (bts->forcesApplied()) {
-					sa->getSutures()->updateSutureGraphics();
-					if (sa->getSurgGraphics()->getSceneNode()->visible)
-						bts->updateSurfaceDraw();
-					else {  // draw only tets without the surface
-						if (ffg.getgl3wGraphics()->getLines()->getSceneNode() && ffg.getgl3wGraphics()->getLines()->getSceneNode()->visible)
-							bts->drawTetLattice();
-					}
+			bool physicsDone = sa->physics.done();
+			if (physicsDone)  // Unfortunately all graphics calls must be executed fom the master thread.
+				sa->updateTopology();
+			// A running solve only writes node positions, so the last frame it published can be drawn meanwhile.
+			// Any other task still running may be changing the topology being drawn.
+			if ((physicsDone || (sa->physics.solving() && bts->newPhysicsFrame())) && bts->forcesApplied()) {
+				sa->getSutures()->updateSutureGraphics();
+				if (ffg.getRenderer()->getSurgGraphics()->getSceneNode()->visible)
+					bts->updateSurfaceDraw();
+				else {  // draw only tets without the surface
+					if (ffg.getgl3wGraphics()->getLines()->getSceneNode() && ffg.getgl3wGraphics()->getLines()->getSceneNode()->visible)
+						bts->drawTetLattice();
 				}
+			}
+			if (physicsDone) {
 				if (ffg.physicsDrag)  //  && ffg.loadFile.empty()
 					ffg.physicsDrag = false;
 				if (ffg.nextCounter > 0) {
@@ -82,13 +77,10 @@ int main(int, char**)
 					--ffg.nextCounter;
 				}
 				else{
-				// below is from: https://www.intel.com/content/www/us/en/develop/documentation/onetbb-documentation/top/onetbb-developer-guide/design-patterns/gui-thread.html
-					if (bts->forcesApplied() && !bts->isPhysicsPaused()) {  // physicsDone recheck necessary since nextHistoryAction() may have spawned a task that this one would collide with
-						sa->physicsDone = false;
-						tbb::task_arena(tbb::task_arena::attach()).enqueue([&]() {  // enqueue
+					if (bts->forcesApplied() && !bts->isPhysicsPaused() && !bts->isPhysicsAsleep()) {
+						sa->physics.run([bts]() {
 							bts->updatePhysics();
-							sa->physicsDone = true;
-							}
+							}, true
 						);
 					}
 				}
@@ -122,8 +114,7 @@ int main(int, char**)
 		}
 		glfwSwapBuffers(ffg.FFwindow);
 	}
-	while (!sa->physicsDone)  // waiting for any running physics thread to complete before destroying its data
-		;
+	sa->physics.wait();  // any running physics task must complete before destroying its data
 	ffg.destroyImguiGlfw();
     return 0;
 }
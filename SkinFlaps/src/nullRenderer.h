@@ -0,0 +1,91 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// File: nullRenderer.h
+// Purpose: surgicalRenderer that displays nothing and needs no openGL context. Keeps only what the simulation reads
+// back, which texture ids were loaded and the tool shape nodes that hold hook, suture and fence positions, and writes
+// user messages to stderr. This is the renderer surgicalActions starts with, so batch drivers like historyReplay can
+// run the whole cutting, physics and collision stack on a headless machine.
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __NULL_RENDERER__
+#define __NULL_RENDERER__
+
+#include <set>
+#include <fstream>
+#include <iostream>
+#include "materialTriangles.h"
+#include "surgicalRenderer.h"
+
+class nullRenderer : public surgicalRenderer
+{
+public:
+	bool loadTexture(int txId, const char* filePath) override {
+		std::ifstream tx(filePath);
+		if (!tx.is_open())
+			return false;
+		_textures.insert(txId);
+		return true;
+	}
+	bool textureExists(int txId) override { return _textures.find(txId) != _textures.end(); }
+	bool loadStaticObject(const char* filePath, std::vector<int>& textureIds) override { return std::ifstream(filePath).is_open(); }
+	void createSurface(materialTriangles* mt, const char* name, std::vector<int>& textureIds, const char* vertexShaderFile, const char* fragmentShaderFile) override {
+		_mt = mt;
+		surfaceTopologyChanged();
+	}
+	void frameScene() override {}
+	void resetView() override {}
+
+	// surgGraphics::setNewTopology() computes the adjacency the cutting code relies on along with its vertex buffers
+	void surfaceTopologyChanged() override {
+		if (_mt)
+			_mt->findAdjacentTriangles(true);
+	}
+	void surfaceMoved() override {}
+	void setSurfaceVisible(bool visible) override {}
+
+	std::shared_ptr<sceneNodeBase> addShape(sceneNodeBase::nodeType type, const char* name) override {
+		auto sn = std::make_shared<sceneNodeBase>();  // never drawn
+		sn->setType(type);
+		sn->setName(name);
+		return sn;
+	}
+	void deleteShape(std::shared_ptr<sceneNodeBase> shape) override {}
+	void showFenceWall(const std::vector<float>& points, const std::vector<float>& normals) override {}
+	void hideFenceWall() override {}
+
+	bool tetLinesCreated() override { return _tetLinesCreated; }
+	bool tetLinesVisible() override { return _tetLinesVisible; }
+	void setTetLinesVisible(bool visible) override { _tetLinesVisible = visible; }
+	void createTetLines(const std::vector<float>& points, const std::vector<unsigned int>& lines) override { _tetLinesCreated = true; _tetLinesVisible = true; }
+	void updateTetLines(const std::vector<float>& points) override {}
+	void eraseTetLines() override { _tetLinesCreated = false; _tetLinesVisible = false; }
+
+	void drawAll() override {}
+	void previewFrame(int milliseconds) override {}
+
+	void sendUserMessage(const char* message, const char* title) override { std::cerr << title << "\n" << message << "\n"; }
+	void clearUserMessage() override {}
+	void showPhysicsBusy(bool busy) override {}
+	void showToolState(int toolState) override {}
+	void showModelFile(const std::string& modelFile) override {}
+	bool ctrlOrShiftKeyDown() override { return false; }
+
+	void getDragVector(float dScreenX, float dScreenY, float(&position)[3], float(&dragVector)[3]) override { dragVector[0] = 0.0f; dragVector[1] = 0.0f; dragVector[2] = 0.0f; }
+	const float* getFrameAndRotationMatrix() override { return _identity; }
+	void getTrianglePickLine(float(&lineStartPosition)[3], float(&lineDirection)[3]) override {
+		for (int i = 0; i < 3; ++i) {
+			lineStartPosition[i] = 0.0f;
+			lineDirection[i] = 0.0f;
+		}
+	}
+
+	nullRenderer() : _mt(nullptr), _tetLinesCreated(false), _tetLinesVisible(false) { loadIdentity4x4(_identity); }
+	~nullRenderer() {}
+
+private:
+	materialTriangles* _mt;
+	std::set<int> _textures;
+	float _identity[16];
+	bool _tetLinesCreated, _tetLinesVisible;
+};
+
+#endif  // __NULL_RENDERER__
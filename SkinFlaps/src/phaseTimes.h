@@ -0,0 +1,50 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// File: phaseTimes.h
+// Purpose: Accumulates wall clock seconds spent in each phase of a surgical action so a history replay can report
+// where the time went. Each phase is only timed from one thread at a time, the incision phases from the thread
+// executing the action and the rest from the physics scheduler, so read the totals after physicsScheduler::wait().
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __PHASE_TIMES__
+#define __PHASE_TIMES__
+
+#include <chrono>
+
+class phaseTimes
+{
+public:
+	enum phase { CUT = 0, TET_RECUT, PD_REINIT, COLLISION, SOLVE, PHASE_COUNT };
+	static const char* phaseName(int p) {
+		static const char* names[PHASE_COUNT] = { "cut", "tetRecut", "pdReinit", "collision", "solve" };
+		return names[p];
+	}
+	inline double seconds(int p) const { return _seconds[p]; }
+	inline int solves() const { return _solves; }
+	inline int solverIterations() const { return _iterations; }
+	inline void addSolve(int iterations) { ++_solves; _iterations += iterations; }
+	void clear() {
+		for (int i = 0; i < PHASE_COUNT; ++i)
+			_seconds[i] = 0.0;
+		_solves = 0;
+		_iterations = 0;
+	}
+
+	class timer  // adds its lifetime to one phase
+	{
+	public:
+		timer(phaseTimes& times, phase p) : _times(times), _phase(p), _start(std::chrono::steady_clock::now()) {}
+		~timer() { _times._seconds[_phase] += std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count(); }
+	private:
+		phaseTimes& _times;
+		phase _phase;
+		std::chrono::steady_clock::time_point _start;
+	};
+
+	phaseTimes() { clear(); }
+
+private:
+	double _seconds[PHASE_COUNT];
+	int _solves, _iterations;
+};
+
+#endif  // __PHASE_TIMES__
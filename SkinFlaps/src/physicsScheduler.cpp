@@ -0,0 +1,65 @@
+#include "physicsScheduler.h"
+
+void physicsScheduler::run(std::function<void()> task, bool solveOnly)
+{
+	{
+		std::lock_guard<std::mutex> lock(_queueLock);
+		_queue.push_back({ std::move(task), solveOnly });
+		if (!_idle)
+			return;  // the running task starts this one when it finishes
+		_idle = false;
+	}
+	// enqueue, not a task_group, so the arena always gets a worker even on a single core host where nobody calls wait()
+	_arena.enqueue([this]() {
+		while (true) {
+			queuedTask next;
+			{
+				std::lock_guard<std::mutex> lock(_queueLock);
+				if (_queue.empty()) {
+					_solving = false;
+					_idle = true;
+					_idleChanged.notify_all();
+					return;
+				}
+				next = std::move(_queue.front());
+				_queue.pop_front();
+				_solving = next.solveOnly;
+			}
+			try {
+				next.task();
+			}
+			catch (...) {  // drop what was queued behind the failed task and rethrow from wait()
+				std::lock_guard<std::mutex> lock(_queueLock);
+				_queue.clear();
+				_failure = std::current_exception();
+			}
+		}
+	});
+}
+
+void physicsScheduler::wait()
+{
+	std::unique_lock<std::mutex> lock(_queueLock);
+	_idleChanged.wait(lock, [this]() { return _idle.load(); });
+	if (_failure) {
+		std::exception_ptr failure = _failure;
+		_failure = nullptr;
+		std::rethrow_exception(failure);
+	}
+}
+
+void physicsScheduler::setMaxConcurrency(int maxConcurrency)
+{
+	wait();
+	_arena.terminate();
+	_arena.initialize(maxConcurrency);
+}
+
+physicsScheduler::~physicsScheduler()
+{
+	try {
+		wait();
+	}
+	catch (...) {  // a destructor must not throw. Callers wanting a failed task's exception call wait() first.
+	}
+}
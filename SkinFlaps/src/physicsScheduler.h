@@ -0,0 +1,54 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// File: physicsScheduler.h
+// Purpose: Runs physics steps and the topology edits that rebuild the physics lattice on a dedicated TBB task arena,
+// one at a time and in the order submitted. A task submitted while another runs is queued and started by the
+// finishing task as its continuation, so edits are always applied between solver steps. Tasks are enqueued in the
+// arena, so they progress while the GUI only polls done(). wait() sleeps instead of spinning until the queue is empty
+// and rethrows the exception of a failed task, which also drops the tasks queued behind it.
+// Each scene owns its scheduler and so its arena, letting several scenes run side by side in one process with the
+// cores divided between them by setMaxConcurrency(). The deformer sizes its OpenMP loops and Pardiso calls to the
+// arena they run in, so those stay within a scene's share too.
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __PHYSICS_SCHEDULER__
+#define __PHYSICS_SCHEDULER__
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <utility>
+#include <tbb/task_arena.h>
+
+class physicsScheduler
+{
+public:
+	// solveOnly marks a task that only moves node positions, so a render thread may draw published frames meanwhile
+	void run(std::function<void()> task, bool solveOnly = false);
+	void wait();  // until every submitted task is complete. Must be called from the thread calling run().
+	inline bool done() const { return _idle; }
+	inline bool solving() const { return _solving; }
+	void setMaxConcurrency(int maxConcurrency);  // waits for submitted tasks. Default is every core.
+	// runs f on the calling thread with any parallel loops it starts confined to this arena, e.g. a surgical action
+	template<class F> auto execute(F&& f) -> decltype(f()) { return _arena.execute(std::forward<F>(f)); }
+	physicsScheduler() : _idle(true), _solving(false) { _arena.initialize(); }
+	physicsScheduler(const physicsScheduler&) = delete;
+	physicsScheduler& operator=(const physicsScheduler&) = delete;
+	~physicsScheduler();  // waits for submitted tasks, dropping any exception a task throws. Call wait() to see it.
+
+private:
+	struct queuedTask {
+		std::function<void()> task;
+		bool solveOnly;
+	};
+	tbb::task_arena _arena;
+	std::mutex _queueLock;
+	std::deque<queuedTask> _queue;
+	std::condition_variable _idleChanged;
+	std::exception_ptr _failure;  // thrown by the last failed task, until wait() rethrows it
+	std::atomic<bool> _idle, _solving;
+};
+
+#endif  // __PHYSICS_SCHEDULER__
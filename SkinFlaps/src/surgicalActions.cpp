@@ -1,4 +1,3 @@
-#include "gl3wGraphics.h"
 #include "Vec3f.h"
 #include "Mat2x2f.h"
 #include <sstream>
@@ -9,15 +8,13 @@
 #include <assert.h>
 #include "insidePolygon.h"
 #include "prettyPrintJSON.h"
-#include "surgGraphics.h"
-#include <tbb/task_arena.h>
-#include "FacialFlapsGui.h"
 #include "surgicalActions.h"
 
 // ReadyPileType ReadyPile;
 
-surgicalActions::surgicalActions() : _toolState(0), _originalTriangleNumber(0), _sceneDir("0"), _historyDir("0"), _strongHooks(false), physicsDone(true), newTopology(false)
+surgicalActions::surgicalActions() : _toolState(0), _originalTriangleNumber(0), _sceneDir("0"), _historyDir("0"), _strongHooks(false), newTopology(false)
 {
+	setRenderer(&_nullRenderer);
 	_bts.setSurgicalActions(this);
 	_historyArray.Clear();
 	_historyIt = _historyArray.begin();
@@ -47,7 +44,7 @@ bool surgicalActions::saveSurgicalHistory(const char *fullFilePath)
 		hstStr = Serialize(_historyArray);
 	std::ofstream outf(fullFilePath);
 	if (!outf.is_open()) {
-		_ffg->sendUserMessage("Can't save to this filename (demos are read only).\n\nPlease create another name for your history file-\n", "History Save Error");
+		sendUserMessage("Can't save to this filename (demos are read only).\n\nPlease create another name for your history file-\n", "History Save Error");
 		return false;
 	}
 	prettyPrintJSON pp;
@@ -59,7 +56,24 @@ bool surgicalActions::saveSurgicalHistory(const char *fullFilePath)
 
 void surgicalActions::sendUserMessage(const char *message, const char *title, bool closeProgram)
 {
-	_ffg->sendUserMessage(message, title);
+	_renderer->sendUserMessage(message, title);
+}
+
+void surgicalActions::setRenderer(surgicalRenderer *renderer)
+{
+	_renderer = renderer;
+	_bts.setRenderer(renderer);
+	_hooks.setRenderer(renderer);
+	_sutures.setRenderer(renderer);
+	_fence.setRenderer(renderer);
+}
+
+void surgicalActions::updateTopology()
+{
+	if (!newTopology)
+		return;
+	_renderer->surfaceTopologyChanged();
+	newTopology = false;
 }
 
 bool surgicalActions::rightMouseDown(std::string objectHit, float (&position)[3], int triangle)
@@ -71,14 +85,12 @@ bool surgicalActions::rightMouseDown(std::string objectHit, float (&position)[3]
 	if (_toolState != 7 && !_periostealUndermineTriangles.empty()){  // forgot to finish periosteal undermining so do it now
 		int newTs = _toolState;
 		_toolState = 7;
-		onKeyDown(73);
 		setToolState(newTs);
 	}
 	if (_toolState > 0) {  // active tool requested by user
 		_bts.setPhysicsPause(true);  // stop doing physics updates
 		// prevent user from doing a new op until previous one is finished
-		while (!physicsDone)  // any previously enqueued physics thread must be complete before doing next op.
-			;
+		physics.wait();  // any previously enqueued physics thread must be complete before doing next op.
 	}
 	if(_toolState==0)	//viewer
 	{
@@ -106,10 +118,9 @@ bool surgicalActions::rightMouseDown(std::string objectHit, float (&position)[3]
 			;
 	}
 	else if (_toolState == 1) {	// create hook mode
-		auto sn = _gl3w->getNodePtr(objectHit);
-		if (sn->getType() != sceneNode::nodeType::MATERIAL_TRIANGLES)
+		if (triangle < 0)  // not the dynamic surface
 			return false;
-		materialTriangles* tr = _sg.getMaterialTriangles();
+		materialTriangles* tr = &_mt;
 		float uv[2] = { 0.0f, 0.0f };
 		tr->getBarycentricProjection(triangle, position, uv);
 		int material;
@@ -118,9 +129,7 @@ bool surgicalActions::rightMouseDown(std::string objectHit, float (&position)[3]
 		if (!setHistoryAttachPoint(triangle, uv, material, hTx, hVec))
 			return false;  // try again
 		if (_hooks.getNumberOfHooks() < 1) {	// initialize hooks
-			_hooks.setHookSize(sn->getRadius() * 0.02f);
-			_hooks.setShapes(_gl3w->getShapes());
-			_hooks.setGLmatrices(_gl3w->getGLmatrices());
+			_hooks.setHookSize(_bts.getSurfaceRadius() * 0.02f);
 			_hooks.setPhysicsLattice(_bts.getPdTetPhysics_2());
 			_hooks.setVnBccTetrahedra(_bts.getVirtualNodedBccTetrahedra());
 		}
@@ -152,12 +161,10 @@ bool surgicalActions::rightMouseDown(std::string objectHit, float (&position)[3]
 			//			return true;  // for above debug use
 
 			if (!_bts.getPdTetPhysics_2()->solverInitialized()) {  // solver must be initialized to add a hook
-				_ffg->physicsDrag = true;
+				_renderer->showPhysicsBusy(true);
 				_bts.setForcesAppliedFlag();
-				physicsDone = false;
 //				tbb::task_arena(tbb::task_arena::attach()).enqueue([&]() {  // enqueue
 					_bts.updatePhysics();
-					physicsDone = true;
 //					}
 //				);
 			}
@@ -197,13 +204,11 @@ bool surgicalActions::rightMouseDown(std::string objectHit, float (&position)[3]
 	}
 	else if (_toolState == 2)	// incision mode
 	{
-		auto sn = _gl3w->getNodePtr(objectHit);
-		if (sn->getType() != sceneNode::nodeType::MATERIAL_TRIANGLES)
+		if (triangle < 0)  // not the dynamic surface
 			return false;
-		materialTriangles* tr = _sg.getMaterialTriangles();
+		materialTriangles* tr = &_mt;
 		if (!_fence.isInitialized()) {	// initialize fence
-			_fence.setFenceSize(sn->getRadius() * 0.02f);
-			_fence.setGl3wGraphics(_gl3w);
+			_fence.setFenceSize(_bts.getSurfaceRadius() * 0.02f);
 		}
 		bool endConn = false;
 		Vec3f vtx(position), nrm;
@@ -214,9 +219,9 @@ bool surgicalActions::rightMouseDown(std::string objectHit, float (&position)[3]
 			_fence.addPost(tr, _fence.getPostTriangle(0), vtx.xyz, nrm.xyz, endConn, false, false);
 			_hooks.selectHook(-1);
 			_sutures.selectSuture(-1);
-			onKeyDown(GLFW_KEY_ENTER);	// press enter key for user
+			onEnterKey();	// press enter key for user
 		};
-		if (_ffg->CtrlOrShiftKeyIsDown()) {
+		if (_renderer->ctrlOrShiftKeyDown()) {
 			endConn = true;
 			int edg, oldTriangle = triangle;
 			float param, closeIncisionDistance = _incisions.closestSkinIncisionPoint(vtx, triangle, edg, param);
@@ -266,20 +271,19 @@ bool surgicalActions::rightMouseDown(std::string objectHit, float (&position)[3]
 		_hooks.selectHook(-1);
 		_sutures.selectSuture(-1);
 		if (_fence.numberOfPosts() > 1 && endConn)	// this must finish an incision
-			onKeyDown(GLFW_KEY_ENTER);	// press enter key for user
+			onEnterKey();	// press enter key for user
 	}
 	else if (_toolState == 3){	// start undermine tool
-		auto sn = _gl3w->getNodePtr(objectHit);
-		if (sn->getType() != sceneNode::nodeType::MATERIAL_TRIANGLES)
+		if (triangle < 0)  // not the dynamic surface
 			return false;
-		materialTriangles* tr = _sg.getMaterialTriangles();
+		materialTriangles* tr = &_mt;
 		if (tr->triangleMaterial(triangle) != 2 && tr->triangleMaterial(triangle) != 10) {
 			sendUserMessage("With this tool you can only undermine from top side of skin.", "USER ERROR");
 			return true;
 		}
 		undermineTriangle ut;
 		ut.triangle = triangle;
-		ut.incisionConnect = !_ffg->CtrlOrShiftKeyIsDown();
+		ut.incisionConnect = !_renderer->ctrlOrShiftKeyDown();
 		_undermineTriangles.push_back(ut);
 		_bts.updateSurfaceDraw();
 		if (!_incisions.addUndermineTriangle(triangle, 2, ut.incisionConnect)) {
@@ -288,14 +292,11 @@ bool surgicalActions::rightMouseDown(std::string objectHit, float (&position)[3]
 		}
 	}
 	else if (_toolState == 4){	// create suture mode
-		auto sn = _gl3w->getNodePtr(objectHit);
-		if (sn->getType() != sceneNode::nodeType::MATERIAL_TRIANGLES)
+		if (triangle < 0)  // not the dynamic surface
 			return false;
-		materialTriangles* tr = _sg.getMaterialTriangles();
+		materialTriangles* tr = &_mt;
 		if (_sutures.getNumberOfSutures() < 1) {	// initialize sutures
-			_sutures.setSutureSize(sn->getRadius()*0.003f);
-			_sutures.setShapes(_gl3w->getShapes());
-			_sutures.setGLmatrices(_gl3w->getGLmatrices());
+			_sutures.setSutureSize(_bts.getSurfaceRadius()*0.003f);
 			_sutures.setPhysicsLattice(_bts.getPdTetPhysics_2());
 			_sutures.setVnBccTetrahedra(_bts.getVirtualNodedBccTetrahedra());
 			_sutures.setSurgicalActions(this);
@@ -376,7 +377,7 @@ bool surgicalActions::rightMouseDown(std::string objectHit, float (&position)[3]
 		}
 		tr->getBarycentricPosition(eTri, uv, _dragXyz);
 		i = _sutures.addUserSuture(tr, eTri, edg, param);
-		if (_ffg->CtrlOrShiftKeyIsDown()) {
+		if (_renderer->ctrlOrShiftKeyDown()) {
 			int prevMat = _sutures.previousUserSuture(i);
 			if (prevMat > -1)
 				prevMat = _sutures.firstVertexMaterial(prevMat);
@@ -396,10 +397,9 @@ bool surgicalActions::rightMouseDown(std::string objectHit, float (&position)[3]
 		_selectedSurgObject = s;
 	}
 	else if (_toolState == 5) {	// excise mode
-		auto sn = _gl3w->getNodePtr(objectHit);
-		if (sn->getType() != sceneNode::nodeType::MATERIAL_TRIANGLES)
+		if (triangle < 0)  // not the dynamic surface
 			return false;
-		materialTriangles* tr = _sg.getMaterialTriangles();
+		materialTriangles* tr = &_mt;
 		int mat = tr->triangleMaterial(triangle);
 		if (mat == 3 || mat == 6) {
 			sendUserMessage("Can't excise from a skin/mucosal edge or a cut muscle belly,  Try again-", "USER ERROR");
@@ -433,19 +433,17 @@ bool surgicalActions::rightMouseDown(std::string objectHit, float (&position)[3]
 		_historyArray.push_back(exciseTitle);
 		_historyIt = _historyArray.end();
 		_incisions.excise(triangle);
-		physicsDone = false;
-		_ffg->physicsDrag = true;
-		tbb::task_arena(tbb::task_arena::attach()).enqueue([&]() {  // enqueue
+		_renderer->showPhysicsBusy(true);
+		physics.run([this]() {
 			_bts.updateOldPhysicsLattice();
 			newTopology = true;
-			physicsDone = true;
 			}
 		);
 		_bts.setPhysicsPause(false);
 		_hooks.selectHook(-1);
 		_sutures.selectSuture(-1);
 		_selectedSurgObject = "";
-		_ffg->setToolState(0);
+		_renderer->showToolState(0);
 		setToolState(0);
 	}
 	else if (_toolState == 6)	// deep cut mode
@@ -460,20 +458,18 @@ bool surgicalActions::rightMouseDown(std::string objectHit, float (&position)[3]
 			_fence.setSpherePos(hookNum, pos);
 			return true;
 		}
-		auto sn = _gl3w->getNodePtr(objectHit);
-		if (sn->getType() != sceneNode::nodeType::MATERIAL_TRIANGLES)
+		if (triangle < 0)  // not the dynamic surface
 			return false;
-		materialTriangles* tr = _sg.getMaterialTriangles();
+		materialTriangles* tr = &_mt;
 		if (tr->triangleMaterial(triangle) != 2 && tr->triangleMaterial(triangle) != 5) {
 			sendUserMessage("Can only deep cut from unelevated skin top or deep bed.  Try again-", "USER ERROR");
 			return true;
 		}
 		if (!_fence.isInitialized()) {	// initialize fence
-			_fence.setFenceSize(sn->getRadius() * 0.02f);
-			_fence.setGl3wGraphics(_gl3w);
+			_fence.setFenceSize(_bts.getSurfaceRadius() * 0.02f);
 		}
 		bool closedEnd = true;
-		if (_ffg->CtrlOrShiftKeyIsDown())
+		if (_renderer->ctrlOrShiftKeyDown())
 			closedEnd = false;
 		Vec3f norm;
 		float pos[3], uv[2] = { 0.0f, 0.0f };
@@ -504,15 +500,14 @@ bool surgicalActions::rightMouseDown(std::string objectHit, float (&position)[3]
 		_sutures.selectSuture(-1);
 	}
 	else if (_toolState == 7){	// periosteal undermine mode
-		auto sn = _gl3w->getNodePtr(objectHit);
-		if (sn->getType() != sceneNode::nodeType::MATERIAL_TRIANGLES)
+		if (triangle < 0)  // not the dynamic surface
 			return false;
-		materialTriangles* tr = _sg.getMaterialTriangles();
+		materialTriangles* tr = &_mt;
 		Vec3f cameraPos, dir;
-		_gl3w->getTrianglePickLine(cameraPos.xyz, dir.xyz);  // this routine only used here as of 3/22/2022
+		_renderer->getTrianglePickLine(cameraPos.xyz, dir.xyz);  // this routine only used here as of 3/22/2022
 		_bts.updateSurfaceDraw();
 		perioTri pt;
-		pt.incisionConnect = !_ffg->CtrlOrShiftKeyIsDown();
+		pt.incisionConnect = !_renderer->ctrlOrShiftKeyDown();
 		pt.periostealTriangle = _incisions.addPeriostealUndermineTriangle(triangle, dir, pt.incisionConnect);
 		if (pt.periostealTriangle > 0x7ffffffe){
 			sendUserMessage("No periosteal triangle hit.  Try again-", "USER ERROR");
@@ -532,23 +527,21 @@ bool surgicalActions::rightMouseUp(std::string objectHit, float (&position)[3],
 		_selectedSurgObject = "";
 	else if (_toolState == 4)	{	// finish applying a suture
 		// prevent user from doing a new op until previous one is finished
-		assert(physicsDone);  // physics update thread must be complete before doing next op.
+		assert(physics.done());  // physics update thread must be complete before doing next op.
 		assert(_selectedSurgObject.substr(0,2)=="S_");
 		materialTriangles *tr = NULL;
 		int i = atoi(_selectedSurgObject.c_str()+2);
-		surgGraphics *sg = NULL;
 		if (objectHit != "") {
-			auto sn = _gl3w->getNodePtr(objectHit);
-			if (sn->getType() != sceneNode::nodeType::MATERIAL_TRIANGLES)
+			if (triangle < 0)  // not the dynamic surface
 				return false;
-			tr = _sg.getMaterialTriangles();
+			tr = &_mt;
 		}
 		int eTri = triangle;
 		int edge, triMat = tr->triangleMaterial(triangle);
 		float param, uv[2];
 		auto invalidate = [&]() {
 			// prevent user from doing a new op until previous one is finished
-			if (!physicsDone)  // physics update thread must be complete before doing next op.
+			if (!physics.done())  // physics update thread must be complete before doing next op.
 				throw(std::logic_error("Trying to invalidate a suture while a physics thread is active.\n"));
 			_sutures.deleteSuture(i);
 			_bts.setPhysicsPause(false);
@@ -556,7 +549,7 @@ bool surgicalActions::rightMouseUp(std::string objectHit, float (&position)[3],
 			_hooks.selectHook(-1);
 			_sutures.selectSuture(-1);
 			setToolState(0);
-			_ffg->setToolState(0);
+			_renderer->showToolState(0);
 		};
 		if (tr == NULL){
 			invalidate();
@@ -663,15 +656,13 @@ bool surgicalActions::rightMouseUp(std::string objectHit, float (&position)[3],
 				uv[1] = param;
 			}
 			tr->getBarycentricPosition(eTri, uv, pos);
-			if (!physicsDone)  // physics update thread must be complete before doing next op.
+			if (!physics.done())  // physics update thread must be complete before doing next op.
 				throw(std::logic_error("Trying to add a suture while a physics thread is active.\n"));
 			_sutures.setSecondVertexPosition(i, pos);
 			if (_sutures.isLinked(i)) {
-				physicsDone = false;
-				_ffg->physicsDrag = true;
-				tbb::task_arena(tbb::task_arena::attach()).enqueue([&]() {
+				_renderer->showPhysicsBusy(true);
+				physics.run([this, i]() {
 					_sutures.laySutureLine(i);
-					physicsDone = true;
 					}
 				);
 			}
@@ -753,7 +744,7 @@ bool surgicalActions::rightMouseUp(std::string objectHit, float (&position)[3],
 		_historyIt = _historyArray.end();
 		_hooks.selectHook(-1);
 		_sutures.selectSuture(i);
-		_ffg->setToolState(0);
+		_renderer->showToolState(0);
 		_bts.setPhysicsPause(false);
 		setToolState(0);
 	}
@@ -762,7 +753,7 @@ bool surgicalActions::rightMouseUp(std::string objectHit, float (&position)[3],
 		if (_toolState == 1) {
 			_bts.setPhysicsPause(false);
 			setToolState(0);
-			_ffg->setToolState(0);
+			_renderer->showToolState(0);
 			return true;
 		}
 		if (_toolState == 0) {  // Too many spurius hook moves recorded due to zoom releases. Fixed in cleftSimViewer.
@@ -816,16 +807,16 @@ bool surgicalActions::mouseMotion(float dScreenX, float dScreenY)
 	{
 		int postNum = atoi(_selectedSurgObject.c_str()+3);
 		_fence.getSpherePos(postNum, xyz);
-		_gl3w->getGLmatrices()->getDragVector(dScreenX, dScreenY, xyz.xyz, dv.xyz);
+		_renderer->getDragVector(dScreenX, dScreenY, xyz.xyz, dv.xyz);
 		xyz += dv;
 		_fence.setSpherePos(postNum, xyz);
 	}
 	else if(_toolState==4)	{
 		assert(_selectedSurgObject.substr(0,2)=="S_");
 		int sutNum = atoi(_selectedSurgObject.c_str()+2);
-		_gl3w->getGLmatrices()->getDragVector(dScreenX,dScreenY,_dragXyz,dv.xyz);
+		_renderer->getDragVector(dScreenX,dScreenY,_dragXyz,dv.xyz);
 		_dragXyz[0]+=dv.xyz[0]; _dragXyz[1]+=dv.xyz[1]; _dragXyz[2]+=dv.xyz[2];
-		const float *mm=_gl3w->getGLmatrices()->getFrameAndRotationMatrix();
+		const float *mm=_renderer->getFrameAndRotationMatrix();
 		transformVector3(_dragXyz,mm,xyz.xyz);
 		xyz *= 0.7f;
 		xyz.xyz[0]-=mm[12]; xyz.xyz[1]-=mm[13]; xyz.xyz[2]-=mm[14];
@@ -838,14 +829,13 @@ bool surgicalActions::mouseMotion(float dScreenX, float dScreenY)
 	{
 		int hookNum = atoi(_selectedSurgObject.c_str() + 2);
 		_hooks.getHookPosition(hookNum, xyz.xyz);
-		_gl3w->getGLmatrices()->getDragVector(dScreenX, dScreenY, xyz.xyz, dv.xyz);
+		_renderer->getDragVector(dScreenX, dScreenY, xyz.xyz, dv.xyz);
 		xyz += dv;
 		_bts.setForcesAppliedFlag();  // this is a hook move so forces are applied
-		if (!_bts.isPhysicsPaused() || !physicsDone) {
+		if (!_bts.isPhysicsPaused() || !physics.done()) {
 			_bts.setPhysicsPause(true);  // stop doing physics updates
 			// prevent user from doing a new op until previous one is finished
-			while (!physicsDone)  // any previously enqueued physics thread must be complete before doing next op.
-				;
+			physics.wait();  // any previously enqueued physics thread must be complete before doing next op.
 		}
 		_hooks.setHookPosition(hookNum, xyz.xyz);
 		_bts.setPhysicsPause(false);
@@ -855,381 +845,358 @@ bool surgicalActions::mouseMotion(float dScreenX, float dScreenY)
 	return true;
 }
 
-void surgicalActions::onKeyDown(int key)
+void surgicalActions::onDeleteKey()
 {
-	std::string hStr;
-	// ctrl and shift keys now handled by frame calls
-	if(key == GLFW_KEY_DELETE)	// delete key
-	{
 ///		// can't delete periosteal undermines (toolState 7) already done.
 //		if (_toolState == 7) {
 //			sendUserMessage("Sorry. Periosteal undermining can't be undone-", "USER ERROR");
 //			return;
 //		}
 //		else 
-		if (_toolState == 2) {
-			if (_fence.numberOfPosts() > 0)
-				_fence.deleteLastPost();
-			return;  // don't reset toolstate
-		}
-		else if (_toolState == 6) {
-			if (_fence.numberOfPosts() > 0) {
-				_fence.deleteLastPost();
+	if (_toolState == 2) {
+		if (_fence.numberOfPosts() > 0)
+			_fence.deleteLastPost();
+		return;  // don't reset toolstate
+	}
+	else if (_toolState == 6) {
+		if (_fence.numberOfPosts() > 0) {
+			_fence.deleteLastPost();
 //				_incisions.popLastDeepPost();
-				_selectedSurgObject = "";
-			}
-			return;  // don't reset toolstate
+			_selectedSurgObject = "";
 		}
-		else if (_toolState == 3){
+		return;  // don't reset toolstate
+	}
+	else if (_toolState == 3){
 //			_incisions.clearCurrentUndermine(2);
-			_undermineTriangles.clear();
-			return;
+		_undermineTriangles.clear();
+		return;
+	}
+	else if (_selectedSurgObject.substr(0, 2) == "H_")
+	{
+		int hookNum = atoi(_selectedSurgObject.c_str()+2);
+		// prevent user from doing a new op until previous one is finished
+		_bts.setPhysicsPause(true);  // don't spawn another physics update till complete
+		physics.wait();  // physics update thread must be complete before doing next op.
+		_hooks.deleteHook(hookNum);
+		_bts.setPhysicsPause(false);
+		if (_historyIt != _historyArray.end()) {
+			json::Array tarr;
+			for (json::Array::ValueVector::iterator it = _historyArray.begin(); it != _historyIt; ++it)
+				tarr.push_back(*it);
+			_historyArray.Clear();
+			_historyArray = tarr;
 		}
-		else if (_selectedSurgObject.substr(0, 2) == "H_")
-		{
-			int hookNum = atoi(_selectedSurgObject.c_str()+2);
-			// prevent user from doing a new op until previous one is finished
-			_bts.setPhysicsPause(true);  // don't spawn another physics update till complete
-			while (!physicsDone)  // physics update thread must be complete before doing next op.
-				;
-			_hooks.deleteHook(hookNum);
-			_bts.setPhysicsPause(false);
-			if (_historyIt != _historyArray.end()) {
-				json::Array tarr;
-				for (json::Array::ValueVector::iterator it = _historyArray.begin(); it != _historyIt; ++it)
-					tarr.push_back(*it);
-				_historyArray.Clear();
-				_historyArray = tarr;
-			}
-			json::Object dObj;
-			dObj["deleteHook"] = hookNum;
-			_historyArray.push_back(dObj);
-			_historyIt = _historyArray.end();
+		json::Object dObj;
+		dObj["deleteHook"] = hookNum;
+		_historyArray.push_back(dObj);
+		_historyIt = _historyArray.end();
+	}
+	else if(_selectedSurgObject.substr(0,2)=="S_")
+	{
+		if (_historyIt != _historyArray.end()) {
+			json::Array tarr;
+			for (json::Array::ValueVector::iterator it = _historyArray.begin(); it != _historyIt; ++it)
+				tarr.push_back(*it);
+			_historyArray.Clear();
+			_historyArray = tarr;
 		}
-		else if(_selectedSurgObject.substr(0,2)=="S_")
-		{
-			if (_historyIt != _historyArray.end()) {
-				json::Array tarr;
-				for (json::Array::ValueVector::iterator it = _historyArray.begin(); it != _historyIt; ++it)
-					tarr.push_back(*it);
-				_historyArray.Clear();
-				_historyArray = tarr;
-			}
-			json::Object sObj;
-			int sutNum = atoi(_selectedSurgObject.c_str() + 2);
-			int userNum = _sutures.baseToUserSutureNumber(sutNum);
-			_bts.setPhysicsPause(true);  // don't spawn another physics update till complete
-			// prevent user from doing a new op until previous one is finished
-			while (!physicsDone)  // physics update thread must be complete before doing next op.
-				;
-			int linkNum = _sutures.deleteSuture(sutNum);
-			if (userNum < 0) {
-				json::Object lObj;
-				lObj["autoSuturesFor"] = _sutures.baseToUserSutureNumber(linkNum);
-				sObj["deleteSuture"] = lObj;
-			}
-			else
-				sObj["deleteSuture"] = userNum;
-			_historyArray.push_back(sObj);
-			_historyIt = _historyArray.end();
+		json::Object sObj;
+		int sutNum = atoi(_selectedSurgObject.c_str() + 2);
+		int userNum = _sutures.baseToUserSutureNumber(sutNum);
+		_bts.setPhysicsPause(true);  // don't spawn another physics update till complete
+		// prevent user from doing a new op until previous one is finished
+		physics.wait();  // physics update thread must be complete before doing next op.
+		int linkNum = _sutures.deleteSuture(sutNum);
+		if (userNum < 0) {
+			json::Object lObj;
+			lObj["autoSuturesFor"] = _sutures.baseToUserSutureNumber(linkNum);
+			sObj["deleteSuture"] = lObj;
 		}
 		else
-			;
-		_ffg->setToolState(0);
-		setToolState(0);
-		_bts.setPhysicsPause(false);
+			sObj["deleteSuture"] = userNum;
+		_historyArray.push_back(sObj);
+		_historyIt = _historyArray.end();
 	}
-	else if (key == GLFW_KEY_ENTER)	// <enter> key
-	{
-		// prevent user from doing a new op until previous one is finished
-//		assert(physicsDone);  // physics update thread must be complete before doing next op.
-		if (_toolState == 7){	//periosteal undermine mode
-			_bts.setPhysicsPause(true);  // should already be done
-			while (!physicsDone)
-				;
-			materialTriangles *mt = _sg.getMaterialTriangles();
-			for (int n = mt->numberOfTriangles(), i = 0; i < n; ++i){
-				if (mt->triangleMaterial(i) == 10)
-					mt->setTriangleMaterial(i, 8);  // 8 is a periosteal triangle that has been undermined
-			}
-			_bts.updateSurfaceDraw();
-			while (!physicsDone)  // physics update thread must be complete before doing next op.
-				;
-			physicsDone = false;
-			_ffg->physicsDrag = true;
-			tbb::task_arena(tbb::task_arena::attach()).enqueue([&]() {  // enqueue
-				_bts.fixPeriostealPeriferalVertices();
-				_bts.nonTetPhysicsUpdate();
-				newTopology = true;
-				physicsDone = true;
-				}
-			);
-			_bts.setPhysicsPause(false);
-			if (_historyIt != _historyArray.end()) {
-				json::Array tarr;
-				for (json::Array::ValueVector::iterator it = _historyArray.begin(); it != _historyIt; ++it)
-					tarr.push_back(*it);
-				_historyArray.Clear();
-				_historyArray = tarr;
-			}
-			float hTx[2], uv[2] = { 0.333f, 0.333f };
-			int material;
-			Vec3f hVec;
-			json::Array uArr;
-			json::Object uObj, pObj;
-			auto ptit = _periostealUndermineTriangles.begin();
-			while (ptit != _periostealUndermineTriangles.end()) {
-				uObj.Clear();
-				setHistoryAttachPoint(ptit->periostealTriangle, uv, material, hTx, hVec);
-				uObj["material"] = material;
-				json::Array sArr;
-				sArr.push_back(hTx[0]);
-				sArr.push_back(hTx[1]);
-				uObj["historyTexture"] = sArr;
-				sArr.Clear();
-				sArr.push_back(hVec[0]);
-				sArr.push_back(hVec[1]);
-				sArr.push_back(hVec[2]);
-				uObj["displacement"] = sArr;
-				uObj["incisionConnect"] = (bool)ptit->incisionConnect;
-				pObj["periostealTriangle"] = uObj;
-				uArr.push_back(pObj);
-				++ptit;
+	else
+		;
+	_renderer->showToolState(0);
+	setToolState(0);
+	_bts.setPhysicsPause(false);
+}
+
+void surgicalActions::onEnterKey()
+{
+	// prevent user from doing a new op until previous one is finished
+//		assert(physics.done());  // physics update thread must be complete before doing next op.
+	if (_toolState == 7){	//periosteal undermine mode
+		_bts.setPhysicsPause(true);  // should already be done
+		physics.wait();
+		materialTriangles *mt = &_mt;
+		for (int n = mt->numberOfTriangles(), i = 0; i < n; ++i){
+			if (mt->triangleMaterial(i) == 10)
+				mt->setTriangleMaterial(i, 8);  // 8 is a periosteal triangle that has been undermined
+		}
+		_bts.updateSurfaceDraw();
+		physics.wait();  // physics update thread must be complete before doing next op.
+		_renderer->showPhysicsBusy(true);
+		physics.run([this]() {
+			_bts.fixPeriostealPeriferalVertices();
+			_bts.nonTetPhysicsUpdate();
+			newTopology = true;
 			}
+		);
+		_bts.setPhysicsPause(false);
+		if (_historyIt != _historyArray.end()) {
+			json::Array tarr;
+			for (json::Array::ValueVector::iterator it = _historyArray.begin(); it != _historyIt; ++it)
+				tarr.push_back(*it);
+			_historyArray.Clear();
+			_historyArray = tarr;
+		}
+		float hTx[2], uv[2] = { 0.333f, 0.333f };
+		int material;
+		Vec3f hVec;
+		json::Array uArr;
+		json::Object uObj, pObj;
+		auto ptit = _periostealUndermineTriangles.begin();
+		while (ptit != _periostealUndermineTriangles.end()) {
 			uObj.Clear();
-			uObj["periostealUndermine"] = uArr;
-			_historyArray.push_back(uObj);
-			_incisions.clearCurrentUndermine(8);  // set all periosteal undermined triangles to material 8 and reset.
-			_periostealUndermineTriangles.clear();
-			_historyIt = _historyArray.end();
-			_hooks.selectHook(-1);
-			_sutures.selectSuture(-1);
-			_selectedSurgObject = "";
+			setHistoryAttachPoint(ptit->periostealTriangle, uv, material, hTx, hVec);
+			uObj["material"] = material;
+			json::Array sArr;
+			sArr.push_back(hTx[0]);
+			sArr.push_back(hTx[1]);
+			uObj["historyTexture"] = sArr;
+			sArr.Clear();
+			sArr.push_back(hVec[0]);
+			sArr.push_back(hVec[1]);
+			sArr.push_back(hVec[2]);
+			uObj["displacement"] = sArr;
+			uObj["incisionConnect"] = (bool)ptit->incisionConnect;
+			pObj["periostealTriangle"] = uObj;
+			uArr.push_back(pObj);
+			++ptit;
+		}
+		uObj.Clear();
+		uObj["periostealUndermine"] = uArr;
+		_historyArray.push_back(uObj);
+		_incisions.clearCurrentUndermine(8);  // set all periosteal undermined triangles to material 8 and reset.
+		_periostealUndermineTriangles.clear();
+		_historyIt = _historyArray.end();
+		_hooks.selectHook(-1);
+		_sutures.selectSuture(-1);
+		_selectedSurgObject = "";
+	}
+	else if (_toolState == 2)	//incision mode
+	{
+		std::vector<Vec3f> positions, normals;
+		std::vector<float> postUvs;
+		std::vector<int> postTriangles;
+		bool edgeStart = false, edgeEnd = false, Tout = false, nukeThis = false, sOpen, eOpen;
+		int n = _fence.getPostData(positions, normals, postTriangles, postUvs, edgeStart, edgeEnd, sOpen, eOpen);
+		if (_historyIt != _historyArray.end()) {
+			json::Array tarr;
+			for (json::Array::ValueVector::iterator it = _historyArray.begin(); it != _historyIt; ++it)
+				tarr.push_back(*it);
+			_historyArray.Clear();
+			_historyArray = tarr;
 		}
-		else if (_toolState == 2)	//incision mode
-		{
-			std::vector<Vec3f> positions, normals;
-			std::vector<float> postUvs;
-			std::vector<int> postTriangles;
-			bool edgeStart = false, edgeEnd = false, Tout = false, nukeThis = false, sOpen, eOpen;
-			int n = _fence.getPostData(positions, normals, postTriangles, postUvs, edgeStart, edgeEnd, sOpen, eOpen);
-			if (_historyIt != _historyArray.end()) {
-				json::Array tarr;
-				for (json::Array::ValueVector::iterator it = _historyArray.begin(); it != _historyIt; ++it)
-					tarr.push_back(*it);
-				_historyArray.Clear();
-				_historyArray = tarr;
-			}
-			json::Object iObj;
-			iObj["incisedObject"] = 0;	// for now only one object incisable
-			iObj["Tin"] = edgeStart;
-			iObj["Tout"] = edgeEnd;
-			iObj["pointNumber"] = n;
-			json::Array iArr;
+		json::Object iObj;
+		iObj["incisedObject"] = 0;	// for now only one object incisable
+		iObj["Tin"] = edgeStart;
+		iObj["Tout"] = edgeEnd;
+		iObj["pointNumber"] = n;
+		json::Array iArr;
+		iArr.push_back(iObj);
+		materialTriangles *tri=&_mt;
+		float uv[2];  //  , minParam = 1.0e15f;
+		int material;
+		float hTx[2];
+		Vec3f hVec;
+		json::Array hArr;
+		for (int i = 0; i<n; ++i)	{
+			uv[0] = postUvs[i << 1];
+			uv[1] = postUvs[(i << 1) + 1];
+			setHistoryAttachPoint(postTriangles[i], uv, material, hTx, hVec);
+			json::Object pObj;
+			pObj["material"] = material;
+			hArr.Clear();
+			hArr.push_back(hTx[0]);
+			hArr.push_back(hTx[1]);
+			pObj["historyTexture"] = hArr;
+			hArr.Clear();
+			hArr.push_back(hVec[0]);
+			hArr.push_back(hVec[1]);
+			hArr.push_back(hVec[2]);
+			pObj["displacement"] = hArr;
+			iObj.Clear();
+			iObj["incisionPoint"] = pObj;
 			iArr.push_back(iObj);
-			materialTriangles *tri=_sg.getMaterialTriangles();
-			float uv[2];  //  , minParam = 1.0e15f;
-			int material;
-			float hTx[2];
-			Vec3f hVec;
-			json::Array hArr;
-			for (int i = 0; i<n; ++i)	{
-				uv[0] = postUvs[i << 1];
-				uv[1] = postUvs[(i << 1) + 1];
-				setHistoryAttachPoint(postTriangles[i], uv, material, hTx, hVec);
-				json::Object pObj;
-				pObj["material"] = material;
-				hArr.Clear();
-				hArr.push_back(hTx[0]);
-				hArr.push_back(hTx[1]);
-				pObj["historyTexture"] = hArr;
-				hArr.Clear();
-				hArr.push_back(hVec[0]);
-				hArr.push_back(hVec[1]);
-				hArr.push_back(hVec[2]);
-				pObj["displacement"] = hArr;
-				iObj.Clear();
-				iObj["incisionPoint"] = pObj;
-				iArr.push_back(iObj);
+		}
+		iObj.Clear();
+		iObj["makeIncision"] = iArr;
+		_historyArray.push_back(iObj);
+		_historyIt = _historyArray.end();
+		if (!nukeThis) {
+			if (!_incisions.skinCut(positions, normals, edgeStart, edgeEnd)) {
+					sendUserMessage("Incision tool error.  Please save history file for debugging-", "Error Message");
 			}
-			iObj.Clear();
-			iObj["makeIncision"] = iArr;
-			_historyArray.push_back(iObj);
-			_historyIt = _historyArray.end();
-			if (!nukeThis) {
-				if (!_incisions.skinCut(positions, normals, edgeStart, edgeEnd)) {
-						sendUserMessage("Incision tool error.  Please save history file for debugging-", "Error Message");
-				}
-				else {
-					if (_incisions.physicsRecutRequired()){
-						_bts.setPhysicsPause(true);  // don't spawn another physics update till complete
-						while (!physicsDone)  // physics update thread must be complete before doing next op.
-							;
+			else {
+				if (_incisions.physicsRecutRequired()){
+					_bts.setPhysicsPause(true);  // don't spawn another physics update till complete
+					physics.wait();  // physics update thread must be complete before doing next op.
 //						physicsDone = false;
 //						_ffg->physicsDrag = true;
 //						tbb::task_arena(tbb::task_arena::attach()).enqueue([&]() {  // enqueue
-							_bts.updateOldPhysicsLattice();
-							newTopology = true;
-							physicsDone = true;
+						_bts.updateOldPhysicsLattice();
+						newTopology = true;
 //							}
 //						);
-					}
-					else {
-						newTopology = true;
-					}
+				}
+				else {
+					newTopology = true;
 				}
 			}
-			_bts.setPhysicsPause(false);
-			_fence.clear();
 		}
-		else if (_toolState == 3) {	// undermine mode
-			if (_historyIt != _historyArray.end()) {
-				json::Array tarr;
-				for (json::Array::ValueVector::iterator it = _historyArray.begin(); it != _historyIt; ++it)
-					tarr.push_back(*it);
-				_historyArray.Clear();
-				_historyArray = tarr;
-			}
-			float hTx[2], uv[2] = {0.333f, 0.333f};
-			int material;
-			Vec3f hVec;
-			json::Array uArr;
-			json::Object uObj, pObj;
-			auto uit = _undermineTriangles.begin();
-			while (uit != _undermineTriangles.end()) {
-				uObj.Clear();
-				setHistoryAttachPoint(uit->triangle, uv, material, hTx, hVec);
-				uObj["material"] = 2;  // at time executed all set to 10, but they came in as 2
-				uObj["incisionConnect"] = (bool)uit->incisionConnect;
-				json::Array sArr;
-				sArr.push_back(hTx[0]);
-				sArr.push_back(hTx[1]);
-				uObj["historyTexture"] = sArr;
-				sArr.Clear();
-				sArr.push_back(hVec[0]);
-				sArr.push_back(hVec[1]);
-				sArr.push_back(hVec[2]);
-				uObj["displacement"] = sArr;
-				pObj["underminePoint"] = uObj;
-				uArr.push_back(pObj);
-				++uit;
-			}
+		_bts.setPhysicsPause(false);
+		_fence.clear();
+	}
+	else if (_toolState == 3) {	// undermine mode
+		if (_historyIt != _historyArray.end()) {
+			json::Array tarr;
+			for (json::Array::ValueVector::iterator it = _historyArray.begin(); it != _historyIt; ++it)
+				tarr.push_back(*it);
+			_historyArray.Clear();
+			_historyArray = tarr;
+		}
+		float hTx[2], uv[2] = {0.333f, 0.333f};
+		int material;
+		Vec3f hVec;
+		json::Array uArr;
+		json::Object uObj, pObj;
+		auto uit = _undermineTriangles.begin();
+		while (uit != _undermineTriangles.end()) {
 			uObj.Clear();
-			uObj["undermine"] = uArr;
-			_historyArray.push_back(uObj);
-			_historyIt = _historyArray.end();
-			_bts.setPhysicsPause(true);  // should already be done
-			while (!physicsDone)
-				;
-			_bts.updateSurfaceDraw();
-			_incisions.undermineSkin();
-			_undermineTriangles.clear();
+			setHistoryAttachPoint(uit->triangle, uv, material, hTx, hVec);
+			uObj["material"] = 2;  // at time executed all set to 10, but they came in as 2
+			uObj["incisionConnect"] = (bool)uit->incisionConnect;
+			json::Array sArr;
+			sArr.push_back(hTx[0]);
+			sArr.push_back(hTx[1]);
+			uObj["historyTexture"] = sArr;
+			sArr.Clear();
+			sArr.push_back(hVec[0]);
+			sArr.push_back(hVec[1]);
+			sArr.push_back(hVec[2]);
+			uObj["displacement"] = sArr;
+			pObj["underminePoint"] = uObj;
+			uArr.push_back(pObj);
+			++uit;
+		}
+		uObj.Clear();
+		uObj["undermine"] = uArr;
+		_historyArray.push_back(uObj);
+		_historyIt = _historyArray.end();
+		_bts.setPhysicsPause(true);  // should already be done
+		physics.wait();
+		_bts.updateSurfaceDraw();
+		_incisions.undermineSkin();
+		_undermineTriangles.clear();
 //			physicsDone = false;
 //			_ffg->physicsDrag = true;
 //			tbb::task_arena(tbb::task_arena::attach()).enqueue([&]() {  // enqueue
-				_bts.updateOldPhysicsLattice();
-				newTopology = true;
-				physicsDone = true;
+			_bts.updateOldPhysicsLattice();
+			newTopology = true;
 //				}
 //			);
-			_bts.setPhysicsPause(false);
+		_bts.setPhysicsPause(false);
+	}
+	else if (_toolState == 6)	// deep cut mode
+	{
+		if (!_incisions.inputCorrectFence(&_fence, this))
+			return;
+		std::vector<Vec3f> positions, rays;
+		std::vector<float> postUvs;
+		std::vector<int> postTriangles;
+		bool edgeStart, edgeEnd, startOpen, endOpen;  //  , Tout = false, nukeThis = false;
+		if (_historyArray.size()>0 && _historyIt != _historyArray.end()) {
+			json::Array tarr;
+			for (json::Array::ValueVector::iterator it = _historyArray.begin(); it != _historyIt; ++it)
+				tarr.push_back(*it);
+			_historyArray.Clear();
+			_historyArray = tarr;
 		}
-		else if (_toolState == 6)	// deep cut mode
-		{
-			if (!_incisions.inputCorrectFence(&_fence, _ffg))
-				return;
-			std::vector<Vec3f> positions, rays;
-			std::vector<float> postUvs;
-			std::vector<int> postTriangles;
-			bool edgeStart, edgeEnd, startOpen, endOpen;  //  , Tout = false, nukeThis = false;
-			if (_historyArray.size()>0 && _historyIt != _historyArray.end()) {
-				json::Array tarr;
-				for (json::Array::ValueVector::iterator it = _historyArray.begin(); it != _historyIt; ++it)
-					tarr.push_back(*it);
-				_historyArray.Clear();
-				_historyArray = tarr;
-			}
-			int n = _fence.getPostData(positions, rays, postTriangles, postUvs, edgeStart, edgeEnd, startOpen, endOpen); // bools not relevant
-			materialTriangles *tri = _sg.getMaterialTriangles();
-			float hTx[2], uv[2];
-			int material;
-			Vec3f hVec;
-			json::Array iArr;
-			json::Object iObj, dObj;
-			iObj["deepCutObject"] = 0;	// for now only one object incisable
-			iObj["openIn"] = startOpen;
-			iObj["openOut"] = endOpen;
-			iObj["pointNumber"] = n;
-			iArr.push_back(iObj);
-			json::Array pArr;
-			for (int i = 0; i<n; ++i)	{
-				iObj.Clear();
-				dObj.Clear();
-				uv[0] = postUvs[i << 1];
-				uv[1] = postUvs[(i << 1) + 1];
-				setHistoryAttachPoint(postTriangles[i], uv, material, hTx, hVec);
-				dObj["material"] = material;
-				json::Array sArr;
-				sArr.push_back(hTx[0]);
-				sArr.push_back(hTx[1]);
-				dObj["historyTexture"] = sArr;
-				sArr.Clear();
-				sArr.push_back(hVec[0]);
-				sArr.push_back(hVec[1]);
-				sArr.push_back(hVec[2]);
-				dObj["displacement"] = sArr;
-				sArr.Clear();
-				sArr.push_back(rays[i].X);
-				sArr.push_back(rays[i].Y);
-				sArr.push_back(rays[i].Z);
-				dObj["postNormal"] = sArr;
-				iObj["deepCutPoint"] = dObj;
-				iArr.push_back(iObj);
-			}
+		int n = _fence.getPostData(positions, rays, postTriangles, postUvs, edgeStart, edgeEnd, startOpen, endOpen); // bools not relevant
+		materialTriangles *tri = &_mt;
+		float hTx[2], uv[2];
+		int material;
+		Vec3f hVec;
+		json::Array iArr;
+		json::Object iObj, dObj;
+		iObj["deepCutObject"] = 0;	// for now only one object incisable
+		iObj["openIn"] = startOpen;
+		iObj["openOut"] = endOpen;
+		iObj["pointNumber"] = n;
+		iArr.push_back(iObj);
+		json::Array pArr;
+		for (int i = 0; i<n; ++i)	{
 			iObj.Clear();
-			iObj["makeDeepCut"] = iArr;
-			_historyArray.push_back(iObj);
-			_historyIt = _historyArray.end();
-			if (!_bts.isPhysicsPaused())
-				throw(std::logic_error("Physics must be paused before deep cut."));
-			while (!physicsDone)
-				;
-			_bts.updateSurfaceDraw();
-			if (!_incisions.cutDeep()) {
-				sendUserMessage("Attempted deepCut failed. Save history to debug.", "PROGRAM ERROR");
-				return;
-			}
-			physicsDone = false;
-			_ffg->physicsDrag = true;
-			_ffg->user_message_flag = false;
-			tbb::task_arena(tbb::task_arena::attach()).enqueue([&]() {  // enqueue
-				_bts.updateOldPhysicsLattice();
-				newTopology = true;
-				physicsDone = true;
-				}
-			);
-			_fence.clear();
-			_incisions.clearDeepCutter();
-			_bts.setPhysicsPause(false);
+			dObj.Clear();
+			uv[0] = postUvs[i << 1];
+			uv[1] = postUvs[(i << 1) + 1];
+			setHistoryAttachPoint(postTriangles[i], uv, material, hTx, hVec);
+			dObj["material"] = material;
+			json::Array sArr;
+			sArr.push_back(hTx[0]);
+			sArr.push_back(hTx[1]);
+			dObj["historyTexture"] = sArr;
+			sArr.Clear();
+			sArr.push_back(hVec[0]);
+			sArr.push_back(hVec[1]);
+			sArr.push_back(hVec[2]);
+			dObj["displacement"] = sArr;
+			sArr.Clear();
+			sArr.push_back(rays[i].X);
+			sArr.push_back(rays[i].Y);
+			sArr.push_back(rays[i].Z);
+			dObj["postNormal"] = sArr;
+			iObj["deepCutPoint"] = dObj;
+			iArr.push_back(iObj);
 		}
-		else
-			;
-		_ffg->setToolState(0);
-		setToolState(0);
+		iObj.Clear();
+		iObj["makeDeepCut"] = iArr;
+		_historyArray.push_back(iObj);
+		_historyIt = _historyArray.end();
+		if (!_bts.isPhysicsPaused())
+			throw(std::logic_error("Physics must be paused before deep cut."));
+		physics.wait();
+		_bts.updateSurfaceDraw();
+		if (!_incisions.cutDeep()) {
+			sendUserMessage("Attempted deepCut failed. Save history to debug.", "PROGRAM ERROR");
+			return;
+		}
+		_renderer->showPhysicsBusy(true);
+		_renderer->clearUserMessage();
+		physics.run([this]() {
+			_bts.updateOldPhysicsLattice();
+			newTopology = true;
+			}
+		);
+		_fence.clear();
+		_incisions.clearDeepCutter();
+		_bts.setPhysicsPause(false);
 	}
 	else
 		;
-}
-
-void surgicalActions::onKeyUp(int key)
-{  // ctrl and shift key now handled by frame call
+	_renderer->showToolState(0);
+	setToolState(0);
 }
 
 bool surgicalActions::loadScene(const char *modelDirectory, const char *sceneFilename)
 {
 	bool ret = _bts.loadScene(modelDirectory, sceneFilename);  // computes bounding spheres
 	_sceneDir.assign(modelDirectory);
-	_originalTriangleNumber = _sg.getMaterialTriangles()->numberOfTriangles();
+	_originalTriangleNumber = _mt.numberOfTriangles();
 	if(ret && _historyArray.size() < 1) {
 		std::string dstr(modelDirectory),fstr(sceneFilename);
 		_historyArray.Clear();
@@ -1241,7 +1208,7 @@ bool surgicalActions::loadScene(const char *modelDirectory, const char *sceneFil
 		_historyArray.push_back(loadObj);
 		_historyIt = _historyArray.end();
 	}
-	_gl3w->zeroViewRotations();
+	_renderer->resetView();
 	return ret;
 }
 
@@ -1249,7 +1216,7 @@ bool surgicalActions::setHistoryAttachPoint(const int triangle, const float(&uv)
 {  // Input an attach point in current environment. Outputs a historyTriangle, historyUv, and historyVec for storage in a history file.
 	// This attachment point is created by program with variable physics state at time of incisions.  For this reason move away a safe distance to an original triangle and use
 	// historyVec to find closest original location.  historyVec is in material coords so less sensitive to physics state.
-	materialTriangles *mtp = _sg.getMaterialTriangles();
+	materialTriangles *mtp = &_mt;
 	material = mtp->triangleMaterial(triangle);
 	if (material == 3 || material == 6) {
 		sendUserMessage("Can't attach to side of skin incision or middle of cut muscle. Try again-", "USER ERROR", false);
@@ -1506,12 +1473,13 @@ void surgicalActions::historyAttachFailure(std::string& errorDescription) {
 	_historyArray = tarr;
 	std::string msg = errorDescription;
 	msg.append("\nSetting history back one step and truncating further forward.");
+	_historyIt = _historyArray.end();
 	sendUserMessage(msg.c_str(), "Program error");
 }
 
 bool surgicalActions::getHistoryAttachPoint(const int material, const float(&historyTexture)[2], const Vec3f &displacement, int &triangle, float(&uv)[2], bool findEdge)
 {  // Input a history attach point from history file. Outputs a triangle, and parametric uv coord in current environment.
-	materialTriangles *mtp = _sg.getMaterialTriangles();
+	materialTriangles *mtp = &_mt;
 	std::vector<Vec2f> triTex;
 	triTex.assign(3, Vec2f());
 	Vec2f txIn(historyTexture[0], historyTexture[1]);
@@ -1738,6 +1706,16 @@ void surgicalActions::pausePhysics()
 	_bts.setPhysicsPause(true);
 }
 
+std::string surgicalActions::nextHistoryActionName()
+{
+	if (_historyIt == _historyArray.end() || _historyIt->GetType() != json::ObjectVal)
+		return std::string();
+	const json::Object& aObj = _historyIt->ToObject();
+	if (aObj.begin() == aObj.end())
+		return std::string();
+	return aObj.begin()->first;
+}
+
 void surgicalActions::nextHistoryAction()
 {
 	try {
@@ -1748,9 +1726,8 @@ void surgicalActions::nextHistoryAction()
 		}
 		_bts.setPhysicsPause(true);  // don't spawn another physics update till complete
 		// prevent user from doing a new op until previous one is finished
-		while (!physicsDone)  // physics update thread must be complete before doing next op.
-			;
-		_gl3w->drawAll();
+		physics.wait();  // physics update thread must be complete before doing next op.
+		_renderer->drawAll();
 		if (_historyIt->HasKey("loadSceneFile"))
 		{
 			const json::Object& fObj = _historyIt->ToObject();
@@ -1759,13 +1736,13 @@ void surgicalActions::nextHistoryAction()
 				_historyArray.Clear();
 			}
 			else {
-				_ffg->setModelFile(fObj.begin()->second.ToString());
+				_renderer->showModelFile(fObj.begin()->second.ToString());
 				++_historyIt;
 			}
 		}
 		else if (_historyIt->HasKey("addHook"))
 		{
-			materialTriangles *tr = _sg.getMaterialTriangles();
+			materialTriangles *tr = &_mt;
 			if (tr == NULL)
 				return;
 			json::Object hookObj = (*_historyIt)["addHook"].ToObject();
@@ -1792,9 +1769,7 @@ void surgicalActions::nextHistoryAction()
 				return;
 			}
 			if (_hooks.getNumberOfHooks() < 1) {	// initialize hooks
-				_hooks.setHookSize(_sg.getSceneNode()->getRadius()*0.02f);
-				_hooks.setShapes(_gl3w->getShapes());
-				_hooks.setGLmatrices(_gl3w->getGLmatrices());
+				_hooks.setHookSize(_bts.getSurfaceRadius()*0.02f);
 				_hooks.setPhysicsLattice(_bts.getPdTetPhysics_2());
 				_hooks.setVnBccTetrahedra(_bts.getVirtualNodedBccTetrahedra());
 			}
@@ -1807,11 +1782,9 @@ void surgicalActions::nextHistoryAction()
 			{
 				if (!_bts.getPdTetPhysics_2()->solverInitialized()) {  // solver must be initialized to add a hook. Done once.
 					_bts.setForcesAppliedFlag();
-					physicsDone = false;
-					_ffg->physicsDrag = true;
-					tbb::task_arena(tbb::task_arena::attach()).enqueue([&]() {  // enqueue
+					_renderer->showPhysicsBusy(true);
+					physics.run([this]() {
 						_bts.updatePhysics();
-						physicsDone = true;
 						}
 					);
 				}
@@ -1866,7 +1839,7 @@ void surgicalActions::nextHistoryAction()
 			std::vector<Vec3f> positions, normals;
 			positions.assign(incisPointNum, Vec3f());
 			normals.assign(incisPointNum, Vec3f());
-			materialTriangles *mtp = _sg.getMaterialTriangles();
+			materialTriangles *mtp = &_mt;
 			for (i = 0; i < incisPointNum; ++i)
 			{
 				iObj = iArr[i + 1].ToObject();
@@ -1906,7 +1879,12 @@ void surgicalActions::nextHistoryAction()
 				mtp->getBarycentricPosition(tri, uv, positions[i].xyz);
 				mtp->getBarycentricNormal(tri, uv, normals[i].xyz);
 			}
-			if (!_incisions.skinCut(positions, normals, startIncis, endIncis)) {
+			bool incised;
+			{
+				phaseTimes::timer cut(_bts.getPhaseTimes(), phaseTimes::CUT);
+				incised = _incisions.skinCut(positions, normals, startIncis, endIncis);
+			}
+			if (!incised) {
 				sendUserMessage("Incision in history file failed.", "Program error", false);
 			}
 			else {
@@ -1916,7 +1894,6 @@ void surgicalActions::nextHistoryAction()
 //					tbb::task_arena(tbb::task_arena::attach()).enqueue([&]() {  // enqueue
 						_bts.updateOldPhysicsLattice();
 						newTopology = true;
-						physicsDone = true;
 //						}
 //					);
 				}
@@ -1955,17 +1932,16 @@ void surgicalActions::nextHistoryAction()
 				}
 				_incisions.addUndermineTriangle(tri, 2, ic);
 			}
-			_gl3w->drawAll();
-			glfwSwapBuffers(_ffg->FFwindow);
-			std::this_thread::sleep_for(std::chrono::milliseconds(800));
-			_incisions.undermineSkin();
+			_renderer->previewFrame(800);  // let the user see what will be undermined
+			{
+				phaseTimes::timer cut(_bts.getPhaseTimes(), phaseTimes::CUT);
+				_incisions.undermineSkin();
+			}
 			_undermineTriangles.clear();
-			physicsDone = false;
-			_ffg->physicsDrag = true;
-			tbb::task_arena(tbb::task_arena::attach()).enqueue([&]() {  // enqueue
+			_renderer->showPhysicsBusy(true);
+			physics.run([this]() {
 				_bts.updateOldPhysicsLattice();
 				newTopology = true;
-				physicsDone = true;
 				}
 			);
 			++_historyIt;
@@ -1992,13 +1968,14 @@ void surgicalActions::nextHistoryAction()
 				historyAttachFailure(msg);
 				return;
 			}
-			_incisions.excise(tri);
-			physicsDone = false;
-			_ffg->physicsDrag = true;
-			tbb::task_arena(tbb::task_arena::attach()).enqueue([&]() {  // enqueue
+			{
+				phaseTimes::timer cut(_bts.getPhaseTimes(), phaseTimes::CUT);
+				_incisions.excise(tri);
+			}
+			_renderer->showPhysicsBusy(true);
+			physics.run([this]() {
 				_bts.updateOldPhysicsLattice();
 				newTopology = true;
-				physicsDone = true;
 				}
 			);
 			++_historyIt;
@@ -2012,14 +1989,12 @@ void surgicalActions::nextHistoryAction()
 
 			float param, uv[2], xyz[3];
 			if (_sutures.getNumberOfSutures() < 1) {	// initialize sutures
-				_sutures.setSutureSize(_sg.getSceneNode()->getRadius()*0.003f);
-				_sutures.setShapes(_gl3w->getShapes());
-				_sutures.setGLmatrices(_gl3w->getGLmatrices());
+				_sutures.setSutureSize(_bts.getSurfaceRadius()*0.003f);
 				_sutures.setPhysicsLattice(_bts.getPdTetPhysics_2());
 				_sutures.setVnBccTetrahedra(_bts.getVirtualNodedBccTetrahedra());
 				_sutures.setSurgicalActions(this);
 			}
-			materialTriangles *tr = _sg.getMaterialTriangles();
+			materialTriangles *tr = &_mt;
 			int material;
 			float hTx[2];
 			Vec3f hVec;
@@ -2138,11 +2113,9 @@ void surgicalActions::nextHistoryAction()
 			else
 				assert(false);
 			if(_sutures.isLinked(sn)){
-				physicsDone = false;
- 				_ffg->physicsDrag = true;
+				_renderer->showPhysicsBusy(true);
 //				tbb::task_arena(tbb::task_arena::attach()).enqueue([&]() {
 					_sutures.laySutureLine(sn);
-					physicsDone = true;
 //					}
 //				);
 			}
@@ -2159,8 +2132,7 @@ void surgicalActions::nextHistoryAction()
 			_selectedSurgObject = s;
 			++_historyIt;
 			if (_historyIt == _historyArray.end()) {  // automatically promote any fake sutures if this is the last one
-				while (!physicsDone)
-					;
+				physics.wait();
 				_bts.promoteSutures();
 			}
 		}
@@ -2195,11 +2167,10 @@ void surgicalActions::nextHistoryAction()
 			startOpen = iObj["openIn"].ToBool();
 			endOpen = iObj["openOut"].ToBool();
 			int pointNum = iObj["pointNumber"].ToInt();
-			materialTriangles* tr = _sg.getMaterialTriangles();
+			materialTriangles* tr = &_mt;
 			_incisions.clearDeepCutter();
 			if (!_fence.isInitialized()) {	// initialize fence
 				_fence.setFenceSize(tr->getDiameter() * 0.01f);
-				_fence.setGl3wGraphics(_gl3w);
 			}
 			_fence.clear();
 			float hTx[2], uv[2];
@@ -2248,35 +2219,36 @@ void surgicalActions::nextHistoryAction()
 					;
 				_fence.addPost(tr, tri, xyz.xyz, postN.xyz, false, true, startOpen);
 			}
-			if (!_incisions.inputCorrectFence(&_fence, _ffg)) {
+			if (!_incisions.inputCorrectFence(&_fence, this)) {
 				sendUserMessage("The deepCut in this history file failed.", "PROGRAM ERROR");
 				_fence.clear();
 				_incisions.clearDeepCutter();
-				_ffg->setToolState(0);
+				_renderer->showToolState(0);
 				setToolState(0);
 				_bts.setPhysicsPause(false);
-				physicsDone = true;
-				_ffg->physicsDrag = false;
+				_renderer->showPhysicsBusy(false);
 				return;
 			}
 			_bts.updateSurfaceDraw();
-			if (!_incisions.cutDeep()) {
+			bool deepCutMade;
+			{
+				phaseTimes::timer cut(_bts.getPhaseTimes(), phaseTimes::CUT);
+				deepCutMade = _incisions.cutDeep();
+			}
+			if (!deepCutMade) {
 				sendUserMessage("Attempted deepCut failed. Save history to debug.", "PROGRAM ERROR");
 				_fence.clear();
 				_incisions.clearDeepCutter();
-				_ffg->setToolState(0);
+				_renderer->showToolState(0);
 				setToolState(0);
 				_bts.setPhysicsPause(false);
-				physicsDone = true;
-				_ffg->physicsDrag = false;
+				_renderer->showPhysicsBusy(false);
 				return;
 			}
-			physicsDone = false;
-			_ffg->physicsDrag = true;
-			tbb::task_arena(tbb::task_arena::attach()).enqueue([&]() {  // enqueue
+			_renderer->showPhysicsBusy(true);
+			physics.run([this]() {
 				_bts.updateOldPhysicsLattice();
 				newTopology = true;
-				physicsDone = true;
 				}
 			);
 			_fence.clear();
@@ -2312,14 +2284,15 @@ void surgicalActions::nextHistoryAction()
 				_incisions.addPeriostealUndermineTriangle(tri, hVec, ic);
 			}
 			// all periosteal undermine triangles now marked as material 10
-			_incisions.clearCurrentUndermine(8);  // set all periosteal undermined triangles to material 8 and reset.
-			_bts.fixPeriostealPeriferalVertices();
-			physicsDone = false;
-			_ffg->physicsDrag = true;
-			tbb::task_arena(tbb::task_arena::attach()).enqueue([&]() {  // enqueue
+			{
+				phaseTimes::timer cut(_bts.getPhaseTimes(), phaseTimes::CUT);
+				_incisions.clearCurrentUndermine(8);  // set all periosteal undermined triangles to material 8 and reset.
+				_bts.fixPeriostealPeriferalVertices();
+			}
+			_renderer->showPhysicsBusy(true);
+			physics.run([this]() {
 				_bts.nonTetPhysicsUpdate();
 				newTopology = true;
-				physicsDone = true;
 				}
 			);
 			++_historyIt;
@@ -2337,7 +2310,7 @@ void surgicalActions::nextHistoryAction()
 		}
 		else
 			++_historyIt;
-		_ffg->setToolState(0);
+		_renderer->showToolState(0);
 		setToolState(0);
 		_bts.setPhysicsPause(false);
 	}  // end try block
@@ -2454,7 +2427,7 @@ bool surgicalActions::closestTexturePick(const float(&txUv)[2], const float tria
 }
 
 bool surgicalActions::saveCurrentObj(const char* fullFilePath, const char* fileNamePrefix) {
-	materialTriangles* tr = _sg.getMaterialTriangles();
+	materialTriangles* tr = &_mt;
 	if (tr == nullptr)
 		return false;
 	return tr->writeObjFile(fullFilePath, fileNamePrefix);
@@ -6,7 +6,7 @@
 #include <list>
 #include "hooks.h"
 #include "sutures.h"
-#include "surgGraphics.h"
+#include "materialTriangles.h"
 #include "fence.h"
 
 #include "deepCut.h"
@@ -15,29 +15,30 @@
 #include "json.h"
 #include <Vec3f.h>
 #include "bccTetScene.h"
-
-// forward declarations
-class FacialFlapsGui;
-class gl3wGraphics;
+#include "physicsScheduler.h"
+#include "surgicalRenderer.h"
+#include "nullRenderer.h"
 
 class surgicalActions
 {
 public:
 	void sendUserMessage(const char *message, const char *title, bool closeProgram = false);
+	// The caller picks. triangle is on the dynamic surface, or -1 if objectHit is some other scene object.
 	bool rightMouseDown(std::string objectHit, float(&position)[3], int triangle);
 	bool rightMouseUp(std::string objectHit, float(&position)[3], int triangle);
 	bool mouseMotion(float dScreenX, float dScreenY);
-	void onKeyDown(int key);
-	void onKeyUp(int key);
+	void onDeleteKey();  // deletes the selected hook, suture or last fence post
+	void onEnterKey();  // completes the active tool's action
 	inline void setToolState(int toolState){ _bts.setPhysicsPause(toolState < 1 ? false : true); _toolState = toolState; }
 	inline int getToolState() { return _toolState; }
-	inline void setGl3wGraphics(gl3wGraphics *gl3w) { _gl3w = gl3w; _bts.setGl3wGraphics(gl3w); }
-	void setFacialFlapsGui(FacialFlapsGui *ffg) { _ffg = ffg; }
+	void setRenderer(surgicalRenderer *renderer);  // a nullRenderer until set
+	inline surgicalRenderer* getRenderer() { return _renderer; }
 	inline hooks* getHooks() { return &_hooks; }
 	inline sutures* getSutures() { return &_sutures; }
 	bool loadScene(const char *modelDirectory, const char *sceneFilename);
 	inline bccTetScene* getBccTetScene() { return &_bts; }
-	inline surgGraphics* getSurgGraphics() { return &_sg; }
+	inline materialTriangles* getMaterialTriangles() { return &_mt; }
+	void updateTopology();  // after physics.wait(), if newTopology was set by the last action
 
 	//	inline deepCut* getDeepCutPtr() { return &_incisions; }
 	inline skinCutUndermineTets* getDeepCutPtr() { return &_incisions; }  // COURT fix when deepCut added back
@@ -45,6 +46,8 @@ public:
 	bool loadHistory(const char *historyDir, const char *historyFile);
 	void nextHistoryAction();
 	bool historyEmpty()	{return _historyArray.size()<1;}
+	inline bool historyComplete() { return _historyIt == _historyArray.end(); }
+	std::string nextHistoryActionName();  // key of the action nextHistoryAction() will execute, empty if none
 	bool setHistoryAttachPoint(const int triangle, const float(&uv)[2], int &material, float(&historyTexture)[2], Vec3f &historyVec);
 	// Input an attach point in current environment. Outputs a material, texture, and displacement for storage in a history file.
 	bool getHistoryAttachPoint(const int material, const float(&historyTexture)[2], const Vec3f &displacement, int &triangle, float(&uv)[2], bool findEdge);
@@ -58,7 +61,8 @@ public:
 	void promoteFakeSutures();
 	void pausePhysics();
 	bool _strongHooks;  // COURT - hack for collision cheating purposes
-	std::atomic<bool> physicsDone, newTopology;
+	std::atomic<bool> newTopology;
+	physicsScheduler physics;  // runs physics steps and lattice updates one at a time off the main thread
 	bccTetScene _bts;
 
 	surgicalActions();
@@ -67,14 +71,14 @@ public:
 private:
     struct float3{	float v[3]; };
 	int _toolState;
-	gl3wGraphics *_gl3w;
-	FacialFlapsGui *_ffg;
+	nullRenderer _nullRenderer;
+	surgicalRenderer *_renderer;
 	std::vector<int> _pXToPbTetVertices;
 	int _originalTriangleNumber;
 	int _dragVertex;
 	float _dragXyz[3];
 	std::string _selectedSurgObject,_dragTissue;
-	surgGraphics _sg;	// dynamic triangulated skin object
+	materialTriangles _mt;	// dynamic triangulated skin object
 	hooks _hooks;
 	sutures _sutures;
 	deepCut _incisions;  // derived from skinCutUndermineTets class
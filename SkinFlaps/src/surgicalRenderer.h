@@ -0,0 +1,71 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// File: surgicalRenderer.h
+// Purpose: Everything the surgical simulation core asks of its display and user interface. surgicalActions and
+// bccTetScene and the tools they own (hooks, sutures, fence) only talk to this interface, so the cutting, physics and
+// collision code can be driven without an openGL context. gl3wRenderer draws into the FacialFlapsGui window and
+// nullRenderer keeps only the state the simulation itself needs, for batch runs on headless machines.
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __SURGICAL_RENDERER__
+#define __SURGICAL_RENDERER__
+
+#include <string>
+#include <vector>
+#include <memory>
+#include "sceneNodeBase.h"
+
+// forward declarations
+class materialTriangles;
+
+class surgicalRenderer
+{
+public:
+	// scene loading
+	virtual bool loadTexture(int txId, const char* filePath) = 0;
+	virtual bool textureExists(int txId) = 0;
+	virtual bool loadStaticObject(const char* filePath, std::vector<int>& textureIds) = 0;
+	// surface must already contain its materialTriangles, which stay owned by the caller. Called once per scene load.
+	virtual void createSurface(materialTriangles* mt, const char* name, std::vector<int>& textureIds, const char* vertexShaderFile, const char* fragmentShaderFile) = 0;
+	virtual void frameScene() = 0;
+	virtual void resetView() = 0;
+
+	// dynamic surface
+	virtual void surfaceTopologyChanged() = 0;  // after any cut, excision or undermine
+	virtual void surfaceMoved() = 0;  // vertex positions only
+	virtual void setSurfaceVisible(bool visible) = 0;
+
+	// tool shapes. Nodes returned always exist so tools may keep their position and color in them.
+	virtual std::shared_ptr<sceneNodeBase> addShape(sceneNodeBase::nodeType type, const char* name) = 0;
+	virtual void deleteShape(std::shared_ptr<sceneNodeBase> shape) = 0;
+	// triangle strip of the fence wall. Points are homogeneous xyz1, normals xyz.
+	virtual void showFenceWall(const std::vector<float>& points, const std::vector<float>& normals) = 0;
+	virtual void hideFenceWall() = 0;
+
+	// tetrahedral lattice display. Points are homogeneous xyz1, 0xffffffff restarts the line strip.
+	virtual bool tetLinesCreated() = 0;
+	virtual bool tetLinesVisible() = 0;
+	virtual void setTetLinesVisible(bool visible) = 0;
+	virtual void createTetLines(const std::vector<float>& points, const std::vector<unsigned int>& lines) = 0;
+	virtual void updateTetLines(const std::vector<float>& points) = 0;
+	virtual void eraseTetLines() = 0;
+
+	virtual void drawAll() = 0;
+	virtual void previewFrame(int milliseconds) = 0;  // show the current scene to the user for this long before continuing
+
+	// user interface feedback
+	virtual void sendUserMessage(const char* message, const char* title) = 0;
+	virtual void clearUserMessage() = 0;
+	virtual void showPhysicsBusy(bool busy) = 0;
+	virtual void showToolState(int toolState) = 0;
+	virtual void showModelFile(const std::string& modelFile) = 0;
+	virtual bool ctrlOrShiftKeyDown() = 0;
+
+	// screen space for the interactive mouse handlers. Picking itself is done by the caller of rightMouseDown().
+	virtual void getDragVector(float dScreenX, float dScreenY, float(&position)[3], float(&dragVector)[3]) = 0;  // world motion at position
+	virtual const float* getFrameAndRotationMatrix() = 0;  // current view transform
+	virtual void getTrianglePickLine(float(&lineStartPosition)[3], float(&lineDirection)[3]) = 0;  // ray of the last pick
+
+	virtual ~surgicalRenderer() {}
+};
+
+#endif  // __SURGICAL_RENDERER__
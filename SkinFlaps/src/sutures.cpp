@@ -19,11 +19,9 @@
 #endif
 #include "sutures.h"
 
-float sutures::_sutureSpanGap = 0.03f;
-float sutures::_sutureSize=1.0f;
-GLfloat sutures::_selectedColor[] = {1.0f, 1.0f, 0.0f, 1.0f};
-GLfloat sutures::_unselectedColor[]={0.4f,0.537f,0.984f,1.0f};
-GLfloat sutures::_userColor[] = { 0.03f,0.03f,0.99f,1.0f };
+float sutures::_selectedColor[] = {1.0f, 1.0f, 0.0f, 1.0f};
+float sutures::_unselectedColor[]={0.4f,0.537f,0.984f,1.0f};
+float sutures::_userColor[] = { 0.03f,0.03f,0.99f,1.0f };
 
 int sutures::previousUserSuture(int sutureNumber)
 {
@@ -77,10 +75,10 @@ void sutures::updateSutureGraphics()
 			++sit;
 			continue;
 		}
-		GLfloat *mm=sut->getSphereShape()->getModelViewMatrix();
+		float *mm=sut->getSphereShape()->getModelViewMatrix();
 		loadIdentity4x4(mm);
 		sut->_selected = true;
-		GLfloat *v,*v2;
+		float *v,*v2;
 		float len;
 		Vec3f v0,v1,p,dv;
 		int *tri;
@@ -94,7 +92,7 @@ void sutures::updateSutureGraphics()
 		v2 = sut->_tri->vertexCoordinate(tri[(sut->_edges[1]+1)%3]);
 		for(int i=0; i<3; ++i)
 			v1.xyz[i]=v2[i]*sut->_params[1] + v[i]*(1.0f-sut->_params[1]);
-		GLfloat sSize = _sutureSize;
+		float sSize = _sutureSize;
 		if (sut->_type < 2)
 			sSize *= 2.0f;
 		scaleMatrix4x4(mm, sSize, sSize, sSize);
@@ -133,7 +131,7 @@ void sutures::setSecondVertexPosition(int sutureNumber, float *position)
 		return;
 	sutureTets *sut = &(sit->second);
 	sut->_selected = true;
-	GLfloat *v,*v2;
+	float *v,*v2;
 	float p[3],dv[3],len;
 	Vec3f v0;
 	int *tri = sut->_tri->triangleVertices(sut->_tris[0]);
@@ -141,10 +139,10 @@ void sutures::setSecondVertexPosition(int sutureNumber, float *position)
 	v2 = sut->_tri->vertexCoordinate(tri[(sut->_edges[0]+1)%3]);
 	for(int i=0; i<3; ++i)
 		v0.xyz[i]=v2[i]*sut->_params[0] + v[i]*(1.0f-sut->_params[0]);
-	GLfloat sSize = _sutureSize;
+	float sSize = _sutureSize;
 	if (sut->_type < 2)
 		sSize *= 2.0f;
-	GLfloat* mm = sut->getSphereShape()->getModelViewMatrix();
+	float* mm = sut->getSphereShape()->getModelViewMatrix();
 	loadIdentity4x4(mm);
 	scaleMatrix4x4(mm,sSize, sSize, sSize);
 	sut->_v1[0]=position[0]; sut->_v1[1]=position[1]; sut->_v1[2]=position[2];
@@ -258,7 +256,7 @@ int sutures::addSuture(materialTriangles *tri, int triangle0, int edge0, float p
 	hpr = _sutures.insert(std::make_pair(_sutureNow, sutureTets()));
 	char name[6];
 	sprintf(name,"S_%d",_sutureNow);
-	 std::shared_ptr<sceneNode> sh=_shapes->addShape(sceneNode::nodeType::SPHERE,name);
+	 std::shared_ptr<sceneNodeBase> sh=_renderer->addShape(sceneNodeBase::nodeType::SPHERE,name);
 	hpr.first->second.setSphereShape(sh);
 	sh->setColor(_selectedColor);
 	++_sutureNow;
@@ -267,21 +265,21 @@ int sutures::addSuture(materialTriangles *tri, int triangle0, int edge0, float p
 	hpr.first->second._params[0] = param0;
 	hpr.first->second._tris[1] = -1;
 	hpr.first->second._tri = tri;
-	GLfloat *mm = sh->getModelViewMatrix();
+	float *mm = sh->getModelViewMatrix();
 	loadIdentity4x4(mm);
 	hpr.first->second._selected = true;
 	int *t = tri->triangleVertices(triangle0);
-	GLfloat *v0,*v1,v[3];
+	float *v0,*v1,v[3];
 	v0 = tri->vertexCoordinate(t[edge0]);
 	v1 = tri->vertexCoordinate(t[(edge0+1)%3]);
 	for(int i=0; i<3; ++i)
 		v[i] = v1[i]*param0 + v0[i]*(1.0f-param0);
-	GLfloat sSize = _sutureSize;
+	float sSize = _sutureSize;
 	if (hpr.first->second._type < 2)
 		sSize *= 2.0f;
 	scaleMatrix4x4(mm, sSize, sSize, sSize);
 	translateMatrix4x4(mm,v[0],v[1],v[2]);
-	sh =_shapes->addShape(sceneNode::nodeType::CYLINDER,name);
+	sh =_renderer->addShape(sceneNodeBase::nodeType::CYLINDER,name);
 	hpr.first->second.setCylinderShape(sh);
 	mm = sh->getModelViewMatrix();
 	loadIdentity4x4(mm);
@@ -301,8 +299,8 @@ int sutures::deleteSuture(int sutureNumber)
 	auto delSut = [&]() {
 		if (sit2->second._constraintId > -1)
 			_ptp->deleteSuture(sit2->second._constraintId);
-		_shapes->deleteShape(sit2->second.getSphereShape());
-		_shapes->deleteShape(sit2->second.getCylinderShape());
+		_renderer->deleteShape(sit2->second.getSphereShape());
+		_renderer->deleteShape(sit2->second.getCylinderShape());
 		sit2 = _sutures.erase(sit2);
 	};
 	sit2 = sit;
@@ -330,8 +328,7 @@ int sutures::deleteSuture(int sutureNumber)
 		_userSutures.erase(usit);
 		delSut();
 	}
-	while (!_surgAct->physicsDone)
-		;
+	_surgAct->physics.wait();
 	_ptp->initializePhysics();
 	return ret;
 }
@@ -531,7 +528,7 @@ void sutures::nearestSkinIncisionEdge(const float triUv[2], int &triangle, int &
 	return;
 }
 
-sutures::sutures() : _groupPhysicsInit(false)
+sutures::sutures() : _sutureSpanGap(0.03f), _sutureSize(1.0f), _groupPhysicsInit(false)
 {
 	_sutureNow=0;
 	_userSutureNext = 0;
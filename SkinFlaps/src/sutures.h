@@ -11,12 +11,11 @@
 #include <memory>
 #include "Vec3f.h"
 #include "pdTetPhysics.h"
-#include "shapes.h"
+#include "sceneNodeBase.h"
 
 // forward declarations
 class materialTriangles;
-class GLmatrices;
-class lightsShaders;
+class surgicalRenderer;
 class vnBccTetrahedra;
 class surgicalActions;
 class deepCut;
@@ -24,10 +23,10 @@ class deepCut;
 class sutureTets
 {
 public:
-	inline void setSphereShape(std::shared_ptr<sceneNode> &sphere) {_sphereShape=sphere;}
-	inline std::shared_ptr<sceneNode> getSphereShape() {return _sphereShape;}
-	inline void setCylinderShape(std::shared_ptr<sceneNode> &cylinder) {_cylinderShape= cylinder;}
-	inline std::shared_ptr<sceneNode> getCylinderShape() {return _cylinderShape;}
+	inline void setSphereShape(std::shared_ptr<sceneNodeBase> &sphere) {_sphereShape=sphere;}
+	inline std::shared_ptr<sceneNodeBase> getSphereShape() {return _sphereShape;}
+	inline void setCylinderShape(std::shared_ptr<sceneNodeBase> &cylinder) {_cylinderShape= cylinder;}
+	inline std::shared_ptr<sceneNodeBase> getCylinderShape() {return _cylinderShape;}
 	sutureTets() : _tri(NULL), _type(0), _sphereShape(nullptr), _cylinderShape(nullptr) {
 		_edges[0] = -1; _tris[0] = -1; _params[0] = -1.0f;
 		_edges[1] = -1; _tris[1] = -1; _params[1] = -1.0f; }
@@ -36,11 +35,11 @@ protected:
 	materialTriangles *_tri;
 	int _edges[2], _tris[2], _tetIdx[2];
 	float _params[2];
-	GLfloat _v1[3];
+	float _v1[3];
 	bool _selected;
 	int _type;  // 0=user entered without link to previous, 1=user entered with link to previous, 2=programatically created in suture strip between a type 0-1 pair
-	std::shared_ptr<sceneNode> _sphereShape;
-	std::shared_ptr<sceneNode> _cylinderShape;
+	std::shared_ptr<sceneNodeBase> _sphereShape;
+	std::shared_ptr<sceneNodeBase> _cylinderShape;
 	int _constraintId;  // index of the suture constraint
 	Vec3f _baryWeights[2];
 	friend class sutures;
@@ -67,12 +66,11 @@ public:
 	inline void setLinked(int sutureNumber, bool link) { _sutures[sutureNumber]._type = (link ? 1 : 0); }
 	int previousUserSuture(int sutureNumber);
 	void laySutureLine(int suture2);  // creates a line of sutures between 2 input sutures
-	inline void setShapes(shapes *shps) { _shapes = shps; }
-	inline void setGLmatrices(GLmatrices *GLm) {_glm=GLm;}
+	inline void setRenderer(surgicalRenderer *renderer) { _renderer = renderer; }
 	inline void setPhysicsLattice(pdTetPhysics *ptp) { _ptp = ptp; }
 	inline void setVnBccTetrahedra(vnBccTetrahedra *vbt) { _vbt = vbt; }
 	inline void setSurgicalActions(surgicalActions* sa) { _surgAct = sa; }
-	inline static void setAutoSutureSpacing(float spacing) { _sutureSpanGap = spacing; }
+	inline void setAutoSutureSpacing(float spacing) { _sutureSpanGap = spacing; }
 	inline bool empty() { return _sutures.empty(); }
 	inline void clear()	{_sutures.clear(); }
 
@@ -101,16 +99,15 @@ private:
 	pdTetPhysics *_ptp;
 	vnBccTetrahedra *_vbt;
 	surgicalActions* _surgAct;
-	GLmatrices *_glm;
-	shapes *_shapes;
+	surgicalRenderer *_renderer;
 	typedef std::map<unsigned int, sutureTets> SUTUREMAP;
 	SUTUREMAP _sutures;
 	std::map<int, int> _userSutures;
 	unsigned int _sutureNow;  // must keep unique number and not decrement with deletions.
 	unsigned int _userSutureNext;  // must keep unique number and not decrement with deletions.
-	static float _sutureSpanGap;
-	static float _sutureSize;
-	static GLfloat _selectedColor[4], _unselectedColor[4], _userColor[4];
+	float _sutureSpanGap;
+	float _sutureSize;
+	static float _selectedColor[4], _unselectedColor[4], _userColor[4];
 	bool _groupPhysicsInit;
 	int addSuture(materialTriangles *tri, int triangle0, int edge0, float param0);
 };
@@ -1,6 +1,7 @@
 #include <unordered_set>
 #include <array>
 #include <map>
+#include <algorithm>
 #include "boundingBox.h"
 #include "Mat2x2f.h"
 #include "insidePolygon.h"
@@ -12,10 +13,6 @@
 
 #include "tbb/tick_count.h"  // for debug nuke later
 
-materialTriangles *tetCollisions::_mt;
-vnBccTetrahedra *tetCollisions::_vnt;
-pdTetPhysics* tetCollisions::_ptp;
-
 void tetCollisions::initSoftCollisions(materialTriangles* mt, vnBccTetrahedra* vnt) {
 	_mt = mt;
 	_vnt = vnt;
@@ -109,6 +106,7 @@ void tetCollisions::initSoftCollisions(materialTriangles* mt, vnBccTetrahedra* v
 		}
 		_flapBottomTris.push_back(tp);
 	}
+	_flapBvhDirty = true;  // vertex positions are not current until findSoftCollisionPairs(), so build the hierarchy there
 	_bedRays.clear();
 	_bedRays.reserve(bedVerts.size());
 	for (auto& bedV : bedVerts) {
@@ -152,7 +150,7 @@ void tetCollisions::findSoftCollisionPairs() {
 //	tbb::tick_count t0 = tbb::tick_count::now();
 
 	auto getVertexData = [&](vertexRay& v) {
-		_mt->getVertexCoordinate(v.vertex, v.P.xyz);
+		_vnt->vertexBarycentricPosition(v.vertex, v.P);  // not _mt, whose positions the render thread updates while this runs
 		const int* nodes = _vnt->tetNodes(_vnt->getVertexTetrahedron(v.vertex));
 		Vec3f cols[3];
 		for (int i = 1; i < 4; ++i)
@@ -164,101 +162,109 @@ void tetCollisions::findSoftCollisionPairs() {
 		getVertexData(bv);
 	for (auto& bv : _bedRays)
 		getVertexData(bv);
-	std::vector<boundingBox<float> > flapBox, bedBox;
 	boundingBox<float> bb;
 	bb.Empty_Box();
-	flapBox.assign(_flapBottomTris.size(), bb);
-	bedBox.assign(_bedRays.size(), bb);
+	_flapBoxes.assign(_flapBottomTris.size(), bb);
 	for (size_t n = _flapBottomTris.size(), i = 0; i < n; ++i) {
 		for (int j = 0; j < 3; ++j)
-			flapBox[i].Enlarge_To_Include_Point(reinterpret_cast<const float(&)[3]>(_flapBottomTris[i][j]->P.xyz));
+			_flapBoxes[i].Enlarge_To_Include_Point(reinterpret_cast<const float(&)[3]>(_flapBottomTris[i][j]->P.xyz));
 	}
+	if (_flapBvhDirty)
+		buildFlapBvh();  // topology changed since last frame
+	else
+		refitFlapBvh();
+	std::vector<boundingBox<float> > bedBox;
+	bedBox.assign(_bedRays.size(), bb);
 	for (size_t n = _bedRays.size(), i = 0; i < n; ++i) {
 		vertexRay& b = _bedRays[i];
 		bedBox[i].Enlarge_To_Include_Point(b.P.xyz);
 		bedBox[i].Enlarge_To_Include_Point((b.P - b.N).xyz);  // normal negated for bed rays
 	}
-	std::vector<int> topTets, bottomTets;
-	topTets.assign(_bedRays.size(), -1);
-	bottomTets.assign(_bedRays.size(), -1);
-	std::vector<std::array<float, 3> > topBarys, bottomBarys, collisionNormals;
-	topBarys.assign(_bedRays.size(), std::array<float, 3>());
-	bottomBarys.assign(_bedRays.size(), std::array<float, 3>());
-	collisionNormals.assign(_bedRays.size(), std::array<float, 3>());
-
-	std::atomic<bool> collisionsFound = false;
-	tbb::parallel_for(tbb::blocked_range<size_t>(0, _bedRays.size()),
-		[&](const tbb::blocked_range<size_t>& r) {
-			for (size_t j = r.begin(); j != r.end(); ++j) {
-//	for (int n = _bedRays.size(), j = 0; j < n; ++j) {  // serial version
-				float nearT = FLT_MAX;
-				vertexRay *nearV = nullptr;
-				vertexRay& b = _bedRays[j];
-				for (size_t n = _flapBottomTris.size(), i = 0; i < n; ++i) {
-					if (bedBox[j].Intersection(flapBox[i])) {
-						const std::array<vertexRay*, 3>& tv = _flapBottomTris[i];
-						if (b.N * (tv[0]->N + tv[1]->N + tv[2]->N) > 0.0f)
-							continue;
-						Mat3x3f C(tv[1]->P - tv[0]->P, tv[2]->P - tv[0]->P, b.N);
-						Vec3f R = C.Robust_Solve_Linear_System(b.P - tv[0]->P);
-						if (R[0] < 1e-6f || R[1] < 1e-6f || R[2] < 1e-4f || R[0] + R[1] > 1.0f || R[0] > 1.0f || R[1] > 1.0f || R[2] > 1.0f)  // R[2] determines how deep the collision must go before processing triggered. Bigger makes less sticky.
-							continue;
-						if (nearT > R[2]) {
-
-							//						bottomTri = i;
-							//						bottomUv[0] = R[0];
-							//						bottomUv[1] = R[1];
+	std::vector<int> nearTris;
+	std::vector<Vec3f> nearRs;
+	nearTris.assign(_bedRays.size(), -1);
+	nearRs.assign(_bedRays.size(), Vec3f());
 
+	auto findNearestTris = [&](bool useBvh) {
+		tbb::parallel_for(tbb::blocked_range<size_t>(0, _bedRays.size()),
+			[&](const tbb::blocked_range<size_t>& r) {
+				for (size_t j = r.begin(); j != r.end(); ++j) {
+					float nearT = FLT_MAX;
+					int nearTri = -1;
+					Vec3f nearR;
+					const vertexRay& b = _bedRays[j];
+					auto visit = [&](int i) {
+						Vec3f R;
+						if (!bedRayHitsFlapTriangle(b, i, R))
+							return;
+						if (nearT > R[2] || (nearT == R[2] && i < nearTri)) {  // index tie break makes result independent of traversal order
 							nearT = R[2];
-							if (R[0] + R[1] < 0.66667f)
-								nearV = tv[0];
-							else if (R[0] > R[1])
-								nearV = tv[1];
-							else
-								nearV = tv[2];
-							collisionsFound = true;
+							nearTri = i;
+							nearR = R;
+						}
+					};
+					if (useBvh)
+						queryFlapBvh(bedBox[j], visit);
+					else {
+						for (int n = (int)_flapBottomTris.size(), i = 0; i < n; ++i) {
+							if (bedBox[j].Intersection(_flapBoxes[i]))
+								visit(i);
 						}
 					}
+					nearTris[j] = nearTri;
+					nearRs[j] = nearR;
 				}
-
-				//			if (bottomTri < 0)
-				//				continue;
-
-				if (nearV == nullptr)
-					continue;
-				// found soft-soft collision pair
-				topTets[j] = _vnt->getVertexTetrahedron(nearV->vertex);
-				const Vec3f* W = _vnt->getVertexWeight(nearV->vertex);
-				std::array<float, 3> tmp = { W->X, W->Y, W->Z };
-				topBarys[j] = tmp;
-				bottomTets[j] = _vnt->getVertexTetrahedron(b.vertex);
-				W = _vnt->getVertexWeight(b.vertex);
-				tmp = { W->X, W->Y, W->Z };
-				bottomBarys[j] = tmp;
-				Vec3f N = b.N * nearT;  // reverse sign of normal
-				tmp = { N.X, N.Y, N.Z };
-				collisionNormals[j] = tmp;
 			}
-		}
-	);
+		);
+	};
 
-	if (!collisionsFound)
-		return;
-	int offset = 0;
-	for (int n = topTets.size(), i = 0; i < n; ++i) {
-		if (topTets[i] > -1) {
-			topTets[offset] = topTets[i];
-			bottomTets[offset] = bottomTets[i];
-			topBarys[offset] = topBarys[i];
-			bottomBarys[offset] = bottomBarys[i];
-			collisionNormals[offset++] = collisionNormals[i];
-		}
+#ifdef SOFT_COLLISION_BENCHMARK
+	tbb::tick_count tb0 = tbb::tick_count::now();
+	findNearestTris(false);
+	tbb::tick_count tb1 = tbb::tick_count::now();
+	std::vector<int> bruteTris = nearTris;
+	findNearestTris(true);
+	tbb::tick_count tb2 = tbb::tick_count::now();
+	if (bruteTris != nearTris)
+		std::cout << "Soft collision BVH result differs from brute force search.\n";
+	_bruteTime += (tb1 - tb0).seconds();
+	_bvhTime += (tb2 - tb1).seconds();
+	if (++_benchFrames % 100 == 0)
+		std::cout << "Soft collision search over " << _benchFrames << " frames with " << _bedRays.size() << " bed rays and " << _flapBottomTris.size() << " flap triangles. Brute force average " << _bruteTime * 1000.0 / _benchFrames << " ms, BVH average " << _bvhTime * 1000.0 / _benchFrames << " ms.\n";
+#else
+	findNearestTris(true);
+#endif
+
+	std::vector<int> topTets, bottomTets;
+	std::vector<std::array<float, 3> > topBarys, bottomBarys, collisionNormals;
+	for (int n = (int)nearTris.size(), j = 0; j < n; ++j) {
+		if (nearTris[j] < 0)
+			continue;
+		// found soft-soft collision pair
+		const std::array<vertexRay*, 3>& tv = _flapBottomTris[nearTris[j]];
+		const Vec3f& R = nearRs[j];
+		vertexRay* nearV;
+		if (R[0] + R[1] < 0.66667f)
+			nearV = tv[0];
+		else if (R[0] > R[1])
+			nearV = tv[1];
+		else
+			nearV = tv[2];
+		const vertexRay& b = _bedRays[j];
+		topTets.push_back(_vnt->getVertexTetrahedron(nearV->vertex));
+		const Vec3f* W = _vnt->getVertexWeight(nearV->vertex);
+		std::array<float, 3> tmp = { W->X, W->Y, W->Z };
+		topBarys.push_back(tmp);
+		bottomTets.push_back(_vnt->getVertexTetrahedron(b.vertex));
+		W = _vnt->getVertexWeight(b.vertex);
+		tmp = { W->X, W->Y, W->Z };
+		bottomBarys.push_back(tmp);
+		Vec3f N = b.N * R[2];  // reverse sign of normal
+		tmp = { N.X, N.Y, N.Z };
+		collisionNormals.push_back(tmp);
 	}
-	topTets.resize(offset);
-	bottomTets.resize(offset);
-	topBarys.resize(offset);
-	bottomBarys.resize(offset);
-	collisionNormals.resize(offset);
+	if (topTets.empty())
+		return;
 
 //	tbb::tick_count t1 = tbb::tick_count::now();
 //	double time = (t1 - t0).seconds();
@@ -272,6 +278,110 @@ void tetCollisions::findSoftCollisionPairs() {
 	_ptp->currentSoftCollisionPairs(topTets, topBarys, bottomTets, bottomBarys, collisionNormals);
 }
 
+bool tetCollisions::bedRayHitsFlapTriangle(const vertexRay& b, const int tri, Vec3f& R) const {
+	const std::array<vertexRay*, 3>& tv = _flapBottomTris[tri];
+	if (b.N * (tv[0]->N + tv[1]->N + tv[2]->N) > 0.0f)
+		return false;
+	Mat3x3f C(tv[1]->P - tv[0]->P, tv[2]->P - tv[0]->P, b.N);
+	R = C.Robust_Solve_Linear_System(b.P - tv[0]->P);
+	if (R[0] < 1e-6f || R[1] < 1e-6f || R[2] < 1e-4f || R[0] + R[1] > 1.0f || R[0] > 1.0f || R[1] > 1.0f || R[2] > 1.0f)  // R[2] determines how deep the collision must go before processing triggered. Bigger makes less sticky.
+		return false;
+	return true;
+}
+
+void tetCollisions::buildFlapBvh() {
+	int n = (int)_flapBottomTris.size();
+	std::vector<Vec3f> centroids;
+	centroids.reserve(n);
+	for (int i = 0; i < n; ++i)
+		centroids.push_back((_flapBottomTris[i][0]->P + _flapBottomTris[i][1]->P + _flapBottomTris[i][2]->P) * (1.0f / 3.0f));
+	_flapBvhTris.clear();
+	_flapBvhTris.reserve(n);
+	for (int i = 0; i < n; ++i)
+		_flapBvhTris.push_back(i);
+	_flapBvh.clear();
+	_flapBvh.reserve(n > 0 ? 2 * n : 1);
+	if (n > 0)
+		buildFlapBvhNode(centroids, 0, n);
+	_flapBvhDirty = false;
+}
+
+int tetCollisions::buildFlapBvhNode(std::vector<Vec3f>& centroids, int begin, int end) {
+	constexpr int leafSize = 4;
+	int node = (int)_flapBvh.size();
+	_flapBvh.push_back(bvhNode());
+	bvhNode* bn = &_flapBvh[node];
+	bn->box.Empty_Box();
+	for (int i = begin; i < end; ++i)
+		bn->box.Enlarge_To_Include_Box(_flapBoxes[_flapBvhTris[i]]);
+	if (end - begin <= leafSize) {
+		bn->first = begin;
+		bn->count = end - begin;
+		return node;
+	}
+	// median split along the longest axis of the centroid bounds
+	boundingBox<float> cb;
+	cb.Empty_Box();
+	for (int i = begin; i < end; ++i)
+		cb.Enlarge_To_Include_Point(centroids[_flapBvhTris[i]].xyz);
+	float lengths[3];
+	cb.Edge_Lengths(lengths);
+	int axis = 0;
+	if (lengths[1] > lengths[axis])
+		axis = 1;
+	if (lengths[2] > lengths[axis])
+		axis = 2;
+	int mid = (begin + end) >> 1;
+	std::nth_element(_flapBvhTris.begin() + begin, _flapBvhTris.begin() + mid, _flapBvhTris.begin() + end, [&](int a, int b) {
+		return centroids[a][axis] < centroids[b][axis]; });
+	buildFlapBvhNode(centroids, begin, mid);  // always node + 1
+	int second = buildFlapBvhNode(centroids, mid, end);
+	bn = &_flapBvh[node];  // push_back may have reallocated
+	bn->first = second;
+	bn->count = 0;
+	return node;
+}
+
+void tetCollisions::refitFlapBvh() {
+	for (int i = (int)_flapBvh.size() - 1; i > -1; --i) {
+		bvhNode& bn = _flapBvh[i];
+		if (bn.count > 0) {
+			bn.box = _flapBoxes[_flapBvhTris[bn.first]];
+			for (int j = 1; j < bn.count; ++j)
+				bn.box.Enlarge_To_Include_Box(_flapBoxes[_flapBvhTris[bn.first + j]]);
+		}
+		else {
+			bn.box = _flapBvh[i + 1].box;
+			bn.box.Enlarge_To_Include_Box(_flapBvh[bn.first].box);
+		}
+	}
+}
+
+template<class Visitor>
+void tetCollisions::queryFlapBvh(const boundingBox<float>& bedBox, Visitor& visit) const {
+	if (_flapBvh.empty())
+		return;
+	int stack[64], top = 0;
+	stack[top++] = 0;
+	while (top > 0) {
+		int node = stack[--top];
+		const bvhNode& bn = _flapBvh[node];
+		if (!bedBox.Intersection(bn.box))
+			continue;
+		if (bn.count > 0) {
+			for (int j = 0; j < bn.count; ++j) {
+				int tri = _flapBvhTris[bn.first + j];
+				if (bedBox.Intersection(_flapBoxes[tri]))
+					visit(tri);
+			}
+		}
+		else {
+			assert(top < 63);
+			stack[top++] = bn.first;
+			stack[top++] = node + 1;
+		}
+	}
+}
 
 float tetCollisions::inverse_rsqrt(float number)
 {  // usual Quake cheat
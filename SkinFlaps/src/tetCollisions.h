@@ -3,6 +3,7 @@
 
 #include <vector>
 #include <array>
+#include "boundingBox.h"
 #include "Vec2f.h"
 #include "Vec3f.h"
 #include "Mat3x3f.h"
@@ -23,16 +24,19 @@ public:
 	void updateFixedCollisions(materialTriangles *mt, vnBccTetrahedra *vnt);  // must be done after every topo change
 	bool empty() { return _fixedCollisionSets.empty() && _bedRays.empty(); }
 	inline void setPdTetPhysics(pdTetPhysics *ptp) { _ptp = ptp; }
-	tetCollisions() : _itCount(0), _initialized(false), _minTime((double)FLT_MAX), _maxTime(0.0){
+	tetCollisions() : _itCount(0), _mt(nullptr), _vnt(nullptr), _ptp(nullptr), _initialized(false), _flapBvhDirty(true), _minTime((double)FLT_MAX), _maxTime(0.0){
 		_fixedCollisionSets.clear(); _flapBottomTris.clear();  // _bedVerts.clear(); _bedVerts.reserve(1024); 
+#ifdef SOFT_COLLISION_BENCHMARK
+		_bruteTime = 0.0; _bvhTime = 0.0; _benchFrames = 0;
+#endif
 	}
 	~tetCollisions() {}
 
 private:
 	int _itCount;
-	static materialTriangles *_mt;
-	static vnBccTetrahedra *_vnt;
-	static pdTetPhysics *_ptp;
+	materialTriangles *_mt;
+	vnBccTetrahedra *_vnt;
+	pdTetPhysics *_ptp;
 	bool _initialized;
 	Mat3x3f _rest[6];  // material inverses used to compute deformation gradients
 	struct vertexRay {
@@ -45,6 +49,26 @@ private:
 	std::vector<vertexRay> _bedRays;
 	std::vector<vertexRay> _flapBottomVerts;
 	std::vector<std::array<vertexRay*, 3> > _flapBottomTris;
+	// Flat bounding volume hierarchy over _flapBottomTris.  Nodes are stored in depth first order so a node's first child is always
+	// the next node and a reverse sweep refits children before parents.  Rebuilt only after initSoftCollisions(), refit every frame.
+	struct bvhNode {
+		boundingBox<float> box;
+		int first;  // leaf: first index into _flapBvhTris.  interior: index of second child
+		int count;  // leaf: number of triangles.  interior: 0
+	};
+	std::vector<bvhNode> _flapBvh;
+	std::vector<int> _flapBvhTris;
+	std::vector<boundingBox<float> > _flapBoxes;
+	bool _flapBvhDirty;
+	void buildFlapBvh();
+	void refitFlapBvh();
+	int buildFlapBvhNode(std::vector<Vec3f>& centroids, int begin, int end);
+	template<class Visitor> void queryFlapBvh(const boundingBox<float>& bedBox, Visitor& visit) const;
+	bool bedRayHitsFlapTriangle(const vertexRay& b, const int tri, Vec3f& R) const;  // R is (u, v, ray parameter) of hit
+#ifdef SOFT_COLLISION_BENCHMARK
+	double _bruteTime, _bvhTime;
+	int _benchFrames;
+#endif
 	std::vector<int> _topTets;
 	std::vector<Vec3f> _topBarys;
 	struct fixedCollisionSet {
@@ -89,12 +89,13 @@ public:
 		return tc;
 	}
 
-	inline void getBarycentricTetPosition(const int tet, const Vec3f &barycentricWeight, Vec3f &position)
-	{
+	inline void getBarycentricTetPosition(const int tet, const Vec3f &barycentricWeight, Vec3f &position, const Vec3f *nodeCoords = nullptr)
+	{  // nodeCoords replaces the node spatial coordinates, e.g. with a published snapshot of them
+		const Vec3f* nc = nodeCoords == nullptr ? _nodeSpatialCoords : nodeCoords;
 		const int *n = _tetNodes[tet].data();
-		position.set(_nodeSpatialCoords[n[0]] * (1.0f - barycentricWeight.X - barycentricWeight.Y - barycentricWeight.Z));
+		position.set(nc[n[0]] * (1.0f - barycentricWeight.X - barycentricWeight.Y - barycentricWeight.Z));
 		for (int i = 1; i < 4; ++i)
-			position += _nodeSpatialCoords[n[i]] * barycentricWeight[i - 1];
+			position += nc[n[i]] * barycentricWeight[i - 1];
 	}
 
 	inline void vertexBarycentricPosition(const int vertex, Vec3f &position)
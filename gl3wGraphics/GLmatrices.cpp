@@ -61,7 +61,7 @@ void GLmatrices::changeZoom(float dZoom)
 	MakePerspectiveMatrix(_angleRadians,_screenAspect,zmin,zfar);
 }
 
-void GLmatrices::setFrameAndRotation(GLfloat *rotMatrix)
+void GLmatrices::setFrameAndRotation(float *rotMatrix)
 {	// remember setProjectionMatrix() must be called first or will get undefined results
 	for(int i=0; i<16; ++i)
 		_rotNow[i]=_mFR[i] = rotMatrix[i];
@@ -4,21 +4,21 @@
 // Purpose: Rudimentary matrix handling for openGL purposes.
 //	Much of the code is modified from Richard Wright's excellent
 //	OpenGL Superbible fifth edition who should get much of the credit for this.
+//	Makes no openGL calls, so the simulation core can place its tool shapes without a GL context.
 
 #ifndef __GLMATRICES_H__
 #define __GLMATRICES_H__
 
 #include <math.h>
-#include <GL/gl3w.h>
 
 class GLmatrices
 {
 public:
 	void getDragVector(float dScreenX, float dScreenY, float (&position)[3], float (&dragVector)[3]);
 	void getViewVector(float (&view)[3]) {view[0]=_mFR[2]; view[1]=_mFR[6]; view[2]=_mFR[10];}		// unscaled
-	const GLfloat* getProjectionMatrix() {return &_mProj[0];}
-	const GLfloat* getFrameAndRotationMatrix() {return &_mFR[0];}
-	void setFrameAndRotation(GLfloat *rotMatrix);
+	const float* getProjectionMatrix() {return &_mProj[0];}
+	const float* getFrameAndRotationMatrix() {return &_mFR[0];}
+	void setFrameAndRotation(float *rotMatrix);
 	void setView(float angleRadians, float screenAspect);
 	void resetPerspective();	// must be called whenever scene changes
 	float getSceneRadius() {return _radius;}
@@ -36,14 +36,14 @@ public:
 
 private:
 	void MakePerspectiveMatrix(float fFov, float fAspect, float zMin, float zMax);
-	GLfloat _mProj[16],_mFR[16],_rotNow[16];
-	GLfloat _center[3];
-	GLfloat _zCenter,_radius;
+	float _mProj[16],_mFR[16],_rotNow[16];
+	float _center[3];
+	float _zCenter,_radius;
 	float _zmin,_angleRadians,_screenAspect;
 };
 
 // public functions
-	inline void loadIdentity4x4(GLfloat *mat)
+	inline void loadIdentity4x4(float *mat)
 	{
 		mat[0]=1.0f; mat[1]=0.0f; mat[2]=0.0f; mat[3]=0.0f; 
 		mat[4]=0.0f; mat[5]=1.0f; mat[6]=0.0f; mat[7]=0.0f; 
@@ -51,11 +51,11 @@ private:
 		mat[12]=0.0f; mat[13]=0.0f; mat[14]=0.0f; mat[15]=1.0f; 
 	}
 
-	inline void translateMatrix4x4(GLfloat *m, float x, float y, float z) {m[12]+=x; m[13]+=y; m[14]+=z;} // assume no perspective. Last row 0,0,0,1
+	inline void translateMatrix4x4(float *m, float x, float y, float z) {m[12]+=x; m[13]+=y; m[14]+=z;} // assume no perspective. Last row 0,0,0,1
 
-	inline void scaleMatrix4x4(GLfloat *m, float x, float y, float z) {m[0]*=x; m[4]*=x; m[8]*=x; m[1]*=y; m[5]*=y; m[9]*=y; m[2]*=z; m[6]*=z; m[10]*=z;} // assume no perspective. Last row 0,0,0,1
+	inline void scaleMatrix4x4(float *m, float x, float y, float z) {m[0]*=x; m[4]*=x; m[8]*=x; m[1]*=y; m[5]*=y; m[9]*=y; m[2]*=z; m[6]*=z; m[10]*=z;} // assume no perspective. Last row 0,0,0,1
 
-	inline void rotateMatrix4x4(GLfloat *m, char axis, float r) { // rotates matrix m r radians about axis. Assume no perspective. Last row 0,0,0,1
+	inline void rotateMatrix4x4(float *m, char axis, float r) { // rotates matrix m r radians about axis. Assume no perspective. Last row 0,0,0,1
 		int c1=0,c2=1;
 		float s=(float)sin(r),c= (float)cos(r);
 		if(axis=='x' || axis=='X') {c1=1; c2=2;}
@@ -67,7 +67,7 @@ private:
 		}
 	}
 
-	inline void axisAngleRotateMatrix4x4(GLfloat *m, float (&axis)[3], float angle) { // rotates matrix m angle radians about axis. Assume no perspective. Last row 0,0,0,1
+	inline void axisAngleRotateMatrix4x4(float *m, float (&axis)[3], float angle) { // rotates matrix m angle radians about axis. Assume no perspective. Last row 0,0,0,1
 		float x=axis[0],y=axis[1],z=axis[2],w;
 		w = x*x + y*y + z*z;
 		if(w<1e-10f)	return;
@@ -91,7 +91,7 @@ private:
 		}
 	}
 
-	static float glMatricesDetIJ(const GLfloat *m, const int i, const int j)
+	static float glMatricesDetIJ(const float *m, const int i, const int j)
 	{ // 3x3 determinant
 		int x, y, ii, jj;
 		float ret, mat[3][3];
@@ -114,7 +114,7 @@ private:
 		return ret;
 	}
 
-	inline void invertMatrix4x4(const GLfloat *m, GLfloat *mInverse)
+	inline void invertMatrix4x4(const float *m, float *mInverse)
 	{
 		int i, j;
 		float det, detij;
@@ -136,7 +136,7 @@ private:
 		}
 	}
 
-	inline void transformVector4(const float (&v)[4], const GLfloat *m, float (&vOut)[4])
+	inline void transformVector4(const float (&v)[4], const float *m, float (&vOut)[4])
 	{
 		vOut[0] = m[0] * v[0] + m[4] * v[1] + m[8] *  v[2] + m[12] * v[3]; 
 		vOut[1] = m[1] * v[0] + m[5] * v[1] + m[9] *  v[2] + m[13] * v[3];	
@@ -144,7 +144,7 @@ private:
 		vOut[3] = m[3] * v[0] + m[7] * v[1] + m[11] * v[2] + m[15] * v[3];
     }
 
-	inline void transformVector3(const float (&v)[3], const GLfloat *m, float (&vOut)[3])
+	inline void transformVector3(const float (&v)[3], const float *m, float (&vOut)[3])
 	{ // assumes no perspective in m and v[3]==1
 		vOut[0] = m[0] * v[0] + m[4] * v[1] + m[8] *  v[2] + m[12]; 
 		vOut[1] = m[1] * v[0] + m[5] * v[1] + m[9] *  v[2] + m[13];	
@@ -77,14 +77,6 @@ void sceneNode::draw(void) {
 //		std::cout << "Graphics draw error code number " << errCode << "\n";
 }
 
-void sceneNode::setType(nodeType type) {
-	_type = type;
-	if (type == sceneNode::nodeType::STATIC_TRIANGLES || type == sceneNode::nodeType::MATERIAL_TRIANGLES)
-		_coloredNotTextured = false;
-	else
-		_coloredNotTextured = true;
-}
-
 void sceneNode::getBounds(GLfloat(&center)[3], GLfloat& radius, bool recomputeAll)
 {
 	if (recomputeAll || !_boundsComputed)
@@ -99,12 +91,8 @@ void sceneNode::getBounds(GLfloat(&center)[3], GLfloat& radius, bool recomputeAl
 sceneNode::sceneNode() : _radius(-1.0f)
 {
 	_boundsComputed = false;
-	loadIdentity4x4(_pat);
-	_coloredNotTextured = true;
 	_glslProgram = 0;
 	textureBuffers.clear();
-	_color[0] = 1.0f; _color[1] = 1.0f; _color[2] = 1.0f; _color[3] = 1.0f;
-	visible = true;
 	vertexArrayBufferObject = 0;
 	bufferObjects.clear();
 }
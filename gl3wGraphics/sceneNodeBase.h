@@ -0,0 +1,43 @@
+// File: sceneNodeBase.h
+// Purpose: The part of every sceneNode with no openGL in it: its type, name, visibility, color and local
+//    position attitude transform. The simulation core keeps its hook, suture and fence shapes as these so it
+//    can place and color them without a GL context. sceneNode adds the buffers and the drawing.
+
+#ifndef __SCENENODEBASE_H__
+#define __SCENENODEBASE_H__
+
+#include <string>
+#include "GLmatrices.h"
+
+class sceneNodeBase
+{
+public:
+	enum class nodeType{ CONE, SPHERE, CYLINDER, TRISTRIP, LINES, STATIC_TRIANGLES, MATERIAL_TRIANGLES };
+	bool visible;
+	inline void setType(nodeType type) {
+		_type = type;
+		_coloredNotTextured = !(type == nodeType::STATIC_TRIANGLES || type == nodeType::MATERIAL_TRIANGLES);
+	}
+	inline nodeType getType() {return _type;}
+	void setName(const char *name) {_name=name;}
+	const std::string& getName() {return _name;}
+	inline float* getModelViewMatrix() {return _pat;}
+	inline bool coloredNotTextured() {return _coloredNotTextured; }
+	float* getColor() {return _color;}
+	inline void setColor(float (&color)[4]) {_color[0]=color[0]; _color[1]=color[1]; _color[2]=color[2]; _color[3]=color[3];}
+	sceneNodeBase() : visible(true), _type(nodeType::SPHERE), _coloredNotTextured(true)
+	{
+		loadIdentity4x4(_pat);
+		_color[0] = 1.0f; _color[1] = 1.0f; _color[2] = 1.0f; _color[3] = 1.0f;
+	}
+	~sceneNodeBase() {}
+
+protected:
+	nodeType _type;
+	bool _coloredNotTextured;
+	std::string _name;
+	float _pat[16];	// GL matrix for local position attitude transform
+	float _color[4];
+};
+
+#endif	// __SCENENODEBASE_H__
@@ -337,13 +337,13 @@ bool surgGraphics::setTextureFilesCreateProgram(std::vector<int> &textureIds, co
 
 void surgGraphics::setNewTopology()
 {
-	// can't _mt.partitionTriangleMaterials() as it invalidates adjacency arrays
-	_mt.findAdjacentTriangles(true);
+	// can't _mt->partitionTriangleMaterials() as it invalidates adjacency arrays
+	_mt->findAdjacentTriangles(true);
 	_tris.clear();
 	_xyz1.clear();
 	_uv.clear();
 	_incisionLines.clear();
-	auto mtta = _mt.getTextureArray();
+	auto mtta = _mt->getTextureArray();
 	int n = (int)mtta.size();
 	_uv.reserve(n << 1);
 	for (auto uvit = mtta.begin(); uvit != mtta.end(); ++uvit) {
@@ -354,11 +354,11 @@ void surgGraphics::setNewTopology()
 	_xyz1.assign(n << 2, 1.0f);
 	_uvPos.clear();
 	_uvPos.assign(n, -1);
-//	auto trArr = _mt.getPositionArray();
+//	auto trArr = _mt->getPositionArray();
 	_tris.reserve(n*3);
-	auto trPos = _mt.getTrianglePositionArray();
-	auto trMat = _mt.getTriangleMaterialArray();
-	auto trTex = _mt.getTriangleTextureArray();
+	auto trPos = _mt->getTrianglePositionArray();
+	auto trMat = _mt->getTriangleMaterialArray();
+	auto trTex = _mt->getTriangleTextureArray();
 	for(int n = (int)trTex.size(), i=0; i<n; ++i) {
 		// include possible deleted triangles so numbering matches up.
 		bool valid = true;
@@ -398,15 +398,15 @@ void surgGraphics::setNewTopology()
 void surgGraphics::getSkinIncisionLines() {
 	_incisionLines.clear();  // indexes into incision lines. 0xffffffff is primitive restart index.
 	std::map<int, int> triEdges, vTex;
-	for (int n = _mt.numberOfTriangles(), i = 0; i < n; ++i) {
-		int mat = _mt.triangleMaterial(i);
+	for (int n = _mt->numberOfTriangles(), i = 0; i < n; ++i) {
+		int mat = _mt->triangleMaterial(i);
 		if (mat < 0)
 			continue;
 		int at[3], ae[3];
-		_mt.triangleAdjacencies(i, at, ae);  // triAdjs(i);
-		const int* tr = _mt.triangleVertices(at[0]), * tx = _mt.triangleTextures(at[0]);
+		_mt->triangleAdjacencies(i, at, ae);  // triAdjs(i);
+		const int* tr = _mt->triangleVertices(at[0]), * tx = _mt->triangleTextures(at[0]);
 		if (mat == 3) {  // surface skin incision . 2-3 pair
-			if (_mt.triangleMaterial(at[0]) != 2)  // incision convention
+			if (_mt->triangleMaterial(at[0]) != 2)  // incision convention
 				continue;
 			int first = tr[ae[0]], second = tr[(ae[0] + 1) % 3];
 			triEdges.insert(std::make_pair(first, second));
@@ -414,7 +414,7 @@ void surgGraphics::getSkinIncisionLines() {
 		}
 		if (mat == 6) {  // deep incision. 5-6, 6-7, or 6-8 pair
 			for (int j = 0; j < 3; ++j) {
-				int aMat = _mt.triangleMaterial(at[j]);
+				int aMat = _mt->triangleMaterial(at[j]);
 				if (aMat == 6 || aMat == 3)  // any different material except 3 which is a non-undermined deep cut
 					continue;
 				int first = tr[ae[j]], second = tr[(ae[j] + 1) % 3];
@@ -464,7 +464,7 @@ void surgGraphics::updatePositionsNormalsTangents()  // bool doTangents now alwa
 	for (int m = (int)_uvPos.size(), i = 0; i < m; ++i) {
 		if (_uvPos[i] < 0)
 			continue;
-		float* fp = _mt.vertexCoordinate(_uvPos[i]);
+		float* fp = _mt->vertexCoordinate(_uvPos[i]);
 		for (int j = 0; j < 3; ++j)
 			_xyz1[(i << 2) + j] = fp[j];
 	}
@@ -561,7 +561,7 @@ void surgGraphics::updatePositionsNormalsTangents()  // bool doTangents now alwa
 
 void surgGraphics::getTextureSeams() {
 	// vertex positions with multiple textures of same material (2 or 5 guaranteed exclusive) associated with them for normal and tangent blending
-//	_mt.findAdjacentTriangles(true);  // not necessary. done in calling routine
+//	_mt->findAdjacentTriangles(true);  // not necessary. done in calling routine
 	auto addSeamVert = [&](int vPos, int tex0, int tex1) {
 		auto pr = _textureSeams.insert(std::make_pair(vPos, std::list<int>()));
 		if (tex0 > tex1) { int tmp = tex1; tex1 = tex0; tex0 = tmp; }
@@ -581,18 +581,18 @@ void surgGraphics::getTextureSeams() {
 				tit = pr.first->second.insert(tit, tex1);
 		}
 	};
-	for (int n = _mt.numberOfTriangles(), i = 0; i < n; ++i) {
-		int at[3], ae[3], mat0 = _mt.triangleMaterial(i);
+	for (int n = _mt->numberOfTriangles(), i = 0; i < n; ++i) {
+		int at[3], ae[3], mat0 = _mt->triangleMaterial(i);
 		if (mat0 != 2 && mat0 != 5)
 			continue;
-		_mt.triangleAdjacencies(i, at, ae);
-		int *tx0 = _mt.triangleTextures(i);
+		_mt->triangleAdjacencies(i, at, ae);
+		int *tx0 = _mt->triangleTextures(i);
 		for (int j = 0; j < 3; ++j) {
-			if (_mt.triangleMaterial(at[j]) != mat0)
+			if (_mt->triangleMaterial(at[j]) != mat0)
 				continue;
-			int* tx1 = _mt.triangleTextures(at[j]);
+			int* tx1 = _mt->triangleTextures(at[j]);
 			if (tx0[j] != tx1[(ae[j] + 1) % 3])
-				addSeamVert(_mt.triangleVertices(i)[j], tx0[j], tx1[(ae[j] + 1) % 3]);
+				addSeamVert(_mt->triangleVertices(i)[j], tx0[j], tx1[(ae[j] + 1) % 3]);
 		}
 	}
 }
@@ -607,13 +607,13 @@ void surgGraphics::draw(void)
 	GLuint start = 0, end = 0;
 	glEnable(GL_POLYGON_OFFSET_FILL);
 	glPolygonOffset(1.0, 1.0);
-	int mat = -1, t=0, nTris = _mt.numberOfTriangles();
+	int mat = -1, t=0, nTris = _mt->numberOfTriangles();
 	while (t < nTris){
-		int tMat = _mt.triangleMaterial(t);
+		int tMat = _mt->triangleMaterial(t);
 		if (tMat < 0){  // deleted triangle
 			end = (t << 1) + t;
 			glDrawElements(GL_TRIANGLES, (GLsizei)(end - start), GL_UNSIGNED_INT, (const GLvoid*)(sizeof(GLuint)*start));
-			while (t<nTris && _mt.triangleMaterial(t) < 0)
+			while (t<nTris && _mt->triangleMaterial(t) < 0)
 				++t;
 			start = (t << 1) + t;
 			continue;
@@ -624,7 +624,7 @@ void surgGraphics::draw(void)
 			start = (t<<1) + t;
 			++t;
 		}
-		while (t<nTris && mat == _mt.triangleMaterial(t))
+		while (t<nTris && mat == _mt->triangleMaterial(t))
 			++t;
 		end = (t << 1) + t;
 		glDrawElements(GL_TRIANGLES, (GLsizei)(end - start), GL_UNSIGNED_INT, (const GLvoid*)(sizeof(GLuint)*start));
@@ -673,7 +673,7 @@ void surgGraphics::computeLocalBounds()
 	_sn->setLocalBounds(lc, radius);
 }
 
-surgGraphics::surgGraphics() : _undermineTriangles(NULL), _sn(nullptr)
+surgGraphics::surgGraphics() : _mt(nullptr), _undermineTriangles(NULL), _sn(nullptr)
 {
 	_incis.setSurgGraphics(this);
 }
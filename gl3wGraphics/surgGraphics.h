@@ -54,7 +54,8 @@ public:
 	void setNewTopology();
 	void updatePositionsNormalsTangents();
 	inline 	incisionLines* getIncisionLines() { return &_incis; }
-	inline materialTriangles* getMaterialTriangles() {return & _mt;}  // gets the material triangles data class
+	inline void setMaterialTriangles(materialTriangles* mt) { _mt = mt; }  // owned by the simulation. Must be set before setNewTopology().
+	inline materialTriangles* getMaterialTriangles() {return _mt;}  // gets the material triangles data class
 	inline sceneNode* getSceneNode() { return _sn.get(); }
 	void setGl3wGraphics(gl3wGraphics *gl3w) { _gl3w = gl3w; }  // must be set before using this class for graphics output
 	surgGraphics(void);
@@ -63,7 +64,7 @@ public:
 private:
 	static const GLchar *skinVertexShader;
 	static const GLchar *skinFragmentShader;
-	materialTriangles _mt;
+	materialTriangles *_mt;
 	gl3wGraphics *_gl3w;
 	std::shared_ptr<sceneNode> _sn;
 	std::vector<GLuint> _tris;  // 0xffffffff signals a deleted triangle
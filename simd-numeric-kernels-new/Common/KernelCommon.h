@@ -41,8 +41,10 @@
 
 #if defined(ENABLE_MIC_INSTRUCTION_SET)
 #include <immintrin.h>
+#if defined(_MSC_VER) || defined(__INTEL_COMPILER)
 #include <zmmintrin.h>
 #endif
+#endif
 
 //#include "NumberPolicy.h"
 #include "Mask.h"
@@ -0,0 +1,84 @@
+#include <cstdlib>
+#include <cmath>
+#include <iostream>
+#include "Add_Force.h"
+
+template < class T > T Get_Random (const T a = (T) - 1., const T b = (T) 1.)
+{
+  return ((b - a) * (T) rand ()) / (T) RAND_MAX + a;
+}
+
+// Compares the Add_Force instances built for every instruction set the cpu supports
+// against the scalar instance, on blocks of randomly deformed elements.
+int
+main (int argc, char *argv[])
+{
+  typedef float T;
+  constexpr int BlockWidth = 16;
+
+  int seed = 1;
+  if (argc == 2)
+    seed = atoi (argv[1]);
+  srand (seed);
+
+  const T threshold = 1e-4;
+  const SIMDArchitectureType best = Detect_SIMD_Architecture ();
+  std::cout << "Running Unit Test for Add_Force, widest instruction set " << (int) best << std::endl;
+
+  for (int test = 0; test < 100; test++)
+    {
+      alignas (64) T x[4][3][BlockWidth];
+      alignas (64) T DmInverse[9][BlockWidth];
+      alignas (64) T restVolume[BlockWidth];
+      alignas (64) T muLow[BlockWidth];
+      alignas (64) T muHigh[BlockWidth];
+      alignas (64) T strainMin[BlockWidth];
+      alignas (64) T strainMax[BlockWidth];
+      alignas (64) T f_reference[4][3][BlockWidth];
+      alignas (64) T f[4][3][BlockWidth];
+
+      for (int e = 0; e < BlockWidth; e++)
+        {
+          // rest shape is the unit corner tetrahedron, so DmInverse is the identity up to a perturbation
+          for (int v = 0; v < 4; v++)
+            for (int i = 0; i < 3; i++)
+              x[v][i][e] = (v == i + 1 ? (T) 1 : (T) 0) + Get_Random < T > ((T) -.3, (T) .3);
+          for (int i = 0; i < 9; i++)
+            DmInverse[i][e] = (i % 4 == 0 ? (T) 1 : (T) 0) + Get_Random < T > ((T) -.1, (T) .1);
+          restVolume[e] = Get_Random < T > ((T) .1, (T) 1);
+          muLow[e] = Get_Random < T > ((T) 0, (T) 1);
+          muHigh[e] = Get_Random < T > ((T) 1, (T) 10);
+          strainMin[e] = Get_Random < T > ((T) .5, (T) .9);
+          strainMax[e] = Get_Random < T > ((T) 1.1, (T) 2);
+          for (int v = 0; v < 4; v++)
+            for (int i = 0; i < 3; i++)
+              f_reference[v][i][e] = (T) 0;
+        }
+
+      Select_Add_Force_Block < T, BlockWidth > (SIMDArchitectureType::Scalar)
+        (x, DmInverse, restVolume, muLow, muHigh, strainMin, strainMax, f_reference);
+
+      for (int a = (int) SIMDArchitectureType::AVX2; a <= (int) best; a++)
+        {
+          for (int v = 0; v < 4; v++)
+            for (int i = 0; i < 3; i++)
+              for (int e = 0; e < BlockWidth; e++)
+                f[v][i][e] = (T) 0;
+
+          Select_Add_Force_Block < T, BlockWidth > ((SIMDArchitectureType) a)
+            (x, DmInverse, restVolume, muLow, muHigh, strainMin, strainMax, f);
+
+          for (int v = 0; v < 4; v++)
+            for (int i = 0; i < 3; i++)
+              for (int e = 0; e < BlockWidth; e++)
+                if (std::abs (f[v][i][e] - f_reference[v][i][e]) > threshold * (1 + std::abs (f_reference[v][i][e])))
+                  {
+                    std::cout << "Failed to confirm unit test for Add_Force, instruction set " << a
+                      << " element " << e << " : " << f[v][i][e] << " vs " << f_reference[v][i][e] << std::endl;
+                    return 1;
+                  }
+        }
+    }
+
+  return 0;
+}